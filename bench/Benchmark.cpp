@@ -0,0 +1,446 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+// Headless benchmark of the renderer
+// RenderFrontend is brought up with PostInitHeadless on a Vulkan device, lavapipe by default,
+// and every frame goes through the real BeginFrame, RenderViews and EndFrameAndPresent.
+// Draws, state changes, uploads and submissions are read from the frontend's own command stats
+// On a software device the GPU runs on the CPU too, so the frame times include it
+//
+// Usage: BtxRendererBench [--entities 1000,10000,100000] [--faces 1,8] [--views 1,4]
+//                         [--frames 100] [--dynamic 0.1] [--batch 0.5] [--data <directory with shaders/vk>]
+//                         [--hardware] [--output results.json]
+
+#include "Precompiled.hpp"
+#include "RenderFrontend.hpp"
+#include "Material.hpp"
+#include "EntityTree.hpp"
+#include "HeadlessEngine.hpp"
+#include <charconv>
+#include <chrono>
+#include <random>
+
+namespace
+{
+	struct BenchConfig
+	{
+		Vector<uint32_t> entityCounts{ 1000U, 10000U, 100000U };
+		Vector<uint32_t> faceCounts{ 1U, 8U };
+		Vector<uint32_t> viewCounts{ 1U, 4U };
+		uint32_t frames{ 100U };
+		float dynamicFraction{ 0.1f };
+		// Of the entities that don't move, this many are merged into a batch
+		float batchFraction{ 0.0f };
+		Path dataDirectory{ "." };
+		bool hardware{ false };
+		String outputPath{};
+	};
+
+	struct BenchResult
+	{
+		uint32_t entities{ 0U };
+		uint32_t faces{ 0U };
+		uint32_t views{ 0U };
+		uint32_t frames{ 0U };
+
+		double cpuMsMin{ DBL_MAX };
+		double cpuMsAvg{ 0.0 };
+		double cpuMsMax{ 0.0 };
+
+		// Per-frame averages
+		double draws{ 0.0 };
+		double stateChanges{ 0.0 };
+		double uploadBytes{ 0.0 };
+		double dispatches{ 0.0 };
+		double submissions{ 0.0 };
+
+		// One-off, when the scene is built
+		size_t modelUploadBytes{ 0U };
+	};
+
+	constexpr uint32_t ViewWidth = 640U;
+	constexpr uint32_t ViewHeight = 360U;
+	// 32x32 quads per face, 1089 vertices
+	constexpr uint32_t FaceGridSize = 32U;
+	constexpr float WorldSize = 4096.0f;
+
+	const char* const Usage =
+		"Usage: BtxRendererBench [--entities 1000,10000,100000] [--faces 1,8] [--views 1,4]\n"
+		"                        [--frames 100] [--dynamic 0.1] [--batch 0.5] [--data <directory with shaders/vk>]\n"
+		"                        [--hardware] [--output results.json]\n";
+
+	Mat4 MakeTranslation( const Vec3& position )
+	{
+		return Mat4(
+			Vec4( 1.0f, 0.0f, 0.0f, 0.0f ),
+			Vec4( 0.0f, 1.0f, 0.0f, 0.0f ),
+			Vec4( 0.0f, 0.0f, 1.0f, 0.0f ),
+			Vec4( position.x, position.y, position.z, 1.0f ) );
+	}
+
+	// Camera looking along a horizontal axis, Z up. Matrices are written out as columns
+	Mat4 MakeViewMatrix( const Vec3& origin, uint32_t direction )
+	{
+		static const Vec3 Forwards[4] = { { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { -1.0f, 0.0f, 0.0f }, { 0.0f, -1.0f, 0.0f } };
+		static const Vec3 Rights[4] = { { 0.0f, -1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { -1.0f, 0.0f, 0.0f } };
+		const Vec3& f = Forwards[direction % 4U];
+		const Vec3& r = Rights[direction % 4U];
+		const Vec3 u = { 0.0f, 0.0f, 1.0f };
+
+		const auto dot = []( const Vec3& a, const Vec3& b )
+		{
+			return a.x * b.x + a.y * b.y + a.z * b.z;
+		};
+
+		return Mat4(
+			Vec4( r.x, u.x, f.x, 0.0f ),
+			Vec4( r.y, u.y, f.y, 0.0f ),
+			Vec4( r.z, u.z, f.z, 0.0f ),
+			Vec4( -dot( r, origin ), -dot( u, origin ), -dot( f, origin ), 1.0f ) );
+	}
+
+	// Depth range of [0, 1]
+	Mat4 MakeProjection( float fovDegrees, float aspect, float nearZ, float farZ )
+	{
+		const float sy = 1.0f / std::tan( fovDegrees * 0.5f * 3.14159265f / 180.0f );
+		const float sx = sy / aspect;
+		const float a = farZ / (farZ - nearZ);
+
+		return Mat4(
+			Vec4( sx, 0.0f, 0.0f, 0.0f ),
+			Vec4( 0.0f, sy, 0.0f, 0.0f ),
+			Vec4( 0.0f, 0.0f, a, 1.0f ),
+			Vec4( 0.0f, 0.0f, -a * nearZ, 0.0f ) );
+	}
+
+	// Per-frame average of a counter between two snapshots of the totals
+	double PerFrame( const CommandStats::Counters& before, const CommandStats::Counters& after, RenderCommand command, bool value, double frames )
+	{
+		const uint64_t start = value ? before.GetValue( command ) : before.GetCount( command );
+		const uint64_t end = value ? after.GetValue( command ) : after.GetCount( command );
+		return double( end - start ) / frames;
+	}
+
+	BenchResult RunScene( RenderFrontend& frontend, uint32_t numEntities, uint32_t numFaces, uint32_t numViews, const BenchConfig& config )
+	{
+		BenchResult result;
+		result.entities = numEntities;
+		result.faces = numFaces;
+		result.views = numViews;
+		result.frames = config.frames;
+
+		// Fixed seed, so runs are comparable
+		std::mt19937 random( 1337U );
+		std::uniform_real_distribution<float> position( 0.0f, WorldSize );
+		std::uniform_real_distribution<float> step( -8.0f, 8.0f );
+
+		// Each face gets its own material, so draws switch materials like in a real level
+		Headless::SyntheticModel modelAsset( format( "synthetic_%u_faces", numFaces ), numFaces, FaceGridSize );
+		result.modelUploadBytes = modelAsset.GetDataSize();
+		IModel* model = frontend.CreateModel( &modelAsset );
+		if ( nullptr == model )
+		{
+			std::fprintf( stderr, "Could not create the synthetic model\n" );
+			return result;
+		}
+
+		Vector<Material*> materials;
+		for ( uint32_t face = 0U; face < numFaces; face++ )
+		{
+			MaterialDesc materialDesc;
+			materialDesc.colour = Vec4( float( face ) / float( numFaces ), 0.5f, 1.0f, 1.0f );
+			materials.push_back( frontend.CreateMaterial( materialDesc ) );
+			frontend.SetFaceMaterial( model, face, materials.back() );
+		}
+
+		Vector<IEntity*> entities;
+		entities.reserve( numEntities );
+		for ( uint32_t i = 0U; i < numEntities; i++ )
+		{
+			EntityDesc desc;
+			desc.model = model;
+			desc.transform = MakeTranslation( { position( random ), position( random ), 0.0f } );
+			entities.push_back( frontend.CreateEntity( desc ) );
+		}
+
+		// The first entities are the moving ones, a part of the rest is batched and then destroyed
+		const uint32_t numDynamic = uint32_t( numEntities * config.dynamicFraction );
+		const uint32_t numBatched = uint32_t( (numEntities - numDynamic) * config.batchFraction );
+		IBatch* batch = nullptr;
+		if ( numBatched > 0U )
+		{
+			const Vector<IEntity*> batched( entities.end() - numBatched, entities.end() );
+			batch = frontend.CreateBatch( BatchDesc(), batched );
+			for ( IEntity* entity : batched )
+			{
+				frontend.DestroyEntity( entity );
+			}
+			entities.resize( entities.size() - numBatched );
+		}
+
+		Vector<Vec3> dynamicPositions( numDynamic );
+		for ( auto& dynamicPosition : dynamicPositions )
+		{
+			dynamicPosition = { position( random ), position( random ), 0.0f };
+		}
+
+		// Cameras spread around the middle of the world, each looking a different way
+		Vector<IView*> views;
+		Vector<const IView*> viewList;
+		const Mat4 projection = MakeProjection( 90.0f, float( ViewWidth ) / float( ViewHeight ), 1.0f, WorldSize );
+		for ( uint32_t view = 0U; view < numViews; view++ )
+		{
+			ViewDesc viewDesc;
+			viewDesc.viewportSize = Vec2( float( ViewWidth ), float( ViewHeight ) );
+			views.push_back( frontend.CreateView( viewDesc ) );
+			viewList.push_back( views.back() );
+
+			const float offset = WorldSize * 0.25f * float( view / 4U );
+			const Vec3 origin = { WorldSize * 0.5f + offset, WorldSize * 0.5f, 32.0f };
+			frontend.SetViewTransform( views.back(), origin, MakeViewMatrix( origin, view ), projection );
+		}
+
+		// Loading and setup aren't part of the frame numbers
+		const CommandStats::Counters before = frontend.GetCommandStats().GetTotal();
+		double totalMs = 0.0;
+		for ( uint32_t frame = 0U; frame < config.frames; frame++ )
+		{
+			const auto start = std::chrono::steady_clock::now();
+
+			frontend.BeginFrame();
+			for ( uint32_t i = 0U; i < numDynamic; i++ )
+			{
+				Vec3& dynamicPosition = dynamicPositions[i];
+				dynamicPosition = { dynamicPosition.x + step( random ), dynamicPosition.y + step( random ), 0.0f };
+				entities[i]->GetDesc().transform = MakeTranslation( dynamicPosition );
+			}
+			frontend.RenderViews( viewList );
+			frontend.EndFrameAndPresent( viewList[0] );
+
+			const double ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+			result.cpuMsMin = std::min( result.cpuMsMin, ms );
+			result.cpuMsMax = std::max( result.cpuMsMax, ms );
+			totalMs += ms;
+		}
+		const CommandStats::Counters after = frontend.GetCommandStats().GetTotal();
+
+		const double frames = std::max( config.frames, 1U );
+		result.cpuMsAvg = totalMs / frames;
+		result.draws = PerFrame( before, after, RenderCommand::DrawIndexed, false, frames );
+		result.stateChanges = PerFrame( before, after, RenderCommand::SetGraphicsState, false, frames );
+		result.uploadBytes = PerFrame( before, after, RenderCommand::WriteBuffer, true, frames );
+		result.dispatches = PerFrame( before, after, RenderCommand::Dispatch, false, frames );
+		result.submissions = PerFrame( before, after, RenderCommand::ExecuteCommandList, false, frames );
+
+		// Through the public API as well, the next scene starts from an empty frontend
+		for ( IView* view : views )
+		{
+			frontend.DestroyView( view );
+		}
+		for ( IEntity* entity : entities )
+		{
+			frontend.DestroyEntity( entity );
+		}
+		if ( nullptr != batch )
+		{
+			frontend.DestroyBatch( batch );
+		}
+		for ( Material* material : materials )
+		{
+			frontend.DestroyMaterial( material );
+		}
+		frontend.DestroyModel( model );
+
+		return result;
+	}
+
+	// Whole input or nothing, so "10k" isn't silently read as 10
+	template<typename T>
+	bool ParseValue( StringView text, T& outValue )
+	{
+		const char* end = text.data() + text.size();
+		const auto [last, error] = std::from_chars( text.data(), end, outValue );
+		return error == std::errc() && last == end;
+	}
+
+	bool ParseList( StringView text, Vector<uint32_t>& outValues )
+	{
+		outValues.clear();
+		while ( !text.empty() )
+		{
+			const size_t comma = std::min( text.find( ',' ), text.size() );
+			uint32_t value = 0U;
+			if ( !ParseValue( text.substr( 0U, comma ), value ) )
+			{
+				return false;
+			}
+
+			outValues.push_back( value );
+			text.remove_prefix( std::min( comma + 1U, text.size() ) );
+		}
+
+		return !outValues.empty();
+	}
+
+	bool ParseArguments( int argc, char** argv, BenchConfig& config )
+	{
+		for ( int i = 1; i < argc; i++ )
+		{
+			const StringView argument = argv[i];
+			if ( argument == "--hardware" )
+			{
+				config.hardware = true;
+				continue;
+			}
+
+			if ( i + 1 >= argc )
+			{
+				std::fprintf( stderr, "Missing value for '%s'\n", argv[i] );
+				return false;
+			}
+
+			const char* value = argv[++i];
+			bool valid = true;
+			if ( argument == "--entities" )
+			{
+				valid = ParseList( value, config.entityCounts );
+			}
+			else if ( argument == "--faces" )
+			{
+				valid = ParseList( value, config.faceCounts );
+			}
+			else if ( argument == "--views" )
+			{
+				valid = ParseList( value, config.viewCounts );
+			}
+			else if ( argument == "--frames" )
+			{
+				valid = ParseValue( value, config.frames );
+			}
+			else if ( argument == "--dynamic" )
+			{
+				valid = ParseValue( value, config.dynamicFraction );
+				config.dynamicFraction = std::clamp( config.dynamicFraction, 0.0f, 1.0f );
+			}
+			else if ( argument == "--batch" )
+			{
+				valid = ParseValue( value, config.batchFraction );
+				config.batchFraction = std::clamp( config.batchFraction, 0.0f, 1.0f );
+			}
+			else if ( argument == "--data" )
+			{
+				config.dataDirectory = value;
+			}
+			else if ( argument == "--output" )
+			{
+				config.outputPath = value;
+			}
+			else
+			{
+				std::fprintf( stderr, "Unknown argument '%s'\n", argv[i - 1] );
+				return false;
+			}
+
+			if ( !valid )
+			{
+				std::fprintf( stderr, "Invalid value '%s' for '%s'\n", value, argv[i - 1] );
+				return false;
+			}
+		}
+
+		// The views are rendered in one go, see RenderViews
+		for ( const uint32_t views : config.viewCounts )
+		{
+			if ( 0U == views || views > EntityTree::MaxFrusta )
+			{
+				std::fprintf( stderr, "View counts must be 1 to %u\n", EntityTree::MaxFrusta );
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	String ToJson( const Vector<BenchResult>& results, const String& deviceName )
+	{
+		String json = format( "{\n\t\"device\": \"%s\",\n\t\"results\": [\n", deviceName.c_str() );
+		for ( size_t i = 0U; i < results.size(); i++ )
+		{
+			const BenchResult& r = results[i];
+			json += format( "\t\t{ \"entities\": %u, \"faces\": %u, \"views\": %u, \"frames\": %u, "
+				"\"cpuMsPerFrame\": { \"min\": %.4f, \"avg\": %.4f, \"max\": %.4f }, "
+				"\"draws\": %.1f, \"stateChanges\": %.1f, \"uploadBytes\": %.1f, \"dispatches\": %.1f, \"submissions\": %.1f, "
+				"\"modelUploadBytes\": %zu }%s\n",
+				r.entities, r.faces, r.views, r.frames,
+				r.cpuMsMin, r.cpuMsAvg, r.cpuMsMax,
+				r.draws, r.stateChanges, r.uploadBytes, r.dispatches, r.submissions,
+				r.modelUploadBytes, i + 1U < results.size() ? "," : "" );
+		}
+		json += "\t]\n}\n";
+
+		return json;
+	}
+}
+
+int main( int argc, char** argv )
+{
+	BenchConfig config;
+	if ( !ParseArguments( argc, argv, config ) )
+	{
+		std::fputs( Usage, stderr );
+		return 1;
+	}
+
+	Headless::VulkanDevice device;
+	if ( !device.Create( !config.hardware ) )
+	{
+		return 1;
+	}
+
+	Headless::Console console;
+	Headless::FileSystem fileSystem;
+	fileSystem.root = config.dataDirectory;
+
+	EngineAPI api{};
+	api.console = &console;
+	api.fileSystem = &fileSystem;
+
+	RenderFrontend frontend;
+	if ( !frontend.Init( api ) || !frontend.PostInitHeadless( device.Get(), ViewWidth, ViewHeight ) )
+	{
+		std::fprintf( stderr, "Could not bring up the frontend, are the shaders in '%s'?\n", config.dataDirectory.string().c_str() );
+		return 1;
+	}
+
+	Vector<BenchResult> results;
+	for ( const uint32_t entities : config.entityCounts )
+	{
+		for ( const uint32_t faces : config.faceCounts )
+		{
+			for ( const uint32_t views : config.viewCounts )
+			{
+				std::fprintf( stderr, "Running %u entities, %u faces, %u views...\n", entities, faces, views );
+				results.push_back( RunScene( frontend, entities, faces, views, config ) );
+			}
+		}
+	}
+
+	frontend.Shutdown();
+
+	const String json = ToJson( results, device.GetName() );
+	if ( config.outputPath.empty() )
+	{
+		std::fputs( json.c_str(), stdout );
+		return 0;
+	}
+
+	std::ofstream file( config.outputPath, std::ios::trunc );
+	file << json;
+	if ( !file )
+	{
+		std::fprintf( stderr, "Could not write '%s'\n", config.outputPath.c_str() );
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,291 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "HeadlessEngine.hpp"
+#include <cstdio>
+#include <cstring>
+#include <vulkan/vulkan.hpp>
+
+// nvrhi's Vulkan backend goes through Vulkan-Hpp's dynamic dispatcher, whose storage the executable provides
+VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
+
+using Assets::RenderData::VertexAttributeType;
+using Assets::RenderData::VertexDataSegment;
+
+namespace Headless
+{
+	void Console::Print( StringView message )
+	{
+		std::fprintf( stderr, "%.*s\n", int( message.size() ), message.data() );
+	}
+
+	void Console::DPrint( StringView message, int developerLevel )
+	{
+		if ( verbose )
+		{
+			Print( message );
+		}
+	}
+
+	void Console::Warning( StringView message )
+	{
+		std::fprintf( stderr, "Warning: %.*s\n", int( message.size() ), message.data() );
+	}
+
+	void Console::Error( StringView message )
+	{
+		std::fprintf( stderr, "Error: %.*s\n", int( message.size() ), message.data() );
+	}
+
+	std::optional<Path> FileSystem::GetPathTo( const Path& path, decltype( IFileSystem::Path_File ) type ) const
+	{
+		Path fullPath = root / path;
+		std::error_code error;
+		if ( !std::filesystem::exists( fullPath, error ) )
+		{
+			return std::nullopt;
+		}
+
+		return fullPath;
+	}
+
+	void MessageCallback::message( nvrhi::MessageSeverity severity, const char* messageText )
+	{
+		if ( severity == nvrhi::MessageSeverity::Warning || severity == nvrhi::MessageSeverity::Error
+			|| severity == nvrhi::MessageSeverity::Fatal )
+		{
+			std::fprintf( stderr, "nvrhi: %s\n", messageText );
+		}
+	}
+
+	VulkanDevice::~VulkanDevice()
+	{
+		// The nvrhi device has to go first, it still uses the Vulkan one
+		if ( nullptr != nvrhiDevice )
+		{
+			nvrhiDevice->waitForIdle();
+			nvrhiDevice = nullptr;
+		}
+
+		if ( VK_NULL_HANDLE != device )
+		{
+			vkDestroyDevice( device, nullptr );
+		}
+
+		if ( VK_NULL_HANDLE != instance )
+		{
+			vkDestroyInstance( instance, nullptr );
+		}
+	}
+
+	bool VulkanDevice::Create( bool preferSoftware )
+	{
+		VULKAN_HPP_DEFAULT_DISPATCHER.init( vkGetInstanceProcAddr );
+
+		VkApplicationInfo applicationInfo{ VK_STRUCTURE_TYPE_APPLICATION_INFO };
+		applicationInfo.pApplicationName = "BtxRendererHeadless";
+		applicationInfo.apiVersion = VK_API_VERSION_1_3;
+
+		VkInstanceCreateInfo instanceInfo{ VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO };
+		instanceInfo.pApplicationInfo = &applicationInfo;
+		if ( VK_SUCCESS != vkCreateInstance( &instanceInfo, nullptr, &instance ) )
+		{
+			std::fprintf( stderr, "Could not create a Vulkan instance\n" );
+			return false;
+		}
+		VULKAN_HPP_DEFAULT_DISPATCHER.init( vk::Instance( instance ) );
+
+		uint32_t numPhysicalDevices = 0U;
+		vkEnumeratePhysicalDevices( instance, &numPhysicalDevices, nullptr );
+		Vector<VkPhysicalDevice> physicalDevices( numPhysicalDevices );
+		vkEnumeratePhysicalDevices( instance, &numPhysicalDevices, physicalDevices.data() );
+
+		// nvrhi needs 1.3 (synchronization2), and a queue that can do everything
+		// The first usable device is taken, unless a later one is of the preferred kind
+		VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+		uint32_t queueFamily = 0U;
+		bool preferredKind = false;
+		for ( VkPhysicalDevice candidate : physicalDevices )
+		{
+			VkPhysicalDeviceProperties properties;
+			vkGetPhysicalDeviceProperties( candidate, &properties );
+			const bool isPreferred = (properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU) == preferSoftware;
+			if ( properties.apiVersion < VK_API_VERSION_1_3 || preferredKind || (VK_NULL_HANDLE != physicalDevice && !isPreferred) )
+			{
+				continue;
+			}
+
+			uint32_t numFamilies = 0U;
+			vkGetPhysicalDeviceQueueFamilyProperties( candidate, &numFamilies, nullptr );
+			Vector<VkQueueFamilyProperties> families( numFamilies );
+			vkGetPhysicalDeviceQueueFamilyProperties( candidate, &numFamilies, families.data() );
+
+			const VkQueueFlags required = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT;
+			for ( uint32_t family = 0U; family < numFamilies; family++ )
+			{
+				if ( (families[family].queueFlags & required) == required )
+				{
+					physicalDevice = candidate;
+					queueFamily = family;
+					preferredKind = isPreferred;
+					name = properties.deviceName;
+					break;
+				}
+			}
+		}
+
+		if ( VK_NULL_HANDLE == physicalDevice )
+		{
+			std::fprintf( stderr, "No Vulkan 1.3 device found\n" );
+			return false;
+		}
+
+		// Everything the device supports is turned on, the frontend picks what it uses
+		VkPhysicalDeviceVulkan13Features features13{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES };
+		VkPhysicalDeviceVulkan12Features features12{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
+		VkPhysicalDeviceVulkan11Features features11{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES };
+		VkPhysicalDeviceFeatures2 features{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+		features.pNext = &features11;
+		features11.pNext = &features12;
+		features12.pNext = &features13;
+		vkGetPhysicalDeviceFeatures2( physicalDevice, &features );
+
+		const float queuePriority = 1.0f;
+		VkDeviceQueueCreateInfo queueInfo{ VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO };
+		queueInfo.queueFamilyIndex = queueFamily;
+		queueInfo.queueCount = 1U;
+		queueInfo.pQueuePriorities = &queuePriority;
+
+		VkDeviceCreateInfo deviceInfo{ VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO };
+		deviceInfo.pNext = &features;
+		deviceInfo.queueCreateInfoCount = 1U;
+		deviceInfo.pQueueCreateInfos = &queueInfo;
+		if ( VK_SUCCESS != vkCreateDevice( physicalDevice, &deviceInfo, nullptr, &device ) )
+		{
+			std::fprintf( stderr, "Could not create a Vulkan device on '%s'\n", name.c_str() );
+			return false;
+		}
+		VULKAN_HPP_DEFAULT_DISPATCHER.init( vk::Device( device ) );
+
+		VkQueue queue = VK_NULL_HANDLE;
+		vkGetDeviceQueue( device, queueFamily, 0U, &queue );
+
+		nvrhi::vulkan::DeviceDesc desc;
+		desc.errorCB = &messageCallback;
+		desc.instance = instance;
+		desc.physicalDevice = physicalDevice;
+		desc.device = device;
+		desc.graphicsQueue = queue;
+		desc.graphicsQueueIndex = int( queueFamily );
+		desc.bufferDeviceAddressSupported = VK_TRUE == features12.bufferDeviceAddress;
+
+		nvrhiDevice = nvrhi::vulkan::createDevice( desc );
+		if ( nullptr == nvrhiDevice )
+		{
+			std::fprintf( stderr, "Could not create an nvrhi device on '%s'\n", name.c_str() );
+			return false;
+		}
+
+		return true;
+	}
+
+	nvrhi::IDevice* VulkanDevice::Get() const
+	{
+		return nvrhiDevice;
+	}
+
+	const String& VulkanDevice::GetName() const
+	{
+		return name;
+	}
+
+	// Appends one vertex attribute to a face
+	template<typename T>
+	static void AddSegment( Assets::RenderData::VertexData& data, VertexAttributeType type, const Vector<T>& values )
+	{
+		VertexDataSegment& segment = data.vertexData.emplace_back();
+		segment.type = type;
+		segment.rawData.resize( values.size() * sizeof( T ) );
+		std::memcpy( segment.rawData.data(), values.data(), segment.rawData.size() );
+	}
+
+	SyntheticModel::SyntheticModel( StringView modelName, uint32_t numFaces, uint32_t gridSize )
+		: name( modelName )
+	{
+		const uint32_t gridVertices = gridSize + 1U;
+		auto& mesh = data.meshes.emplace_back();
+		mesh.name = name;
+		for ( uint32_t faceIndex = 0U; faceIndex < numFaces; faceIndex++ )
+		{
+			// Faces are stacked on top of each other, so the model stays the same size
+			const float height = 4.0f * float( faceIndex );
+
+			Vector<float> positions;
+			Vector<int8_t> normals;
+			Vector<float> uvs;
+			Vector<uint8_t> colours;
+			for ( uint32_t y = 0U; y < gridVertices; y++ )
+			{
+				for ( uint32_t x = 0U; x < gridVertices; x++ )
+				{
+					const float u = float( x ) / float( gridSize );
+					const float v = float( y ) / float( gridSize );
+					positions.insert( positions.end(), { -16.0f + 32.0f * u, -16.0f + 32.0f * v, height } );
+					normals.insert( normals.end(), { 0, 0, 127, 0 } );
+					uvs.insert( uvs.end(), { u, v } );
+					colours.insert( colours.end(), { uint8_t( u * 255.0f ), uint8_t( v * 255.0f ), 255U, 255U } );
+				}
+			}
+
+			auto& face = mesh.faces.emplace_back();
+			for ( uint32_t y = 0U; y < gridSize; y++ )
+			{
+				for ( uint32_t x = 0U; x < gridSize; x++ )
+				{
+					const uint32_t corner = y * gridVertices + x;
+					face.data.vertexIndices.insert( face.data.vertexIndices.end(),
+						{ corner, corner + 1U, corner + gridVertices, corner + 1U, corner + gridVertices + 1U, corner + gridVertices } );
+				}
+			}
+
+			AddSegment( face.data, VertexAttributeType::Position, positions );
+			AddSegment( face.data, VertexAttributeType::Normal, normals );
+			AddSegment( face.data, VertexAttributeType::Uv1, uvs );
+			AddSegment( face.data, VertexAttributeType::Colour1, colours );
+		}
+	}
+
+	const ModelData& SyntheticModel::GetModelData() const
+	{
+		return data;
+	}
+
+	const Assets::ModelDesc& SyntheticModel::GetDesc() const
+	{
+		return desc;
+	}
+
+	ModelName SyntheticModel::GetName() const
+	{
+		return name;
+	}
+
+	size_t SyntheticModel::GetDataSize() const
+	{
+		size_t size = 0U;
+		for ( const auto& mesh : data.meshes )
+		{
+			for ( const auto& face : mesh.faces )
+			{
+				size += face.data.vertexIndices.size() * sizeof( uint32_t );
+				for ( const auto& segment : face.data.vertexData )
+				{
+					size += segment.rawData.size();
+				}
+			}
+		}
+
+		return size;
+	}
+}
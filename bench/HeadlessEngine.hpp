@@ -0,0 +1,86 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+// What RenderFrontend needs to run outside the engine, shared by the benchmark and the tests:
+// stand-ins for the engine subsystems it calls, a Vulkan device and synthetic model assets
+// The stand-ins only do what the renderer uses, i.e. printing and finding shader files
+
+#include <optional>
+#include <type_traits>
+#include <nvrhi/vulkan.h>
+
+namespace Headless
+{
+	// Prints to stderr, developer messages only with verbose on
+	class Console final : public IConsole
+	{
+	public:
+		void				Print( StringView message ) override;
+		void				DPrint( StringView message, int developerLevel ) override;
+		void				Warning( StringView message ) override;
+		void				Error( StringView message ) override;
+
+		bool				verbose{ false };
+	};
+
+	// Finds files relative to one directory, which should have the compiled shaders in it (shaders/vk/...)
+	class FileSystem final : public IFileSystem
+	{
+	public:
+		std::optional<Path>	GetPathTo( const Path& path, decltype( IFileSystem::Path_File ) type ) const override;
+
+		Path				root{ "." };
+	};
+
+	class MessageCallback final : public nvrhi::IMessageCallback
+	{
+	public:
+		void				message( nvrhi::MessageSeverity severity, const char* messageText ) override;
+	};
+
+	// A Vulkan 1.3 device, preferably a software one like lavapipe, so results don't depend on the GPU
+	class VulkanDevice
+	{
+	public:
+		~VulkanDevice();
+
+		// False if there's no usable device, e.g. no Vulkan driver at all
+		bool				Create( bool preferSoftware );
+		nvrhi::IDevice*		Get() const;
+		// Name of the physical device, for the results
+		const String&		GetName() const;
+
+	private:
+		VkInstance			instance{ VK_NULL_HANDLE };
+		VkDevice			device{ VK_NULL_HANDLE };
+		nvrhi::DeviceHandle	nvrhiDevice{};
+		MessageCallback		messageCallback{};
+		String				name{};
+	};
+
+	// The types of the engine's model data, taken from the interface so they don't have to be spelt out
+	using ModelData = std::remove_cv_t<std::remove_reference_t<decltype( std::declval<const Assets::IModel&>().GetModelData() )>>;
+	using ModelName = decltype( std::declval<const Assets::IModel&>().GetName() );
+
+	// A model made of square grids, one per face, on the XY plane and a little above it
+	// Every face has positions, normals, UVs and colours, like a typical static mesh
+	class SyntheticModel final : public Assets::IModel
+	{
+	public:
+		SyntheticModel( StringView modelName, uint32_t numFaces, uint32_t gridSize );
+
+		const ModelData&	GetModelData() const override;
+		const Assets::ModelDesc& GetDesc() const override;
+		ModelName			GetName() const override;
+
+		// Bytes of index and vertex data, i.e. what uploading it costs
+		size_t				GetDataSize() const;
+
+	private:
+		String				name;
+		ModelData			data{};
+		Assets::ModelDesc	desc{};
+	};
+}
@@ -1,15 +1,45 @@
-// SPDX-FileCopyrightText: 2022 Admer Šuko
-// SPDX-License-Identifier: MIT
-
-#include "Precompiled.hpp"
-#include "Batch.hpp"
-
-BatchDesc& Batch::GetDesc()
-{
-	return desc;
-}
-
-const BatchDesc& Batch::GetDesc() const
-{
-	return desc;
-}
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "Batch.hpp"
+
+Batch::Batch( const BatchDesc& desc, Vector<BatchGroup>&& groups )
+	: desc( desc ), groups( std::move( groups ) )
+{
+	for ( const auto& group : this->groups )
+	{
+		bounds.Add( group.bounds );
+	}
+}
+
+BatchDesc& Batch::GetDesc()
+{
+	return desc;
+}
+
+const BatchDesc& Batch::GetDesc() const
+{
+	return desc;
+}
+
+const Vector<BatchGroup>& Batch::GetGroups() const
+{
+	return groups;
+}
+
+const Bounds& Batch::GetBounds() const
+{
+	return bounds;
+}
+
+void Batch::ReplaceMaterial( uint32_t oldMaterial, uint32_t newMaterial )
+{
+	for ( auto& group : groups )
+	{
+		if ( group.material == oldMaterial )
+		{
+			group.material = newMaterial;
+		}
+	}
+}
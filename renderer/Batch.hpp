@@ -1,13 +1,57 @@
-// SPDX-FileCopyrightText: 2022 Admer Šuko
-// SPDX-License-Identifier: MIT
-
-#pragma once
-
-class Batch final : public IBatch
-{
-public:
-	BatchDesc& GetDesc() override;
-	const BatchDesc& GetDesc() const override;
-private:
-	BatchDesc desc;
-};
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "Bounds.hpp"
+#include "MemoryTracker.hpp"
+#include "ShaderPermutations.hpp"
+
+// A contiguous range of indices within a batch group, with its own bounds for culling
+struct BatchChunk
+{
+	uint32_t firstIndex{ 0U };
+	uint32_t numIndices{ 0U };
+	Bounds bounds{};
+};
+
+// Merged world-space geometry that shares the same vertex layout
+// Streams are in the same order as the entity pipeline's input layout
+struct BatchGroup
+{
+	nvrhi::BufferHandle positionBuffer{};
+	nvrhi::BufferHandle normalBuffer{};
+	nvrhi::BufferHandle uvBuffer{};
+	// Null unless features has EntityFeatures::VertexColours
+	nvrhi::BufferHandle colourBuffer{};
+	nvrhi::BufferHandle indexBuffer{};
+
+	// Sorted spatially, so neighbouring chunks tend to be visible together
+	// and can be drawn with a single call
+	Vector<BatchChunk> chunks{};
+	Bounds bounds{};
+	// All faces of a group share a material slot
+	uint32_t material{ 0U };
+	// Picks the entity pipeline, like FaceDrawRecord::features
+	ShaderFeatureMask features{ 0U };
+};
+
+class Batch final : public IBatch
+{
+public:
+	Batch( const BatchDesc& desc, Vector<BatchGroup>&& groups );
+
+	BatchDesc& GetDesc() override;
+	const BatchDesc& GetDesc() const override;
+
+	const Vector<BatchGroup>& GetGroups() const;
+	const Bounds& GetBounds() const;
+	void ReplaceMaterial( uint32_t oldMaterial, uint32_t newMaterial );
+
+	MemoryTracker::OwnerId memoryOwner{ MemoryTracker::InvalidOwner };
+
+private:
+	BatchDesc desc;
+	Vector<BatchGroup> groups{};
+	Bounds bounds{};
+};
@@ -0,0 +1,764 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "BlockCompression.hpp"
+
+#include <cmath>
+#include <limits>
+#include <thread>
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || defined( _M_AMD64 )
+#define BTXR_BC_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace BlockCompression
+{
+	// 16 pixels of a block, stored per channel so they can be processed 4 at a time
+	struct BlockPixels
+	{
+		alignas( 16 ) float channels[4][16];
+	};
+
+	// BC7 interpolation weights for 4-bit indices
+	constexpr int Bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	size_t GetBytesPerBlock( Format format )
+	{
+		switch ( format )
+		{
+		case Format::BC1:
+		case Format::BC4: return 8U;
+		case Format::BC3:
+		case Format::BC5:
+		case Format::BC7: return 16U;
+		}
+
+		return 16U;
+	}
+
+	size_t GetEncodedSize( Format format, uint32_t width, uint32_t height )
+	{
+		const size_t blocksX = (width + BlockSize - 1U) / BlockSize;
+		const size_t blocksY = (height + BlockSize - 1U) / BlockSize;
+		return blocksX * blocksY * GetBytesPerBlock( format );
+	}
+
+	nvrhi::Format ToNvrhiFormat( Format format )
+	{
+		switch ( format )
+		{
+		case Format::BC1: return nvrhi::Format::BC1_UNORM;
+		case Format::BC3: return nvrhi::Format::BC3_UNORM;
+		case Format::BC4: return nvrhi::Format::BC4_UNORM;
+		case Format::BC5: return nvrhi::Format::BC5_UNORM;
+		case Format::BC7: return nvrhi::Format::BC7_UNORM;
+		}
+
+		return nvrhi::Format::UNKNOWN;
+	}
+
+	const char* ToString( Format format )
+	{
+		switch ( format )
+		{
+		case Format::BC1: return "BC1";
+		case Format::BC3: return "BC3";
+		case Format::BC4: return "BC4";
+		case Format::BC5: return "BC5";
+		case Format::BC7: return "BC7";
+		}
+
+		return "UNKNOWN";
+	}
+
+	// ---------------------------------------------------------------------------------
+	// Shared helpers
+	// ---------------------------------------------------------------------------------
+
+	static void FetchBlock( const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, BlockPixels& outPixels )
+	{
+		for ( uint32_t y = 0U; y < BlockSize; y++ )
+		{
+			const uint32_t sourceY = std::min( blockY * BlockSize + y, height - 1U );
+			for ( uint32_t x = 0U; x < BlockSize; x++ )
+			{
+				const uint32_t sourceX = std::min( blockX * BlockSize + x, width - 1U );
+				const uint8_t* pixel = rgba + (size_t( sourceY ) * width + sourceX) * 4U;
+				for ( uint32_t channel = 0U; channel < 4U; channel++ )
+				{
+					outPixels.channels[channel][y * BlockSize + x] = pixel[channel];
+				}
+			}
+		}
+	}
+
+	static void StoreBlock( const uint8_t decoded[16][4], uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, uint8_t* outRgba )
+	{
+		for ( uint32_t y = 0U; y < BlockSize; y++ )
+		{
+			const uint32_t targetY = blockY * BlockSize + y;
+			for ( uint32_t x = 0U; x < BlockSize; x++ )
+			{
+				const uint32_t targetX = blockX * BlockSize + x;
+				if ( targetX >= width || targetY >= height )
+				{
+					continue;
+				}
+
+				std::memcpy( outRgba + (size_t( targetY ) * width + targetX) * 4U, decoded[y * BlockSize + x], 4U );
+			}
+		}
+	}
+
+	// Finds the principal axis of the first numChannels channels with a few power iterations,
+	// then returns the extremes of the block along that axis
+	static void FindEndpoints( const BlockPixels& pixels, uint32_t numChannels, float outStart[4], float outEnd[4] )
+	{
+		float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		for ( uint32_t c = 0U; c < numChannels; c++ )
+		{
+			for ( uint32_t i = 0U; i < 16U; i++ )
+			{
+				mean[c] += pixels.channels[c][i];
+			}
+			mean[c] /= 16.0f;
+		}
+
+		float covariance[4][4] = {};
+		for ( uint32_t i = 0U; i < 16U; i++ )
+		{
+			for ( uint32_t a = 0U; a < numChannels; a++ )
+			{
+				for ( uint32_t b = a; b < numChannels; b++ )
+				{
+					covariance[a][b] += (pixels.channels[a][i] - mean[a]) * (pixels.channels[b][i] - mean[b]);
+				}
+			}
+		}
+
+		for ( uint32_t a = 0U; a < numChannels; a++ )
+		{
+			for ( uint32_t b = 0U; b < a; b++ )
+			{
+				covariance[a][b] = covariance[b][a];
+			}
+		}
+
+		float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+		for ( int iteration = 0; iteration < 8; iteration++ )
+		{
+			float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			float largest = 0.0f;
+			for ( uint32_t a = 0U; a < numChannels; a++ )
+			{
+				for ( uint32_t b = 0U; b < numChannels; b++ )
+				{
+					next[a] += covariance[a][b] * axis[b];
+				}
+				largest = std::max( largest, std::abs( next[a] ) );
+			}
+
+			// Flat block, any axis works
+			if ( largest < 1.0e-6f )
+			{
+				break;
+			}
+
+			for ( uint32_t a = 0U; a < numChannels; a++ )
+			{
+				axis[a] = next[a] / largest;
+			}
+		}
+
+		float minT = std::numeric_limits<float>::max();
+		float maxT = std::numeric_limits<float>::lowest();
+		float axisLengthSquared = 0.0f;
+		for ( uint32_t a = 0U; a < numChannels; a++ )
+		{
+			axisLengthSquared += axis[a] * axis[a];
+		}
+
+		for ( uint32_t i = 0U; i < 16U; i++ )
+		{
+			float t = 0.0f;
+			for ( uint32_t a = 0U; a < numChannels; a++ )
+			{
+				t += (pixels.channels[a][i] - mean[a]) * axis[a];
+			}
+			t /= axisLengthSquared;
+
+			minT = std::min( minT, t );
+			maxT = std::max( maxT, t );
+		}
+
+		for ( uint32_t a = 0U; a < 4U; a++ )
+		{
+			outStart[a] = a < numChannels ? std::clamp( mean[a] + axis[a] * minT, 0.0f, 255.0f ) : 255.0f;
+			outEnd[a] = a < numChannels ? std::clamp( mean[a] + axis[a] * maxT, 0.0f, 255.0f ) : 255.0f;
+		}
+	}
+
+	// Projects all 16 pixels onto the segment between start and end, writing the
+	// position along it, clamped to [0, 1]. This is the hot loop of every encoder here
+	static void ProjectOntoSegment( const BlockPixels& pixels, uint32_t numChannels, const float start[4], const float end[4], float outT[16] )
+	{
+		float direction[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float lengthSquared = 0.0f;
+		for ( uint32_t c = 0U; c < numChannels; c++ )
+		{
+			direction[c] = end[c] - start[c];
+			lengthSquared += direction[c] * direction[c];
+		}
+
+		if ( lengthSquared < 1.0e-6f )
+		{
+			std::fill( outT, outT + 16, 0.0f );
+			return;
+		}
+
+		const float inverseLength = 1.0f / lengthSquared;
+
+#if BTXR_BC_SSE2
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps( 1.0f );
+		for ( uint32_t i = 0U; i < 16U; i += 4U )
+		{
+			__m128 dot = zero;
+			for ( uint32_t c = 0U; c < numChannels; c++ )
+			{
+				const __m128 value = _mm_load_ps( &pixels.channels[c][i] );
+				const __m128 offset = _mm_sub_ps( value, _mm_set1_ps( start[c] ) );
+				dot = _mm_add_ps( dot, _mm_mul_ps( offset, _mm_set1_ps( direction[c] ) ) );
+			}
+
+			const __m128 t = _mm_mul_ps( dot, _mm_set1_ps( inverseLength ) );
+			_mm_storeu_ps( outT + i, _mm_min_ps( _mm_max_ps( t, zero ), one ) );
+		}
+#else
+		for ( uint32_t i = 0U; i < 16U; i++ )
+		{
+			float dot = 0.0f;
+			for ( uint32_t c = 0U; c < numChannels; c++ )
+			{
+				dot += (pixels.channels[c][i] - start[c]) * direction[c];
+			}
+
+			outT[i] = std::clamp( dot * inverseLength, 0.0f, 1.0f );
+		}
+#endif
+	}
+
+	// ---------------------------------------------------------------------------------
+	// BC1 colour block
+	// ---------------------------------------------------------------------------------
+
+	static uint16_t PackRgb565( const float colour[4] )
+	{
+		const uint32_t r = (uint32_t( colour[0] + 0.5f ) * 31U + 127U) / 255U;
+		const uint32_t g = (uint32_t( colour[1] + 0.5f ) * 63U + 127U) / 255U;
+		const uint32_t b = (uint32_t( colour[2] + 0.5f ) * 31U + 127U) / 255U;
+		return uint16_t( (r << 11U) | (g << 5U) | b );
+	}
+
+	static void UnpackRgb565( uint16_t packed, int outColour[3] )
+	{
+		const int r = (packed >> 11U) & 31;
+		const int g = (packed >> 5U) & 63;
+		const int b = packed & 31;
+		outColour[0] = (r << 3) | (r >> 2);
+		outColour[1] = (g << 2) | (g >> 4);
+		outColour[2] = (b << 3) | (b >> 2);
+	}
+
+	static void EncodeColourBlock( const BlockPixels& pixels, uint8_t* outBlock )
+	{
+		float start[4], end[4];
+		FindEndpoints( pixels, 3U, start, end );
+
+		uint16_t colour0 = PackRgb565( end );
+		uint16_t colour1 = PackRgb565( start );
+		uint32_t indices = 0U;
+
+		if ( colour0 != colour1 )
+		{
+			// 4-colour mode requires colour0 > colour1
+			if ( colour0 < colour1 )
+			{
+				std::swap( colour0, colour1 );
+			}
+
+			// Project against the quantised endpoints, since that's what the GPU will interpolate
+			int quantised0[3], quantised1[3];
+			UnpackRgb565( colour0, quantised0 );
+			UnpackRgb565( colour1, quantised1 );
+			const float segmentStart[4] = { float( quantised0[0] ), float( quantised0[1] ), float( quantised0[2] ), 0.0f };
+			const float segmentEnd[4] = { float( quantised1[0] ), float( quantised1[1] ), float( quantised1[2] ), 0.0f };
+
+			float t[16];
+			ProjectOntoSegment( pixels, 3U, segmentStart, segmentEnd, t );
+
+			// Position along the segment -> palette index: colour0, 2/3 c0 + 1/3 c1, 1/3 c0 + 2/3 c1, colour1
+			constexpr uint32_t LevelToIndex[4] = { 0U, 2U, 3U, 1U };
+			for ( uint32_t i = 0U; i < 16U; i++ )
+			{
+				indices |= LevelToIndex[uint32_t( t[i] * 3.0f + 0.5f )] << (i * 2U);
+			}
+		}
+
+		outBlock[0] = uint8_t( colour0 & 0xff );
+		outBlock[1] = uint8_t( colour0 >> 8U );
+		outBlock[2] = uint8_t( colour1 & 0xff );
+		outBlock[3] = uint8_t( colour1 >> 8U );
+		std::memcpy( outBlock + 4, &indices, 4U );
+	}
+
+	static void DecodeColourBlock( const uint8_t* block, bool alwaysFourColours, uint8_t outPixels[16][4] )
+	{
+		const uint16_t colour0 = uint16_t( block[0] | (block[1] << 8U) );
+		const uint16_t colour1 = uint16_t( block[2] | (block[3] << 8U) );
+		uint32_t indices;
+		std::memcpy( &indices, block + 4, 4U );
+
+		int palette[4][4];
+		UnpackRgb565( colour0, palette[0] );
+		UnpackRgb565( colour1, palette[1] );
+		palette[0][3] = palette[1][3] = 255;
+
+		const bool fourColours = alwaysFourColours || colour0 > colour1;
+		for ( int c = 0; c < 3; c++ )
+		{
+			if ( fourColours )
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+			else
+			{
+				palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+				palette[3][c] = 0;
+			}
+		}
+		palette[2][3] = 255;
+		palette[3][3] = fourColours ? 255 : 0;
+
+		for ( uint32_t i = 0U; i < 16U; i++ )
+		{
+			const uint32_t index = (indices >> (i * 2U)) & 3U;
+			for ( int c = 0; c < 4; c++ )
+			{
+				outPixels[i][c] = uint8_t( palette[index][c] );
+			}
+		}
+	}
+
+	// ---------------------------------------------------------------------------------
+	// BC4 single channel block, also used for BC3 alpha and BC5
+	// ---------------------------------------------------------------------------------
+
+	static void EncodeChannelBlock( const BlockPixels& pixels, uint32_t channel, uint8_t* outBlock )
+	{
+		const float* values = pixels.channels[channel];
+		float minValue = values[0];
+		float maxValue = values[0];
+		for ( uint32_t i = 1U; i < 16U; i++ )
+		{
+			minValue = std::min( minValue, values[i] );
+			maxValue = std::max( maxValue, values[i] );
+		}
+
+		// 8-value mode, endpoint 0 must be larger
+		const uint8_t endpoint0 = uint8_t( maxValue + 0.5f );
+		const uint8_t endpoint1 = uint8_t( minValue + 0.5f );
+		outBlock[0] = endpoint0;
+		outBlock[1] = endpoint1;
+
+		uint64_t indices = 0U;
+		if ( endpoint0 > endpoint1 )
+		{
+			const float scale = 7.0f / float( endpoint0 - endpoint1 );
+			for ( uint32_t i = 0U; i < 16U; i++ )
+			{
+				const float level = std::clamp( (float( endpoint0 ) - values[i]) * scale, 0.0f, 7.0f );
+				const uint32_t step = uint32_t( level + 0.5f );
+				// Steps 0 and 7 are the endpoints, everything in between is shifted by one
+				const uint64_t index = step == 0U ? 0U : (step == 7U ? 1U : step + 1U);
+				indices |= index << (i * 3U);
+			}
+		}
+
+		for ( uint32_t i = 0U; i < 6U; i++ )
+		{
+			outBlock[2U + i] = uint8_t( (indices >> (i * 8U)) & 0xff );
+		}
+	}
+
+	static void DecodeChannelBlock( const uint8_t* block, uint32_t channel, uint8_t outPixels[16][4] )
+	{
+		const int endpoint0 = block[0];
+		const int endpoint1 = block[1];
+
+		int palette[8];
+		palette[0] = endpoint0;
+		palette[1] = endpoint1;
+		if ( endpoint0 > endpoint1 )
+		{
+			for ( int i = 1; i < 7; i++ )
+			{
+				palette[i + 1] = ((7 - i) * endpoint0 + i * endpoint1) / 7;
+			}
+		}
+		else
+		{
+			for ( int i = 1; i < 5; i++ )
+			{
+				palette[i + 1] = ((5 - i) * endpoint0 + i * endpoint1) / 5;
+			}
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+
+		uint64_t indices = 0U;
+		for ( uint32_t i = 0U; i < 6U; i++ )
+		{
+			indices |= uint64_t( block[2U + i] ) << (i * 8U);
+		}
+
+		for ( uint32_t i = 0U; i < 16U; i++ )
+		{
+			outPixels[i][channel] = uint8_t( palette[(indices >> (i * 3U)) & 7U] );
+		}
+	}
+
+	// ---------------------------------------------------------------------------------
+	// BC7, mode 6 only: one subset, RGBA 7.7.7.7 endpoints with a p-bit each, 4-bit indices
+	// ---------------------------------------------------------------------------------
+
+	class BitWriter
+	{
+	public:
+		BitWriter( uint8_t* target )
+			: target( target )
+		{
+			std::memset( target, 0, 16U );
+		}
+
+		void Write( uint32_t value, uint32_t numBits )
+		{
+			for ( uint32_t i = 0U; i < numBits; i++, position++ )
+			{
+				target[position / 8U] |= uint8_t( ((value >> i) & 1U) << (position % 8U) );
+			}
+		}
+
+	private:
+		uint8_t* target;
+		uint32_t position{ 0U };
+	};
+
+	class BitReader
+	{
+	public:
+		BitReader( const uint8_t* source )
+			: source( source )
+		{
+		}
+
+		uint32_t Read( uint32_t numBits )
+		{
+			uint32_t value = 0U;
+			for ( uint32_t i = 0U; i < numBits; i++, position++ )
+			{
+				value |= uint32_t( (source[position / 8U] >> (position % 8U)) & 1U ) << i;
+			}
+			return value;
+		}
+
+	private:
+		const uint8_t* source;
+		uint32_t position{ 0U };
+	};
+
+	// Picks the p-bit with the least error, and returns the 7-bit values
+	static uint32_t QuantiseBc7Endpoint( const float endpoint[4], uint32_t outValues[4] )
+	{
+		float bestError = std::numeric_limits<float>::max();
+		uint32_t bestPBit = 0U;
+
+		for ( uint32_t pBit = 0U; pBit < 2U; pBit++ )
+		{
+			float error = 0.0f;
+			uint32_t values[4];
+			for ( uint32_t c = 0U; c < 4U; c++ )
+			{
+				values[c] = uint32_t( std::clamp( std::round( (endpoint[c] - float( pBit )) * 0.5f ), 0.0f, 127.0f ) );
+				const float decoded = float( (values[c] << 1U) | pBit );
+				error += (decoded - endpoint[c]) * (decoded - endpoint[c]);
+			}
+
+			if ( error < bestError )
+			{
+				bestError = error;
+				bestPBit = pBit;
+				std::copy( values, values + 4, outValues );
+			}
+		}
+
+		return bestPBit;
+	}
+
+	static void EncodeBc7Block( const BlockPixels& pixels, uint8_t* outBlock )
+	{
+		float start[4], end[4];
+		FindEndpoints( pixels, 4U, start, end );
+
+		uint32_t values[2][4];
+		uint32_t pBits[2];
+		pBits[0] = QuantiseBc7Endpoint( start, values[0] );
+		pBits[1] = QuantiseBc7Endpoint( end, values[1] );
+
+		float quantised[2][4];
+		for ( uint32_t e = 0U; e < 2U; e++ )
+		{
+			for ( uint32_t c = 0U; c < 4U; c++ )
+			{
+				quantised[e][c] = float( (values[e][c] << 1U) | pBits[e] );
+			}
+		}
+
+		float t[16];
+		ProjectOntoSegment( pixels, 4U, quantised[0], quantised[1], t );
+
+		uint32_t indices[16];
+		for ( uint32_t i = 0U; i < 16U; i++ )
+		{
+			const float weight = t[i] * 64.0f;
+			uint32_t best = 0U;
+			for ( uint32_t w = 1U; w < 16U; w++ )
+			{
+				if ( std::abs( float( Bc7Weights[w] ) - weight ) < std::abs( float( Bc7Weights[best] ) - weight ) )
+				{
+					best = w;
+				}
+			}
+			indices[i] = best;
+		}
+
+		// The anchor index (pixel 0) has an implicit 0 as its top bit, swapping the endpoints makes it fit
+		if ( indices[0] >= 8U )
+		{
+			std::swap( values[0], values[1] );
+			std::swap( pBits[0], pBits[1] );
+			for ( uint32_t& index : indices )
+			{
+				index = 15U - index;
+			}
+		}
+
+		BitWriter writer( outBlock );
+		writer.Write( 1U << 6U, 7U );
+		for ( uint32_t c = 0U; c < 4U; c++ )
+		{
+			writer.Write( values[0][c], 7U );
+			writer.Write( values[1][c], 7U );
+		}
+		writer.Write( pBits[0], 1U );
+		writer.Write( pBits[1], 1U );
+
+		writer.Write( indices[0], 3U );
+		for ( uint32_t i = 1U; i < 16U; i++ )
+		{
+			writer.Write( indices[i], 4U );
+		}
+	}
+
+	// Only decodes mode 6, which is all EncodeBc7Block produces. Other modes decode to black
+	static void DecodeBc7Block( const uint8_t* block, uint8_t outPixels[16][4] )
+	{
+		BitReader reader( block );
+		if ( reader.Read( 7U ) != (1U << 6U) )
+		{
+			std::memset( outPixels, 0, 16U * 4U );
+			return;
+		}
+
+		uint32_t values[2][4];
+		for ( uint32_t c = 0U; c < 4U; c++ )
+		{
+			values[0][c] = reader.Read( 7U );
+			values[1][c] = reader.Read( 7U );
+		}
+
+		const uint32_t pBit0 = reader.Read( 1U );
+		const uint32_t pBit1 = reader.Read( 1U );
+
+		int endpoints[2][4];
+		for ( uint32_t c = 0U; c < 4U; c++ )
+		{
+			endpoints[0][c] = int( (values[0][c] << 1U) | pBit0 );
+			endpoints[1][c] = int( (values[1][c] << 1U) | pBit1 );
+		}
+
+		for ( uint32_t i = 0U; i < 16U; i++ )
+		{
+			const int weight = Bc7Weights[reader.Read( i == 0U ? 3U : 4U )];
+			for ( uint32_t c = 0U; c < 4U; c++ )
+			{
+				outPixels[i][c] = uint8_t( ((64 - weight) * endpoints[0][c] + weight * endpoints[1][c] + 32) >> 6 );
+			}
+		}
+	}
+
+	// ---------------------------------------------------------------------------------
+	// Images
+	// ---------------------------------------------------------------------------------
+
+	static void EncodeBlock( Format format, const BlockPixels& pixels, uint8_t* outBlock )
+	{
+		switch ( format )
+		{
+		case Format::BC1:
+			EncodeColourBlock( pixels, outBlock );
+			break;
+		case Format::BC3:
+			EncodeChannelBlock( pixels, 3U, outBlock );
+			EncodeColourBlock( pixels, outBlock + 8 );
+			break;
+		case Format::BC4:
+			EncodeChannelBlock( pixels, 0U, outBlock );
+			break;
+		case Format::BC5:
+			EncodeChannelBlock( pixels, 0U, outBlock );
+			EncodeChannelBlock( pixels, 1U, outBlock + 8 );
+			break;
+		case Format::BC7:
+			EncodeBc7Block( pixels, outBlock );
+			break;
+		}
+	}
+
+	static void DecodeBlock( Format format, const uint8_t* block, uint8_t outPixels[16][4] )
+	{
+		// Defaults for channels that aren't stored
+		for ( uint32_t i = 0U; i < 16U; i++ )
+		{
+			outPixels[i][0] = outPixels[i][1] = outPixels[i][2] = 0U;
+			outPixels[i][3] = 255U;
+		}
+
+		switch ( format )
+		{
+		case Format::BC1:
+			DecodeColourBlock( block, false, outPixels );
+			break;
+		case Format::BC3:
+			DecodeColourBlock( block + 8, true, outPixels );
+			DecodeChannelBlock( block, 3U, outPixels );
+			break;
+		case Format::BC4:
+			DecodeChannelBlock( block, 0U, outPixels );
+			break;
+		case Format::BC5:
+			DecodeChannelBlock( block, 0U, outPixels );
+			DecodeChannelBlock( block + 8, 1U, outPixels );
+			break;
+		case Format::BC7:
+			DecodeBc7Block( block, outPixels );
+			break;
+		}
+	}
+
+	void EncodeImage( Format format, const uint8_t* rgba, uint32_t width, uint32_t height, Vector<uint8_t>& outData, uint32_t numThreads )
+	{
+		const uint32_t blocksX = (width + BlockSize - 1U) / BlockSize;
+		const uint32_t blocksY = (height + BlockSize - 1U) / BlockSize;
+		const size_t bytesPerBlock = GetBytesPerBlock( format );
+		outData.resize( GetEncodedSize( format, width, height ) );
+
+		if ( 0U == numThreads )
+		{
+			numThreads = std::max( std::thread::hardware_concurrency(), 1U );
+		}
+		numThreads = std::min( numThreads, blocksY );
+
+		const auto encodeRows = [&]( uint32_t firstRow, uint32_t lastRow )
+		{
+			BlockPixels pixels;
+			for ( uint32_t blockY = firstRow; blockY < lastRow; blockY++ )
+			{
+				for ( uint32_t blockX = 0U; blockX < blocksX; blockX++ )
+				{
+					FetchBlock( rgba, width, height, blockX, blockY, pixels );
+					EncodeBlock( format, pixels, outData.data() + (size_t( blockY ) * blocksX + blockX) * bytesPerBlock );
+				}
+			}
+		};
+
+		if ( numThreads <= 1U )
+		{
+			encodeRows( 0U, blocksY );
+			return;
+		}
+
+		Vector<std::thread> workers;
+		const uint32_t rowsPerThread = (blocksY + numThreads - 1U) / numThreads;
+		for ( uint32_t firstRow = 0U; firstRow < blocksY; firstRow += rowsPerThread )
+		{
+			workers.emplace_back( encodeRows, firstRow, std::min( firstRow + rowsPerThread, blocksY ) );
+		}
+
+		for ( auto& worker : workers )
+		{
+			worker.join();
+		}
+	}
+
+	void DecodeImage( Format format, const uint8_t* data, uint32_t width, uint32_t height, Vector<uint8_t>& outRgba )
+	{
+		const uint32_t blocksX = (width + BlockSize - 1U) / BlockSize;
+		const uint32_t blocksY = (height + BlockSize - 1U) / BlockSize;
+		const size_t bytesPerBlock = GetBytesPerBlock( format );
+		outRgba.resize( size_t( width ) * height * 4U );
+
+		uint8_t decoded[16][4];
+		for ( uint32_t blockY = 0U; blockY < blocksY; blockY++ )
+		{
+			for ( uint32_t blockX = 0U; blockX < blocksX; blockX++ )
+			{
+				DecodeBlock( format, data + (size_t( blockY ) * blocksX + blockX) * bytesPerBlock, decoded );
+				StoreBlock( decoded, width, height, blockX, blockY, outRgba.data() );
+			}
+		}
+	}
+
+	double ComputePSNR( const uint8_t* a, const uint8_t* b, uint32_t width, uint32_t height, uint32_t channelMask )
+	{
+		double squaredError = 0.0;
+		size_t numSamples = 0U;
+
+		const size_t numPixels = size_t( width ) * height;
+		for ( size_t i = 0U; i < numPixels; i++ )
+		{
+			for ( uint32_t c = 0U; c < 4U; c++ )
+			{
+				if ( !(channelMask & (1U << c)) )
+				{
+					continue;
+				}
+
+				const double difference = double( a[i * 4U + c] ) - double( b[i * 4U + c] );
+				squaredError += difference * difference;
+				numSamples++;
+			}
+		}
+
+		if ( 0U == numSamples || squaredError == 0.0 )
+		{
+			return std::numeric_limits<double>::infinity();
+		}
+
+		const double meanSquaredError = squaredError / double( numSamples );
+		return 10.0 * std::log10( (255.0 * 255.0) / meanSquaredError );
+	}
+}
@@ -0,0 +1,44 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+// CPU block compression of RGBA8 images into BCn formats
+// This has no GPU dependencies, so it can be verified headless by
+// round-tripping images through EncodeImage & DecodeImage and checking the PSNR
+namespace BlockCompression
+{
+	enum class Format : uint8_t
+	{
+		// RGB, 1-bit alpha is not used
+		BC1,
+		// RGB + interpolated alpha
+		BC3,
+		// Red channel only, e.g. masks and heightmaps
+		BC4,
+		// Red and green channels, e.g. normal maps
+		BC5,
+		// High quality RGBA, encoded with mode 6 only
+		BC7
+	};
+
+	constexpr uint32_t BlockSize = 4U;
+
+	size_t				GetBytesPerBlock( Format format );
+	size_t				GetEncodedSize( Format format, uint32_t width, uint32_t height );
+	nvrhi::Format		ToNvrhiFormat( Format format );
+	const char*			ToString( Format format );
+
+	// Encodes a tightly packed RGBA8 image. Rows of blocks are split across numThreads threads,
+	// 0 means one per hardware thread. Partial blocks at the edges get clamped pixels
+	void				EncodeImage( Format format, const uint8_t* rgba, uint32_t width, uint32_t height,
+							Vector<uint8_t>& outData, uint32_t numThreads = 0U );
+
+	// Decodes back into RGBA8. Channels not stored by the format are 0 (colour) or 255 (alpha)
+	void				DecodeImage( Format format, const uint8_t* data, uint32_t width, uint32_t height,
+							Vector<uint8_t>& outRgba );
+
+	// Peak signal-to-noise ratio in decibels, over the channels set in channelMask (bit 0 = R ... bit 3 = A)
+	// Returns infinity for identical images
+	double				ComputePSNR( const uint8_t* a, const uint8_t* b, uint32_t width, uint32_t height, uint32_t channelMask = 0b1111U );
+}
@@ -0,0 +1,196 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <cfloat>
+
+// Transforms a point by a 4x4 matrix, with an implicit W of 1
+inline Vec4 TransformPoint( const Mat4& transform, const Vec3& point )
+{
+	return transform * Vec4( point.x, point.y, point.z, 1.0f );
+}
+
+// Axis-aligned bounding box, used for culling and spatial queries
+struct Bounds
+{
+	Vec3 mins{ FLT_MAX, FLT_MAX, FLT_MAX };
+	Vec3 maxs{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+	bool IsValid() const
+	{
+		return mins.x <= maxs.x && mins.y <= maxs.y && mins.z <= maxs.z;
+	}
+
+	void Add( const Vec3& point )
+	{
+		mins = { std::min( mins.x, point.x ), std::min( mins.y, point.y ), std::min( mins.z, point.z ) };
+		maxs = { std::max( maxs.x, point.x ), std::max( maxs.y, point.y ), std::max( maxs.z, point.z ) };
+	}
+
+	void Add( const Bounds& other )
+	{
+		if ( !other.IsValid() )
+		{
+			return;
+		}
+
+		Add( other.mins );
+		Add( other.maxs );
+	}
+
+	// Corners are enumerated as bits: X = bit 0, Y = bit 1, Z = bit 2
+	Vec3 GetCorner( uint32_t index ) const
+	{
+		return {
+			(index & 1U) ? maxs.x : mins.x,
+			(index & 2U) ? maxs.y : mins.y,
+			(index & 4U) ? maxs.z : mins.z };
+	}
+
+	Vec3 GetCentre() const
+	{
+		return { (mins.x + maxs.x) * 0.5f, (mins.y + maxs.y) * 0.5f, (mins.z + maxs.z) * 0.5f };
+	}
+
+	// Used as the cost metric when building the entity tree
+	float GetSurfaceArea() const
+	{
+		const float dx = maxs.x - mins.x;
+		const float dy = maxs.y - mins.y;
+		const float dz = maxs.z - mins.z;
+		return 2.0f * (dx * dy + dy * dz + dz * dx);
+	}
+
+	Bounds Expanded( float margin ) const
+	{
+		return { { mins.x - margin, mins.y - margin, mins.z - margin },
+			{ maxs.x + margin, maxs.y + margin, maxs.z + margin } };
+	}
+
+	bool Contains( const Bounds& other ) const
+	{
+		return mins.x <= other.mins.x && mins.y <= other.mins.y && mins.z <= other.mins.z
+			&& maxs.x >= other.maxs.x && maxs.y >= other.maxs.y && maxs.z >= other.maxs.z;
+	}
+
+	bool Overlaps( const Bounds& other ) const
+	{
+		return mins.x <= other.maxs.x && maxs.x >= other.mins.x
+			&& mins.y <= other.maxs.y && maxs.y >= other.mins.y
+			&& mins.z <= other.maxs.z && maxs.z >= other.mins.z;
+	}
+
+	bool OverlapsSphere( const Vec3& centre, float radius ) const
+	{
+		const float dx = std::max( { mins.x - centre.x, 0.0f, centre.x - maxs.x } );
+		const float dy = std::max( { mins.y - centre.y, 0.0f, centre.y - maxs.y } );
+		const float dz = std::max( { mins.z - centre.z, 0.0f, centre.z - maxs.z } );
+		return (dx * dx + dy * dy + dz * dz) <= radius * radius;
+	}
+
+	// Slab test. inverseDirection may contain infinities for axis-aligned rays
+	// outDistance is the distance along the ray at which it enters the box
+	bool IntersectsRay( const Vec3& start, const Vec3& inverseDirection, float maxDistance, float& outDistance ) const
+	{
+		float tMin = 0.0f;
+		float tMax = maxDistance;
+
+		const float starts[3] = { start.x, start.y, start.z };
+		const float inverses[3] = { inverseDirection.x, inverseDirection.y, inverseDirection.z };
+		const float boxMins[3] = { mins.x, mins.y, mins.z };
+		const float boxMaxs[3] = { maxs.x, maxs.y, maxs.z };
+
+		for ( int axis = 0; axis < 3; axis++ )
+		{
+			float t1 = (boxMins[axis] - starts[axis]) * inverses[axis];
+			float t2 = (boxMaxs[axis] - starts[axis]) * inverses[axis];
+			if ( t1 > t2 )
+			{
+				std::swap( t1, t2 );
+			}
+
+			tMin = std::max( tMin, t1 );
+			tMax = std::min( tMax, t2 );
+			if ( tMin > tMax )
+			{
+				return false;
+			}
+		}
+
+		outDistance = tMin;
+		return true;
+	}
+
+	// Transforms all 8 corners and wraps a new box around them
+	Bounds Transformed( const Mat4& transform ) const
+	{
+		Bounds result;
+		for ( uint32_t i = 0U; i < 8U; i++ )
+		{
+			const Vec4 p = TransformPoint( transform, GetCorner( i ) );
+			result.Add( Vec3( p.m.x, p.m.y, p.m.z ) );
+		}
+
+		return result;
+	}
+};
+
+enum class FrustumTestResult
+{
+	Outside,
+	Intersecting,
+	Inside
+};
+
+// A view frustum, tested in clip space
+// Instead of extracting planes, box corners are projected and compared against
+// the clip-space half-spaces, which also lets portals narrow the frustum down
+// to a sub-rectangle of normalised device coordinates
+struct Frustum
+{
+	// Projection * view
+	Mat4 viewProjection{};
+	// NDC rectangle that is considered visible, [-1, 1] is the whole screen
+	float left{ -1.0f };
+	float right{ 1.0f };
+	float bottom{ -1.0f };
+	float top{ 1.0f };
+
+	bool IsEmpty() const
+	{
+		return left >= right || bottom >= top;
+	}
+
+	FrustumTestResult Test( const Bounds& bounds ) const
+	{
+		// One bit per plane: left, right, bottom, top, near, far
+		uint32_t outsideAll = 0b111111U;
+		uint32_t outsideAny = 0U;
+
+		for ( uint32_t i = 0U; i < 8U; i++ )
+		{
+			const Vec4 p = TransformPoint( viewProjection, bounds.GetCorner( i ) );
+			const float w = p.m.w;
+
+			uint32_t outside = 0U;
+			outside |= (p.m.x < left * w) ? (1U << 0U) : 0U;
+			outside |= (p.m.x > right * w) ? (1U << 1U) : 0U;
+			outside |= (p.m.y < bottom * w) ? (1U << 2U) : 0U;
+			outside |= (p.m.y > top * w) ? (1U << 3U) : 0U;
+			outside |= (p.m.z < 0.0f) ? (1U << 4U) : 0U;
+			outside |= (p.m.z > w) ? (1U << 5U) : 0U;
+
+			outsideAll &= outside;
+			outsideAny |= outside;
+		}
+
+		// Every corner is behind the same plane
+		if ( outsideAll )
+		{
+			return FrustumTestResult::Outside;
+		}
+
+		return outsideAny ? FrustumTestResult::Intersecting : FrustumTestResult::Inside;
+	}
+};
@@ -0,0 +1,102 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "CommandStats.hpp"
+
+const char* RenderCommandToString( RenderCommand command )
+{
+	switch ( command )
+	{
+	case RenderCommand::SetGraphicsState: return "SetGraphicsState";
+	case RenderCommand::Draw: return "Draw";
+	case RenderCommand::DrawIndexed: return "DrawIndexed";
+	case RenderCommand::Dispatch: return "Dispatch";
+	case RenderCommand::WriteBuffer: return "WriteBuffer";
+	case RenderCommand::WriteTexture: return "WriteTexture";
+	case RenderCommand::CopyTexture: return "CopyTexture";
+	case RenderCommand::ClearTexture: return "ClearTexture";
+	case RenderCommand::ExecuteCommandList: return "ExecuteCommandList";
+	case RenderCommand::CreateBuffer: return "CreateBuffer";
+	case RenderCommand::CreateTexture: return "CreateTexture";
+	case RenderCommand::Count: break;
+	}
+
+	return "UNKNOWN";
+}
+
+void CommandStats::EndFrame()
+{
+	lastFrame = currentFrame;
+	currentFrame = {};
+	frameIndex++;
+}
+
+const CommandStats::Counters& CommandStats::GetCurrentFrame() const
+{
+	return currentFrame;
+}
+
+const CommandStats::Counters& CommandStats::GetLastFrame() const
+{
+	return lastFrame;
+}
+
+const CommandStats::Counters& CommandStats::GetTotal() const
+{
+	return total;
+}
+
+void CommandStats::Reset()
+{
+	currentFrame = {};
+	lastFrame = {};
+	total = {};
+}
+
+void CommandStats::SetLogging( bool enabled )
+{
+	logging = enabled;
+}
+
+const Vector<CommandStats::LogEntry>& CommandStats::GetLog() const
+{
+	return log;
+}
+
+bool CommandStats::WriteLog( const Path& path ) const
+{
+	std::ofstream file( path, std::ios::trunc );
+	if ( !file )
+	{
+		return false;
+	}
+
+	for ( const LogEntry& entry : log )
+	{
+		file << entry.frame << ' ' << RenderCommandToString( entry.command ) << ' ' << entry.value << '\n';
+	}
+
+	return bool( file );
+}
+
+void CommandStats::ClearLog()
+{
+	log.clear();
+}
+
+void CommandStats::Dump() const
+{
+	Console->Print( "Render commands:           last frame               total" );
+	for ( size_t i = 0U; i < size_t( RenderCommand::Count ); i++ )
+	{
+		Console->Print( format( "  * %-20s %8llu (%10llu) %10llu (%12llu)", RenderCommandToString( RenderCommand( i ) ),
+			(unsigned long long)lastFrame.counts[i], (unsigned long long)lastFrame.values[i],
+			(unsigned long long)total.counts[i], (unsigned long long)total.values[i] ) );
+	}
+
+	if ( logging )
+	{
+		Console->Print( format( "  Logged %zu commands%s", log.size(), log.size() >= MaxLogEntries ? " (log is full)" : "" ) );
+	}
+}
@@ -0,0 +1,101 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+enum class RenderCommand : uint8_t
+{
+	SetGraphicsState,
+	// Value is the number of vertices
+	Draw,
+	DrawIndexed,
+	// Value is the number of thread groups
+	Dispatch,
+	// Value is the number of bytes written
+	WriteBuffer,
+	WriteTexture,
+	CopyTexture,
+	ClearTexture,
+	// Command list submissions
+	ExecuteCommandList,
+	CreateBuffer,
+	CreateTexture,
+	Count
+};
+
+const char* RenderCommandToString( RenderCommand command );
+
+// Counts the commands and resource creations that the frontend issues to the backend
+// Every call site records itself, so this doesn't depend on any particular backend,
+// and the numbers come out the same no matter what the GPU is. Optionally, the whole
+// command stream is logged, so two runs can be diffed
+class CommandStats
+{
+public:
+	struct Counters
+	{
+		uint64_t counts[size_t( RenderCommand::Count )]{};
+		// Bytes for writes, index counts for draws
+		uint64_t values[size_t( RenderCommand::Count )]{};
+
+		uint64_t GetCount( RenderCommand command ) const
+		{
+			return counts[size_t( command )];
+		}
+
+		uint64_t GetValue( RenderCommand command ) const
+		{
+			return values[size_t( command )];
+		}
+	};
+
+	struct LogEntry
+	{
+		uint64_t frame{ 0U };
+		RenderCommand command{ RenderCommand::Count };
+		uint64_t value{ 0U };
+	};
+
+	// Stops logging past this, so a forgotten log doesn't eat all memory
+	static constexpr size_t MaxLogEntries = 4U * 1024U * 1024U;
+
+	void					Record( RenderCommand command, uint64_t value = 0U )
+	{
+		currentFrame.counts[size_t( command )]++;
+		currentFrame.values[size_t( command )] += value;
+		total.counts[size_t( command )]++;
+		total.values[size_t( command )] += value;
+
+		if ( logging && log.size() < MaxLogEntries )
+		{
+			log.push_back( { frameIndex, command, value } );
+		}
+	}
+
+	// Finishes the current frame, its counters become the last frame's
+	void					EndFrame();
+
+	const Counters&			GetCurrentFrame() const;
+	const Counters&			GetLastFrame() const;
+	// Everything since startup or the last Reset, including loading
+	const Counters&			GetTotal() const;
+	void					Reset();
+
+	void					SetLogging( bool enabled );
+	const Vector<LogEntry>& GetLog() const;
+	// One command per line: frame, command, value
+	bool					WriteLog( const Path& path ) const;
+	void					ClearLog();
+
+	// Prints the last frame's counters and the totals
+	void					Dump() const;
+
+private:
+	Counters				currentFrame{};
+	Counters				lastFrame{};
+	Counters				total{};
+	uint64_t				frameIndex{ 0U };
+
+	bool					logging{ false };
+	Vector<LogEntry>		log{};
+};
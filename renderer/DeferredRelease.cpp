@@ -0,0 +1,59 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "DeferredRelease.hpp"
+
+void DeferredReleaseQueue::Release( uint64_t completedFrame, MemoryTracker& memoryTracker )
+{
+	while ( !pending.empty() && pending.front().frameIndex <= completedFrame )
+	{
+		PendingRelease& release = pending.front();
+		memoryTracker.ReleaseOwner( release.memoryOwner );
+		pendingBytes -= release.bytes;
+		numReleased++;
+
+		pending.pop_front();
+	}
+}
+
+void DeferredReleaseQueue::ReleaseAll( MemoryTracker& memoryTracker )
+{
+	Release( UINT64_MAX, memoryTracker );
+}
+
+void DeferredReleaseQueue::Request( std::function<void()> request )
+{
+	std::lock_guard<std::mutex> lock( requestMutex );
+	requests.push_back( std::move( request ) );
+}
+
+void DeferredReleaseQueue::RunRequests()
+{
+	{
+		std::lock_guard<std::mutex> lock( requestMutex );
+		runningRequests.swap( requests );
+	}
+
+	for ( auto& request : runningRequests )
+	{
+		request();
+	}
+
+	runningRequests.clear();
+}
+
+size_t DeferredReleaseQueue::GetNumPending() const
+{
+	return pending.size();
+}
+
+size_t DeferredReleaseQueue::GetPendingBytes() const
+{
+	return pendingBytes;
+}
+
+uint64_t DeferredReleaseQueue::GetNumReleased() const
+{
+	return numReleased;
+}
@@ -0,0 +1,64 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "MemoryTracker.hpp"
+
+// Keeps destroyed models, views, textures and batches alive until the GPU is done
+// with every frame that could have used them, then releases them in one go at the
+// start of a frame. Destruction can also be requested from other threads, in which
+// case it's carried out on the main thread at the next frame boundary
+class DeferredReleaseQueue
+{
+public:
+	// The object is released once the GPU completes the frame it was queued in
+	// Its memory owner is released along with it, until then its memory counts as in use
+	template<typename T>
+	void					Enqueue( UniquePtr<T> object, uint64_t frameIndex, const MemoryTracker& memoryTracker, MemoryTracker::OwnerId memoryOwner )
+	{
+		const MemoryTracker::OwnerInfo* owner = memoryTracker.GetOwner( memoryOwner );
+		const size_t bytes = nullptr != owner ? owner->bytes : 0U;
+
+		pendingBytes += bytes;
+		pending.push_back( { frameIndex, std::shared_ptr<void>( std::move( object ) ), memoryOwner, bytes } );
+	}
+
+	// Releases everything that was queued in or before completedFrame
+	void					Release( uint64_t completedFrame, MemoryTracker& memoryTracker );
+	// Only safe once the GPU is idle
+	void					ReleaseAll( MemoryTracker& memoryTracker );
+
+	// Thread-safe, the request is run by RunRequests
+	void					Request( std::function<void()> request );
+	// Main thread only
+	void					RunRequests();
+
+	size_t					GetNumPending() const;
+	size_t					GetPendingBytes() const;
+	uint64_t				GetNumReleased() const;
+
+private:
+	struct PendingRelease
+	{
+		uint64_t frameIndex{ 0U };
+		std::shared_ptr<void> object{};
+		MemoryTracker::OwnerId memoryOwner{ MemoryTracker::InvalidOwner };
+		size_t bytes{ 0U };
+	};
+
+	// In the order of frames, so releasing stops at the first one that isn't done
+	std::deque<PendingRelease> pending{};
+	size_t					pendingBytes{ 0U };
+	uint64_t				numReleased{ 0U };
+
+	std::mutex				requestMutex{};
+	Vector<std::function<void()>> requests{};
+	// Swapped with requests, so a request may queue another one
+	Vector<std::function<void()>> runningRequests{};
+};
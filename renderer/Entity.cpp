@@ -1,20 +1,59 @@
-// SPDX-FileCopyrightText: 2022 Admer uko
-// SPDX-License-Identifier: MIT
-
-#include "Precompiled.hpp"
-#include "Entity.hpp"
-
-Entity::Entity( const EntityDesc& desc )
-	: desc( desc )
-{
-}
-
-EntityDesc& Entity::GetDesc()
-{
-	return desc;
-}
-
-const EntityDesc& Entity::GetDesc() const
-{
-	return desc;
-}
+// SPDX-FileCopyrightText: 2022 Admer uko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "Model.hpp"
+#include "Entity.hpp"
+
+Entity::Entity( const EntityDesc& desc, Vector<Entity*>& changeList )
+	: desc( desc ), changeList( changeList )
+{
+}
+
+EntityDesc& Entity::GetDesc()
+{
+	if ( !changed )
+	{
+		changed = true;
+		changeList.push_back( this );
+	}
+
+	return desc;
+}
+
+const EntityDesc& Entity::GetDesc() const
+{
+	return desc;
+}
+
+const Bounds& Entity::UpdateWorldBounds()
+{
+	const Model* model = static_cast<const Model*>( desc.model );
+	worldBounds = model->GetBounds().Transformed( desc.transform );
+	return worldBounds;
+}
+
+const Bounds& Entity::GetWorldBounds() const
+{
+	return worldBounds;
+}
+
+const Vector<FaceDrawRecord>& Entity::GetDrawRecords() const
+{
+	if ( nullptr != skin )
+	{
+		return skin->drawRecords;
+	}
+
+	return static_cast<const Model*>( desc.model )->GetDrawRecords();
+}
+
+bool Entity::IsChanged() const
+{
+	return changed;
+}
+
+void Entity::ClearChanged()
+{
+	changed = false;
+}
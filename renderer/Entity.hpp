@@ -1,16 +1,50 @@
-// SPDX-FileCopyrightText: 2022 Admer uko
-// SPDX-License-Identifier: MIT
-
-#pragma once
-
-class Entity final : public IEntity
-{
-public:
-	Entity( const EntityDesc& desc );
-	
-	EntityDesc& GetDesc() override;
-	const EntityDesc& GetDesc() const override;
-
-private:
-	EntityDesc desc;
-};
+// SPDX-FileCopyrightText: 2022 Admer uko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "Bounds.hpp"
+#include "Skinning.hpp"
+
+class Volume;
+
+class Entity final : public IEntity
+{
+public:
+	// changeList is where this entity will put itself once it's modified
+	Entity( const EntityDesc& desc, Vector<Entity*>& changeList );
+	
+	// Handing out a mutable desc counts as a modification, since
+	// we cannot know what the caller will do with it
+	EntityDesc& GetDesc() override;
+	const EntityDesc& GetDesc() const override;
+
+	// Recomputes the world-space bounds from the model and transform
+	const Bounds& UpdateWorldBounds();
+	const Bounds& GetWorldBounds() const;
+
+	// The model's, or the skin's if the entity is skinned
+	const Vector<FaceDrawRecord>& GetDrawRecords() const;
+
+	bool IsChanged() const;
+	void ClearChanged();
+
+	// Entity tree leaf, see EntityTree
+	int32_t treeProxy{ -1 };
+	// Visibility cells this entity overlaps
+	Vector<Volume*> cells{};
+	// Used to avoid adding an entity twice when it's reached through several cells
+	uint32_t visibilityStamp{ 0U };
+	// Frontend change serial of the last update this entity went through, see UpdateEntityTree
+	uint64_t changeSerial{ 0U };
+	// Slot in the frontend's entity buffer, see RenderFrontend::EntityData
+	uint32_t dataSlot{ 0U };
+	// Only for entities with bones, see RenderFrontend::UpdateEntitySkin
+	UniquePtr<EntitySkin> skin{};
+
+private:
+	EntityDesc desc;
+	Bounds worldBounds{};
+	Vector<Entity*>& changeList;
+	bool changed{ false };
+};
@@ -0,0 +1,495 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "EntityTree.hpp"
+
+static Bounds CombineBounds( const Bounds& a, const Bounds& b )
+{
+	Bounds result = a;
+	result.Add( b );
+	return result;
+}
+
+int32_t EntityTree::Insert( const Bounds& bounds, IEntity* entity )
+{
+	const int32_t proxy = AllocateNode();
+	nodes[proxy].bounds = bounds.Expanded( FatMargin );
+	nodes[proxy].entity = entity;
+	nodes[proxy].height = 0;
+
+	InsertLeaf( proxy );
+	numProxies++;
+
+	return proxy;
+}
+
+void EntityTree::Remove( int32_t proxy )
+{
+	RemoveLeaf( proxy );
+	FreeNode( proxy );
+	numProxies--;
+}
+
+bool EntityTree::Move( int32_t proxy, const Bounds& bounds )
+{
+	// Still fits within the fat bounds, nothing to do
+	if ( nodes[proxy].bounds.Contains( bounds ) )
+	{
+		return false;
+	}
+
+	RemoveLeaf( proxy );
+	nodes[proxy].bounds = bounds.Expanded( FatMargin );
+	InsertLeaf( proxy );
+
+	return true;
+}
+
+void EntityTree::Clear()
+{
+	nodes.clear();
+	root = NullNode;
+	freeList = NullNode;
+	numProxies = 0U;
+}
+
+const Bounds& EntityTree::GetFatBounds( int32_t proxy ) const
+{
+	return nodes[proxy].bounds;
+}
+
+size_t EntityTree::GetNumProxies() const
+{
+	return numProxies;
+}
+
+int32_t EntityTree::GetHeight() const
+{
+	return root == NullNode ? 0 : nodes[root].height;
+}
+
+template<typename NodeTest, typename LeafCallback>
+void EntityTree::Traverse( NodeTest&& nodeTest, LeafCallback&& leafCallback ) const
+{
+	if ( root == NullNode )
+	{
+		return;
+	}
+
+	Vector<int32_t> stack;
+	stack.reserve( 64U );
+	stack.push_back( root );
+
+	while ( !stack.empty() )
+	{
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+
+		if ( !nodeTest( node.bounds ) )
+		{
+			continue;
+		}
+
+		if ( node.IsLeaf() )
+		{
+			leafCallback( node );
+			continue;
+		}
+
+		stack.push_back( node.child1 );
+		stack.push_back( node.child2 );
+	}
+}
+
+void EntityTree::QueryFrustum( const Frustum& frustum, Vector<IEntity*>& outEntities ) const
+{
+	if ( root == NullNode || frustum.IsEmpty() )
+	{
+		return;
+	}
+
+	// Subtrees that are fully inside the frustum get added without further testing
+	struct StackEntry
+	{
+		int32_t node;
+		bool fullyInside;
+	};
+
+	Vector<StackEntry> stack;
+	stack.reserve( 64U );
+	stack.push_back( { root, false } );
+
+	while ( !stack.empty() )
+	{
+		const StackEntry entry = stack.back();
+		stack.pop_back();
+
+		const Node& node = nodes[entry.node];
+		bool fullyInside = entry.fullyInside;
+		if ( !fullyInside )
+		{
+			const FrustumTestResult result = frustum.Test( node.bounds );
+			if ( result == FrustumTestResult::Outside )
+			{
+				continue;
+			}
+
+			fullyInside = result == FrustumTestResult::Inside;
+		}
+
+		if ( node.IsLeaf() )
+		{
+			outEntities.push_back( node.entity );
+			continue;
+		}
+
+		stack.push_back( { node.child1, fullyInside } );
+		stack.push_back( { node.child2, fullyInside } );
+	}
+}
+
+void EntityTree::QueryFrusta( const Frustum* frusta, uint32_t numFrusta, Vector<VisibleEntity>& outEntities ) const
+{
+	numFrusta = std::min( numFrusta, MaxFrusta );
+
+	uint64_t initialMask = 0U;
+	for ( uint32_t i = 0U; i < numFrusta; i++ )
+	{
+		if ( !frusta[i].IsEmpty() )
+		{
+			initialMask |= 1ULL << i;
+		}
+	}
+
+	if ( root == NullNode || 0U == initialMask )
+	{
+		return;
+	}
+
+	// Same as QueryFrustum, but per frustum: a frustum is dropped from a subtree once the
+	// subtree is outside of it, and isn't tested anymore once the subtree is fully inside it
+	struct StackEntry
+	{
+		int32_t node;
+		uint64_t testMask;
+		uint64_t insideMask;
+	};
+
+	Vector<StackEntry> stack;
+	stack.reserve( 64U );
+	stack.push_back( { root, initialMask, 0U } );
+
+	while ( !stack.empty() )
+	{
+		StackEntry entry = stack.back();
+		stack.pop_back();
+
+		const Node& node = nodes[entry.node];
+		for ( uint32_t i = 0U; i < numFrusta; i++ )
+		{
+			const uint64_t bit = 1ULL << i;
+			if ( 0U == (entry.testMask & bit) )
+			{
+				continue;
+			}
+
+			const FrustumTestResult result = frusta[i].Test( node.bounds );
+			if ( result != FrustumTestResult::Intersecting )
+			{
+				entry.testMask &= ~bit;
+			}
+			if ( result == FrustumTestResult::Inside )
+			{
+				entry.insideMask |= bit;
+			}
+		}
+
+		const uint64_t visibleMask = entry.testMask | entry.insideMask;
+		if ( 0U == visibleMask )
+		{
+			continue;
+		}
+
+		if ( node.IsLeaf() )
+		{
+			outEntities.push_back( { node.entity, visibleMask } );
+			continue;
+		}
+
+		stack.push_back( { node.child1, entry.testMask, entry.insideMask } );
+		stack.push_back( { node.child2, entry.testMask, entry.insideMask } );
+	}
+}
+
+void EntityTree::QueryBox( const Bounds& box, Vector<IEntity*>& outEntities ) const
+{
+	Traverse( [&box]( const Bounds& bounds )
+		{
+			return box.Overlaps( bounds );
+		},
+		[&outEntities]( const Node& node )
+		{
+			outEntities.push_back( node.entity );
+		} );
+}
+
+void EntityTree::QuerySphere( const Vec3& centre, float radius, Vector<IEntity*>& outEntities ) const
+{
+	Traverse( [&centre, radius]( const Bounds& bounds )
+		{
+			return bounds.OverlapsSphere( centre, radius );
+		},
+		[&outEntities]( const Node& node )
+		{
+			outEntities.push_back( node.entity );
+		} );
+}
+
+void EntityTree::QueryRay( const Vec3& start, const Vec3& direction, float maxDistance, Vector<IEntity*>& outEntities ) const
+{
+	const Vec3 inverseDirection = { 1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z };
+
+	Vector<std::pair<float, IEntity*>> hits;
+	float hitDistance = 0.0f;
+
+	Traverse( [&]( const Bounds& bounds )
+		{
+			return bounds.IntersectsRay( start, inverseDirection, maxDistance, hitDistance );
+		},
+		[&]( const Node& node )
+		{
+			// hitDistance was written by the node test right before this
+			hits.push_back( { hitDistance, node.entity } );
+		} );
+
+	std::sort( hits.begin(), hits.end(), []( const auto& a, const auto& b )
+		{
+			return a.first < b.first;
+		} );
+
+	for ( const auto& hit : hits )
+	{
+		outEntities.push_back( hit.second );
+	}
+}
+
+int32_t EntityTree::AllocateNode()
+{
+	if ( freeList == NullNode )
+	{
+		nodes.emplace_back();
+		return int32_t( nodes.size() - 1U );
+	}
+
+	const int32_t node = freeList;
+	freeList = nodes[node].parent;
+	nodes[node] = Node();
+	return node;
+}
+
+void EntityTree::FreeNode( int32_t node )
+{
+	nodes[node].parent = freeList;
+	nodes[node].entity = nullptr;
+	nodes[node].height = -1;
+	freeList = node;
+}
+
+void EntityTree::InsertLeaf( int32_t leaf )
+{
+	if ( root == NullNode )
+	{
+		root = leaf;
+		nodes[root].parent = NullNode;
+		return;
+	}
+
+	// Descend towards the cheapest sibling, based on how much area would be added
+	const Bounds leafBounds = nodes[leaf].bounds;
+	int32_t index = root;
+	while ( !nodes[index].IsLeaf() )
+	{
+		const Node& node = nodes[index];
+		const float area = node.bounds.GetSurfaceArea();
+		const float combinedArea = CombineBounds( node.bounds, leafBounds ).GetSurfaceArea();
+
+		// Cost of making a new parent for this node and the leaf
+		const float cost = 2.0f * combinedArea;
+		// Minimum cost of pushing the leaf further down the tree
+		const float inheritanceCost = 2.0f * (combinedArea - area);
+
+		const auto childCost = [&]( int32_t child )
+		{
+			const Bounds combined = CombineBounds( nodes[child].bounds, leafBounds );
+			if ( nodes[child].IsLeaf() )
+			{
+				return combined.GetSurfaceArea() + inheritanceCost;
+			}
+
+			return (combined.GetSurfaceArea() - nodes[child].bounds.GetSurfaceArea()) + inheritanceCost;
+		};
+
+		const float cost1 = childCost( node.child1 );
+		const float cost2 = childCost( node.child2 );
+
+		if ( cost < cost1 && cost < cost2 )
+		{
+			break;
+		}
+
+		index = (cost1 < cost2) ? node.child1 : node.child2;
+	}
+
+	const int32_t sibling = index;
+	const int32_t oldParent = nodes[sibling].parent;
+	const int32_t newParent = AllocateNode();
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].bounds = CombineBounds( leafBounds, nodes[sibling].bounds );
+	nodes[newParent].height = nodes[sibling].height + 1;
+	nodes[newParent].child1 = sibling;
+	nodes[newParent].child2 = leaf;
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+
+	if ( oldParent == NullNode )
+	{
+		root = newParent;
+	}
+	else if ( nodes[oldParent].child1 == sibling )
+	{
+		nodes[oldParent].child1 = newParent;
+	}
+	else
+	{
+		nodes[oldParent].child2 = newParent;
+	}
+
+	Refit( newParent );
+}
+
+void EntityTree::RemoveLeaf( int32_t leaf )
+{
+	if ( leaf == root )
+	{
+		root = NullNode;
+		return;
+	}
+
+	const int32_t parent = nodes[leaf].parent;
+	const int32_t grandParent = nodes[parent].parent;
+	const int32_t sibling = (nodes[parent].child1 == leaf) ? nodes[parent].child2 : nodes[parent].child1;
+
+	FreeNode( parent );
+
+	if ( grandParent == NullNode )
+	{
+		root = sibling;
+		nodes[sibling].parent = NullNode;
+		return;
+	}
+
+	// The sibling takes the parent's place
+	if ( nodes[grandParent].child1 == parent )
+	{
+		nodes[grandParent].child1 = sibling;
+	}
+	else
+	{
+		nodes[grandParent].child2 = sibling;
+	}
+	nodes[sibling].parent = grandParent;
+
+	Refit( grandParent );
+}
+
+// Walks up from the given node, rebalancing and recomputing bounds & heights
+void EntityTree::Refit( int32_t index )
+{
+	while ( index != NullNode )
+	{
+		index = Balance( index );
+
+		Node& node = nodes[index];
+		node.height = 1 + std::max( nodes[node.child1].height, nodes[node.child2].height );
+		node.bounds = CombineBounds( nodes[node.child1].bounds, nodes[node.child2].bounds );
+
+		index = node.parent;
+	}
+}
+
+// Performs a left or right rotation if node A is imbalanced
+// Returns the new root of this subtree
+int32_t EntityTree::Balance( int32_t iA )
+{
+	Node& a = nodes[iA];
+	if ( a.IsLeaf() || a.height < 2 )
+	{
+		return iA;
+	}
+
+	const int32_t iB = a.child1;
+	const int32_t iC = a.child2;
+	const int32_t balance = nodes[iC].height - nodes[iB].height;
+
+	// Promotes the taller child (iUp) of A, the shorter child (iStay) remains on A
+	const auto rotate = [&]( int32_t iUp, int32_t iStay )
+	{
+		Node& up = nodes[iUp];
+		const int32_t iF = up.child1;
+		const int32_t iG = up.child2;
+
+		// Swap A and the promoted node
+		up.child1 = iA;
+		up.parent = a.parent;
+		a.parent = iUp;
+
+		if ( up.parent == NullNode )
+		{
+			root = iUp;
+		}
+		else if ( nodes[up.parent].child1 == iA )
+		{
+			nodes[up.parent].child1 = iUp;
+		}
+		else
+		{
+			nodes[up.parent].child2 = iUp;
+		}
+
+		// The taller grandchild stays on the promoted node, the other goes to A
+		const bool fIsTaller = nodes[iF].height > nodes[iG].height;
+		const int32_t iTall = fIsTaller ? iF : iG;
+		const int32_t iShort = fIsTaller ? iG : iF;
+
+		up.child2 = iTall;
+		if ( a.child1 == iUp )
+		{
+			a.child1 = iShort;
+		}
+		else
+		{
+			a.child2 = iShort;
+		}
+		nodes[iShort].parent = iA;
+
+		a.bounds = CombineBounds( nodes[iStay].bounds, nodes[iShort].bounds );
+		a.height = 1 + std::max( nodes[iStay].height, nodes[iShort].height );
+		up.bounds = CombineBounds( a.bounds, nodes[iTall].bounds );
+		up.height = 1 + std::max( a.height, nodes[iTall].height );
+
+		return iUp;
+	};
+
+	if ( balance > 1 )
+	{
+		return rotate( iC, iB );
+	}
+
+	if ( balance < -1 )
+	{
+		return rotate( iB, iC );
+	}
+
+	return iA;
+}
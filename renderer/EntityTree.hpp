@@ -0,0 +1,81 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "Bounds.hpp"
+
+// An entity and the set of frusta it's visible in, one bit per frustum
+struct VisibleEntity
+{
+	IEntity* entity{ nullptr };
+	uint64_t frustumMask{ 0U };
+};
+
+// Dynamic bounding volume hierarchy over render entities
+// Leaves store "fat" bounds, so small movements don't touch the tree at all,
+// and larger ones only remove & reinsert a single leaf. Insertion picks the
+// sibling by surface area cost and the tree is kept balanced with rotations
+class EntityTree
+{
+public:
+	static constexpr int32_t NullNode = -1;
+	// How much leaf bounds are inflated by, in world units
+	static constexpr float FatMargin = 4.0f;
+	// Limit of QueryFrusta, one bit per frustum
+	static constexpr uint32_t MaxFrusta = 64U;
+
+	int32_t					Insert( const Bounds& bounds, IEntity* entity );
+	void					Remove( int32_t proxy );
+	// Returns true if the leaf had to be reinserted
+	bool					Move( int32_t proxy, const Bounds& bounds );
+	void					Clear();
+
+	const Bounds&			GetFatBounds( int32_t proxy ) const;
+	size_t					GetNumProxies() const;
+	int32_t					GetHeight() const;
+
+	void					QueryFrustum( const Frustum& frustum, Vector<IEntity*>& outEntities ) const;
+	// Walks the tree once for all frusta, each entity is output once with the frusta it's visible in
+	void					QueryFrusta( const Frustum* frusta, uint32_t numFrusta, Vector<VisibleEntity>& outEntities ) const;
+	void					QueryBox( const Bounds& box, Vector<IEntity*>& outEntities ) const;
+	void					QuerySphere( const Vec3& centre, float radius, Vector<IEntity*>& outEntities ) const;
+	// Results are sorted from nearest to farthest
+	// The direction must be unit length, maxDistance is in the same units as the bounds
+	void					QueryRay( const Vec3& start, const Vec3& direction, float maxDistance, Vector<IEntity*>& outEntities ) const;
+
+private:
+	struct Node
+	{
+		Bounds bounds{};
+		IEntity* entity{ nullptr };
+		// Doubles as the next free node when this node is not in use
+		int32_t parent{ NullNode };
+		int32_t child1{ NullNode };
+		int32_t child2{ NullNode };
+		// Leaves are 0, free nodes are -1
+		int32_t height{ -1 };
+
+		bool IsLeaf() const
+		{
+			return child1 == NullNode;
+		}
+	};
+
+	int32_t					AllocateNode();
+	void					FreeNode( int32_t node );
+	void					InsertLeaf( int32_t leaf );
+	void					RemoveLeaf( int32_t leaf );
+	int32_t					Balance( int32_t node );
+	void					Refit( int32_t node );
+
+	// Visits nodes whose bounds pass nodeTest, calling leafCallback on each leaf that passes
+	template<typename NodeTest, typename LeafCallback>
+	void					Traverse( NodeTest&& nodeTest, LeafCallback&& leafCallback ) const;
+
+private:
+	Vector<Node>			nodes{};
+	int32_t					root{ NullNode };
+	int32_t					freeList{ NullNode };
+	size_t					numProxies{ 0U };
+};
@@ -0,0 +1,240 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "GpuProfiler.hpp"
+
+// Some backends can't do timer queries at all, in which case
+// this whole thing just stays quiet
+void GpuProfiler::Init( IBackend* backendDevice )
+{
+	device = backendDevice;
+
+	nvrhi::TimerQueryHandle testQuery = device->createTimerQuery();
+	supported = nullptr != testQuery;
+	if ( !supported )
+	{
+		Console->Warning( "GpuProfiler: timer queries are not supported by this backend, GPU timings will not be available" );
+		return;
+	}
+
+	freeQueries.push_back( testQuery );
+}
+
+void GpuProfiler::Shutdown()
+{
+	pendingFrames.clear();
+	freeQueries.clear();
+	passStats.clear();
+	passOrder.clear();
+	frameStats = {};
+	lastFrameTime = 0.0f;
+	lastFrameIndex = 0U;
+	openPass = -1;
+	supported = false;
+	device = nullptr;
+}
+
+void GpuProfiler::BeginFrame( uint64_t frameIndex )
+{
+	if ( !supported )
+	{
+		return;
+	}
+
+	// Frames complete in order, so stop at the first one that isn't done
+	while ( !pendingFrames.empty() && pendingFrames.front().frameIndex + FrameLatency <= frameIndex )
+	{
+		if ( !ReadFrame( pendingFrames.front() ) )
+		{
+			break;
+		}
+
+		pendingFrames.pop_front();
+	}
+
+	// Its queries are not recycled, since the GPU may still write into them
+	if ( pendingFrames.size() >= MaxPendingFrames )
+	{
+		pendingFrames.pop_front();
+	}
+
+	if ( openPass != -1 )
+	{
+		Console->Warning( "GpuProfiler::BeginFrame: a pass was never ended" );
+		openPass = -1;
+	}
+
+	pendingFrames.push_back( { frameIndex, {} } );
+}
+
+void GpuProfiler::BeginPass( nvrhi::ICommandList* commandList, StringView name )
+{
+	if ( !supported || pendingFrames.empty() )
+	{
+		return;
+	}
+
+	if ( openPass != -1 )
+	{
+		Console->Warning( format( "GpuProfiler::BeginPass: pass '%s' began before the previous one ended", String( name ).c_str() ) );
+		return;
+	}
+
+	FrameQueries& frame = pendingFrames.back();
+	openPass = int32_t( frame.passes.size() );
+	frame.passes.push_back( { String( name ), AllocateQuery() } );
+	commandList->beginTimerQuery( frame.passes.back().query );
+}
+
+void GpuProfiler::EndPass( nvrhi::ICommandList* commandList )
+{
+	if ( !supported || openPass == -1 )
+	{
+		return;
+	}
+
+	commandList->endTimerQuery( pendingFrames.back().passes[openPass].query );
+	openPass = -1;
+}
+
+bool GpuProfiler::IsSupported() const
+{
+	return supported;
+}
+
+float GpuProfiler::GetAveragePassTime( StringView name ) const
+{
+	auto it = passStats.find( String( name ) );
+	return it != passStats.end() ? GetAverage( it->second ) : 0.0f;
+}
+
+float GpuProfiler::GetAverageFrameTime() const
+{
+	return GetAverage( frameStats );
+}
+
+float GpuProfiler::GetLastFrameTime() const
+{
+	return lastFrameTime;
+}
+
+uint64_t GpuProfiler::GetLastFrameIndex() const
+{
+	return lastFrameIndex;
+}
+
+void GpuProfiler::Dump() const
+{
+	if ( !supported )
+	{
+		Console->Print( "GpuProfiler: timer queries are not supported by this backend" );
+		return;
+	}
+
+	const auto printStats = []( const char* name, const PassStats& stats )
+	{
+		if ( 0U == stats.numSamples )
+		{
+			return;
+		}
+
+		float minimum = FLT_MAX, maximum = 0.0f;
+		for ( uint32_t i = 0U; i < stats.numSamples; i++ )
+		{
+			minimum = std::min( minimum, stats.samples[i] );
+			maximum = std::max( maximum, stats.samples[i] );
+		}
+
+		Console->Print( format( "  %-32s min %7.3f  avg %7.3f  max %7.3f ms", name, minimum, GetAverage( stats ), maximum ) );
+	};
+
+	Console->Print( format( "GPU timings: last %u frames, %u frames behind", frameStats.numSamples, uint32_t( pendingFrames.size() ) ) );
+	printStats( "All passes", frameStats );
+	for ( const String& name : passOrder )
+	{
+		printStats( name.c_str(), passStats.at( name ) );
+	}
+}
+
+nvrhi::TimerQueryHandle GpuProfiler::AllocateQuery()
+{
+	if ( freeQueries.empty() )
+	{
+		return device->createTimerQuery();
+	}
+
+	nvrhi::TimerQueryHandle query = freeQueries.back();
+	freeQueries.pop_back();
+	return query;
+}
+
+// Returns false if the GPU isn't done with this frame yet
+bool GpuProfiler::ReadFrame( FrameQueries& frame )
+{
+	for ( const PassQuery& pass : frame.passes )
+	{
+		if ( !device->pollTimerQuery( pass.query ) )
+		{
+			return false;
+		}
+	}
+
+	Map<String, float> frameTimes;
+	float frameTotal = 0.0f;
+	for ( const PassQuery& pass : frame.passes )
+	{
+		const float milliseconds = device->getTimerQueryTime( pass.query ) * 1000.0f;
+		device->resetTimerQuery( pass.query );
+		freeQueries.push_back( pass.query );
+
+		frameTimes[pass.name] += milliseconds;
+		frameTotal += milliseconds;
+	}
+
+	for ( const PassQuery& pass : frame.passes )
+	{
+		auto [it, inserted] = passStats.try_emplace( pass.name );
+		if ( inserted )
+		{
+			passOrder.push_back( pass.name );
+		}
+	}
+
+	for ( const auto& [name, milliseconds] : frameTimes )
+	{
+		AddSample( passStats[name], milliseconds );
+	}
+
+	if ( !frame.passes.empty() )
+	{
+		AddSample( frameStats, frameTotal );
+		lastFrameTime = frameTotal;
+		lastFrameIndex = frame.frameIndex;
+	}
+
+	return true;
+}
+
+void GpuProfiler::AddSample( PassStats& stats, float milliseconds )
+{
+	stats.samples[stats.nextSample] = milliseconds;
+	stats.nextSample = (stats.nextSample + 1U) % StatsWindow;
+	stats.numSamples = std::min( stats.numSamples + 1U, StatsWindow );
+}
+
+float GpuProfiler::GetAverage( const PassStats& stats )
+{
+	if ( 0U == stats.numSamples )
+	{
+		return 0.0f;
+	}
+
+	float sum = 0.0f;
+	for ( uint32_t i = 0U; i < stats.numSamples; i++ )
+	{
+		sum += stats.samples[i];
+	}
+
+	return sum / stats.numSamples;
+}
@@ -0,0 +1,83 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <deque>
+
+// Times render passes on the GPU with timer queries
+// Queries are read back a few frames later, and only once they're done,
+// so this never waits on the GPU. Frames whose queries aren't done yet
+// are simply checked again next frame
+class GpuProfiler
+{
+public:
+	// Frames to wait before trying to read a frame's queries
+	static constexpr uint32_t FrameLatency = 3U;
+	// Past this, the oldest frame is given up on, e.g. after a device loss
+	static constexpr uint32_t MaxPendingFrames = 16U;
+	// Number of frames that min/avg/max are computed over
+	static constexpr uint32_t StatsWindow = 120U;
+
+	void					Init( IBackend* backendDevice );
+	void					Shutdown();
+
+	// Reads back finished frames and starts recording a new one
+	void					BeginFrame( uint64_t frameIndex );
+
+	// Begin and end must be recorded into the same command list
+	// Passes with the same name within a frame are summed up
+	void					BeginPass( nvrhi::ICommandList* commandList, StringView name );
+	void					EndPass( nvrhi::ICommandList* commandList );
+
+	bool					IsSupported() const;
+	// Average over the stats window, 0 if the pass was never timed
+	float					GetAveragePassTime( StringView name ) const;
+	float					GetAverageFrameTime() const;
+	// Total of the newest frame that was read back, and which frame that was
+	float					GetLastFrameTime() const;
+	uint64_t				GetLastFrameIndex() const;
+	// Prints min/avg/max GPU milliseconds per pass
+	void					Dump() const;
+
+private:
+	struct PassQuery
+	{
+		String name{};
+		nvrhi::TimerQueryHandle query{};
+	};
+
+	struct FrameQueries
+	{
+		uint64_t frameIndex{ 0U };
+		Vector<PassQuery> passes{};
+	};
+
+	struct PassStats
+	{
+		float samples[StatsWindow]{};
+		uint32_t numSamples{ 0U };
+		uint32_t nextSample{ 0U };
+	};
+
+	nvrhi::TimerQueryHandle	AllocateQuery();
+	bool					ReadFrame( FrameQueries& frame );
+	static void				AddSample( PassStats& stats, float milliseconds );
+	static float			GetAverage( const PassStats& stats );
+
+private:
+	IBackend*				device{ nullptr };
+	bool					supported{ false };
+
+	std::deque<FrameQueries> pendingFrames{};
+	Vector<nvrhi::TimerQueryHandle> freeQueries{};
+	// Index into the current frame's passes, of the pass that's being recorded
+	int32_t					openPass{ -1 };
+
+	Map<String, PassStats>	passStats{};
+	// Order in which passes were first seen, for printing
+	Vector<String>			passOrder{};
+	PassStats				frameStats{};
+	float					lastFrameTime{ 0.0f };
+	uint64_t				lastFrameIndex{ 0U };
+};
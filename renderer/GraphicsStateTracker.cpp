@@ -0,0 +1,117 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "GraphicsStateTracker.hpp"
+#include <nvrhi/common/misc.h>
+
+bool GraphicsStateTracker::Set( nvrhi::ICommandList* commandList, const nvrhi::GraphicsState& state )
+{
+	const uint32_t changes = Diff( state );
+	if ( 0U == changes )
+	{
+		stats.skipped++;
+		return false;
+	}
+
+	for ( size_t i = 0U; i < size_t( Part::Count ); i++ )
+	{
+		if ( changes & (1U << i) )
+		{
+			stats.partChanges[i]++;
+		}
+	}
+
+	commandList->setGraphicsState( state );
+	stats.emitted++;
+
+	last = state;
+	valid = true;
+	return true;
+}
+
+void GraphicsStateTracker::Invalidate()
+{
+	valid = false;
+	// Don't keep resources alive just for comparisons
+	last = nvrhi::GraphicsState();
+}
+
+const GraphicsStateTracker::Stats& GraphicsStateTracker::GetStats() const
+{
+	return stats;
+}
+
+void GraphicsStateTracker::ResetStats()
+{
+	stats = {};
+}
+
+const char* GraphicsStateTracker::PartToString( Part part )
+{
+	switch ( part )
+	{
+	case Part::Pipeline: return "Pipeline";
+	case Part::Framebuffer: return "Framebuffer";
+	case Part::Viewport: return "Viewport";
+	case Part::Bindings: return "Bindings";
+	case Part::VertexBuffers: return "VertexBuffers";
+	case Part::IndexBuffer: return "IndexBuffer";
+	case Part::Count: break;
+	}
+
+	return "UNKNOWN";
+}
+
+uint32_t GraphicsStateTracker::Diff( const nvrhi::GraphicsState& state ) const
+{
+	if ( !valid )
+	{
+		return (1U << uint32_t( Part::Count )) - 1U;
+	}
+
+	const auto bit = []( Part part )
+	{
+		return 1U << uint32_t( part );
+	};
+
+	uint32_t changes = 0U;
+	if ( state.pipeline != last.pipeline )
+	{
+		changes |= bit( Part::Pipeline );
+	}
+
+	if ( state.framebuffer != last.framebuffer )
+	{
+		changes |= bit( Part::Framebuffer );
+	}
+
+	if ( nvrhi::arraysAreDifferent( state.viewport.viewports, last.viewport.viewports )
+		|| nvrhi::arraysAreDifferent( state.viewport.scissorRects, last.viewport.scissorRects ) )
+	{
+		changes |= bit( Part::Viewport );
+	}
+
+	if ( nvrhi::arraysAreDifferent( state.bindings, last.bindings ) )
+	{
+		changes |= bit( Part::Bindings );
+	}
+
+	if ( nvrhi::arraysAreDifferent( state.vertexBuffers, last.vertexBuffers ) )
+	{
+		changes |= bit( Part::VertexBuffers );
+	}
+
+	if ( state.indexBuffer != last.indexBuffer )
+	{
+		changes |= bit( Part::IndexBuffer );
+	}
+
+	// Not used by the frontend, but a state that differs only in these must still be set
+	if ( state.blendConstantColor != last.blendConstantColor || state.indirectParams != last.indirectParams )
+	{
+		changes |= bit( Part::Pipeline );
+	}
+
+	return changes;
+}
@@ -0,0 +1,50 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+// Remembers the last graphics state set on a command list, so identical states aren't set again
+// nvrhi only takes whole states, but it diffs bindings and buffers internally, so in practice
+// only the parts that changed are re-bound. Writes into volatile constant buffers don't need
+// a new state, nvrhi picks those up at the next draw
+class GraphicsStateTracker
+{
+public:
+	enum class Part : uint8_t
+	{
+		Pipeline,
+		Framebuffer,
+		Viewport,
+		Bindings,
+		VertexBuffers,
+		IndexBuffer,
+		Count
+	};
+
+	struct Stats
+	{
+		uint64_t emitted{ 0U };
+		uint64_t skipped{ 0U };
+		// How many times each part was different from the last state
+		uint64_t partChanges[size_t( Part::Count )]{};
+	};
+
+	// Sets the state if it differs from the last one. Returns true if it was set
+	bool					Set( nvrhi::ICommandList* commandList, const nvrhi::GraphicsState& state );
+	// Must be called whenever the command list loses its state: when it's opened, after clears,
+	// copies and writes into non-volatile resources, or after compute & other pipelines
+	void					Invalidate();
+
+	const Stats&			GetStats() const;
+	void					ResetStats();
+	static const char*		PartToString( Part part );
+
+private:
+	// Bitmask of parts that differ, all bits if there's no valid last state
+	uint32_t				Diff( const nvrhi::GraphicsState& state ) const;
+
+private:
+	nvrhi::GraphicsState	last{};
+	bool					valid{ false };
+	Stats					stats{};
+};
@@ -1,15 +1,20 @@
-// SPDX-FileCopyrightText: 2022 Admer Šuko
-// SPDX-License-Identifier: MIT
-
-#include "Precompiled.hpp"
-#include "Light.hpp"
-
-LightDesc& Light::GetDesc()
-{
-	return desc;
-}
-
-const LightDesc& Light::GetDesc() const
-{
-	return desc;
-}
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "Light.hpp"
+
+Light::Light( const LightDesc& lightDesc )
+	: desc( lightDesc )
+{
+}
+
+LightDesc& Light::GetDesc()
+{
+	return desc;
+}
+
+const LightDesc& Light::GetDesc() const
+{
+	return desc;
+}
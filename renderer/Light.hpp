@@ -1,13 +1,89 @@
-// SPDX-FileCopyrightText: 2022 Admer Šuko
-// SPDX-License-Identifier: MIT
-
-#pragma once
-
-class Light final : public ILight
-{
-public:
-	LightDesc& GetDesc() override;
-	const LightDesc& GetDesc() const override;
-private:
-	LightDesc desc;
-};
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "ShadowAtlas.hpp"
+
+enum class ShadowProjection : uint8_t
+{
+	// One perspective tile
+	Spot,
+	// Six perspective tiles, one per axis
+	Point,
+	// Orthographic cascades that follow the view
+	Directional
+};
+
+// How a light casts shadows. LightDesc doesn't describe shadows yet, so this is set separately
+struct LightShadowDesc
+{
+	ShadowProjection projection{ ShadowProjection::Spot };
+	Vec3 position{};
+	// Spot and directional lights shine along this, must be normalised
+	Vec3 direction{ 0.0f, 0.0f, -1.0f };
+	// For directional lights, how far casters can be from what they shadow
+	float range{ 512.0f };
+	// Full cone angle of spot lights, in degrees
+	float spotAngle{ 60.0f };
+	// Off until SetLightShadow turns it on, the default position means nothing for most lights
+	bool castShadows{ false };
+};
+
+struct ShadowSettings
+{
+	// Size of both shadow atlases, the static and the dynamic one
+	uint32_t atlasSize{ 4096U };
+	uint32_t minTileSize{ 128U };
+	uint32_t maxTileSize{ 2048U };
+	// Tile size per pixel of the light's on-screen size
+	float resolutionScale{ 1.0f };
+
+	// Directional lights only
+	uint32_t numCascades{ 4U };
+	uint32_t cascadeTileSize{ 1024U };
+	// How far from the camera the cascades reach
+	float cascadeDistance{ 2048.0f };
+	// 0 is uniform splits, 1 is logarithmic
+	float cascadeSplitLambda{ 0.75f };
+
+	// Tiles of lights that weren't visible for this many frames are given back
+	uint32_t tileKeepFrames{ 60U };
+};
+
+// One shadow-casting direction of a light, with its place in the atlas
+struct LightShadowFace
+{
+	// World to clip space, depth in [0, 1]
+	Mat4 viewProjection{};
+	ShadowAtlas::Tile tile{};
+	// Directional lights only: distance from the camera where this cascade ends
+	float splitDistance{ 0.0f };
+	// The static atlas has this face's batches rendered with the current matrix and tile
+	bool staticValid{ false };
+};
+
+class Light final : public ILight
+{
+public:
+	Light() = default;
+	Light( const LightDesc& lightDesc );
+
+	LightDesc& GetDesc() override;
+	const LightDesc& GetDesc() const override;
+
+public: // Shadow state, managed by RenderFrontend.Shadow.cpp
+	LightShadowDesc			shadowDesc{};
+	Vector<LightShadowFace>	shadowFaces{};
+	// Size of each face's tile, 0 if the light has no tiles
+	uint32_t				shadowTileSize{ 0U };
+	// The size that was asked for last time, which can be more than what fit into the atlas
+	uint32_t				shadowRequestedSize{ 0U };
+	float					shadowImportance{ 0.0f };
+	// The static change serial that the static atlas is up to date with
+	uint64_t				shadowStaticSerial{ 0U };
+	uint64_t				shadowVisibleFrame{ 0U };
+
+private:
+	LightDesc desc;
+};
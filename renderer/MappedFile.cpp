@@ -0,0 +1,133 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+bool MappedFile::Open( const Path& path )
+{
+	Close();
+
+	HANDLE file = CreateFileW( path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+	if ( INVALID_HANDLE_VALUE == file )
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if ( !GetFileSizeEx( file, &fileSize ) || 0 == fileSize.QuadPart )
+	{
+		CloseHandle( file );
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingW( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+	if ( nullptr == mapping )
+	{
+		CloseHandle( file );
+		return false;
+	}
+
+	const void* view = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+	if ( nullptr == view )
+	{
+		CloseHandle( mapping );
+		CloseHandle( file );
+		return false;
+	}
+
+	fileHandle = file;
+	mappingHandle = mapping;
+	data = static_cast<const uint8_t*>( view );
+	size = size_t( fileSize.QuadPart );
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if ( nullptr != data )
+	{
+		UnmapViewOfFile( data );
+		CloseHandle( mappingHandle );
+		CloseHandle( fileHandle );
+	}
+
+	data = nullptr;
+	size = 0U;
+	fileHandle = nullptr;
+	mappingHandle = nullptr;
+}
+#else
+bool MappedFile::Open( const Path& path )
+{
+	Close();
+
+	const int file = open( path.c_str(), O_RDONLY );
+	if ( file < 0 )
+	{
+		return false;
+	}
+
+	struct stat fileStat;
+	if ( fstat( file, &fileStat ) < 0 || 0 == fileStat.st_size )
+	{
+		close( file );
+		return false;
+	}
+
+	void* view = mmap( nullptr, size_t( fileStat.st_size ), PROT_READ, MAP_PRIVATE, file, 0 );
+	// The mapping keeps the file alive on its own
+	close( file );
+	if ( MAP_FAILED == view )
+	{
+		return false;
+	}
+
+	data = static_cast<const uint8_t*>( view );
+	size = size_t( fileStat.st_size );
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if ( nullptr != data )
+	{
+		munmap( const_cast<uint8_t*>( data ), size );
+	}
+
+	data = nullptr;
+	size = 0U;
+}
+#endif
+
+bool MappedFile::IsOpen() const
+{
+	return nullptr != data;
+}
+
+const uint8_t* MappedFile::GetData() const
+{
+	return data;
+}
+
+size_t MappedFile::GetSize() const
+{
+	return size;
+}
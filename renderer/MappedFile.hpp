@@ -0,0 +1,32 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+// A whole file mapped into memory, read-only
+// Nothing is read up front, the OS pages the file in as it's accessed
+class MappedFile final
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile( const MappedFile& ) = delete;
+	MappedFile& operator=( const MappedFile& ) = delete;
+
+	// Returns false if the file doesn't exist, is empty or can't be mapped
+	bool					Open( const Path& path );
+	void					Close();
+
+	bool					IsOpen() const;
+	const uint8_t*			GetData() const;
+	size_t					GetSize() const;
+
+private:
+	const uint8_t*			data{ nullptr };
+	size_t					size{ 0U };
+#ifdef _WIN32
+	void*					fileHandle{ nullptr };
+	void*					mappingHandle{ nullptr };
+#endif
+};
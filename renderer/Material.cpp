@@ -0,0 +1,25 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "Material.hpp"
+
+Material::Material( const MaterialDesc& materialDesc, uint32_t materialSlot )
+	: desc( materialDesc ), slot( materialSlot )
+{
+}
+
+const MaterialDesc& Material::GetDesc() const
+{
+	return desc;
+}
+
+void Material::SetDesc( const MaterialDesc& newDesc )
+{
+	desc = newDesc;
+}
+
+uint32_t Material::GetSlot() const
+{
+	return slot;
+}
@@ -0,0 +1,47 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "ShaderPermutations.hpp"
+
+// Permutations of the entity pixel shader, see default.hlsl
+namespace MaterialFeatures
+{
+	// Textures are indexed out of one global descriptor table. Backends without
+	// descriptor indexing get a binding set per material instead
+	constexpr ShaderFeatureMask Bindless = 1U << 0U;
+
+	constexpr const char* Defines[] = { "BINDLESS" };
+	constexpr uint32_t Count = uint32_t( std::size( Defines ) );
+}
+
+// There's no material system in the engine yet, so this is the bare minimum
+// that's needed to texture faces. Textures must be ones made by the frontend
+struct MaterialDesc
+{
+	Vec4 colour{ 1.0f, 1.0f, 1.0f, 1.0f };
+	// Null for plain white
+	ITexture* diffuseTexture{ nullptr };
+};
+
+// All materials are in one GPU buffer, and draws only carry the index of their material
+class Material final
+{
+public:
+	Material( const MaterialDesc& desc, uint32_t slot );
+
+	const MaterialDesc& GetDesc() const;
+	void SetDesc( const MaterialDesc& newDesc );
+	// Index in the material buffer
+	uint32_t GetSlot() const;
+
+	// Without bindless, each material has a binding set with its textures
+	nvrhi::BindingSetHandle textureBindingSet{};
+	// Waiting to be written into the material buffer
+	bool uploadPending{ false };
+
+private:
+	MaterialDesc desc{};
+	uint32_t slot{ 0U };
+};
@@ -0,0 +1,144 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "MemoryTracker.hpp"
+
+const char* MemoryCategoryToString( MemoryCategory category )
+{
+	switch ( category )
+	{
+	case MemoryCategory::Geometry: return "Geometry";
+	case MemoryCategory::Textures: return "Textures";
+	case MemoryCategory::ViewAttachments: return "View attachments";
+	case MemoryCategory::ConstantBuffers: return "Constant buffers";
+	case MemoryCategory::ShadowMaps: return "Shadow maps";
+	case MemoryCategory::EntityData: return "Entity data";
+	case MemoryCategory::BonePalettes: return "Bone palettes";
+	case MemoryCategory::Materials: return "Materials";
+	case MemoryCategory::Count: break;
+	}
+
+	return "UNKNOWN";
+}
+
+MemoryTracker::OwnerId MemoryTracker::CreateOwner( MemoryCategory category, StringView name )
+{
+	const OwnerId id = nextOwner++;
+	owners[id] = { String( name ), category, 0U, 0U };
+	return id;
+}
+
+void MemoryTracker::ReleaseOwner( OwnerId owner )
+{
+	auto it = owners.find( owner );
+	if ( it == owners.end() )
+	{
+		return;
+	}
+
+	Update( it->second.category, -int64_t( it->second.bytes ) );
+	owners.erase( it );
+}
+
+void MemoryTracker::Allocate( OwnerId owner, size_t bytes )
+{
+	auto it = owners.find( owner );
+	if ( it == owners.end() )
+	{
+		return;
+	}
+
+	OwnerInfo& info = it->second;
+	info.bytes += bytes;
+	info.peakBytes = std::max( info.peakBytes, info.bytes );
+	Update( info.category, int64_t( bytes ) );
+}
+
+void MemoryTracker::Free( OwnerId owner, size_t bytes )
+{
+	auto it = owners.find( owner );
+	if ( it == owners.end() )
+	{
+		return;
+	}
+
+	OwnerInfo& info = it->second;
+	bytes = std::min( bytes, info.bytes );
+	info.bytes -= bytes;
+	Update( info.category, -int64_t( bytes ) );
+}
+
+size_t MemoryTracker::GetTotalBytes() const
+{
+	return totalBytes;
+}
+
+size_t MemoryTracker::GetPeakBytes() const
+{
+	return peakBytes;
+}
+
+size_t MemoryTracker::GetCategoryBytes( MemoryCategory category ) const
+{
+	return categoryBytes[size_t( category )];
+}
+
+size_t MemoryTracker::GetCategoryPeakBytes( MemoryCategory category ) const
+{
+	return categoryPeakBytes[size_t( category )];
+}
+
+const MemoryTracker::OwnerInfo* MemoryTracker::GetOwner( OwnerId owner ) const
+{
+	auto it = owners.find( owner );
+	return it != owners.end() ? &it->second : nullptr;
+}
+
+const Map<MemoryTracker::OwnerId, MemoryTracker::OwnerInfo>& MemoryTracker::GetOwners() const
+{
+	return owners;
+}
+
+void MemoryTracker::Update( MemoryCategory category, int64_t delta )
+{
+	size_t& bytes = categoryBytes[size_t( category )];
+	bytes = size_t( int64_t( bytes ) + delta );
+	totalBytes = size_t( int64_t( totalBytes ) + delta );
+
+	categoryPeakBytes[size_t( category )] = std::max( categoryPeakBytes[size_t( category )], bytes );
+	peakBytes = std::max( peakBytes, totalBytes );
+}
+
+static float ToMegabytes( size_t bytes )
+{
+	return float( bytes ) / (1024.0f * 1024.0f);
+}
+
+void MemoryTracker::Dump() const
+{
+	Console->Print( format( "GPU memory: %.2f MiB (peak %.2f MiB)", ToMegabytes( totalBytes ), ToMegabytes( peakBytes ) ) );
+	for ( size_t i = 0U; i < size_t( MemoryCategory::Count ); i++ )
+	{
+		Console->Print( format( "  * %-18s %9.2f MiB (peak %.2f MiB)", MemoryCategoryToString( MemoryCategory( i ) ),
+			ToMegabytes( categoryBytes[i] ), ToMegabytes( categoryPeakBytes[i] ) ) );
+	}
+
+	Vector<const OwnerInfo*> sorted;
+	for ( const auto& [id, info] : owners )
+	{
+		sorted.push_back( &info );
+	}
+
+	std::sort( sorted.begin(), sorted.end(), []( const OwnerInfo* a, const OwnerInfo* b )
+		{
+			return a->bytes > b->bytes;
+		} );
+
+	Console->Print( "Owners:" );
+	for ( const OwnerInfo* info : sorted )
+	{
+		Console->Print( format( "  * %9.2f MiB (peak %9.2f MiB) [%s] %s", ToMegabytes( info->bytes ), ToMegabytes( info->peakBytes ),
+			MemoryCategoryToString( info->category ), info->name.c_str() ) );
+	}
+}
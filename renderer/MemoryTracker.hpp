@@ -0,0 +1,73 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+enum class MemoryCategory : uint8_t
+{
+	// Vertex & index buffers of models and batches
+	Geometry,
+	Textures,
+	// Colour & depth attachments of views
+	ViewAttachments,
+	// Per-frame view constants
+	ConstantBuffers,
+	ShadowMaps,
+	// Transforms of all entities, and their staging buffers
+	EntityData,
+	// Bones of all skinned entities
+	BonePalettes,
+	// The material buffer and the material system's default texture
+	Materials,
+	Count
+};
+
+const char* MemoryCategoryToString( MemoryCategory category );
+
+// Keeps track of how much GPU memory the frontend's resources take up
+// Every resource is attributed to an owner (a model, a view, a texture etc.),
+// and each owner belongs to a category. Sizes are the logical sizes of
+// resources, i.e. without driver padding and alignment
+class MemoryTracker
+{
+public:
+	using OwnerId = uint32_t;
+	static constexpr OwnerId InvalidOwner = 0U;
+
+	struct OwnerInfo
+	{
+		String name{};
+		MemoryCategory category{ MemoryCategory::Geometry };
+		size_t bytes{ 0U };
+		size_t peakBytes{ 0U };
+	};
+
+	OwnerId					CreateOwner( MemoryCategory category, StringView name );
+	// Frees everything the owner still holds
+	void					ReleaseOwner( OwnerId owner );
+
+	void					Allocate( OwnerId owner, size_t bytes );
+	void					Free( OwnerId owner, size_t bytes );
+
+	size_t					GetTotalBytes() const;
+	size_t					GetPeakBytes() const;
+	size_t					GetCategoryBytes( MemoryCategory category ) const;
+	size_t					GetCategoryPeakBytes( MemoryCategory category ) const;
+	const OwnerInfo*		GetOwner( OwnerId owner ) const;
+	const Map<OwnerId, OwnerInfo>& GetOwners() const;
+
+	// Prints totals, high-water marks and every owner, biggest first
+	void					Dump() const;
+
+private:
+	void					Update( MemoryCategory category, int64_t delta );
+
+private:
+	Map<OwnerId, OwnerInfo>	owners{};
+	OwnerId					nextOwner{ 1U };
+
+	size_t					totalBytes{ 0U };
+	size_t					peakBytes{ 0U };
+	size_t					categoryBytes[size_t( MemoryCategory::Count )]{};
+	size_t					categoryPeakBytes[size_t( MemoryCategory::Count )]{};
+};
@@ -1,53 +1,132 @@
-// SPDX-FileCopyrightText: 2022 Admer Šuko
-// SPDX-License-Identifier: MIT
-
-#include "Precompiled.hpp"
-#include "Model.hpp"
-
-Model::Model( const Assets::IModel* asset,
-	Vector<nvrhi::BufferHandle>&& indexBuffers,
-	VertexBufferMap&& vertexBuffers,
-	Vector<size_t> indexCountPerFace,
-	Vector<size_t> vertexCountPerFace )
-{
-	modelAsset = asset;
-	this->indexBuffers = std::move( indexBuffers );
-	this->vertexBuffers = std::move( vertexBuffers );
-	indexCounts = indexCountPerFace;
-	vertexCounts = vertexCountPerFace;
-}
-
-StringView Model::GetName() const
-{
-	return GetDesc().modelData.name;
-}
-
-size_t Model::GetNumFaces() const
-{
-	return indexBuffers.size();
-}
-
-size_t Model::GetNumIndices( uint32_t face ) const
-{
-	return indexCounts[face];
-}
-
-size_t Model::GetNumVertices( uint32_t face ) const
-{
-	return vertexCounts[face];
-}
-
-IBuffer* Model::GetVertexBuffer( uint32_t face, Assets::RenderData::VertexAttributeType attribute ) const
-{
-	return vertexBuffers.at( { face, attribute } );
-}
-
-IBuffer* Model::GetIndexBuffer( uint32_t face ) const
-{
-	return indexBuffers.at( face );
-}
-
-const Assets::ModelDesc& Model::GetDesc() const
-{
-	return modelAsset->GetDesc();
-}
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "Model.hpp"
+
+Model::Model( const Assets::IModel* asset,
+	Vector<nvrhi::BufferHandle>&& indexBuffers,
+	VertexBufferMap&& vertexBuffers,
+	Vector<size_t> indexCountPerFace,
+	Vector<size_t> vertexCountPerFace,
+	const Bounds& bounds,
+	Vector<nvrhi::Format> indexFormatPerFace )
+{
+	modelAsset = asset;
+	this->indexBuffers = std::move( indexBuffers );
+	this->vertexBuffers = std::move( vertexBuffers );
+	indexCounts = indexCountPerFace;
+	vertexCounts = vertexCountPerFace;
+	localBounds = bounds;
+
+	drawRecords.resize( this->indexBuffers.size() );
+	for ( uint32_t face = 0U; face < drawRecords.size(); face++ )
+	{
+		FaceDrawRecord& record = drawRecords[face];
+		record.indexBuffer = this->indexBuffers[face];
+		record.numIndices = uint32_t( indexCounts[face] );
+		if ( face < indexFormatPerFace.size() )
+		{
+			record.indexFormat = indexFormatPerFace[face];
+		}
+		record.complete = nullptr != record.indexBuffer;
+
+		for ( size_t stream = 0U; stream < NumEntityVertexStreams; stream++ )
+		{
+			auto it = this->vertexBuffers.find( { face, EntityVertexStreams[stream] } );
+			if ( it == this->vertexBuffers.end() || nullptr == it->second )
+			{
+				// Colours are optional, there's a permutation without them
+				if ( EntityVertexStreams[stream] != Assets::RenderData::VertexAttributeType::Colour1 )
+				{
+					record.complete = false;
+				}
+				continue;
+			}
+
+			record.vertexBuffers[stream] = it->second;
+			if ( EntityVertexStreams[stream] == Assets::RenderData::VertexAttributeType::Colour1 )
+			{
+				record.features |= EntityFeatures::VertexColours;
+			}
+		}
+	}
+}
+
+StringView Model::GetName() const
+{
+	return GetDesc().modelData.name;
+}
+
+size_t Model::GetNumFaces() const
+{
+	return indexBuffers.size();
+}
+
+size_t Model::GetNumIndices( uint32_t face ) const
+{
+	return indexCounts[face];
+}
+
+size_t Model::GetNumVertices( uint32_t face ) const
+{
+	return vertexCounts[face];
+}
+
+IBuffer* Model::GetVertexBuffer( uint32_t face, Assets::RenderData::VertexAttributeType attribute ) const
+{
+	return vertexBuffers.at( { face, attribute } );
+}
+
+nvrhi::IBuffer* Model::FindVertexBuffer( uint32_t face, Assets::RenderData::VertexAttributeType attribute ) const
+{
+	auto it = vertexBuffers.find( { face, attribute } );
+	return it != vertexBuffers.end() ? it->second.Get() : nullptr;
+}
+
+IBuffer* Model::GetIndexBuffer( uint32_t face ) const
+{
+	return indexBuffers.at( face );
+}
+
+const Assets::ModelDesc& Model::GetDesc() const
+{
+	return modelAsset->GetDesc();
+}
+
+const Bounds& Model::GetBounds() const
+{
+	return localBounds;
+}
+
+const Assets::IModel* Model::GetAsset() const
+{
+	return modelAsset;
+}
+
+const Vector<FaceDrawRecord>& Model::GetDrawRecords() const
+{
+	return drawRecords;
+}
+
+bool Model::SetFaceMaterial( uint32_t face, uint32_t material )
+{
+	if ( face >= drawRecords.size() )
+	{
+		return false;
+	}
+
+	drawRecords[face].material = material;
+	return true;
+}
+
+void Model::ReplaceMaterial( uint32_t oldMaterial, uint32_t newMaterial )
+{
+	for ( FaceDrawRecord& record : drawRecords )
+	{
+		if ( record.material == oldMaterial )
+		{
+			record.material = newMaterial;
+		}
+	}
+}
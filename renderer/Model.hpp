@@ -1,61 +1,125 @@
-// SPDX-FileCopyrightText: 2022 Admer Šuko
-// SPDX-License-Identifier: MIT
-
-#pragma once
-
-struct VertexMapKey
-{
-	uint32_t face{};
-	Assets::RenderData::VertexAttributeType vertexAttribute{ Assets::RenderData::VertexAttributeType::Position };
-
-	// Hashing function, required for VertexMap (std::unordered_map)
-	size_t operator()() const noexcept
-	{
-		return face + (1U << (16U + static_cast<size_t>(vertexAttribute)));
-	}
-	// Required for hashing
-	bool operator==( const VertexMapKey& other ) const noexcept
-	{
-		return face == other.face && vertexAttribute == other.vertexAttribute;
-	}
-};
-
-template<>
-struct std::hash<VertexMapKey>
-{
-	std::size_t operator()( const VertexMapKey& other ) const noexcept
-	{
-		return other();
-	}
-};
-
-using VertexBufferMap = Map<VertexMapKey, nvrhi::BufferHandle>;
-
-class Model final : public IModel
-{
-public:
-	Model() = default;
-	Model( const Assets::IModel* asset,
-		Vector<nvrhi::BufferHandle>&& indexBuffers,
-		VertexBufferMap&& vertexBuffers,
-		Vector<size_t> indexCountPerFace,
-		Vector<size_t> vertexCountPerFace );
-	~Model() = default;
-	
-	StringView GetName() const override;
-
-	size_t GetNumFaces() const override;
-	size_t GetNumIndices( uint32_t face ) const override;
-	size_t GetNumVertices( uint32_t face ) const override;
-	IBuffer* GetVertexBuffer( uint32_t face, Assets::RenderData::VertexAttributeType attribute ) const override;
-	IBuffer* GetIndexBuffer( uint32_t face ) const override;
-
-	const Assets::ModelDesc& GetDesc() const override;
-
-private:
-	Vector<size_t> indexCounts{};
-	Vector<size_t> vertexCounts{};
-	Vector<nvrhi::BufferHandle> indexBuffers{};
-	VertexBufferMap vertexBuffers{};
-	const Assets::IModel* modelAsset{ nullptr };
-};
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "Bounds.hpp"
+#include "MemoryTracker.hpp"
+#include "ShaderPermutations.hpp"
+
+struct VertexMapKey
+{
+	uint32_t face{};
+	Assets::RenderData::VertexAttributeType vertexAttribute{ Assets::RenderData::VertexAttributeType::Position };
+
+	// Hashing function, required for VertexMap (std::unordered_map)
+	// Attributes fit in the lower 4 bits, so neighbouring faces don't collide
+	size_t operator()() const noexcept
+	{
+		return (size_t( face ) << 4U) | static_cast<size_t>(vertexAttribute);
+	}
+	// Required for hashing
+	bool operator==( const VertexMapKey& other ) const noexcept
+	{
+		return face == other.face && vertexAttribute == other.vertexAttribute;
+	}
+};
+
+template<>
+struct std::hash<VertexMapKey>
+{
+	std::size_t operator()( const VertexMapKey& other ) const noexcept
+	{
+		return other();
+	}
+};
+
+using VertexBufferMap = Map<VertexMapKey, nvrhi::BufferHandle>;
+
+// Vertex streams read by the entity pipeline, in the order of their binding slots
+constexpr Assets::RenderData::VertexAttributeType EntityVertexStreams[] =
+{
+	Assets::RenderData::VertexAttributeType::Position,
+	Assets::RenderData::VertexAttributeType::Normal,
+	Assets::RenderData::VertexAttributeType::Uv1,
+	Assets::RenderData::VertexAttributeType::Colour1
+};
+constexpr size_t NumEntityVertexStreams = std::size( EntityVertexStreams );
+
+// Permutations of the entity vertex shader, see default.hlsl
+namespace EntityFeatures
+{
+	// Faces without colours are drawn white, without binding the colour stream
+	constexpr ShaderFeatureMask VertexColours = 1U << 0U;
+
+	constexpr const char* Defines[] = { "VERTEX_COLOURS" };
+	constexpr uint32_t Count = uint32_t( std::size( Defines ) );
+	constexpr uint32_t NumPermutations = 1U << Count;
+}
+
+// Everything needed to draw one face, precomputed when the model is built,
+// so the render loop reads straight from an array instead of looking up buffers
+struct FaceDrawRecord
+{
+	nvrhi::IBuffer* vertexBuffers[NumEntityVertexStreams]{};
+	uint64_t vertexOffsets[NumEntityVertexStreams]{};
+	nvrhi::IBuffer* indexBuffer{ nullptr };
+	uint64_t indexOffset{ 0U };
+	nvrhi::Format indexFormat{ nvrhi::Format::R32_UINT };
+	uint32_t numIndices{ 0U };
+	// Picks the entity pipeline, see EntityFeatures
+	ShaderFeatureMask features{ 0U };
+	// Slot in the material buffer, passed to the draw along with the entity's
+	uint32_t material{ 0U };
+	// False if the face lacks any of the streams the entity pipeline needs
+	bool complete{ false };
+};
+
+class Model final : public IModel
+{
+public:
+	Model() = default;
+	Model( const Assets::IModel* asset,
+		Vector<nvrhi::BufferHandle>&& indexBuffers,
+		VertexBufferMap&& vertexBuffers,
+		Vector<size_t> indexCountPerFace,
+		Vector<size_t> vertexCountPerFace,
+		const Bounds& bounds,
+		// R32_UINT for faces that aren't in here
+		Vector<nvrhi::Format> indexFormatPerFace = {} );
+	~Model() = default;
+	
+	StringView GetName() const override;
+
+	size_t GetNumFaces() const override;
+	size_t GetNumIndices( uint32_t face ) const override;
+	size_t GetNumVertices( uint32_t face ) const override;
+	IBuffer* GetVertexBuffer( uint32_t face, Assets::RenderData::VertexAttributeType attribute ) const override;
+	IBuffer* GetIndexBuffer( uint32_t face ) const override;
+
+	const Assets::ModelDesc& GetDesc() const override;
+
+	// Local-space bounds of all faces
+	const Bounds& GetBounds() const;
+	// Source data, for when geometry needs to be processed on the CPU
+	const Assets::IModel* GetAsset() const;
+	// Null if the face doesn't have this attribute
+	nvrhi::IBuffer* FindVertexBuffer( uint32_t face, Assets::RenderData::VertexAttributeType attribute ) const;
+	// One per face, see FaceDrawRecord
+	const Vector<FaceDrawRecord>& GetDrawRecords() const;
+	// Material slots, see RenderFrontend.Material.cpp. Returns false if there's no such face
+	bool SetFaceMaterial( uint32_t face, uint32_t material );
+	void ReplaceMaterial( uint32_t oldMaterial, uint32_t newMaterial );
+
+	MemoryTracker::OwnerId memoryOwner{ MemoryTracker::InvalidOwner };
+
+private:
+	Vector<size_t> indexCounts{};
+	Vector<size_t> vertexCounts{};
+	Vector<nvrhi::BufferHandle> indexBuffers{};
+	VertexBufferMap vertexBuffers{};
+	// Points into the buffers above, which stay alive for as long as the model does
+	Vector<FaceDrawRecord> drawRecords{};
+	Bounds localBounds{};
+	const Assets::IModel* modelAsset{ nullptr };
+};
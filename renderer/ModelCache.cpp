@@ -0,0 +1,330 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "ModelCache.hpp"
+#include "TextureCache.hpp"
+#include <nvrhi/common/misc.h>
+
+void ModelCache::SetDirectory( const Path& newDirectory )
+{
+	directory = newDirectory;
+}
+
+const Path& ModelCache::GetDirectory() const
+{
+	return directory;
+}
+
+uint64_t ModelCache::HashAsset( const Assets::IModel* asset )
+{
+	uint64_t hash = HashSeed;
+	for ( const auto& mesh : asset->GetModelData().meshes )
+	{
+		// Face counts go in too, so geometry moving from one face to another changes the hash
+		const uint64_t numFaces = mesh.faces.size();
+		hash = HashData( reinterpret_cast<const uint8_t*>( &numFaces ), sizeof( numFaces ), hash );
+
+		for ( const auto& face : mesh.faces )
+		{
+			const auto& indices = face.data.vertexIndices;
+			const uint64_t numIndices = indices.size();
+			hash = HashData( reinterpret_cast<const uint8_t*>( &numIndices ), sizeof( numIndices ), hash );
+			hash = HashData( reinterpret_cast<const uint8_t*>( indices.data() ), indices.size() * sizeof( uint32_t ), hash );
+
+			for ( const auto& segment : face.data.vertexData )
+			{
+				const uint64_t segmentInfo[2] = { uint64_t( segment.type ), segment.rawData.size() };
+				hash = HashData( reinterpret_cast<const uint8_t*>( segmentInfo ), sizeof( segmentInfo ), hash );
+				hash = HashData( segment.rawData.data(), segment.rawData.size(), hash );
+			}
+		}
+	}
+
+	return hash;
+}
+
+// Bytes per vertex of the streams the renderer reads, 0 for the rest, see entityVertexLayout and skinning.hlsl
+static size_t GetVertexStride( Assets::RenderData::VertexAttributeType type )
+{
+	using Assets::RenderData::VertexAttributeType;
+
+	switch ( type )
+	{
+	case VertexAttributeType::Position: return sizeof( float ) * 3U;
+	case VertexAttributeType::Uv1: return sizeof( float ) * 2U;
+	case VertexAttributeType::Normal:
+	case VertexAttributeType::Colour1:
+	case VertexAttributeType::BoneIndices:
+	case VertexAttributeType::BoneWeights: return 4U;
+	default: return 0U;
+	}
+}
+
+Path ModelCache::GetPath( uint64_t hash ) const
+{
+	// e.g. cache/models/0123456789abcdef.btxm
+	char fileName[64];
+	std::snprintf( fileName, sizeof( fileName ), "%016llx.btxm", static_cast<unsigned long long>( hash ) );
+	return directory / fileName;
+}
+
+bool ModelCache::Load( uint64_t hash, PreparedModel& outModel ) const
+{
+	auto file = std::make_unique<MappedFile>();
+	if ( !file->Open( GetPath( hash ) ) )
+	{
+		return false;
+	}
+
+	const uint8_t* data = file->GetData();
+	const size_t size = file->GetSize();
+
+	Header expected;
+	expected.contentHash = hash;
+
+	Header header;
+	if ( size < sizeof( Header ) )
+	{
+		return false;
+	}
+
+	std::memcpy( &header, data, sizeof( Header ) );
+	if ( std::memcmp( header.magic, expected.magic, sizeof( header.magic ) )
+		|| header.version != expected.version || header.contentHash != expected.contentHash )
+	{
+		return false;
+	}
+
+	const uint64_t tablesSize = uint64_t( header.numFaces ) * sizeof( FaceEntry ) + uint64_t( header.numStreams ) * sizeof( StreamEntry );
+	if ( sizeof( Header ) + tablesSize > size )
+	{
+		return false;
+	}
+
+	// Corrupt files are treated like missing ones, they get written again
+	const auto isInFile = [size]( uint64_t offset, uint64_t byteSize )
+	{
+		return offset <= size && byteSize <= size - offset;
+	};
+
+	const FaceEntry* faceEntries = reinterpret_cast<const FaceEntry*>( data + sizeof( Header ) );
+	const StreamEntry* streamEntries = reinterpret_cast<const StreamEntry*>( faceEntries + header.numFaces );
+
+	PreparedModel model;
+	model.bounds.mins = { header.mins[0], header.mins[1], header.mins[2] };
+	model.bounds.maxs = { header.maxs[0], header.maxs[1], header.maxs[2] };
+	model.faces.resize( header.numFaces );
+	for ( uint32_t faceIndex = 0U; faceIndex < header.numFaces; faceIndex++ )
+	{
+		const FaceEntry& entry = faceEntries[faceIndex];
+		if ( !isInFile( entry.indexOffset, entry.indexSize )
+			|| uint64_t( entry.firstStream ) + entry.numStreams > header.numStreams )
+		{
+			return false;
+		}
+
+		PreparedFace& face = model.faces[faceIndex];
+		face.indexData = data + entry.indexOffset;
+		face.indexDataSize = size_t( entry.indexSize );
+		face.indexFormat = nvrhi::Format( entry.indexFormat );
+		face.numIndices = entry.numIndices;
+		face.numVertices = entry.numVertices;
+		face.bounds.mins = { entry.mins[0], entry.mins[1], entry.mins[2] };
+		face.bounds.maxs = { entry.maxs[0], entry.maxs[1], entry.maxs[2] };
+
+		face.streams.resize( entry.numStreams );
+		for ( uint32_t stream = 0U; stream < entry.numStreams; stream++ )
+		{
+			const StreamEntry& streamEntry = streamEntries[entry.firstStream + stream];
+			if ( !isInFile( streamEntry.offset, streamEntry.size ) )
+			{
+				return false;
+			}
+
+			face.streams[stream].type = Assets::RenderData::VertexAttributeType( streamEntry.type );
+			face.streams[stream].data = data + streamEntry.offset;
+			face.streams[stream].size = size_t( streamEntry.size );
+		}
+	}
+
+	for ( const PreparedFace& face : model.faces )
+	{
+		if ( nullptr != face.Validate() )
+		{
+			return false;
+		}
+	}
+
+	model.mapping = std::move( file );
+	outModel = std::move( model );
+	return true;
+}
+
+bool ModelCache::Write( uint64_t hash, const PreparedModel& model ) const
+{
+	const Path path = GetPath( hash );
+
+	Header header;
+	header.contentHash = hash;
+	header.numFaces = uint32_t( model.faces.size() );
+	for ( const auto& face : model.faces )
+	{
+		header.numStreams += uint32_t( face.streams.size() );
+	}
+
+	header.mins[0] = model.bounds.mins.x;
+	header.mins[1] = model.bounds.mins.y;
+	header.mins[2] = model.bounds.mins.z;
+	header.maxs[0] = model.bounds.maxs.x;
+	header.maxs[1] = model.bounds.maxs.y;
+	header.maxs[2] = model.bounds.maxs.z;
+
+	// Lay the data out after the tables, each block aligned so it can be uploaded in place
+	Vector<FaceEntry> faceEntries( header.numFaces );
+	Vector<StreamEntry> streamEntries;
+	streamEntries.reserve( header.numStreams );
+
+	uint64_t offset = sizeof( Header ) + faceEntries.size() * sizeof( FaceEntry ) + uint64_t( header.numStreams ) * sizeof( StreamEntry );
+	for ( size_t faceIndex = 0U; faceIndex < model.faces.size(); faceIndex++ )
+	{
+		const PreparedFace& face = model.faces[faceIndex];
+		FaceEntry& entry = faceEntries[faceIndex];
+		entry.numIndices = face.numIndices;
+		entry.numVertices = face.numVertices;
+		entry.indexFormat = uint32_t( face.indexFormat );
+		entry.firstStream = uint32_t( streamEntries.size() );
+		entry.numStreams = uint32_t( face.streams.size() );
+		entry.mins[0] = face.bounds.mins.x;
+		entry.mins[1] = face.bounds.mins.y;
+		entry.mins[2] = face.bounds.mins.z;
+		entry.maxs[0] = face.bounds.maxs.x;
+		entry.maxs[1] = face.bounds.maxs.y;
+		entry.maxs[2] = face.bounds.maxs.z;
+
+		offset = nvrhi::align( offset, DataAlignment );
+		entry.indexOffset = offset;
+		entry.indexSize = face.indexDataSize;
+		offset += face.indexDataSize;
+
+		for ( const auto& stream : face.streams )
+		{
+			offset = nvrhi::align( offset, DataAlignment );
+			streamEntries.push_back( { uint32_t( stream.type ), 0U, offset, stream.size } );
+			offset += stream.size;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::create_directories( path.parent_path(), error );
+
+	// Write to a temporary file first, so a crash never leaves a half-written cache entry behind
+	Path temporaryPath = path;
+	temporaryPath += ".tmp";
+	{
+		std::ofstream file( temporaryPath, std::ios::binary | std::ios::trunc );
+		if ( !file )
+		{
+			return false;
+		}
+
+		file.write( reinterpret_cast<const char*>( &header ), sizeof( header ) );
+		file.write( reinterpret_cast<const char*>( faceEntries.data() ), faceEntries.size() * sizeof( FaceEntry ) );
+		file.write( reinterpret_cast<const char*>( streamEntries.data() ), streamEntries.size() * sizeof( StreamEntry ) );
+
+		const char zeroes[DataAlignment]{};
+		const auto writeAligned = [&file, &zeroes]( const uint8_t* data, size_t size )
+		{
+			const uint64_t position = uint64_t( file.tellp() );
+			file.write( zeroes, std::streamsize( nvrhi::align( position, DataAlignment ) - position ) );
+			file.write( reinterpret_cast<const char*>( data ), size );
+		};
+
+		for ( const auto& face : model.faces )
+		{
+			writeAligned( face.indexData, face.indexDataSize );
+			for ( const auto& stream : face.streams )
+			{
+				writeAligned( stream.data, stream.size );
+			}
+		}
+
+		if ( !file )
+		{
+			return false;
+		}
+	}
+
+	std::filesystem::rename( temporaryPath, path, error );
+	return !error;
+}
+
+const char* PreparedFace::Validate() const
+{
+	// Draws read numIndices indices of this format
+	if ( indexFormat != nvrhi::Format::R16_UINT && indexFormat != nvrhi::Format::R32_UINT )
+	{
+		return "unsupported index format";
+	}
+
+	const bool shortIndices = indexFormat == nvrhi::Format::R16_UINT;
+	const size_t indexStride = shortIndices ? sizeof( uint16_t ) : sizeof( uint32_t );
+	if ( uint64_t( numIndices ) * indexStride > indexDataSize )
+	{
+		return "the index data is shorter than numIndices";
+	}
+
+	for ( uint32_t i = 0U; i < numIndices; i++ )
+	{
+		const uint32_t index = shortIndices
+			? reinterpret_cast<const uint16_t*>( indexData )[i]
+			: reinterpret_cast<const uint32_t*>( indexData )[i];
+
+		if ( index >= numVertices )
+		{
+			return "an index is past the last vertex";
+		}
+	}
+
+	// Vertex shaders and skinning read numVertices elements from the streams they know
+	for ( const PreparedStream& stream : streams )
+	{
+		if ( uint64_t( numVertices ) * GetVertexStride( stream.type ) > stream.size )
+		{
+			return "a vertex stream is shorter than numVertices";
+		}
+	}
+
+	return nullptr;
+}
+
+PreparedFace PreparedFace::FromSource( const Assets::RenderData::VertexData& data )
+{
+	PreparedFace face;
+	face.indexData = reinterpret_cast<const uint8_t*>( data.vertexIndices.data() );
+	face.indexDataSize = data.vertexIndices.size() * sizeof( uint32_t );
+	face.indexFormat = nvrhi::Format::R32_UINT;
+	face.numIndices = uint32_t( data.vertexIndices.size() );
+	face.numVertices = data.vertexData.empty() ? 0U : uint32_t( data.vertexData[0].GetNumVertices() );
+	for ( const auto& segment : data.vertexData )
+	{
+		face.streams.push_back( { segment.type, segment.rawData.data(), segment.rawData.size() } );
+	}
+
+	return face;
+}
+
+size_t PreparedModel::GetDataSize() const
+{
+	size_t size = 0U;
+	for ( const auto& face : faces )
+	{
+		size += face.indexDataSize;
+		for ( const auto& stream : face.streams )
+		{
+			size += stream.size;
+		}
+	}
+
+	return size;
+}
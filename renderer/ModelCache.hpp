@@ -0,0 +1,128 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "Bounds.hpp"
+#include "MappedFile.hpp"
+
+// One vertex stream of a face, ready to be copied into a vertex buffer
+struct PreparedStream
+{
+	Assets::RenderData::VertexAttributeType type{ Assets::RenderData::VertexAttributeType::Position };
+	const uint8_t* data{ nullptr };
+	size_t size{ 0U };
+};
+
+// One face, ready to be uploaded as it is
+struct PreparedFace
+{
+	const uint8_t* indexData{ nullptr };
+	size_t indexDataSize{ 0U };
+	nvrhi::Format indexFormat{ nvrhi::Format::R32_UINT };
+	uint32_t numIndices{ 0U };
+	uint32_t numVertices{ 0U };
+	Vector<PreparedStream> streams{};
+	Bounds bounds{};
+
+	// Checks that drawing and skinning this face stays in bounds: the indices are all there and below numVertices,
+	// and every stream the renderer reads has numVertices elements. Null if it's fine, otherwise what's wrong
+	// Used on source assets and on cache files alike
+	const char* Validate() const;
+
+	// Points straight into a source face, with 32-bit indices, so it can be validated before anything is copied
+	static PreparedFace FromSource( const Assets::RenderData::VertexData& data );
+};
+
+// A model with all the CPU-side work done, see RenderFrontend::PrepareModel
+// The data either points into the source asset, into storage, or into the mapped cache file,
+// so this must not outlive the asset
+struct PreparedModel
+{
+	Vector<PreparedFace> faces{};
+	Bounds bounds{};
+	// Indices that were narrowed to 16 bits
+	Vector<Vector<uint8_t>> storage{};
+	// Set if the model came from the cache
+	UniquePtr<MappedFile> mapping{};
+
+	// Bytes of index and vertex data, i.e. how much an upload will copy
+	size_t GetDataSize() const;
+};
+
+// One model being created, see RenderFrontend::CreateModels
+// Everything but the asset is filled in on a worker thread
+struct ModelLoadJob
+{
+	const Assets::IModel* asset{ nullptr };
+	uint64_t hash{ 0U };
+	PreparedModel prepared{};
+	// Printed on the main thread afterwards
+	Vector<String> errors{};
+	bool valid{ false };
+	bool cacheHit{ false };
+	bool cacheWritten{ false };
+};
+
+// On-disk cache of prepared models, keyed by a hash of the source geometry
+// Cache files are mapped into memory and uploaded straight from there
+// Nothing is printed, so loading and writing can happen on worker threads,
+// as long as no two threads work with the same hash
+class ModelCache
+{
+public:
+	// Bump this whenever the file layout or PrepareModel's output changes, so stale cache files get ignored
+	static constexpr uint32_t FormatVersion = 1U;
+
+	void					SetDirectory( const Path& newDirectory );
+	const Path&				GetDirectory() const;
+
+	// Covers everything that ends up on the GPU: faces, indices and vertex streams
+	static uint64_t			HashAsset( const Assets::IModel* asset );
+
+	// Returns false if there's no valid cache file for this hash
+	bool					Load( uint64_t hash, PreparedModel& outModel ) const;
+	bool					Write( uint64_t hash, const PreparedModel& model ) const;
+
+private:
+	struct Header
+	{
+		char magic[4]{ 'B', 'T', 'X', 'M' };
+		uint32_t version{ FormatVersion };
+		uint64_t contentHash{ 0U };
+		uint32_t numFaces{ 0U };
+		uint32_t numStreams{ 0U };
+		float mins[3]{};
+		float maxs[3]{};
+	};
+
+	struct FaceEntry
+	{
+		uint32_t numIndices{ 0U };
+		uint32_t numVertices{ 0U };
+		uint32_t indexFormat{ 0U };
+		uint32_t firstStream{ 0U };
+		uint32_t numStreams{ 0U };
+		uint32_t padding{ 0U };
+		uint64_t indexOffset{ 0U };
+		uint64_t indexSize{ 0U };
+		float mins[3]{};
+		float maxs[3]{};
+	};
+
+	struct StreamEntry
+	{
+		uint32_t type{ 0U };
+		uint32_t padding{ 0U };
+		uint64_t offset{ 0U };
+		uint64_t size{ 0U };
+	};
+
+	// Every block of data starts at a multiple of this
+	static constexpr uint64_t DataAlignment = 16U;
+
+	Path					GetPath( uint64_t hash ) const;
+
+private:
+	Path					directory{ "cache/models" };
+};
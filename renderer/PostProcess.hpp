@@ -0,0 +1,61 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "ShaderPermutations.hpp"
+
+enum class Tonemapper : uint8_t
+{
+	// Just clamps
+	None,
+	Reinhard,
+	// Narkowicz's fit of the ACES filmic curve
+	Aces
+};
+
+// Permutations of the screen pass, see screen.hlsl. Used by the frontend only
+namespace ScreenFeatures
+{
+	// Two bits holding the Tonemapper, one permutation per tonemapper
+	constexpr ShaderFeatureMask TonemapperShift = 0U;
+	constexpr ShaderFeatureMask TonemapperMask = 3U << TonemapperShift;
+	constexpr ShaderFeatureMask Grading = 1U << 2U;
+	constexpr ShaderFeatureMask Sharpen = 1U << 3U;
+	constexpr ShaderFeatureMask Bloom = 1U << 4U;
+
+	constexpr const char* Defines[] = { "TONEMAPPER", "GRADING", "SHARPEN", "BLOOM" };
+	// How many values each define has
+	constexpr uint32_t Values[] = { 3U, 2U, 2U, 2U };
+	constexpr uint32_t Count = uint32_t( std::size( Defines ) );
+}
+
+// The post-process chain, applied when a view is presented
+// Sharpening, bloom, exposure, tonemapping and grading are all done by the final pass, the one
+// that upscales the view onto the screen, so they don't cost a full-resolution read & write each
+// Every combination of effects is a permutation of that pass, effects that are off cost nothing
+// Only bloom has passes of its own, at a lower resolution
+struct PostProcessSettings
+{
+	// Off by default, so scenes authored for LDR look the same as before
+	Tonemapper tonemapper{ Tonemapper::None };
+	float exposure{ 1.0f };
+
+	// Done after tonemapping. Contrast pivots around middle grey
+	bool colourGrading{ false };
+	Vec3 colourFilter{ 1.0f, 1.0f, 1.0f };
+	float contrast{ 1.0f };
+	float saturation{ 1.0f };
+
+	// Unsharp mask on top of the upscaling filter, 0 turns it off
+	float sharpness{ 0.0f };
+
+	bool bloom{ false };
+	// Only what's brighter than this blooms, with a soft knee
+	float bloomThreshold{ 1.0f };
+	float bloomIntensity{ 0.05f };
+	// Bloom targets are the screen size divided by this
+	uint32_t bloomDownscale{ 4U };
+	// Each is a horizontal and a vertical pass
+	uint32_t bloomBlurPasses{ 2U };
+};
@@ -0,0 +1,311 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "Profiler.hpp"
+#include <mutex>
+
+namespace Profiler
+{
+	// Number of frames that min/avg/max are computed over
+	constexpr uint32_t StatsWindow = 120U;
+
+	struct ThreadState
+	{
+		MarkerRing ring{};
+		String name{};
+		uint32_t threadId{ 0U };
+		uint32_t depth{ 0U };
+	};
+
+	// Per marker name, the total time spent in it during each of the last frames
+	struct MarkerStats
+	{
+		float samples[StatsWindow]{};
+		uint32_t numSamples{ 0U };
+		uint32_t nextSample{ 0U };
+		uint32_t depth{ 0U };
+		// Number of calls in the last frame it was seen in
+		uint32_t calls{ 0U };
+
+		double frameTotal{ 0.0 };
+		uint32_t frameCalls{ 0U };
+		bool seenThisFrame{ false };
+	};
+
+	struct CapturedMarker
+	{
+		Marker marker{};
+		uint32_t threadId{ 0U };
+	};
+
+	// Registration happens once per thread, so a lock is fine here
+	static std::mutex ThreadsMutex;
+	static Vector<UniquePtr<ThreadState>> Threads;
+	static thread_local ThreadState* CurrentThread = nullptr;
+
+	// Only touched by the thread calling EndFrame
+	static Map<StringView, MarkerStats> Stats;
+	static Vector<String> StatsOrder;
+	static MarkerStats FrameStats;
+	static uint64_t LastFrameEnd = 0U;
+
+	static Vector<CapturedMarker> Capture;
+	static Path CapturePath;
+	static uint32_t CaptureFramesLeft = 0U;
+
+	bool MarkerRing::Push( const Marker& marker )
+	{
+		const uint32_t writeIndex = head.load( std::memory_order_relaxed );
+		if ( writeIndex - tail.load( std::memory_order_acquire ) >= Capacity )
+		{
+			dropped.fetch_add( 1U, std::memory_order_relaxed );
+			return false;
+		}
+
+		markers[writeIndex % Capacity] = marker;
+		head.store( writeIndex + 1U, std::memory_order_release );
+		return true;
+	}
+
+	uint32_t MarkerRing::GetNumDropped() const
+	{
+		return dropped.load( std::memory_order_relaxed );
+	}
+
+	static ThreadState& GetThreadState()
+	{
+		if ( nullptr == CurrentThread )
+		{
+			std::lock_guard lock( ThreadsMutex );
+			auto& state = Threads.emplace_back( new ThreadState() );
+			state->threadId = uint32_t( Threads.size() );
+			state->name = format( "Thread %u", state->threadId );
+			CurrentThread = state.get();
+		}
+
+		return *CurrentThread;
+	}
+
+	uint32_t& GetThreadDepth()
+	{
+		return GetThreadState().depth;
+	}
+
+	void Submit( const Marker& marker )
+	{
+		GetThreadState().ring.Push( marker );
+	}
+
+	void SetThreadName( const char* name )
+	{
+		ThreadState& state = GetThreadState();
+		std::lock_guard lock( ThreadsMutex );
+		state.name = name;
+	}
+
+	static void AddSample( MarkerStats& stats, float milliseconds )
+	{
+		stats.samples[stats.nextSample] = milliseconds;
+		stats.nextSample = (stats.nextSample + 1U) % StatsWindow;
+		stats.numSamples = std::min( stats.numSamples + 1U, StatsWindow );
+	}
+
+	static float ToMilliseconds( uint64_t nanoseconds )
+	{
+		return float( double( nanoseconds ) / 1.0e6 );
+	}
+
+	static bool WriteChromeTrace( const Path& path )
+	{
+		std::ofstream file( path, std::ios::trunc );
+		if ( !file )
+		{
+			return false;
+		}
+
+		const uint64_t origin = Capture.empty() ? 0U : Capture.front().marker.start;
+		const auto toMicroseconds = [origin]( uint64_t time )
+		{
+			return double( int64_t( time - origin ) ) / 1000.0;
+		};
+
+		file << "{\"traceEvents\":[\n";
+		{
+			std::lock_guard lock( ThreadsMutex );
+			for ( const auto& thread : Threads )
+			{
+				file << format( "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"%s\"}},\n",
+					thread->threadId, thread->name.c_str() );
+			}
+		}
+
+		for ( size_t i = 0U; i < Capture.size(); i++ )
+		{
+			const Marker& marker = Capture[i].marker;
+			file << format( "{\"name\":\"%s\",\"cat\":\"renderer\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"count\":%u}}%s\n",
+				marker.name, Capture[i].threadId, toMicroseconds( marker.start ), double( marker.end - marker.start ) / 1000.0,
+				marker.count, i + 1U < Capture.size() ? "," : "" );
+		}
+
+		file << "]}\n";
+		return bool( file );
+	}
+
+	void EndFrame()
+	{
+		// Markers are submitted as they end, so children come before their parents
+		// New names are put in order of their start time, so the stats read top-down
+		Vector<std::pair<uint64_t, const char*>> newNames;
+		{
+			std::lock_guard lock( ThreadsMutex );
+			for ( const auto& thread : Threads )
+			{
+				thread->ring.Drain( [&thread, &newNames]( const Marker& marker )
+					{
+						auto [it, inserted] = Stats.try_emplace( marker.name );
+						MarkerStats& stats = it->second;
+						if ( inserted )
+						{
+							newNames.push_back( { marker.start, marker.name } );
+						}
+
+						stats.frameTotal += double( marker.end - marker.start );
+						stats.frameCalls += marker.count;
+						stats.depth = marker.depth;
+						stats.seenThisFrame = true;
+
+						if ( CaptureFramesLeft > 0U )
+						{
+							Capture.push_back( { marker, thread->threadId } );
+						}
+					} );
+			}
+		}
+
+		std::sort( newNames.begin(), newNames.end() );
+		for ( const auto& [start, name] : newNames )
+		{
+			StatsOrder.push_back( name );
+		}
+
+		for ( auto& [name, stats] : Stats )
+		{
+			if ( stats.seenThisFrame )
+			{
+				AddSample( stats, ToMilliseconds( uint64_t( stats.frameTotal ) ) );
+				stats.calls = stats.frameCalls;
+			}
+
+			stats.frameTotal = 0.0;
+			stats.frameCalls = 0U;
+			stats.seenThisFrame = false;
+		}
+
+		const uint64_t now = Now();
+		if ( LastFrameEnd > 0U )
+		{
+			AddSample( FrameStats, ToMilliseconds( now - LastFrameEnd ) );
+			FrameStats.calls = 1U;
+		}
+		LastFrameEnd = now;
+
+		if ( CaptureFramesLeft > 0U && 0U == --CaptureFramesLeft )
+		{
+			// Markers from different threads arrive in bursts, Chrome wants them roughly in order
+			std::sort( Capture.begin(), Capture.end(), []( const CapturedMarker& a, const CapturedMarker& b )
+				{
+					return a.marker.start < b.marker.start;
+				} );
+
+			if ( WriteChromeTrace( CapturePath ) )
+			{
+				Console->Print( format( "Profiler: wrote %u markers to '%s'", uint32_t( Capture.size() ), CapturePath.string().c_str() ) );
+			}
+			else
+			{
+				Console->Warning( format( "Profiler: could not write capture to '%s'", CapturePath.string().c_str() ) );
+			}
+
+			Capture.clear();
+		}
+	}
+
+	void StartCapture( uint32_t numFrames, const Path& path )
+	{
+		if ( 0U == numFrames )
+		{
+			Console->Warning( "Profiler::StartCapture: need at least one frame to capture" );
+			return;
+		}
+
+#if !BTXR_PROFILING
+		Console->Warning( "Profiler::StartCapture: this build has profiling markers disabled, the capture will be empty" );
+#endif
+
+		Capture.clear();
+		CapturePath = path;
+		CaptureFramesLeft = numFrames;
+	}
+
+	bool IsCapturing()
+	{
+		return CaptureFramesLeft > 0U;
+	}
+
+	static void PrintStats( const char* name, const MarkerStats& stats, uint32_t depth )
+	{
+		if ( 0U == stats.numSamples )
+		{
+			return;
+		}
+
+		float minimum = FLT_MAX, maximum = 0.0f, sum = 0.0f;
+		for ( uint32_t i = 0U; i < stats.numSamples; i++ )
+		{
+			minimum = std::min( minimum, stats.samples[i] );
+			maximum = std::max( maximum, stats.samples[i] );
+			sum += stats.samples[i];
+		}
+
+		Console->Print( format( "  %*s%-*s min %7.3f  avg %7.3f  max %7.3f ms  (%u calls)", int( depth * 2U ), "",
+			int( 32U - std::min( depth * 2U, 16U ) ), name, minimum, sum / stats.numSamples, maximum, stats.calls ) );
+	}
+
+	void DumpStats()
+	{
+		Console->Print( format( "Profiler: last %u frames", FrameStats.numSamples ) );
+		PrintStats( "Frame", FrameStats, 0U );
+
+		uint32_t dropped = 0U;
+		{
+			std::lock_guard lock( ThreadsMutex );
+			for ( const auto& thread : Threads )
+			{
+				dropped += thread->ring.GetNumDropped();
+			}
+		}
+
+		for ( const String& name : StatsOrder )
+		{
+			const MarkerStats& stats = Stats.at( name );
+			PrintStats( name.c_str(), stats, stats.depth + 1U );
+		}
+
+		if ( dropped > 0U )
+		{
+			Console->Warning( format( "Profiler: %u markers were dropped, ring buffers were full", dropped ) );
+		}
+	}
+
+	void Shutdown()
+	{
+		std::lock_guard lock( ThreadsMutex );
+		Stats.clear();
+		StatsOrder.clear();
+		FrameStats = {};
+		LastFrameEnd = 0U;
+		Capture.clear();
+		CaptureFramesLeft = 0U;
+	}
+}
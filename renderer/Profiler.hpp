@@ -0,0 +1,161 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+// Hierarchical CPU profiler
+// Markers are written into a per-thread ring buffer, which only the owning thread
+// writes into and only the main thread reads from, once per frame in EndFrame
+// Names must be string literals or otherwise outlive the profiler
+namespace Profiler
+{
+	struct Marker
+	{
+		const char* name{ nullptr };
+		uint64_t start{ 0U };
+		uint64_t end{ 0U };
+		// For accumulated markers, how many calls were merged into this one
+		uint32_t count{ 1U };
+		uint32_t depth{ 0U };
+	};
+
+	// Single producer, single consumer, drops markers when full
+	class MarkerRing
+	{
+	public:
+		static constexpr uint32_t Capacity = 1U << 14U;
+
+		bool				Push( const Marker& marker );
+		template<typename Callback>
+		void				Drain( Callback&& callback );
+
+		uint32_t			GetNumDropped() const;
+
+	private:
+		Marker				markers[Capacity]{};
+		std::atomic<uint32_t> head{ 0U };
+		std::atomic<uint32_t> tail{ 0U };
+		std::atomic<uint32_t> dropped{ 0U };
+	};
+
+	inline uint64_t Now()
+	{
+		using namespace std::chrono;
+		return uint64_t( duration_cast<nanoseconds>( steady_clock::now().time_since_epoch() ).count() );
+	}
+
+	// Per-thread state, these live until Shutdown
+	uint32_t&				GetThreadDepth();
+	void					Submit( const Marker& marker );
+	void					SetThreadName( const char* name );
+
+	// Drains all threads' markers into the statistics and an active capture. Call once per frame
+	void					EndFrame();
+	// Records the next numFrames frames and writes them as a Chrome trace (chrome://tracing, Perfetto)
+	void					StartCapture( uint32_t numFrames, const Path& path );
+	bool					IsCapturing();
+	// Prints min/avg/max over the last frames, per marker name
+	void					DumpStats();
+	void					Shutdown();
+
+	class ScopedMarker
+	{
+	public:
+		ScopedMarker( const char* name )
+			: name( name ), start( Now() ), depth( GetThreadDepth()++ )
+		{
+		}
+
+		~ScopedMarker()
+		{
+			GetThreadDepth()--;
+			Submit( { name, start, Now(), 1U, depth } );
+		}
+
+	private:
+		const char* name;
+		uint64_t start;
+		uint32_t depth;
+	};
+
+	// Sums up many short scopes, e.g. one per entity, and submits them as a single marker
+	// spanning from the first to the last call when it goes out of scope
+	class Accumulator
+	{
+	public:
+		Accumulator( const char* name )
+			: name( name ), depth( GetThreadDepth() )
+		{
+		}
+
+		~Accumulator()
+		{
+			if ( count > 0U )
+			{
+				Submit( { name, first, first + total, count, depth } );
+			}
+		}
+
+		class Scope
+		{
+		public:
+			Scope( Accumulator& accumulator )
+				: accumulator( accumulator ), start( Now() )
+			{
+				if ( 0U == accumulator.count++ )
+				{
+					accumulator.first = start;
+				}
+			}
+
+			~Scope()
+			{
+				accumulator.total += Now() - start;
+			}
+
+		private:
+			Accumulator& accumulator;
+			uint64_t start;
+		};
+
+	private:
+		const char* name;
+		uint32_t depth;
+		uint64_t first{ 0U };
+		uint64_t total{ 0U };
+		uint32_t count{ 0U };
+	};
+
+	template<typename Callback>
+	void MarkerRing::Drain( Callback&& callback )
+	{
+		uint32_t readIndex = tail.load( std::memory_order_relaxed );
+		const uint32_t writeIndex = head.load( std::memory_order_acquire );
+		for ( ; readIndex != writeIndex; readIndex++ )
+		{
+			callback( markers[readIndex % Capacity] );
+		}
+
+		tail.store( readIndex, std::memory_order_release );
+	}
+}
+
+// Markers compile to nothing unless BTXR_PROFILING is defined, see CMakeLists.txt
+#if BTXR_PROFILING
+#define PROFILE_CONCAT_INNER( a, b ) a##b
+#define PROFILE_CONCAT( a, b ) PROFILE_CONCAT_INNER( a, b )
+#define PROFILE_SCOPE( name ) Profiler::ScopedMarker PROFILE_CONCAT( profileMarker, __LINE__ )( name )
+#define PROFILE_ACCUMULATOR( variable, name ) Profiler::Accumulator variable( name )
+#define PROFILE_ACCUMULATE( variable ) Profiler::Accumulator::Scope PROFILE_CONCAT( profileScope, __LINE__ )( variable )
+#define PROFILE_THREAD( name ) Profiler::SetThreadName( name )
+#define PROFILE_END_FRAME() Profiler::EndFrame()
+#else
+#define PROFILE_SCOPE( name )
+#define PROFILE_ACCUMULATOR( variable, name )
+#define PROFILE_ACCUMULATE( variable )
+#define PROFILE_THREAD( name )
+#define PROFILE_END_FRAME()
+#endif
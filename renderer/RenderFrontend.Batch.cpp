@@ -0,0 +1,290 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "RenderFrontend.hpp"
+#include "Batch.hpp"
+#include "Entity.hpp"
+#include <unordered_set>
+
+using Assets::RenderData::VertexAttributeType;
+using Assets::RenderData::VertexData;
+using Assets::RenderData::VertexDataSegment;
+
+// Upper limit of vertices per chunk, smaller chunks cull better but may need more draws
+constexpr size_t MaxChunkVertices = 16384U;
+
+// A face of a static entity that will be merged into a batch
+struct BatchSourceFace
+{
+	const EntityDesc* entityDesc{ nullptr };
+	const VertexData* data{ nullptr };
+	Bounds bounds{};
+	uint32_t mortonCode{ 0U };
+};
+
+static const VertexDataSegment* FindSegment( const VertexData& data, VertexAttributeType type )
+{
+	for ( const auto& segment : data.vertexData )
+	{
+		if ( segment.type == type )
+		{
+			return &segment;
+		}
+	}
+
+	return nullptr;
+}
+
+// Bitmask of all attributes present in this face
+static uint32_t GetFaceLayout( const VertexData& data )
+{
+	uint32_t layout = 0U;
+	for ( const auto& segment : data.vertexData )
+	{
+		layout |= 1U << static_cast<uint32_t>( segment.type );
+	}
+
+	return layout;
+}
+
+// Spreads the lower 10 bits of a value so there are 2 zero bits between each
+static uint32_t SpreadBits( uint32_t value )
+{
+	value &= 0x3ffU;
+	value = (value | (value << 16U)) & 0x030000ffU;
+	value = (value | (value << 8U)) & 0x0300f00fU;
+	value = (value | (value << 4U)) & 0x030c30c3U;
+	value = (value | (value << 2U)) & 0x09249249U;
+	return value;
+}
+
+static uint32_t MortonCode( const Vec3& point, const Bounds& bounds )
+{
+	const auto quantise = []( float value, float min, float max )
+	{
+		const float range = max - min;
+		const float normalised = range > 0.0f ? (value - min) / range : 0.0f;
+		return uint32_t( std::clamp( normalised, 0.0f, 1.0f ) * 1023.0f );
+	};
+
+	return SpreadBits( quantise( point.x, bounds.mins.x, bounds.maxs.x ) )
+		| (SpreadBits( quantise( point.y, bounds.mins.y, bounds.maxs.y ) ) << 1U)
+		| (SpreadBits( quantise( point.z, bounds.mins.z, bounds.maxs.z ) ) << 2U);
+}
+
+static int8_t PackSnorm8( float value )
+{
+	return int8_t( std::round( std::clamp( value, -1.0f, 1.0f ) * 127.0f ) );
+}
+
+// Appends a face's vertices in world space, returns the new face's bounds
+// Every stream must have numVertices elements, see PreparedFace::Validate
+static Bounds AppendTransformedFace( const BatchSourceFace& face, size_t numVertices,
+	Vector<float>& positions, Vector<uint8_t>& normals, Vector<float>& uvs, Vector<uint8_t>& colours )
+{
+	const Mat4& transform = face.entityDesc->transform;
+	const VertexDataSegment* positionSegment = FindSegment( *face.data, VertexAttributeType::Position );
+	const VertexDataSegment* normalSegment = FindSegment( *face.data, VertexAttributeType::Normal );
+	const VertexDataSegment* uvSegment = FindSegment( *face.data, VertexAttributeType::Uv1 );
+	// Either every face of a group has colours or none does, see CreateBatch
+	const VertexDataSegment* colourSegment = FindSegment( *face.data, VertexAttributeType::Colour1 );
+
+	const float* sourcePositions = reinterpret_cast<const float*>( positionSegment->rawData.data() );
+	const int8_t* sourceNormals = reinterpret_cast<const int8_t*>( normalSegment->rawData.data() );
+
+	Bounds bounds;
+	for ( size_t i = 0U; i < numVertices; i++ )
+	{
+		const Vec3 localPosition = { sourcePositions[i * 3U], sourcePositions[i * 3U + 1U], sourcePositions[i * 3U + 2U] };
+		const Vec4 position = TransformPoint( transform, localPosition );
+		positions.push_back( position.m.x );
+		positions.push_back( position.m.y );
+		positions.push_back( position.m.z );
+		bounds.Add( Vec3( position.m.x, position.m.y, position.m.z ) );
+
+		// Treated as a direction, which is correct for uniform scaling
+		const Vec4 normal = transform * Vec4(
+			sourceNormals[i * 4U] / 127.0f,
+			sourceNormals[i * 4U + 1U] / 127.0f,
+			sourceNormals[i * 4U + 2U] / 127.0f,
+			0.0f );
+		const float length = std::sqrt( normal.m.x * normal.m.x + normal.m.y * normal.m.y + normal.m.z * normal.m.z );
+		const float inverseLength = length > 0.0f ? 1.0f / length : 0.0f;
+		normals.push_back( uint8_t( PackSnorm8( normal.m.x * inverseLength ) ) );
+		normals.push_back( uint8_t( PackSnorm8( normal.m.y * inverseLength ) ) );
+		normals.push_back( uint8_t( PackSnorm8( normal.m.z * inverseLength ) ) );
+		normals.push_back( uint8_t( sourceNormals[i * 4U + 3U] ) );
+	}
+
+	// These don't depend on the transform
+	const float* sourceUvs = reinterpret_cast<const float*>( uvSegment->rawData.data() );
+	uvs.insert( uvs.end(), sourceUvs, sourceUvs + numVertices * 2U );
+	if ( nullptr != colourSegment )
+	{
+		colours.insert( colours.end(), colourSegment->rawData.begin(), colourSegment->rawData.begin() + numVertices * 4U );
+	}
+
+	return bounds;
+}
+
+bool RenderFrontend::BuildBatchGroup( Vector<BatchSourceFace>& faces, BatchGroup& outGroup, MemoryTracker::OwnerId memoryOwner )
+{
+	Bounds groupBounds;
+	for ( const auto& face : faces )
+	{
+		groupBounds.Add( face.bounds );
+	}
+
+	for ( auto& face : faces )
+	{
+		face.mortonCode = MortonCode( face.bounds.GetCentre(), groupBounds );
+	}
+
+	std::sort( faces.begin(), faces.end(), []( const BatchSourceFace& a, const BatchSourceFace& b )
+		{
+			return a.mortonCode < b.mortonCode;
+		} );
+
+	Vector<float> positions;
+	Vector<uint8_t> normals;
+	Vector<float> uvs;
+	Vector<uint8_t> colours;
+	Vector<uint32_t> indices;
+
+	BatchChunk chunk;
+	size_t chunkVertices = 0U;
+	for ( const auto& face : faces )
+	{
+		const size_t faceVertices = face.data->vertexData[0].GetNumVertices();
+		if ( chunkVertices > 0U && chunkVertices + faceVertices > MaxChunkVertices )
+		{
+			outGroup.chunks.push_back( chunk );
+			chunk = { uint32_t( indices.size() ), 0U, {} };
+			chunkVertices = 0U;
+		}
+
+		const uint32_t baseVertex = uint32_t( positions.size() / 3U );
+		chunk.bounds.Add( AppendTransformedFace( face, faceVertices, positions, normals, uvs, colours ) );
+		for ( const uint32_t index : face.data->vertexIndices )
+		{
+			indices.push_back( baseVertex + index );
+		}
+
+		chunk.numIndices += uint32_t( face.data->vertexIndices.size() );
+		chunkVertices += faceVertices;
+	}
+	outGroup.chunks.push_back( chunk );
+	outGroup.bounds = groupBounds;
+
+	outGroup.positionBuffer = CreateVertexBuffer( positions, memoryOwner );
+	outGroup.normalBuffer = CreateVertexBuffer( normals, memoryOwner );
+	outGroup.uvBuffer = CreateVertexBuffer( uvs, memoryOwner );
+	outGroup.indexBuffer = CreateIndexBuffer( indices, memoryOwner );
+
+	const bool hasColours = 0U != (outGroup.features & EntityFeatures::VertexColours);
+	if ( hasColours )
+	{
+		outGroup.colourBuffer = CreateVertexBuffer( colours, memoryOwner );
+	}
+
+	return nullptr != outGroup.positionBuffer && nullptr != outGroup.normalBuffer
+		&& nullptr != outGroup.uvBuffer && (!hasColours || nullptr != outGroup.colourBuffer)
+		&& nullptr != outGroup.indexBuffer;
+}
+
+IBatch* RenderFrontend::CreateBatch( const BatchDesc& desc, const Vector<IEntity*>& staticEntities )
+{
+	// The streams that every entity pipeline reads, see RenderEntity
+	const uint32_t requiredLayout = (1U << uint32_t( VertexAttributeType::Position ))
+		| (1U << uint32_t( VertexAttributeType::Normal ))
+		| (1U << uint32_t( VertexAttributeType::Uv1 ));
+	// Colours are optional, faces without them go into groups drawn without the colour stream
+	const uint32_t colourLayout = 1U << uint32_t( VertexAttributeType::Colour1 );
+	const uint32_t pipelineLayout = requiredLayout | colourLayout;
+
+	// Faces grouped by material and vertex layout, the material slot is in the upper half of the key
+	Map<uint64_t, Vector<BatchSourceFace>> facesPerLayout;
+
+	// Batches can take a good part of the level, so registration isn't checked with a linear search per entity
+	std::unordered_set<const IEntity*> registeredEntities;
+	registeredEntities.reserve( entities.size() );
+	for ( const auto& entity : entities )
+	{
+		registeredEntities.insert( entity.get() );
+	}
+
+	for ( IEntity* entity : staticEntities )
+	{
+		if ( registeredEntities.count( entity ) == 0U )
+		{
+			Console->Warning( "RenderFrontend::CreateBatch: tried batching an unregistered entity" );
+			continue;
+		}
+
+		const EntityDesc& entityDesc = static_cast<const IEntity*>( entity )->GetDesc();
+		const Model* model = static_cast<const Model*>( entityDesc.model );
+		uint32_t faceIndex = 0U;
+		for ( const auto& mesh : model->GetAsset()->GetModelData().meshes )
+		{
+			for ( const auto& face : mesh.faces )
+			{
+				const uint32_t material = model->GetDrawRecords()[faceIndex++].material;
+				const uint32_t layout = GetFaceLayout( face.data );
+				if ( (layout & requiredLayout) != requiredLayout )
+				{
+					Console->Warning( format( "RenderFrontend::CreateBatch: model '%s', mesh '%s' has a face that is missing vertex streams, skipping it",
+						model->GetName().data(), mesh.name.data() ) );
+					continue;
+				}
+
+				// Cached models never looked at the asset's data, and the batch reads it directly
+				if ( const char* problem = PreparedFace::FromSource( face.data ).Validate() )
+				{
+					Console->Warning( format( "RenderFrontend::CreateBatch: model '%s', mesh '%s' has an invalid face (%s), skipping it",
+						model->GetName().data(), mesh.name.data(), problem ) );
+					continue;
+				}
+
+				BatchSourceFace sourceFace;
+				sourceFace.entityDesc = &entityDesc;
+				sourceFace.data = &face.data;
+				sourceFace.bounds = CalculateFaceBounds( face.data ).Transformed( entityDesc.transform );
+				// Streams the pipeline doesn't read, like Uv2, shouldn't split groups
+				facesPerLayout[(uint64_t( material ) << 32U) | (layout & pipelineLayout)].push_back( sourceFace );
+			}
+		}
+	}
+
+	if ( facesPerLayout.empty() )
+	{
+		Console->Warning( "RenderFrontend::CreateBatch: no geometry to batch" );
+		return nullptr;
+	}
+
+	const MemoryTracker::OwnerId memoryOwner = memoryTracker.CreateOwner( MemoryCategory::Geometry,
+		format( "batch of %u entities", uint32_t( staticEntities.size() ) ) );
+
+	Vector<BatchGroup> groups;
+	for ( auto& [key, faces] : facesPerLayout )
+	{
+		BatchGroup group;
+		group.material = uint32_t( key >> 32U );
+		group.features = (key & colourLayout) ? EntityFeatures::VertexColours : 0U;
+		if ( !BuildBatchGroup( faces, group, memoryOwner ) )
+		{
+			Console->Warning( "RenderFrontend::CreateBatch: failed to upload batch geometry to the GPU" );
+			memoryTracker.ReleaseOwner( memoryOwner );
+			return nullptr;
+		}
+
+		groups.push_back( std::move( group ) );
+	}
+
+	Batch* batch = new Batch( desc, std::move( groups ) );
+	batch->memoryOwner = memoryOwner;
+
+	// Views that only update on changes and cached shadows need to know about it
+	MarkStaticChange( batch->GetBounds() );
+	return batches.emplace_back( batch ).get();
+}
@@ -0,0 +1,258 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "RenderFrontend.hpp"
+#include "Profiler.hpp"
+
+// Must match numthreads in entity_scatter.hlsl
+constexpr uint32_t EntityScatterGroupSize = 64U;
+
+bool RenderFrontend::CreateEntityDataResources()
+{
+	entityScatterShader = CreateComputeShader( "entity_scatter" );
+	if ( nullptr == entityScatterShader )
+	{
+		return false;
+	}
+
+	auto scatterBindingLayoutDesc = nvrhi::BindingLayoutDesc()
+		.setVisibility( nvrhi::ShaderType::Compute )
+		.addItem( nvrhi::BindingLayoutItem::StructuredBuffer_SRV( 0 ) )
+		.addItem( nvrhi::BindingLayoutItem::StructuredBuffer_UAV( 0 ) )
+		.addItem( nvrhi::BindingLayoutItem::PushConstants( 0, sizeof( uint32_t ) ) );
+
+	entityScatterBindingLayout = backend->createBindingLayout( scatterBindingLayoutDesc );
+	if ( nullptr == entityScatterBindingLayout )
+	{
+		Console->Error( "RenderFrontend: Failed to create entity scatter binding layout" );
+		return false;
+	}
+
+	auto scatterPipelineDesc = nvrhi::ComputePipelineDesc()
+		.setComputeShader( entityScatterShader )
+		.addBindingLayout( entityScatterBindingLayout );
+
+	entityScatterPipeline = backend->createComputePipeline( scatterPipelineDesc );
+	if ( nullptr == entityScatterPipeline )
+	{
+		Console->Error( "RenderFrontend: Failed to create entity scatter pipeline" );
+		return false;
+	}
+
+	entityDataMemory = memoryTracker.CreateOwner( MemoryCategory::EntityData, "entity data" );
+	if ( !ResizeEntityDataBuffer( 1024U ) || !ResizeEntityUploadBuffer( 256U ) )
+	{
+		return false;
+	}
+
+	EntityDesc identityDesc;
+	identityDesc.transform = Mat4::Identity;
+	identityDesc.shaderParameters[0] = Vec4( 0.0f, 0.0f, 0.0f, 0.0f );
+	identityDesc.shaderParameters[1] = Vec4( 0.0f, 0.0f, 0.0f, 0.0f );
+	pendingEntitySlots.resize( numEntitySlots, 0U );
+	QueueEntityUpload( IdentityEntitySlot, identityDesc );
+
+	return true;
+}
+
+uint32_t RenderFrontend::AllocateEntitySlot()
+{
+	if ( !freeEntitySlots.empty() )
+	{
+		const uint32_t slot = freeEntitySlots.back();
+		freeEntitySlots.pop_back();
+		return slot;
+	}
+
+	pendingEntitySlots.resize( numEntitySlots + 1U, 0U );
+	return numEntitySlots++;
+}
+
+// The GPU may still be reading the slot, but whoever gets it next
+// can only overwrite it in a later submission, so it can be reused right away
+void RenderFrontend::FreeEntitySlot( uint32_t slot )
+{
+	if ( slot != IdentityEntitySlot )
+	{
+		freeEntitySlots.push_back( slot );
+	}
+}
+
+void RenderFrontend::QueueEntityUpload( uint32_t slot, const EntityDesc& desc )
+{
+	EntityUpload upload;
+	upload.slot = slot;
+	upload.padding[0] = upload.padding[1] = upload.padding[2] = 0U;
+	upload.data.modelMatrix = desc.transform;
+	upload.data.shaderParametersA = desc.shaderParameters[0];
+	upload.data.shaderParametersB = desc.shaderParameters[1];
+
+	// Two uploads of the same slot in one dispatch would race
+	uint32_t& pendingIndex = pendingEntitySlots[slot];
+	if ( 0U != pendingIndex )
+	{
+		pendingEntityUploads[pendingIndex - 1U] = upload;
+		return;
+	}
+
+	pendingEntityUploads.push_back( upload );
+	pendingIndex = uint32_t( pendingEntityUploads.size() );
+}
+
+// Old contents are copied over in renderCommands, so this must be called while it's open
+// The old buffer is kept alive by the command list until the GPU is done with it
+bool RenderFrontend::ResizeEntityDataBuffer( uint32_t capacity )
+{
+	auto bufferDesc = nvrhi::BufferDesc()
+		.setByteSize( uint64_t( capacity ) * sizeof( EntityData ) )
+		.setStructStride( sizeof( EntityData ) )
+		.setCanHaveUAVs( true )
+		.setInitialState( nvrhi::ResourceStates::ShaderResource )
+		.setKeepInitialState( true )
+		.setDebugName( "Entity data" );
+
+	nvrhi::BufferHandle newBuffer = backend->createBuffer( bufferDesc );
+	if ( nullptr == newBuffer )
+	{
+		Console->Error( format( "RenderFrontend: Failed to create an entity buffer for %u entities", capacity ) );
+		return false;
+	}
+
+	commandStats.Record( RenderCommand::CreateBuffer, bufferDesc.byteSize );
+
+	if ( nullptr != entityDataBuffer )
+	{
+		renderCommands->copyBuffer( newBuffer, 0U, entityDataBuffer, 0U, uint64_t( entityDataCapacity ) * sizeof( EntityData ) );
+		memoryTracker.Free( entityDataMemory, size_t( entityDataCapacity ) * sizeof( EntityData ) );
+	}
+	memoryTracker.Allocate( entityDataMemory, size_t( bufferDesc.byteSize ) );
+
+	entityDataBuffer = newBuffer;
+	entityDataCapacity = capacity;
+
+	auto entitySetDesc = nvrhi::BindingSetDesc()
+		.addItem( nvrhi::BindingSetItem::StructuredBuffer_SRV( 0, entityDataBuffer ) )
+		.addItem( nvrhi::BindingSetItem::PushConstants( 1, sizeof( EntityConstants ) ) );
+	entityBindingSet = backend->createBindingSet( entitySetDesc, entityBindingLayout );
+	if ( nullptr == entityBindingSet )
+	{
+		Console->Error( "RenderFrontend: Failed to create entity binding set" );
+		return false;
+	}
+
+	// The upload buffer may not exist yet, the scatter set is made when it does
+	if ( nullptr == entityUploadBuffer )
+	{
+		return true;
+	}
+
+	return ResizeEntityUploadBuffer( entityUploadCapacity );
+}
+
+bool RenderFrontend::ResizeEntityUploadBuffer( uint32_t capacity )
+{
+	if ( capacity != entityUploadCapacity || nullptr == entityUploadBuffer )
+	{
+		auto bufferDesc = nvrhi::BufferDesc()
+			.setByteSize( uint64_t( capacity ) * sizeof( EntityUpload ) )
+			.setStructStride( sizeof( EntityUpload ) )
+			.setInitialState( nvrhi::ResourceStates::ShaderResource )
+			.setKeepInitialState( true )
+			.setDebugName( "Entity uploads" );
+
+		nvrhi::BufferHandle newBuffer = backend->createBuffer( bufferDesc );
+		if ( nullptr == newBuffer )
+		{
+			Console->Error( format( "RenderFrontend: Failed to create an entity upload buffer for %u entities", capacity ) );
+			return false;
+		}
+
+		commandStats.Record( RenderCommand::CreateBuffer, bufferDesc.byteSize );
+
+		if ( nullptr != entityUploadBuffer )
+		{
+			memoryTracker.Free( entityDataMemory, size_t( entityUploadCapacity ) * sizeof( EntityUpload ) );
+		}
+		memoryTracker.Allocate( entityDataMemory, size_t( bufferDesc.byteSize ) );
+
+		entityUploadBuffer = newBuffer;
+		entityUploadCapacity = capacity;
+	}
+
+	auto scatterSetDesc = nvrhi::BindingSetDesc()
+		.addItem( nvrhi::BindingSetItem::StructuredBuffer_SRV( 0, entityUploadBuffer ) )
+		.addItem( nvrhi::BindingSetItem::StructuredBuffer_UAV( 0, entityDataBuffer ) )
+		.addItem( nvrhi::BindingSetItem::PushConstants( 0, sizeof( uint32_t ) ) );
+	entityScatterBindingSet = backend->createBindingSet( scatterSetDesc, entityScatterBindingLayout );
+	if ( nullptr == entityScatterBindingSet )
+	{
+		Console->Error( "RenderFrontend: Failed to create entity scatter binding set" );
+		return false;
+	}
+
+	return true;
+}
+
+// Changed entries are written into the upload buffer as one compact array,
+// and a compute pass puts each into its slot. Upload size scales with changes, not scene size
+void RenderFrontend::FlushEntityUploads()
+{
+	if ( pendingEntityUploads.empty() && numEntitySlots <= entityDataCapacity )
+	{
+		return;
+	}
+
+	PROFILE_SCOPE( "FlushEntityUploads" );
+
+	if ( numEntitySlots > entityDataCapacity
+		&& !ResizeEntityDataBuffer( std::max( numEntitySlots, entityDataCapacity * 2U ) ) )
+	{
+		return;
+	}
+
+	const uint32_t numUploads = uint32_t( pendingEntityUploads.size() );
+	if ( numUploads > entityUploadCapacity
+		&& !ResizeEntityUploadBuffer( std::max( numUploads, entityUploadCapacity * 2U ) ) )
+	{
+		return;
+	}
+
+	if ( numUploads > 0U )
+	{
+		gpuProfiler.BeginPass( renderCommands, "Entity uploads" );
+
+		const size_t uploadBytes = pendingEntityUploads.size() * sizeof( EntityUpload );
+		renderCommands->writeBuffer( entityUploadBuffer, pendingEntityUploads.data(), uploadBytes );
+		commandStats.Record( RenderCommand::WriteBuffer, uploadBytes );
+
+		auto computeState = nvrhi::ComputeState()
+			.setPipeline( entityScatterPipeline )
+			.addBindingSet( entityScatterBindingSet );
+		renderCommands->setComputeState( computeState );
+		renderCommands->setPushConstants( &numUploads, sizeof( numUploads ) );
+
+		const uint32_t numGroups = (numUploads + EntityScatterGroupSize - 1U) / EntityScatterGroupSize;
+		renderCommands->dispatch( numGroups );
+		commandStats.Record( RenderCommand::Dispatch, numGroups );
+
+		gpuProfiler.EndPass( renderCommands );
+	}
+
+	for ( const EntityUpload& upload : pendingEntityUploads )
+	{
+		pendingEntitySlots[upload.slot] = 0U;
+	}
+	entityUploads += numUploads;
+	pendingEntityUploads.clear();
+
+	// Copies and compute both drop the graphics state
+	stateTracker.Invalidate();
+}
+
+// Push constants don't survive state changes on every backend, so this is called for every draw
+void RenderFrontend::SetEntityConstants( uint32_t slot, uint32_t material )
+{
+	const EntityConstants constants = { slot, material };
+	renderCommands->setPushConstants( &constants, sizeof( constants ) );
+}
@@ -1,125 +1,269 @@
-// SPDX-FileCopyrightText: 2022 Admer Šuko
-// SPDX-License-Identifier: MIT
-
-#include "Precompiled.hpp"
-#include "RenderFrontend.hpp"
-#include <nvrhi/utils.h>
-
-bool RenderFrontend::PostInit( RenderBackend* renderBackend, IWindow* mainWindow )
-{
-	backendManager = renderBackend;
-	backend = backendManager->GetDevice();
-	window = mainWindow;
-
-	if ( !CreateCommandLists() )
-	{
-		Console->Error( "RenderFrontend::PostInit: Failed to create commandlists" );
-		return false;
-	}
-
-	if ( !CreateMainFramebuffer() )
-	{
-		Console->Error( "RenderFrontend::PostInit: Failed to create main framebuffer" );
-		return false;
-	}
-
-	if ( !CreateMainGraphicsPipelines() )
-	{
-		Console->Error( "RenderFrontend::PostInit: Failed to create core graphics pipeline" );
-		return false;
-	}
-
-	if ( !CreateScreenVertexBuffer() )
-	{
-		Console->Error( "RenderFrontend::PostInit: Failed to create screen quad" );
-		return false;
-	}
-
-	return true;
-}
-
-bool RenderFrontend::CreateCommandLists()
-{
-	auto renderParams = nvrhi::CommandListParameters()
-		.setQueueType( nvrhi::CommandQueue::Graphics );
-
-	auto transferParams = nvrhi::CommandListParameters()
-		.setQueueType( nvrhi::CommandQueue::Graphics );
-
-	renderCommands = backend->createCommandList( renderParams );
-	transferCommands = backend->createCommandList( transferParams );
-
-	return (nullptr != renderCommands) && (nullptr != transferCommands);
-}
-
-static nvrhi::Format WindowFormatToNvrhi( WindowVideoFormat format )
-{
-	switch ( format )
-	{
-	case WindowVideoFormat::SRGBA8: return nvrhi::Format::SRGBA8_UNORM;
-	case WindowVideoFormat::SBGRA8: return nvrhi::Format::SBGRA8_UNORM;
-	case WindowVideoFormat::RGBA8: return nvrhi::Format::RGBA8_UNORM;
-	case WindowVideoFormat::BGRA8: return nvrhi::Format::BGRA8_UNORM;
-	}
-
-	return nvrhi::Format::UNKNOWN;
-}
-
-// Todo: cleanup since we no longer have a main framebuffer
-bool RenderFrontend::CreateMainFramebuffer()
-{
-	// Sampler
-	auto& textureSampler = nvrhi::SamplerDesc()
-		.setAllFilters( true )
-		.setAllAddressModes( nvrhi::SamplerAddressMode::Wrap );
-
-	screenSampler = backend->createSampler( textureSampler );
-
-	const auto printFramebufferInfo = []( const nvrhi::FramebufferInfo& fbInfo, const char* name )
-	{
-		Console->DPrint( format( "Framebuffer '%s' info: ", name ), 1 );
-		Console->DPrint( format( "  * Size:          %ux%u ", fbInfo.width, fbInfo.height ), 1);
-		Console->DPrint( format( "  * Colour format: %s ", nvrhi::utils::FormatToString( fbInfo.colorFormats[0] ) ), 1 );
-		Console->DPrint( format( "  * Depth format:  %s ", nvrhi::utils::FormatToString( fbInfo.depthFormat ) ), 1 );
-	};
-
-	printFramebufferInfo( backendManager->GetCurrentFramebuffer()->getFramebufferInfo(), "Screen backbuffer" );
-	
-	const auto& viewDataBufferDesc = nvrhi::utils::CreateVolatileConstantBufferDesc( sizeof( currentViewData ), "currentViewData", 16U );
-	viewDataBuffer = backend->createBuffer( viewDataBufferDesc );
-
-	const auto& entityDataBufferDesc = nvrhi::utils::CreateVolatileConstantBufferDesc( sizeof( currentEntityData ), "currentEntityData", 16U );
-	entityDataBuffer = backend->createBuffer( entityDataBufferDesc );
-
-	return true;
-}
-
-bool RenderFrontend::CreateScreenVertexBuffer()
-{
-	// Format: XY UV
-	const Vector<float> ScreenQuadVertexData =
-	{
-		-1.0f, -1.0f,
-		0.0f, 1.0f,
-
-		1.0f, -1.0f,
-		1.0f, 1.0f,
-
-		1.0f, 1.0f,
-		1.0f, 0.0f,
-
-		-1.0f, 1.0f,
-		0.0f, 0.0f
-	};
-
-	const Vector<uint32_t> ScreenQuadIndexData =
-	{
-		0, 1, 2,
-		2, 3, 0
-	};
-
-	screenIndexBuffer = CreateIndexBuffer( ScreenQuadIndexData );
-	screenVertexBuffer = CreateVertexBuffer( ScreenQuadVertexData );
-
-	return (nullptr != screenIndexBuffer) && (nullptr != screenVertexBuffer);
-}
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "RenderFrontend.hpp"
+#include "Profiler.hpp"
+#include <nvrhi/utils.h>
+
+bool RenderFrontend::PostInit( RenderBackend* renderBackend, IWindow* mainWindow )
+{
+	backendManager = renderBackend;
+	backend = backendManager->GetDevice();
+	window = mainWindow;
+
+	return CreateResources();
+}
+
+bool RenderFrontend::PostInitHeadless( IBackend* device, uint32_t width, uint32_t height )
+{
+	if ( nullptr == device || 0U == width || 0U == height )
+	{
+		Console->Error( "RenderFrontend::PostInitHeadless: a device and a non-zero size are required" );
+		return false;
+	}
+
+	backend = device;
+
+	// Same kind of format a swapchain would have
+	auto colourDesc = nvrhi::TextureDesc()
+		.setDebugName( "Headless backbuffer" )
+		.setDimension( nvrhi::TextureDimension::Texture2D )
+		.setWidth( width )
+		.setHeight( height )
+		.setFormat( nvrhi::Format::RGBA8_UNORM )
+		.setIsRenderTarget( true )
+		.setInitialState( nvrhi::ResourceStates::RenderTarget )
+		.setKeepInitialState( true );
+
+	headlessColour = backend->createTexture( colourDesc );
+	if ( nullptr == headlessColour )
+	{
+		Console->Error( "RenderFrontend::PostInitHeadless: Failed to create the offscreen target" );
+		return false;
+	}
+	commandStats.Record( RenderCommand::CreateTexture );
+
+	headlessFramebuffer = backend->createFramebuffer( nvrhi::FramebufferDesc().addColorAttachment( headlessColour ) );
+	if ( nullptr == headlessFramebuffer )
+	{
+		Console->Error( "RenderFrontend::PostInitHeadless: Failed to create the offscreen framebuffer" );
+		return false;
+	}
+
+	return CreateResources();
+}
+
+bool RenderFrontend::CreateResources()
+{
+	if ( !CreateCommandLists() )
+	{
+		Console->Error( "RenderFrontend::PostInit: Failed to create commandlists" );
+		return false;
+	}
+
+	if ( !CreateMainFramebuffer() )
+	{
+		Console->Error( "RenderFrontend::PostInit: Failed to create main framebuffer" );
+		return false;
+	}
+
+	if ( !CreateMainGraphicsPipelines() )
+	{
+		Console->Error( "RenderFrontend::PostInit: Failed to create core graphics pipeline" );
+		return false;
+	}
+
+	if ( !CreatePostProcessResources() )
+	{
+		Console->Error( "RenderFrontend::PostInit: Failed to create post-process resources" );
+		return false;
+	}
+
+	if ( !CreateFrameResources() )
+	{
+		Console->Error( "RenderFrontend::PostInit: Failed to create per-frame resources" );
+		return false;
+	}
+
+	if ( !CreateEntityDataResources() )
+	{
+		Console->Error( "RenderFrontend::PostInit: Failed to create the entity buffer" );
+		return false;
+	}
+
+	if ( !CreateMaterialResources() )
+	{
+		Console->Error( "RenderFrontend::PostInit: Failed to create material resources" );
+		return false;
+	}
+
+	if ( !CreateSkinningResources() )
+	{
+		Console->Error( "RenderFrontend::PostInit: Failed to create skinning resources" );
+		return false;
+	}
+
+	if ( !CreateShadowResources() )
+	{
+		Console->Error( "RenderFrontend::PostInit: Failed to create shadow maps" );
+		return false;
+	}
+
+	textureStreamer.Start();
+	workerPool.Start();
+	gpuProfiler.Init( backend );
+
+	return true;
+}
+
+bool RenderFrontend::CreateCommandLists()
+{
+	auto transferParams = nvrhi::CommandListParameters()
+		.setQueueType( nvrhi::CommandQueue::Graphics );
+
+	transferCommands = backend->createCommandList( transferParams );
+
+	return nullptr != transferCommands;
+}
+
+static nvrhi::Format WindowFormatToNvrhi( WindowVideoFormat format )
+{
+	switch ( format )
+	{
+	case WindowVideoFormat::SRGBA8: return nvrhi::Format::SRGBA8_UNORM;
+	case WindowVideoFormat::SBGRA8: return nvrhi::Format::SBGRA8_UNORM;
+	case WindowVideoFormat::RGBA8: return nvrhi::Format::RGBA8_UNORM;
+	case WindowVideoFormat::BGRA8: return nvrhi::Format::BGRA8_UNORM;
+	}
+
+	return nvrhi::Format::UNKNOWN;
+}
+
+// Todo: cleanup since we no longer have a main framebuffer
+bool RenderFrontend::CreateMainFramebuffer()
+{
+	// Sampler
+	auto& textureSampler = nvrhi::SamplerDesc()
+		.setAllFilters( true )
+		.setAllAddressModes( nvrhi::SamplerAddressMode::Wrap );
+
+	screenSampler = backend->createSampler( textureSampler );
+
+	const auto printFramebufferInfo = []( const nvrhi::FramebufferInfo& fbInfo, const char* name )
+	{
+		Console->DPrint( format( "Framebuffer '%s' info: ", name ), 1 );
+		Console->DPrint( format( "  * Size:          %ux%u ", fbInfo.width, fbInfo.height ), 1);
+		Console->DPrint( format( "  * Colour format: %s ", nvrhi::utils::FormatToString( fbInfo.colorFormats[0] ) ), 1 );
+		Console->DPrint( format( "  * Depth format:  %s ", nvrhi::utils::FormatToString( fbInfo.depthFormat ) ), 1 );
+	};
+
+	printFramebufferInfo( GetScreenFramebuffer()->getFramebufferInfo(), "Screen backbuffer" );
+
+	return true;
+}
+
+nvrhi::IFramebuffer* RenderFrontend::GetScreenFramebuffer() const
+{
+	if ( nullptr != headlessFramebuffer )
+	{
+		return headlessFramebuffer;
+	}
+
+	return backendManager->GetCurrentFramebuffer();
+}
+
+Vec2 RenderFrontend::GetScreenSize() const
+{
+	if ( nullptr != headlessColour )
+	{
+		const nvrhi::TextureDesc& desc = headlessColour->getDesc();
+		return { float( desc.width ), float( desc.height ) };
+	}
+
+	return window->GetSize();
+}
+
+bool RenderFrontend::CreateFrameResources()
+{
+	constantBufferMemory = memoryTracker.CreateOwner( MemoryCategory::ConstantBuffers, "frontend constant buffers" );
+
+	auto renderParams = nvrhi::CommandListParameters()
+		.setQueueType( nvrhi::CommandQueue::Graphics );
+
+	const auto& viewDataBufferDesc = nvrhi::utils::CreateVolatileConstantBufferDesc( sizeof( currentViewData ), "currentViewData", 16U );
+
+	frames.resize( framesInFlight );
+	for ( FrameResources& frame : frames )
+	{
+		frame.renderCommands = backend->createCommandList( renderParams );
+		frame.fence = backend->createEventQuery();
+		if ( nullptr == frame.renderCommands || nullptr == frame.fence )
+		{
+			Console->Error( "RenderFrontend: Failed to create frame command list" );
+			return false;
+		}
+
+		frame.viewDataBuffer = backend->createBuffer( viewDataBufferDesc );
+		if ( nullptr == frame.viewDataBuffer )
+		{
+			Console->Error( "RenderFrontend: Failed to create frame constant buffers" );
+			return false;
+		}
+		commandStats.Record( RenderCommand::CreateBuffer, viewDataBufferDesc.byteSize );
+		memoryTracker.Allocate( constantBufferMemory, viewDataBufferDesc.byteSize );
+
+		auto viewFrameSetDesc = nvrhi::BindingSetDesc()
+			.addItem( nvrhi::BindingSetItem::ConstantBuffer( 0, frame.viewDataBuffer ) );
+		frame.viewFrameBindingSet = backend->createBindingSet( viewFrameSetDesc, viewFrameBindingLayout );
+		if ( nullptr == frame.viewFrameBindingSet )
+		{
+			Console->Error( "RenderFrontend: Failed to create view binding set" );
+			return false;
+		}
+	}
+
+	currentFrame = nullptr;
+	AcquireFrameResources();
+	return true;
+}
+
+void RenderFrontend::DestroyFrameResources()
+{
+	// Only called when the GPU is idle
+	completedFrameIndex = frameIndex;
+	currentFrame = nullptr;
+	renderCommands = nullptr;
+	viewDataBuffer = nullptr;
+	viewFrameBindingSet = nullptr;
+	frames.clear();
+
+	memoryTracker.ReleaseOwner( constantBufferMemory );
+	constantBufferMemory = MemoryTracker::InvalidOwner;
+}
+
+void RenderFrontend::AcquireFrameResources()
+{
+	FrameResources& frame = frames[frameIndex % frames.size()];
+	if ( frame.submitted )
+	{
+		// Normally the GPU is done with it by now, anything else means the GPU is the bottleneck
+		if ( !backend->pollEventQuery( frame.fence ) )
+		{
+			PROFILE_SCOPE( "WaitForFrame" );
+			frameStalls++;
+			backend->waitEventQuery( frame.fence );
+		}
+
+		backend->resetEventQuery( frame.fence );
+		frame.submitted = false;
+		// Frames complete in order, so everything before it is done too
+		completedFrameIndex = std::max( completedFrameIndex, frame.frameIndex );
+	}
+
+	frame.frameIndex = frameIndex;
+	currentFrame = &frame;
+	renderCommands = frame.renderCommands;
+	viewDataBuffer = frame.viewDataBuffer;
+	viewFrameBindingSet = frame.viewFrameBindingSet;
+}
@@ -0,0 +1,515 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "RenderFrontend.hpp"
+#include "Batch.hpp"
+#include "Entity.hpp"
+#include "Profiler.hpp"
+#include "Texture.hpp"
+
+// Size of the texture table, textures past this are drawn white
+constexpr uint32_t MaxBindlessTextures = 4096U;
+constexpr uint32_t MaxMaterials = 65536U;
+
+// Made before the entity pipelines, which need to know whether they're bindless
+bool RenderFrontend::CreateMaterialBindingLayouts()
+{
+	auto materialBindingLayoutDesc = nvrhi::BindingLayoutDesc()
+		.setVisibility( nvrhi::ShaderType::Pixel )
+		.addItem( nvrhi::BindingLayoutItem::StructuredBuffer_SRV( 1 ) )
+		.addItem( nvrhi::BindingLayoutItem::Sampler( 1 ) );
+
+	materialBindingLayout = backend->createBindingLayout( materialBindingLayoutDesc );
+	if ( nullptr == materialBindingLayout )
+	{
+		Console->Error( "RenderFrontend: Failed to create material binding layout" );
+		return false;
+	}
+
+	// D3D11 has no descriptor indexing at all, the rest may still refuse if the hardware is too old
+	if ( backend->getGraphicsAPI() != nvrhi::GraphicsAPI::D3D11 )
+	{
+		auto textureTableLayoutDesc = nvrhi::BindlessLayoutDesc()
+			.setVisibility( nvrhi::ShaderType::Pixel )
+			.setFirstSlot( 0U )
+			.setMaxCapacity( MaxBindlessTextures )
+			.addRegisterSpace( nvrhi::BindingLayoutItem::Texture_SRV( 3 ) );
+
+		textureTableLayout = backend->createBindlessLayout( textureTableLayoutDesc );
+	}
+
+	bindless = nullptr != textureTableLayout;
+	if ( bindless )
+	{
+		Console->DPrint( "RenderFrontend: Material textures are bindless", 1 );
+		return true;
+	}
+
+	auto materialTextureBindingLayoutDesc = nvrhi::BindingLayoutDesc()
+		.setVisibility( nvrhi::ShaderType::Pixel )
+		.addItem( nvrhi::BindingLayoutItem::Texture_SRV( 2 ) );
+
+	materialTextureBindingLayout = backend->createBindingLayout( materialTextureBindingLayoutDesc );
+	if ( nullptr == materialTextureBindingLayout )
+	{
+		Console->Error( "RenderFrontend: Failed to create material texture binding layout" );
+		return false;
+	}
+
+	Console->DPrint( "RenderFrontend: No bindless support, using a binding set per material", 1 );
+	return true;
+}
+
+bool RenderFrontend::CreateMaterialResources()
+{
+	materialMemory = memoryTracker.CreateOwner( MemoryCategory::Materials, "materials" );
+
+	auto samplerDesc = nvrhi::SamplerDesc()
+		.setAllFilters( true )
+		.setAllAddressModes( nvrhi::SamplerAddressMode::Wrap )
+		.setMaxAnisotropy( 8.0f );
+
+	materialSampler = backend->createSampler( samplerDesc );
+	if ( nullptr == materialSampler )
+	{
+		Console->Error( "RenderFrontend: Failed to create the material sampler" );
+		return false;
+	}
+
+	// Materials without a texture sample this, so they don't need a shader of their own
+	auto whiteTextureDesc = nvrhi::TextureDesc()
+		.setWidth( 1U )
+		.setHeight( 1U )
+		.setFormat( nvrhi::Format::RGBA8_UNORM )
+		.setDimension( nvrhi::TextureDimension::Texture2D )
+		.setInitialState( nvrhi::ResourceStates::ShaderResource )
+		.setKeepInitialState( true )
+		.setDebugName( "Material white texture" );
+
+	whiteTexture = backend->createTexture( whiteTextureDesc );
+	if ( nullptr == whiteTexture )
+	{
+		Console->Error( "RenderFrontend: Failed to create the material white texture" );
+		return false;
+	}
+
+	commandStats.Record( RenderCommand::CreateTexture );
+	memoryTracker.Allocate( materialMemory, GetMipByteSize( whiteTextureDesc.format, 1U, 1U, 0U ) );
+
+	const uint32_t whitePixel = 0xffffffffU;
+	transferCommands->open();
+	transferCommands->writeTexture( whiteTexture, 0U, 0U, &whitePixel, sizeof( whitePixel ) );
+	commandStats.Record( RenderCommand::WriteTexture, sizeof( whitePixel ) );
+	transferCommands->close();
+	backend->executeCommandList( transferCommands );
+	commandStats.Record( RenderCommand::ExecuteCommandList );
+
+	// Slot 0 of both is the white texture & the default material
+	textureSlots.Init( bindless ? MaxBindlessTextures : 1U, WhiteTextureSlot + 1U );
+	materialSlotAllocator.Init( MaxMaterials, DefaultMaterialSlot + 1U );
+
+	if ( bindless )
+	{
+		textureTable = backend->createDescriptorTable( textureTableLayout );
+		if ( nullptr == textureTable )
+		{
+			Console->Error( "RenderFrontend: Failed to create the texture table" );
+			return false;
+		}
+
+		backend->resizeDescriptorTable( textureTable, MaxBindlessTextures, false );
+		backend->writeDescriptorTable( textureTable, nvrhi::BindingSetItem::Texture_SRV( WhiteTextureSlot, whiteTexture ) );
+	}
+
+	if ( !ResizeMaterialBuffer( 256U ) )
+	{
+		return false;
+	}
+
+	Material* defaultMaterial = new Material( MaterialDesc(), DefaultMaterialSlot );
+	materials.emplace_back( defaultMaterial );
+	materialSlots.resize( DefaultMaterialSlot + 1U, nullptr );
+	materialSlots[DefaultMaterialSlot] = defaultMaterial;
+	if ( !bindless && !CreateMaterialTextureSet( defaultMaterial ) )
+	{
+		return false;
+	}
+
+	QueueMaterialUpload( defaultMaterial );
+	return true;
+}
+
+void RenderFrontend::DestroyMaterialResources()
+{
+	pendingMaterialUploads.clear();
+	materialSlots.clear();
+	materials.clear();
+	materialSlotAllocator.Clear();
+	textureSlots.Clear();
+	textureTable = nullptr;
+	materialBindingSet = nullptr;
+	materialBuffer = nullptr;
+	materialCapacity = 0U;
+	whiteTexture = nullptr;
+	materialSampler = nullptr;
+	memoryTracker.ReleaseOwner( materialMemory );
+	materialMemory = MemoryTracker::InvalidOwner;
+}
+
+// Old contents are copied over in renderCommands, so this must be called while it's open,
+// unless it's the first buffer
+bool RenderFrontend::ResizeMaterialBuffer( uint32_t capacity )
+{
+	auto bufferDesc = nvrhi::BufferDesc()
+		.setByteSize( uint64_t( capacity ) * sizeof( MaterialData ) )
+		.setStructStride( sizeof( MaterialData ) )
+		.setInitialState( nvrhi::ResourceStates::ShaderResource )
+		.setKeepInitialState( true )
+		.setDebugName( "Material data" );
+
+	nvrhi::BufferHandle newBuffer = backend->createBuffer( bufferDesc );
+	if ( nullptr == newBuffer )
+	{
+		Console->Error( format( "RenderFrontend: Failed to create a material buffer for %u materials", capacity ) );
+		return false;
+	}
+
+	commandStats.Record( RenderCommand::CreateBuffer, bufferDesc.byteSize );
+
+	if ( nullptr != materialBuffer )
+	{
+		renderCommands->copyBuffer( newBuffer, 0U, materialBuffer, 0U, uint64_t( materialCapacity ) * sizeof( MaterialData ) );
+		memoryTracker.Free( materialMemory, size_t( materialCapacity ) * sizeof( MaterialData ) );
+	}
+	memoryTracker.Allocate( materialMemory, size_t( bufferDesc.byteSize ) );
+
+	materialBuffer = newBuffer;
+	materialCapacity = capacity;
+
+	auto materialSetDesc = nvrhi::BindingSetDesc()
+		.addItem( nvrhi::BindingSetItem::StructuredBuffer_SRV( 1, materialBuffer ) )
+		.addItem( nvrhi::BindingSetItem::Sampler( 1, materialSampler ) );
+	materialBindingSet = backend->createBindingSet( materialSetDesc, materialBindingLayout );
+	if ( nullptr == materialBindingSet )
+	{
+		Console->Error( "RenderFrontend: Failed to create material binding set" );
+		return false;
+	}
+
+	return true;
+}
+
+uint32_t RenderFrontend::GetTextureSlot( const ITexture* texture ) const
+{
+	if ( nullptr == texture )
+	{
+		return WhiteTextureSlot;
+	}
+
+	return static_cast<const Texture*>( texture )->tableSlot;
+}
+
+// Called when the texture is created and whenever it gets a new image, i.e. when its resident mips change
+void RenderFrontend::UpdateTextureDescriptor( Texture* texture )
+{
+	shadingChangeSerial++;
+
+	if ( !bindless )
+	{
+		for ( const auto& material : materials )
+		{
+			if ( material->GetDesc().diffuseTexture == texture )
+			{
+				CreateMaterialTextureSet( material.get() );
+			}
+		}
+		return;
+	}
+
+	if ( nullptr == textureTable )
+	{
+		return;
+	}
+
+	// Frames in flight may still read the old descriptor, and table writes aren't ordered with them,
+	// so it's never overwritten. The new image gets a fresh slot, the old one is freed once the GPU is done
+	const uint32_t slot = textureSlots.Allocate();
+	if ( SlotAllocator::InvalidSlot == slot )
+	{
+		Console->Warning( format( "RenderFrontend: the texture table is full (%u textures), texture #%u will be white",
+			textureSlots.GetMaxSlots(), texture->GetStreamingId() ) );
+	}
+	else
+	{
+		backend->writeDescriptorTable( textureTable, nvrhi::BindingSetItem::Texture_SRV( slot, texture->GetHandle() ) );
+	}
+
+	if ( WhiteTextureSlot != texture->tableSlot )
+	{
+		textureSlots.Free( texture->tableSlot, frameIndex );
+	}
+	texture->tableSlot = SlotAllocator::InvalidSlot != slot ? slot : WhiteTextureSlot;
+
+	// Materials store the slot, so they have to be uploaded again
+	for ( const auto& material : materials )
+	{
+		if ( material->GetDesc().diffuseTexture == texture )
+		{
+			QueueMaterialUpload( material.get() );
+		}
+	}
+}
+
+// Materials that used the texture go white, and the slot is reused once the GPU is done with it
+void RenderFrontend::ReleaseTextureSlot( Texture* texture )
+{
+	for ( const auto& material : materials )
+	{
+		if ( material->GetDesc().diffuseTexture != texture )
+		{
+			continue;
+		}
+
+		MaterialDesc desc = material->GetDesc();
+		desc.diffuseTexture = nullptr;
+		UpdateMaterial( material.get(), desc );
+	}
+
+	if ( WhiteTextureSlot != texture->tableSlot )
+	{
+		textureSlots.Free( texture->tableSlot, frameIndex );
+		texture->tableSlot = WhiteTextureSlot;
+	}
+}
+
+bool RenderFrontend::CreateMaterialTextureSet( Material* material )
+{
+	const ITexture* diffuse = material->GetDesc().diffuseTexture;
+	nvrhi::ITexture* diffuseImage = nullptr != diffuse ? static_cast<const Texture*>( diffuse )->GetHandle() : nullptr;
+
+	auto textureSetDesc = nvrhi::BindingSetDesc()
+		.addItem( nvrhi::BindingSetItem::Texture_SRV( 2, nullptr != diffuseImage ? diffuseImage : whiteTexture.Get() ) );
+	material->textureBindingSet = backend->createBindingSet( textureSetDesc, materialTextureBindingLayout );
+	if ( nullptr == material->textureBindingSet )
+	{
+		Console->Error( "RenderFrontend: Failed to create material texture binding set" );
+		return false;
+	}
+
+	return true;
+}
+
+void RenderFrontend::QueueMaterialUpload( Material* material )
+{
+	shadingChangeSerial++;
+
+	if ( !material->uploadPending )
+	{
+		material->uploadPending = true;
+		pendingMaterialUploads.push_back( material );
+	}
+}
+
+void RenderFrontend::FlushMaterialUploads()
+{
+	if ( pendingMaterialUploads.empty() )
+	{
+		return;
+	}
+
+	PROFILE_SCOPE( "FlushMaterialUploads" );
+
+	const uint32_t numSlots = materialSlotAllocator.GetNumSlots();
+	if ( numSlots > materialCapacity
+		&& !ResizeMaterialBuffer( std::max( numSlots, materialCapacity * 2U ) ) )
+	{
+		return;
+	}
+
+	// Materials rarely change, so these are plain writes rather than a scatter pass like entities
+	for ( Material* material : pendingMaterialUploads )
+	{
+		const MaterialDesc& desc = material->GetDesc();
+		MaterialData data;
+		data.colour = desc.colour;
+		data.diffuseTexture = GetTextureSlot( desc.diffuseTexture );
+		data.padding[0] = data.padding[1] = data.padding[2] = 0U;
+
+		renderCommands->writeBuffer( materialBuffer, &data, sizeof( data ), uint64_t( material->GetSlot() ) * sizeof( MaterialData ) );
+		commandStats.Record( RenderCommand::WriteBuffer, sizeof( data ) );
+		material->uploadPending = false;
+	}
+	pendingMaterialUploads.clear();
+
+	stateTracker.Invalidate();
+}
+
+nvrhi::IBindingSet* RenderFrontend::GetMaterialTextureSet( uint32_t slot ) const
+{
+	if ( bindless )
+	{
+		return textureTable;
+	}
+
+	const Material* material = slot < materialSlots.size() ? materialSlots[slot] : nullptr;
+	return nullptr != material ? material->textureBindingSet : materialSlots[DefaultMaterialSlot]->textureBindingSet;
+}
+
+void RenderFrontend::ReplaceFaceMaterial( uint32_t oldMaterial, uint32_t newMaterial )
+{
+	shadingChangeSerial++;
+
+	for ( const auto& model : models )
+	{
+		static_cast<Model*>( model.get() )->ReplaceMaterial( oldMaterial, newMaterial );
+	}
+
+	for ( const auto& entity : entities )
+	{
+		Entity* entityInternal = static_cast<Entity*>( entity.get() );
+		if ( nullptr == entityInternal->skin )
+		{
+			continue;
+		}
+
+		for ( FaceDrawRecord& record : entityInternal->skin->drawRecords )
+		{
+			record.material = record.material == oldMaterial ? newMaterial : record.material;
+		}
+	}
+
+	for ( const auto& batch : batches )
+	{
+		static_cast<Batch*>( batch.get() )->ReplaceMaterial( oldMaterial, newMaterial );
+	}
+}
+
+Material* RenderFrontend::CreateMaterial( const MaterialDesc& desc )
+{
+	if ( nullptr != desc.diffuseTexture && FindIterator( textures, desc.diffuseTexture ) == textures.end() )
+	{
+		Console->Warning( "RenderFrontend::CreateMaterial: the diffuse texture isn't registered" );
+		return nullptr;
+	}
+
+	const uint32_t slot = materialSlotAllocator.Allocate();
+	if ( SlotAllocator::InvalidSlot == slot )
+	{
+		Console->Warning( format( "RenderFrontend::CreateMaterial: too many materials (max. %u)", MaxMaterials ) );
+		return nullptr;
+	}
+
+	Material* material = new Material( desc, slot );
+	if ( !bindless && !CreateMaterialTextureSet( material ) )
+	{
+		materialSlotAllocator.Free( slot, frameIndex );
+		delete material;
+		return nullptr;
+	}
+
+	if ( slot >= materialSlots.size() )
+	{
+		materialSlots.resize( slot + 1U, nullptr );
+	}
+	materialSlots[slot] = material;
+
+	QueueMaterialUpload( material );
+	return materials.emplace_back( material ).get();
+}
+
+bool RenderFrontend::UpdateMaterial( Material* material, const MaterialDesc& desc )
+{
+	if ( nullptr == material || FindIterator( materials, material ) == materials.end() )
+	{
+		Console->Warning( "RenderFrontend::UpdateMaterial: tried updating an unregistered material" );
+		return false;
+	}
+
+	if ( nullptr != desc.diffuseTexture && FindIterator( textures, desc.diffuseTexture ) == textures.end() )
+	{
+		Console->Warning( "RenderFrontend::UpdateMaterial: the diffuse texture isn't registered" );
+		return false;
+	}
+
+	material->SetDesc( desc );
+	if ( !bindless && !CreateMaterialTextureSet( material ) )
+	{
+		return false;
+	}
+
+	QueueMaterialUpload( material );
+	return true;
+}
+
+bool RenderFrontend::DestroyMaterial( Material* material )
+{
+	if ( nullptr == material )
+	{
+		Console->Warning( "RenderFrontend::DestroyMaterial: tried destroying a non-existing material" );
+		return false;
+	}
+
+	auto it = FindIterator( materials, material );
+	if ( it == materials.end() || material->GetSlot() == DefaultMaterialSlot )
+	{
+		Console->Warning( "RenderFrontend::DestroyMaterial: tried destroying an unregistered material" );
+		return false;
+	}
+
+	const uint32_t slot = material->GetSlot();
+	ReplaceFaceMaterial( slot, DefaultMaterialSlot );
+	materialSlotAllocator.Free( slot, frameIndex );
+	materialSlots[slot] = nullptr;
+
+	if ( material->uploadPending )
+	{
+		pendingMaterialUploads.erase( std::find( pendingMaterialUploads.begin(), pendingMaterialUploads.end(), material ) );
+	}
+
+	// The binding set is kept alive by the command lists that use it
+	materials.erase( it );
+	return true;
+}
+
+bool RenderFrontend::SetFaceMaterial( IModel* model, uint32_t face, Material* material )
+{
+	if ( nullptr == model || FindIterator( models, model ) == models.end() )
+	{
+		Console->Warning( "RenderFrontend::SetFaceMaterial: tried using an unregistered model" );
+		return false;
+	}
+
+	if ( nullptr != material && FindIterator( materials, material ) == materials.end() )
+	{
+		Console->Warning( "RenderFrontend::SetFaceMaterial: tried using an unregistered material" );
+		return false;
+	}
+
+	const uint32_t slot = nullptr != material ? material->GetSlot() : DefaultMaterialSlot;
+	if ( !static_cast<Model*>( model )->SetFaceMaterial( face, slot ) )
+	{
+		Console->Warning( format( "RenderFrontend::SetFaceMaterial: model '%s' has no face %u",
+			static_cast<Model*>( model )->GetName().data(), face ) );
+		return false;
+	}
+
+	shadingChangeSerial++;
+
+	// Skins have their own copies of the records
+	for ( const auto& entity : entities )
+	{
+		Entity* entityInternal = static_cast<Entity*>( entity.get() );
+		if ( nullptr != entityInternal->skin && entityInternal->skin->model == model )
+		{
+			entityInternal->skin->drawRecords[face].material = slot;
+		}
+	}
+
+	return true;
+}
+
+bool RenderFrontend::IsBindless() const
+{
+	return bindless;
+}
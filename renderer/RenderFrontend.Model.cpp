@@ -1,233 +1,378 @@
-// SPDX-FileCopyrightText: 2022 Admer Šuko
-// SPDX-License-Identifier: MIT
-
-#include "Precompiled.hpp"
-#include "RenderFrontend.hpp"
-#include <nvrhi/common/misc.h>
-
-bool RenderFrontend::ValidateModelAsset( const Assets::IModel* modelAsset )
-{
-	const auto& data = modelAsset->GetModelData();
-	const StringView name = modelAsset->GetName();
-
-	if ( data.meshes.empty() )
-	{
-		Console->Error( format( "RenderFrontend: model '%s' has no meshes",
-			name.data() ) );
-		return false;
-	}
-
-	bool modelInvalid = false;
-
-	for ( const auto& mesh : data.meshes )
-	{
-		if ( mesh.faces.empty() )
-		{
-			Console->Error( format( "RenderFrontend: model '%s', mesh '%s' has no faces",
-				name.data(), mesh.name.data() ) );
-			modelInvalid = true;
-			continue;
-		}
-
-		int faceId = -1;
-		for ( const auto& face : mesh.faces )
-		{
-			faceId++;
-
-			if ( face.data.vertexIndices.empty() || face.data.vertexData.empty() )
-			{
-				Console->Error( format( "RenderFrontend: model '%s', mesh '%s' has face with no data",
-					name.data(), mesh.name.data() ) );
-				modelInvalid = true;
-				continue;
-			}
-
-			if ( face.data.vertexIndices.size() % 3 )
-			{
-				Console->Error( format( "RenderFrontend: model '%s', mesh '%s' has face with isolated vertices or edges (vertex indices should be a multiple of 3)",
-					name.data(), mesh.name.data() ) );
-				modelInvalid = true;
-				continue;
-			}
-		}
-	}
-
-	return !modelInvalid;
-}
-
-nvrhi::BufferHandle RenderFrontend::CreateIndexBuffer( Vector<uint32_t> indices )
-{
-	nvrhi::BufferHandle indexBuffer;
-
-	auto desc = nvrhi::BufferDesc()
-		.setByteSize( indices.size() * sizeof( uint32_t ) )
-		//.setFormat( nvrhi::Format::R32_UINT )
-		.setIsIndexBuffer( true )
-		.setInitialState( nvrhi::ResourceStates::CopyDest );
-
-	indexBuffer = backend->createBuffer( desc );
-	if ( nullptr == indexBuffer )
-	{
-		return nullptr;
-	}
-
-	transferCommands->open();
-	transferCommands->beginTrackingBufferState( indexBuffer, nvrhi::ResourceStates::CopyDest );
-	transferCommands->writeBuffer( indexBuffer, indices.data(), indices.size() * sizeof( uint32_t ) );
-	transferCommands->setPermanentBufferState( indexBuffer, nvrhi::ResourceStates::IndexBuffer );
-	transferCommands->close();
-
-	backend->executeCommandList( transferCommands, nvrhi::CommandQueue::Graphics );
-	
-	// TODO: Figure out **when** to populate the buffers
-	// Should we:
-	// 1) Open a commandlist here, record everything that's needed and execute immediately?
-	// 2) Open a commandlist here, record, execute later?
-	// 3) Submit some sorta request into a queue, to do #1 sometime later?
-	// Right now, we're doing #1 because it's the most naive & simple one
-	return indexBuffer;
-}
-
-static const char* VertexSegmentToString( Assets::RenderData::VertexAttributeType segmentType )
-{
-	using Assets::RenderData::VertexAttributeType;
-
-	switch ( segmentType )
-	{
-	case VertexAttributeType::Position: return "Position";
-	case VertexAttributeType::Normal: return "Normal";
-	case VertexAttributeType::TangentAndBitangent: return "TangentAndBitangent";
-	case VertexAttributeType::Uv1: return "Uv1";
-	case VertexAttributeType::Uv2: return "Uv2";
-	case VertexAttributeType::Uv3: return "Uv3";
-	case VertexAttributeType::Uv4: return "Uv4";
-	case VertexAttributeType::Colour1: return "Colour1";
-	case VertexAttributeType::Colour2: return "Colour2";
-	case VertexAttributeType::Colour3: return "Colour3";
-	case VertexAttributeType::Colour4: return "Colour4";
-	case VertexAttributeType::BoneWeights: return "BoneWeights";
-	case VertexAttributeType::BoneIndices: return "BoneIndices";
-	}
-
-	return "UNKNOWN";
-}
-
-nvrhi::BufferHandle RenderFrontend::CreateVertexBuffer( const Vector<float>& rawVertexData )
-{
-	auto desc = nvrhi::BufferDesc()
-		.setByteSize( rawVertexData.size() * sizeof( float ) )
-		.setIsVertexBuffer( true )
-		.setInitialState( nvrhi::ResourceStates::CopyDest );
-
-	nvrhi::BufferHandle vertexBuffer = backend->createBuffer( desc );
-	if ( nullptr == vertexBuffer )
-	{
-		return nullptr;
-	}
-
-	transferCommands->open();
-	transferCommands->beginTrackingBufferState( vertexBuffer, nvrhi::ResourceStates::CopyDest );
-	transferCommands->writeBuffer( vertexBuffer, rawVertexData.data(), desc.byteSize );
-	transferCommands->setPermanentBufferState( vertexBuffer, nvrhi::ResourceStates::VertexBuffer );
-	transferCommands->close();
-
-	backend->executeCommandList( transferCommands, nvrhi::CommandQueue::Graphics );
-
-	return vertexBuffer;
-}
-
-bool RenderFrontend::CreateVertexBuffer( uint32_t face, const Assets::RenderData::VertexDataSegment& segment, VertexBufferMap& outVertexBuffers )
-{
-	const VertexMapKey key = { face, segment.type };
-
-	auto desc = nvrhi::BufferDesc()
-		.setByteSize( nvrhi::align( segment.rawData.size(), 4ULL ) ) // Modern GAPIs do not like data that isn't aligned to 4 bytes
-		.setIsVertexBuffer( true )
-		.setInitialState( nvrhi::ResourceStates::CopyDest );
-
-	nvrhi::BufferHandle vertexBuffer = backend->createBuffer( desc );
-
-	if ( nullptr == vertexBuffer )
-	{
-		return false;
-	}
-
-	transferCommands->open();
-	transferCommands->beginTrackingBufferState( vertexBuffer, nvrhi::ResourceStates::CopyDest );
-	transferCommands->writeBuffer( vertexBuffer, segment.rawData.data(), desc.byteSize );
-	transferCommands->setPermanentBufferState( vertexBuffer, nvrhi::ResourceStates::VertexBuffer );
-	transferCommands->close();
-
-	backend->executeCommandList( transferCommands, nvrhi::CommandQueue::Graphics );
-	
-	// Finally insert the thing
-	outVertexBuffers[key] = vertexBuffer;
-
-	return true;
-}
-
-bool RenderFrontend::CreateBuffersFromVertexData( uint32_t face, const Assets::RenderData::VertexData& data,
-	Vector<nvrhi::BufferHandle>& outIndexBuffers, VertexBufferMap& outVertexBuffers )
-{
-	// The render backend will report errors in this situation
-	nvrhi::BufferHandle indexBufferHandle = CreateIndexBuffer( data.vertexIndices );
-	if ( nullptr == indexBufferHandle )
-	{
-		Console->Error( format( "Failed to create index buffer (face %u)", face ) );
-		return false;
-	}
-
-	outIndexBuffers.push_back( std::move( indexBufferHandle ) );
-
-	// Build different vertex buffer segments, e.g. one buffer for positions, one for normals etc.
-	bool failedCreatingVertexBuffers = false;
-	for ( const auto& segment : data.vertexData )
-	{
-		if ( !CreateVertexBuffer( face, segment, outVertexBuffers ) )
-		{
-			Console->Error( format( "Failed to create vertex buffer (face %u, segment '%s')",
-				face, VertexSegmentToString( segment.type ) ) );
-			failedCreatingVertexBuffers = true;
-		}
-	}
-
-	return !failedCreatingVertexBuffers;
-}
-
-IModel* RenderFrontend::BuildModelFromAsset( const Assets::IModel* modelAsset )
-{
-	Vector<size_t> indexCountPerFace;
-	Vector<size_t> vertexCountPerFace;
-	Vector<nvrhi::BufferHandle> indexBuffers;
-	VertexBufferMap vertexBuffers;
-
-	auto& data = modelAsset->GetModelData();
-	for ( const auto& mesh : data.meshes )
-	{
-		int faceId = -1;
-		for ( const auto& face : mesh.faces )
-		{
-			faceId++;
-
-			if ( !CreateBuffersFromVertexData( uint32_t( faceId ), face.data, indexBuffers, vertexBuffers ) )
-			{
-				Console->Warning( format( "RenderFrontend: failed to build vertex buffers for model '%', mesh '%s', face %i. Part(s) of the model will not be visible!",
-					modelAsset->GetName().data(), mesh.name.data(), faceId ) );
-				continue;
-			}
-
-			indexCountPerFace.push_back( face.data.vertexIndices.size() );
-			vertexCountPerFace.push_back( face.data.vertexData[0].GetNumVertices() );
-		}
-	}
-
-	if ( indexBuffers.empty() || vertexBuffers.empty() || vertexCountPerFace.empty() || indexCountPerFace.empty() )
-	{
-		Console->Error( format( "RenderFrontend: could not upload any model data to the GPU for model '%s'", modelAsset->GetName().data() ) );
-		return nullptr;
-	}
-
-	return new Model( modelAsset,
-		std::move( indexBuffers ), std::move( vertexBuffers ),
-		std::move( indexCountPerFace ), std::move( vertexCountPerFace ) );
-}
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "RenderFrontend.hpp"
+#include <nvrhi/common/misc.h>
+
+bool RenderFrontend::ValidateModelAsset( const Assets::IModel* modelAsset, Vector<String>& outErrors ) const
+{
+	const auto& data = modelAsset->GetModelData();
+	const StringView name = modelAsset->GetName();
+
+	if ( data.meshes.empty() )
+	{
+		outErrors.push_back( format( "RenderFrontend: model '%s' has no meshes",
+			name.data() ) );
+		return false;
+	}
+
+	bool modelInvalid = false;
+
+	for ( const auto& mesh : data.meshes )
+	{
+		if ( mesh.faces.empty() )
+		{
+			outErrors.push_back( format( "RenderFrontend: model '%s', mesh '%s' has no faces",
+				name.data(), mesh.name.data() ) );
+			modelInvalid = true;
+			continue;
+		}
+
+		int faceId = -1;
+		for ( const auto& face : mesh.faces )
+		{
+			faceId++;
+
+			if ( face.data.vertexIndices.empty() || face.data.vertexData.empty() )
+			{
+				outErrors.push_back( format( "RenderFrontend: model '%s', mesh '%s' has face with no data",
+					name.data(), mesh.name.data() ) );
+				modelInvalid = true;
+				continue;
+			}
+
+			if ( face.data.vertexIndices.size() % 3 )
+			{
+				outErrors.push_back( format( "RenderFrontend: model '%s', mesh '%s' has face with isolated vertices or edges (vertex indices should be a multiple of 3)",
+					name.data(), mesh.name.data() ) );
+				modelInvalid = true;
+				continue;
+			}
+
+			// Same checks as cache files get, on the asset's data as it is
+			if ( const char* problem = PreparedFace::FromSource( face.data ).Validate() )
+			{
+				outErrors.push_back( format( "RenderFrontend: model '%s', mesh '%s', face %i is invalid: %s",
+					name.data(), mesh.name.data(), faceId, problem ) );
+				modelInvalid = true;
+				continue;
+			}
+		}
+	}
+
+	return !modelInvalid;
+}
+
+nvrhi::BufferHandle RenderFrontend::CreateIndexBuffer( Vector<uint32_t> indices, MemoryTracker::OwnerId memoryOwner )
+{
+	nvrhi::BufferHandle indexBuffer;
+
+	auto desc = nvrhi::BufferDesc()
+		.setByteSize( indices.size() * sizeof( uint32_t ) )
+		//.setFormat( nvrhi::Format::R32_UINT )
+		.setIsIndexBuffer( true )
+		.setInitialState( nvrhi::ResourceStates::CopyDest );
+
+	indexBuffer = backend->createBuffer( desc );
+	if ( nullptr == indexBuffer )
+	{
+		return nullptr;
+	}
+
+	commandStats.Record( RenderCommand::CreateBuffer, desc.byteSize );
+	transferCommands->open();
+	transferCommands->beginTrackingBufferState( indexBuffer, nvrhi::ResourceStates::CopyDest );
+	transferCommands->writeBuffer( indexBuffer, indices.data(), indices.size() * sizeof( uint32_t ) );
+	commandStats.Record( RenderCommand::WriteBuffer, indices.size() * sizeof( uint32_t ) );
+	transferCommands->setPermanentBufferState( indexBuffer, nvrhi::ResourceStates::IndexBuffer );
+	transferCommands->close();
+
+	backend->executeCommandList( transferCommands, nvrhi::CommandQueue::Graphics );
+	commandStats.Record( RenderCommand::ExecuteCommandList );
+	memoryTracker.Allocate( memoryOwner, desc.byteSize );
+	
+	// TODO: Figure out **when** to populate the buffers
+	// Should we:
+	// 1) Open a commandlist here, record everything that's needed and execute immediately?
+	// 2) Open a commandlist here, record, execute later?
+	// 3) Submit some sorta request into a queue, to do #1 sometime later?
+	// Right now, we're doing #1 because it's the most naive & simple one
+	return indexBuffer;
+}
+
+static const char* VertexSegmentToString( Assets::RenderData::VertexAttributeType segmentType )
+{
+	using Assets::RenderData::VertexAttributeType;
+
+	switch ( segmentType )
+	{
+	case VertexAttributeType::Position: return "Position";
+	case VertexAttributeType::Normal: return "Normal";
+	case VertexAttributeType::TangentAndBitangent: return "TangentAndBitangent";
+	case VertexAttributeType::Uv1: return "Uv1";
+	case VertexAttributeType::Uv2: return "Uv2";
+	case VertexAttributeType::Uv3: return "Uv3";
+	case VertexAttributeType::Uv4: return "Uv4";
+	case VertexAttributeType::Colour1: return "Colour1";
+	case VertexAttributeType::Colour2: return "Colour2";
+	case VertexAttributeType::Colour3: return "Colour3";
+	case VertexAttributeType::Colour4: return "Colour4";
+	case VertexAttributeType::BoneWeights: return "BoneWeights";
+	case VertexAttributeType::BoneIndices: return "BoneIndices";
+	}
+
+	return "UNKNOWN";
+}
+
+nvrhi::BufferHandle RenderFrontend::CreateVertexBuffer( const Vector<float>& rawVertexData, MemoryTracker::OwnerId memoryOwner )
+{
+	auto desc = nvrhi::BufferDesc()
+		.setByteSize( rawVertexData.size() * sizeof( float ) )
+		.setIsVertexBuffer( true )
+		.setInitialState( nvrhi::ResourceStates::CopyDest );
+
+	nvrhi::BufferHandle vertexBuffer = backend->createBuffer( desc );
+	if ( nullptr == vertexBuffer )
+	{
+		return nullptr;
+	}
+
+	commandStats.Record( RenderCommand::CreateBuffer, desc.byteSize );
+	transferCommands->open();
+	transferCommands->beginTrackingBufferState( vertexBuffer, nvrhi::ResourceStates::CopyDest );
+	transferCommands->writeBuffer( vertexBuffer, rawVertexData.data(), desc.byteSize );
+	commandStats.Record( RenderCommand::WriteBuffer, desc.byteSize );
+	transferCommands->setPermanentBufferState( vertexBuffer, nvrhi::ResourceStates::VertexBuffer );
+	transferCommands->close();
+
+	backend->executeCommandList( transferCommands, nvrhi::CommandQueue::Graphics );
+	commandStats.Record( RenderCommand::ExecuteCommandList );
+	memoryTracker.Allocate( memoryOwner, desc.byteSize );
+
+	return vertexBuffer;
+}
+
+nvrhi::BufferHandle RenderFrontend::CreateVertexBuffer( const Vector<uint8_t>& rawVertexData, MemoryTracker::OwnerId memoryOwner )
+{
+	auto desc = nvrhi::BufferDesc()
+		.setByteSize( nvrhi::align( rawVertexData.size(), 4ULL ) )
+		.setIsVertexBuffer( true )
+		.setInitialState( nvrhi::ResourceStates::CopyDest );
+
+	nvrhi::BufferHandle vertexBuffer = backend->createBuffer( desc );
+	if ( nullptr == vertexBuffer )
+	{
+		return nullptr;
+	}
+
+	commandStats.Record( RenderCommand::CreateBuffer, desc.byteSize );
+	transferCommands->open();
+	transferCommands->beginTrackingBufferState( vertexBuffer, nvrhi::ResourceStates::CopyDest );
+	transferCommands->writeBuffer( vertexBuffer, rawVertexData.data(), rawVertexData.size() );
+	commandStats.Record( RenderCommand::WriteBuffer, rawVertexData.size() );
+	transferCommands->setPermanentBufferState( vertexBuffer, nvrhi::ResourceStates::VertexBuffer );
+	transferCommands->close();
+
+	backend->executeCommandList( transferCommands, nvrhi::CommandQueue::Graphics );
+	commandStats.Record( RenderCommand::ExecuteCommandList );
+	memoryTracker.Allocate( memoryOwner, desc.byteSize );
+
+	return vertexBuffer;
+}
+
+nvrhi::BufferHandle RenderFrontend::CreateModelBuffer( nvrhi::BufferDesc desc, const uint8_t* data, size_t dataSize,
+	nvrhi::ResourceStates finalState, MemoryTracker::OwnerId memoryOwner )
+{
+	// Modern GAPIs do not like data that isn't aligned to 4 bytes
+	desc.setByteSize( nvrhi::align( dataSize, size_t( 4U ) ) )
+		.setInitialState( nvrhi::ResourceStates::CopyDest );
+
+	nvrhi::BufferHandle buffer = backend->createBuffer( desc );
+	if ( nullptr == buffer )
+	{
+		return nullptr;
+	}
+
+	commandStats.Record( RenderCommand::CreateBuffer, desc.byteSize );
+	transferCommands->beginTrackingBufferState( buffer, nvrhi::ResourceStates::CopyDest );
+	transferCommands->writeBuffer( buffer, data, dataSize );
+	commandStats.Record( RenderCommand::WriteBuffer, dataSize );
+	transferCommands->setPermanentBufferState( buffer, finalState );
+	memoryTracker.Allocate( memoryOwner, desc.byteSize );
+
+	return buffer;
+}
+
+Bounds RenderFrontend::CalculateFaceBounds( const Assets::RenderData::VertexData& data ) const
+{
+	Bounds bounds;
+	for ( const auto& segment : data.vertexData )
+	{
+		if ( segment.type != Assets::RenderData::VertexAttributeType::Position )
+		{
+			continue;
+		}
+
+		// Positions are tightly packed float triplets, see entityVertexLayout
+		const float* positions = reinterpret_cast<const float*>( segment.rawData.data() );
+		const size_t numVertices = segment.rawData.size() / sizeof( Vec3 );
+		for ( size_t i = 0U; i < numVertices; i++ )
+		{
+			bounds.Add( Vec3( positions[i * 3U], positions[i * 3U + 1U], positions[i * 3U + 2U] ) );
+		}
+	}
+
+	return bounds;
+}
+
+void RenderFrontend::PrepareModel( const Assets::IModel* modelAsset, PreparedModel& outModel ) const
+{
+	const auto& data = modelAsset->GetModelData();
+
+	size_t numFaces = 0U;
+	for ( const auto& mesh : data.meshes )
+	{
+		numFaces += mesh.faces.size();
+	}
+
+	// Storage is reserved so the faces' pointers into it stay put
+	outModel.faces.reserve( numFaces );
+	outModel.storage.reserve( numFaces );
+
+	// Faces are numbered across meshes, the same way skinning and batching go through them
+	for ( const auto& mesh : data.meshes )
+	{
+		for ( const auto& face : mesh.faces )
+		{
+			const auto& indices = face.data.vertexIndices;
+
+			PreparedFace& prepared = outModel.faces.emplace_back();
+			prepared.numIndices = uint32_t( indices.size() );
+			prepared.numVertices = uint32_t( face.data.vertexData[0].GetNumVertices() );
+			prepared.bounds = CalculateFaceBounds( face.data );
+			outModel.bounds.Add( prepared.bounds );
+
+			// Most faces are small enough for 16-bit indices, which halves their index buffers
+			// 0xFFFF is left out, some APIs treat it as a primitive restart
+			const uint32_t maxIndex = *std::max_element( indices.begin(), indices.end() );
+			if ( maxIndex < 0xFFFFU )
+			{
+				Vector<uint8_t>& shortIndices = outModel.storage.emplace_back( nvrhi::align( indices.size() * sizeof( uint16_t ), size_t( 4U ) ) );
+				uint16_t* destination = reinterpret_cast<uint16_t*>( shortIndices.data() );
+				for ( size_t i = 0U; i < indices.size(); i++ )
+				{
+					destination[i] = uint16_t( indices[i] );
+				}
+
+				prepared.indexFormat = nvrhi::Format::R16_UINT;
+				prepared.indexData = shortIndices.data();
+				prepared.indexDataSize = shortIndices.size();
+			}
+			else
+			{
+				prepared.indexFormat = nvrhi::Format::R32_UINT;
+				prepared.indexData = reinterpret_cast<const uint8_t*>( indices.data() );
+				prepared.indexDataSize = indices.size() * sizeof( uint32_t );
+			}
+
+			for ( const auto& segment : face.data.vertexData )
+			{
+				prepared.streams.push_back( { segment.type, segment.rawData.data(), segment.rawData.size() } );
+			}
+		}
+	}
+}
+
+void RenderFrontend::LoadModel( ModelLoadJob& job ) const
+{
+	// Cached models were prepared when they were written, and their faces are checked on load like assets are
+	if ( modelCache.Load( job.hash, job.prepared ) )
+	{
+		job.valid = true;
+		job.cacheHit = true;
+		return;
+	}
+
+	job.valid = ValidateModelAsset( job.asset, job.errors );
+	if ( !job.valid )
+	{
+		return;
+	}
+
+	PrepareModel( job.asset, job.prepared );
+	job.cacheWritten = modelCache.Write( job.hash, job.prepared );
+}
+
+Model* RenderFrontend::RecordModelUpload( const Assets::IModel* modelAsset, const PreparedModel& prepared )
+{
+	const size_t numFaces = prepared.faces.size();
+	Vector<size_t> indexCountPerFace( numFaces );
+	Vector<size_t> vertexCountPerFace( numFaces );
+	Vector<nvrhi::Format> indexFormatPerFace( numFaces );
+	Vector<nvrhi::BufferHandle> indexBuffers( numFaces );
+	VertexBufferMap vertexBuffers;
+	size_t numFacesUploaded = 0U;
+
+	const MemoryTracker::OwnerId memoryOwner = memoryTracker.CreateOwner( MemoryCategory::Geometry,
+		format( "model '%s'", modelAsset->GetName().data() ) );
+
+	for ( uint32_t face = 0U; face < numFaces; face++ )
+	{
+		const PreparedFace& preparedFace = prepared.faces[face];
+		indexCountPerFace[face] = preparedFace.numIndices;
+		vertexCountPerFace[face] = preparedFace.numVertices;
+		indexFormatPerFace[face] = preparedFace.indexFormat;
+
+		// The render backend will report errors in this situation
+		nvrhi::BufferHandle indexBuffer = CreateModelBuffer( nvrhi::BufferDesc().setIsIndexBuffer( true ),
+			preparedFace.indexData, preparedFace.indexDataSize, nvrhi::ResourceStates::IndexBuffer, memoryOwner );
+		if ( nullptr == indexBuffer )
+		{
+			Console->Warning( format( "RenderFrontend: failed to create index buffer for model '%s', face %u. Part(s) of the model will not be visible!",
+				modelAsset->GetName().data(), face ) );
+			continue;
+		}
+
+		// Different vertex buffer segments, e.g. one buffer for positions, one for normals etc.
+		// Raw views are for skinning, which reads the model's streams in a compute shader
+		bool failedCreatingVertexBuffers = false;
+		for ( const auto& stream : preparedFace.streams )
+		{
+			nvrhi::BufferHandle vertexBuffer = CreateModelBuffer( nvrhi::BufferDesc().setIsVertexBuffer( true ).setCanHaveRawViews( true ),
+				stream.data, stream.size, nvrhi::ResourceStates::VertexBuffer | nvrhi::ResourceStates::ShaderResource, memoryOwner );
+			if ( nullptr == vertexBuffer )
+			{
+				Console->Warning( format( "RenderFrontend: failed to create vertex buffer for model '%s', face %u, segment '%s'. Part(s) of the model will not be visible!",
+					modelAsset->GetName().data(), face, VertexSegmentToString( stream.type ) ) );
+				failedCreatingVertexBuffers = true;
+				continue;
+			}
+
+			vertexBuffers[{ face, stream.type }] = vertexBuffer;
+		}
+
+		// Faces with missing streams keep their slot, so face numbers stay the same, but are never drawn
+		if ( !failedCreatingVertexBuffers )
+		{
+			indexBuffers[face] = std::move( indexBuffer );
+			numFacesUploaded++;
+		}
+	}
+
+	if ( 0U == numFacesUploaded )
+	{
+		// Buffers that were created are kept alive by the command list until it's executed
+		Console->Error( format( "RenderFrontend: could not upload any model data to the GPU for model '%s'", modelAsset->GetName().data() ) );
+		memoryTracker.ReleaseOwner( memoryOwner );
+		return nullptr;
+	}
+
+	Model* model = new Model( modelAsset,
+		std::move( indexBuffers ), std::move( vertexBuffers ),
+		std::move( indexCountPerFace ), std::move( vertexCountPerFace ), prepared.bounds,
+		std::move( indexFormatPerFace ) );
+	model->memoryOwner = memoryOwner;
+
+	return model;
+}
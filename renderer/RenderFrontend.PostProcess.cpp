@@ -0,0 +1,328 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "RenderFrontend.hpp"
+#include "Profiler.hpp"
+#include "Texture.hpp"
+
+constexpr nvrhi::Format BloomFormat = nvrhi::Format::RGBA16_FLOAT;
+
+bool RenderFrontend::CreatePostProcessResources()
+{
+	bloomDownsampleShader = CreateShader( nvrhi::ShaderType::Pixel, "bloom_downsample" );
+	bloomBlurShader = CreateShader( nvrhi::ShaderType::Pixel, "bloom_blur" );
+	if ( nullptr == bloomDownsampleShader || nullptr == bloomBlurShader )
+	{
+		return false;
+	}
+
+	postProcessMemory = memoryTracker.CreateOwner( MemoryCategory::ViewAttachments, "post-process targets" );
+
+	// Stands in for the bloom target when bloom is off, so the final pass has the same bindings either way
+	auto blackTextureDesc = nvrhi::TextureDesc()
+		.setWidth( 1U )
+		.setHeight( 1U )
+		.setFormat( BloomFormat )
+		.setDimension( nvrhi::TextureDimension::Texture2D )
+		.setIsRenderTarget( true )
+		.setInitialState( nvrhi::ResourceStates::ShaderResource )
+		.setKeepInitialState( true )
+		.setDebugName( "Post-process black texture" );
+
+	postBlackTexture = backend->createTexture( blackTextureDesc );
+	if ( nullptr == postBlackTexture )
+	{
+		Console->Error( "RenderFrontend: Failed to create the post-process black texture" );
+		return false;
+	}
+
+	commandStats.Record( RenderCommand::CreateTexture );
+	memoryTracker.Allocate( postProcessMemory, GetMipByteSize( BloomFormat, 1U, 1U, 0U ) );
+
+	transferCommands->open();
+	transferCommands->clearTextureFloat( postBlackTexture, nvrhi::AllSubresources, nvrhi::Color( 0.0f ) );
+	commandStats.Record( RenderCommand::ClearTexture );
+	transferCommands->close();
+	backend->executeCommandList( transferCommands );
+	commandStats.Record( RenderCommand::ExecuteCommandList );
+
+	auto blackSetDesc = nvrhi::BindingSetDesc()
+		.addItem( nvrhi::BindingSetItem::Texture_SRV( 2, postBlackTexture ) );
+	postBlackBindingSet = backend->createBindingSet( blackSetDesc, postBindingLayout );
+	if ( nullptr == postBlackBindingSet )
+	{
+		Console->Error( "RenderFrontend: Failed to create the post-process binding set" );
+		return false;
+	}
+
+	return true;
+}
+
+void RenderFrontend::DestroyPostProcessResources()
+{
+	DestroyBloomTargets();
+	postBlackBindingSet = nullptr;
+	postBlackTexture = nullptr;
+	bloomDownsamplePipeline = nullptr;
+	bloomBlurPipeline = nullptr;
+	memoryTracker.ReleaseOwner( postProcessMemory );
+	postProcessMemory = MemoryTracker::InvalidOwner;
+}
+
+void RenderFrontend::DestroyBloomTargets()
+{
+	for ( uint32_t i = 0U; i < 2U; i++ )
+	{
+		bloomSourceBindingSets[i] = nullptr;
+		bloomFramebuffers[i] = nullptr;
+		bloomTextures[i] = nullptr;
+	}
+	bloomBindingSet = nullptr;
+
+	if ( 0U != bloomWidth )
+	{
+		memoryTracker.Free( postProcessMemory, GetMipByteSize( BloomFormat, bloomWidth, bloomHeight, 0U ) * 2U );
+	}
+	bloomWidth = 0U;
+	bloomHeight = 0U;
+}
+
+// The old targets are kept alive by the command lists that still use them
+bool RenderFrontend::CreateBloomTargets( uint32_t width, uint32_t height )
+{
+	DestroyBloomTargets();
+
+	auto textureDesc = nvrhi::TextureDesc()
+		.setWidth( width )
+		.setHeight( height )
+		.setFormat( BloomFormat )
+		.setDimension( nvrhi::TextureDimension::Texture2D )
+		.setIsRenderTarget( true )
+		.setInitialState( nvrhi::ResourceStates::ShaderResource )
+		.setKeepInitialState( true )
+		.setDebugName( "Bloom target" );
+
+	for ( uint32_t i = 0U; i < 2U; i++ )
+	{
+		bloomTextures[i] = backend->createTexture( textureDesc );
+		if ( nullptr == bloomTextures[i] )
+		{
+			Console->Error( format( "RenderFrontend: Failed to create %ux%u bloom targets", width, height ) );
+			DestroyBloomTargets();
+			return false;
+		}
+
+		commandStats.Record( RenderCommand::CreateTexture );
+		bloomFramebuffers[i] = backend->createFramebuffer( nvrhi::FramebufferDesc().addColorAttachment( bloomTextures[i] ) );
+		// Blur passes don't read depth, so the target goes into that slot too
+		bloomSourceBindingSets[i] = CreateBindingSetForView( bloomTextures[i], bloomTextures[i] );
+		if ( nullptr == bloomFramebuffers[i] || nullptr == bloomSourceBindingSets[i] )
+		{
+			Console->Error( "RenderFrontend: Failed to create bloom framebuffers" );
+			DestroyBloomTargets();
+			return false;
+		}
+	}
+
+	bloomWidth = width;
+	bloomHeight = height;
+	memoryTracker.Allocate( postProcessMemory, GetMipByteSize( BloomFormat, width, height, 0U ) * 2U );
+
+	// Every blur pass ends in the first target
+	auto bloomSetDesc = nvrhi::BindingSetDesc()
+		.addItem( nvrhi::BindingSetItem::Texture_SRV( 2, bloomTextures[0] ) );
+	bloomBindingSet = backend->createBindingSet( bloomSetDesc, postBindingLayout );
+	if ( nullptr == bloomBindingSet )
+	{
+		Console->Error( "RenderFrontend: Failed to create the bloom binding set" );
+		DestroyBloomTargets();
+		return false;
+	}
+
+	// Made along with the first targets, since pipelines need a framebuffer of the right format
+	if ( nullptr != bloomDownsamplePipeline )
+	{
+		return true;
+	}
+
+	auto renderState = nvrhi::RenderState()
+		.setRasterState( nvrhi::RasterState().setCullNone().setFillSolid() )
+		.setDepthStencilState( nvrhi::DepthStencilState().disableDepthTest().disableDepthWrite().disableStencil() );
+
+	auto pipelineDesc = nvrhi::GraphicsPipelineDesc()
+		.setVertexShader( screenVertexShader )
+		.setPixelShader( bloomDownsampleShader )
+		.setRenderState( renderState )
+		.addBindingLayout( screenBindingLayout );
+
+	bloomDownsamplePipeline = backend->createGraphicsPipeline( pipelineDesc, bloomFramebuffers[0] );
+	bloomBlurPipeline = backend->createGraphicsPipeline( pipelineDesc.setPixelShader( bloomBlurShader ), bloomFramebuffers[0] );
+	if ( nullptr == bloomDownsamplePipeline || nullptr == bloomBlurPipeline )
+	{
+		Console->Error( "RenderFrontend: Failed to create bloom pipelines" );
+		bloomDownsamplePipeline = nullptr;
+		bloomBlurPipeline = nullptr;
+		return false;
+	}
+
+	return true;
+}
+
+RenderFrontend::ScreenConstants RenderFrontend::GetScreenConstants( const View* view ) const
+{
+	// Only the rendered part of the view is upscaled onto the screen
+	const Vec2 attachmentSize = view->GetAttachmentSize();
+	const Vec2 renderSize = view->GetRenderSize();
+
+	ScreenConstants constants{};
+	constants.uvScale = Vec2( renderSize.x / attachmentSize.x, renderSize.y / attachmentSize.y );
+	constants.texelSize = Vec2( 1.0f / attachmentSize.x, 1.0f / attachmentSize.y );
+	constants.colourFilter = Vec4( postSettings.colourFilter.x, postSettings.colourFilter.y, postSettings.colourFilter.z, postSettings.exposure );
+	constants.contrast = postSettings.contrast;
+	constants.saturation = postSettings.saturation;
+	constants.sharpness = postSettings.sharpness;
+	constants.bloomIntensity = postSettings.bloomIntensity;
+	constants.bloomThreshold = postSettings.bloomThreshold;
+	constants.padding = 0U;
+	constants.blurDirection = Vec2( 0.0f, 0.0f );
+
+	return constants;
+}
+
+ShaderFeatureMask RenderFrontend::GetScreenFeatures() const
+{
+	ShaderFeatureMask features = 0U;
+	features |= ShaderFeatureMask( postSettings.tonemapper ) << ScreenFeatures::TonemapperShift;
+	features |= postSettings.colourGrading ? ScreenFeatures::Grading : 0U;
+	features |= postSettings.sharpness > 0.0f ? ScreenFeatures::Sharpen : 0U;
+	features |= postSettings.bloom ? ScreenFeatures::Bloom : 0U;
+	return features;
+}
+
+void RenderFrontend::DrawScreenPass( const nvrhi::GraphicsState& state, const ScreenConstants& constants )
+{
+	if ( stateTracker.Set( renderCommands, state ) )
+	{
+		commandStats.Record( RenderCommand::SetGraphicsState );
+	}
+	renderCommands->setPushConstants( &constants, sizeof( constants ) );
+
+	// A single triangle, see screen.hlsl
+	const auto drawArguments = nvrhi::DrawArguments().setVertexCount( 3U );
+	renderCommands->draw( drawArguments );
+	commandStats.Record( RenderCommand::Draw, drawArguments.vertexCount );
+}
+
+// Bright parts go into a target at a fraction of the screen's size,
+// which is then blurred by ping-ponging between it and a second target
+bool RenderFrontend::RenderBloom( const View* view, const ScreenConstants& viewConstants )
+{
+	const Vec2 screenSize = GetScreenSize();
+	const uint32_t downscale = std::max( postSettings.bloomDownscale, 1U );
+	const uint32_t width = std::max( uint32_t( screenSize.x ) / downscale, 1U );
+	const uint32_t height = std::max( uint32_t( screenSize.y ) / downscale, 1U );
+	if ( width != bloomWidth || height != bloomHeight )
+	{
+		// Tried already, wait for the settings or the window size to change
+		if ( width == bloomFailedWidth && height == bloomFailedHeight )
+		{
+			return false;
+		}
+
+		if ( !CreateBloomTargets( width, height ) )
+		{
+			bloomFailedWidth = width;
+			bloomFailedHeight = height;
+			return false;
+		}
+	}
+
+	nvrhi::Viewport viewport = { float( width ), float( height ) };
+
+	gpuProfiler.BeginPass( renderCommands, "Bloom downsample" );
+	{
+		auto graphicsState = nvrhi::GraphicsState()
+			.addBindingSet( view->GetBindingSet() )
+			.setFramebuffer( bloomFramebuffers[0] )
+			.setPipeline( bloomDownsamplePipeline );
+		graphicsState.viewport.addViewportAndScissorRect( viewport );
+
+		DrawScreenPass( graphicsState, viewConstants );
+	}
+	gpuProfiler.EndPass( renderCommands );
+
+	ScreenConstants blurConstants = viewConstants;
+	blurConstants.uvScale = Vec2( 1.0f, 1.0f );
+	blurConstants.texelSize = Vec2( 1.0f / float( width ), 1.0f / float( height ) );
+
+	gpuProfiler.BeginPass( renderCommands, "Bloom blur" );
+	for ( uint32_t pass = 0U; pass < postSettings.bloomBlurPasses * 2U; pass++ )
+	{
+		// Horizontal from the first target into the second, vertical back
+		const uint32_t source = pass & 1U;
+		blurConstants.blurDirection = 0U == source ? Vec2( 1.0f, 0.0f ) : Vec2( 0.0f, 1.0f );
+
+		auto graphicsState = nvrhi::GraphicsState()
+			.addBindingSet( bloomSourceBindingSets[source] )
+			.setFramebuffer( bloomFramebuffers[1U - source] )
+			.setPipeline( bloomBlurPipeline );
+		graphicsState.viewport.addViewportAndScissorRect( viewport );
+
+		DrawScreenPass( graphicsState, blurConstants );
+	}
+	gpuProfiler.EndPass( renderCommands );
+
+	return true;
+}
+
+// Everything that works on single pixels is fused into the pass that puts the view on the screen
+void RenderFrontend::RenderPostProcess( const View* view )
+{
+	const ScreenConstants constants = GetScreenConstants( view );
+	ShaderFeatureMask features = GetScreenFeatures();
+	if ( (features & ScreenFeatures::Bloom) && !RenderBloom( view, constants ) )
+	{
+		features &= ~ScreenFeatures::Bloom;
+	}
+
+	nvrhi::IGraphicsPipeline* pipeline = GetScreenPipeline( features );
+	if ( nullptr == pipeline )
+	{
+		// Settings the shader archive doesn't have, plain upscaling still works
+		pipeline = GetScreenPipeline( 0U );
+		features = 0U;
+	}
+
+	const bool bloom = 0U != (features & ScreenFeatures::Bloom);
+	const Vec2 screenSize = GetScreenSize();
+	const nvrhi::Viewport windowViewport = { screenSize.x, screenSize.y };
+	auto graphicsState = nvrhi::GraphicsState()
+		.addBindingSet( view->GetBindingSet() )
+		.addBindingSet( bloom ? bloomBindingSet : postBlackBindingSet )
+		.setFramebuffer( GetScreenFramebuffer() )
+		.setPipeline( pipeline );
+	graphicsState.viewport.addViewportAndScissorRect( windowViewport );
+
+	gpuProfiler.BeginPass( renderCommands, "Post-process" );
+	DrawScreenPass( graphicsState, constants );
+	gpuProfiler.EndPass( renderCommands );
+}
+
+void RenderFrontend::SetPostProcessSettings( const PostProcessSettings& settings )
+{
+	postSettings = settings;
+	bloomFailedWidth = 0U;
+	bloomFailedHeight = 0U;
+
+	// Let the targets be recreated at the new size, or not at all
+	if ( !settings.bloom && nullptr != bloomTextures[0] )
+	{
+		DestroyBloomTargets();
+	}
+}
+
+const PostProcessSettings& RenderFrontend::GetPostProcessSettings() const
+{
+	return postSettings;
+}
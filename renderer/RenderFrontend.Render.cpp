@@ -1,53 +1,273 @@
-// SPDX-FileCopyrightText: 2022 Admer Šuko
-// SPDX-License-Identifier: MIT
-
-#include "Precompiled.hpp"
-#include "RenderFrontend.hpp"
-
-bool RenderFrontend::IsEntityVisible( const IView* view, const IEntity* entity )
-{
-	// We could do all kinds of things here, like frustum culling
-	return true;
-}
-
-void RenderFrontend::RenderEntity( const IView* view, const IEntity* entity )
-{
-	using VA = Assets::RenderData::VertexAttributeType;
-
-	const nvrhi::Viewport viewport = { view->GetDesc().viewportSize.x, view->GetDesc().viewportSize.y };
-	auto graphicsState = nvrhi::GraphicsState()
-		.addBindingSet( viewFrameBindingSet )
-		.addBindingSet( entityBindingSet )
-		.setFramebuffer( view->GetFramebuffer() )
-		.setPipeline( entityPipeline );
-	graphicsState.viewport.addViewportAndScissorRect( viewport );
-
-	const EntityDesc& desc = entity->GetDesc();
-
-	currentEntityData.modelMatrix = desc.transform;
-	currentEntityData.shaderParametersA = desc.shaderParameters[0];
-	currentEntityData.shaderParametersB = desc.shaderParameters[1];
-
-	renderCommands->writeBuffer( entityDataBuffer, &currentEntityData, sizeof( currentEntityData ) );
-
-	const IModel* model = entity->GetDesc().model;
-	for ( size_t face = 0; face < model->GetNumFaces(); face++ )
-	{
-		// TODO: Once there's a material system in place, we need to
-		// determine which vertex buffers are used, based on the current
-		// material's requirements
-		graphicsState.vertexBuffers =
-		{
-			{ model->GetVertexBuffer( face, VA::Position ), 0U, 0U },
-			{ model->GetVertexBuffer( face, VA::Normal ),	1U, 0U },
-			{ model->GetVertexBuffer( face, VA::Uv1 ),		2U, 0U },
-			{ model->GetVertexBuffer( face, VA::Colour1 ),	3U, 0U }
-		};
-		graphicsState.indexBuffer = { model->GetIndexBuffer( face ), nvrhi::Format::R32_UINT, 0U };
-
-		const auto drawArguments = nvrhi::DrawArguments().setVertexCount( model->GetNumIndices( face ) );
-
-		renderCommands->setGraphicsState( graphicsState );
-		renderCommands->drawIndexed( drawArguments );
-	}
-}
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "RenderFrontend.hpp"
+#include "Batch.hpp"
+#include "Entity.hpp"
+#include "Profiler.hpp"
+#include "View.hpp"
+
+// Refits the entity tree for every entity that was touched since the last update
+void RenderFrontend::UpdateEntityTree()
+{
+	PROFILE_SCOPE( "UpdateEntityTree" );
+
+	if ( !changedEntities.empty() )
+	{
+		changeSerial++;
+	}
+
+	for ( Entity* entity : changedEntities )
+	{
+		entity->changeSerial = changeSerial;
+		QueueEntityUpload( entity->dataSlot, static_cast<const Entity*>( entity )->GetDesc() );
+		UpdateEntitySkin( entity );
+		entityTree.Move( entity->treeProxy, entity->UpdateWorldBounds() );
+		if ( !volumes.empty() )
+		{
+			AssignEntityToVolumes( entity );
+		}
+		entity->ClearChanged();
+	}
+
+	changedEntities.clear();
+}
+
+RenderFrontend::ViewUpdate RenderFrontend::GetViewUpdate( const View* view ) const
+{
+	// The old image can't be reused at all
+	if ( !view->hasImage || view->updateRequested || view->resolutionScale != view->renderedScale )
+	{
+		return ViewUpdate::Render;
+	}
+
+	switch ( view->updatePolicy )
+	{
+	case ViewUpdatePolicy::EveryFrame:
+		return ViewUpdate::Render;
+
+	case ViewUpdatePolicy::Interval:
+		return frameIndex - view->renderedFrame >= view->updateInterval ? ViewUpdate::Render : ViewUpdate::Skip;
+
+	case ViewUpdatePolicy::OnDemand:
+		return ViewUpdate::Skip;
+
+	case ViewUpdatePolicy::OnChange:
+		if ( view->IsTransformChanged() || batchChangeSerial > view->renderedChangeSerial )
+		{
+			return ViewUpdate::Render;
+		}
+		return ViewUpdate::CheckChanges;
+	}
+
+	return ViewUpdate::Render;
+}
+
+static uint64_t MixHash( uint64_t value )
+{
+	value ^= value >> 33U;
+	value *= 0xff51afd7ed558ccdULL;
+	value ^= value >> 33U;
+	value *= 0xc4ceb9fe1a85ec53ULL;
+	value ^= value >> 33U;
+	return value;
+}
+
+// Hashes are sums, so they don't depend on the order the entity tree returns entities in
+// A view's set changed if an entity entered or left it, or if any of its entities was modified
+// Edits to the view's desc, materials and texture images are folded in too, as they change the image
+void RenderFrontend::HashVisibleSets( const View* const* viewList, uint32_t numViews, uint64_t* outHashes, uint64_t& outChangedMask ) const
+{
+	for ( uint32_t i = 0U; i < numViews; i++ )
+	{
+		outHashes[i] += MixHash( shadingChangeSerial ) + MixHash( viewList[i]->GetDescSerial() );
+	}
+
+	for ( const VisibleEntity& visible : visibleEntities )
+	{
+		const Entity* entity = static_cast<const Entity*>( visible.entity );
+		const uint64_t entityHash = MixHash( uint64_t( uintptr_t( entity ) ) );
+
+		for ( uint32_t i = 0U; i < numViews; i++ )
+		{
+			const uint64_t bit = 1ULL << i;
+			if ( 0U == (visible.frustumMask & bit) )
+			{
+				continue;
+			}
+
+			outHashes[i] += entityHash;
+			if ( entity->changeSerial > viewList[i]->renderedChangeSerial )
+			{
+				outChangedMask |= bit;
+			}
+		}
+	}
+}
+
+bool RenderFrontend::IsEntityVisible( const IView* view, const IEntity* entity )
+{
+	const Frustum frustum = static_cast<const View*>( view )->GetFrustum();
+	return frustum.Test( static_cast<const Entity*>( entity )->GetWorldBounds() ) != FrustumTestResult::Outside;
+}
+
+void RenderFrontend::RenderEntity( const IView* view, const IEntity* entity )
+{
+	const Vec2 renderSize = static_cast<const View*>( view )->GetRenderSize();
+	const nvrhi::Viewport viewport = { renderSize.x, renderSize.y };
+	auto graphicsState = nvrhi::GraphicsState()
+		.addBindingSet( viewFrameBindingSet )
+		.addBindingSet( entityBindingSet )
+		.addBindingSet( materialBindingSet )
+		.addBindingSet( GetMaterialTextureSet( DefaultMaterialSlot ) )
+		.setFramebuffer( view->GetFramebuffer() );
+	graphicsState.viewport.addViewportAndScissorRect( viewport );
+
+	// The entity's data is already on the GPU, see FlushEntityUploads
+	const uint32_t entitySlot = static_cast<const Entity*>( entity )->dataSlot;
+	for ( const FaceDrawRecord& record : static_cast<const Entity*>( entity )->GetDrawRecords() )
+	{
+		if ( !record.complete )
+		{
+			continue;
+		}
+
+		// The only material feature, bindless, is the same for every draw and is baked into
+		// all entity pipelines, see CreateMainGraphicsPipelines. So only the face's own features pick one
+		graphicsState.pipeline = entityPipelines[record.features];
+		graphicsState.vertexBuffers =
+		{
+			{ record.vertexBuffers[0], 0U, record.vertexOffsets[0] },
+			{ record.vertexBuffers[1], 1U, record.vertexOffsets[1] },
+			{ record.vertexBuffers[2], 2U, record.vertexOffsets[2] }
+		};
+		if ( record.features & EntityFeatures::VertexColours )
+		{
+			graphicsState.vertexBuffers.push_back( { record.vertexBuffers[3], 3U, record.vertexOffsets[3] } );
+		}
+		graphicsState.indexBuffer = { record.indexBuffer, record.indexFormat, record.indexOffset };
+		// With bindless this is the same table for every material, so it never changes
+		graphicsState.bindings[3] = GetMaterialTextureSet( record.material );
+
+		const auto drawArguments = nvrhi::DrawArguments().setVertexCount( record.numIndices );
+
+		if ( stateTracker.Set( renderCommands, graphicsState ) )
+		{
+			commandStats.Record( RenderCommand::SetGraphicsState );
+		}
+		SetEntityConstants( entitySlot, record.material );
+		renderCommands->drawIndexed( drawArguments );
+		commandStats.Record( RenderCommand::DrawIndexed, drawArguments.vertexCount );
+	}
+}
+
+// Batches are already in world space, so they're drawn with an identity transform
+// Visible chunks that are next to each other in the index buffer get merged into one draw
+void RenderFrontend::RenderBatch( const IView* view, const IBatch* batch )
+{
+	const Batch* batchInternal = static_cast<const Batch*>( batch );
+	const Frustum frustum = static_cast<const View*>( view )->GetFrustum();
+	if ( frustum.Test( batchInternal->GetBounds() ) == FrustumTestResult::Outside )
+	{
+		return;
+	}
+
+	const Vec2 renderSize = static_cast<const View*>( view )->GetRenderSize();
+	const nvrhi::Viewport viewport = { renderSize.x, renderSize.y };
+	auto graphicsState = nvrhi::GraphicsState()
+		.addBindingSet( viewFrameBindingSet )
+		.addBindingSet( entityBindingSet )
+		.addBindingSet( materialBindingSet )
+		.addBindingSet( GetMaterialTextureSet( DefaultMaterialSlot ) )
+		.setFramebuffer( view->GetFramebuffer() );
+	graphicsState.viewport.addViewportAndScissorRect( viewport );
+
+	for ( const BatchGroup& group : batchInternal->GetGroups() )
+	{
+		if ( frustum.Test( group.bounds ) == FrustumTestResult::Outside )
+		{
+			continue;
+		}
+
+		graphicsState.pipeline = entityPipelines[group.features];
+		graphicsState.vertexBuffers =
+		{
+			{ group.positionBuffer, 0U, 0U },
+			{ group.normalBuffer,	1U, 0U },
+			{ group.uvBuffer,		2U, 0U }
+		};
+		if ( group.features & EntityFeatures::VertexColours )
+		{
+			graphicsState.vertexBuffers.push_back( { group.colourBuffer, 3U, 0U } );
+		}
+		graphicsState.indexBuffer = { group.indexBuffer, nvrhi::Format::R32_UINT, 0U };
+		graphicsState.bindings[3] = GetMaterialTextureSet( group.material );
+		if ( stateTracker.Set( renderCommands, graphicsState ) )
+		{
+			commandStats.Record( RenderCommand::SetGraphicsState );
+		}
+
+		uint32_t runStart = 0U;
+		uint32_t runCount = 0U;
+		const auto flushRun = [&]()
+		{
+			if ( runCount > 0U )
+			{
+				SetEntityConstants( IdentityEntitySlot, group.material );
+				renderCommands->drawIndexed( nvrhi::DrawArguments()
+					.setVertexCount( runCount )
+					.setStartIndexLocation( runStart ) );
+				commandStats.Record( RenderCommand::DrawIndexed, runCount );
+			}
+			runCount = 0U;
+		};
+
+		for ( const BatchChunk& chunk : group.chunks )
+		{
+			if ( frustum.Test( chunk.bounds ) == FrustumTestResult::Outside )
+			{
+				flushRun();
+				continue;
+			}
+
+			if ( runCount == 0U )
+			{
+				runStart = chunk.firstIndex;
+			}
+			runCount += chunk.numIndices;
+		}
+		flushRun();
+	}
+}
+
+// Feeds the last frame's timings to the governor and applies its scale to views with dynamic resolution
+void RenderFrontend::UpdateDynamicResolution()
+{
+	const auto now = std::chrono::steady_clock::now();
+	if ( lastFrameStart != std::chrono::steady_clock::time_point() )
+	{
+		cpuFrameMilliseconds = std::chrono::duration<float, std::milli>( now - lastFrameStart ).count();
+	}
+	lastFrameStart = now;
+
+	if ( !gpuProfiler.IsSupported() )
+	{
+		resolutionGovernor.Update( 0.0f, cpuFrameMilliseconds );
+	}
+	// Each GPU frame is only taken into account once
+	else if ( gpuProfiler.GetLastFrameIndex() != governedGpuFrame )
+	{
+		governedGpuFrame = gpuProfiler.GetLastFrameIndex();
+		resolutionGovernor.Update( gpuProfiler.GetLastFrameTime(), cpuFrameMilliseconds );
+	}
+
+	for ( const auto& view : views )
+	{
+		View* viewInternal = static_cast<View*>( view.get() );
+		if ( viewInternal->dynamicResolution )
+		{
+			viewInternal->resolutionScale = resolutionGovernor.GetScale();
+		}
+	}
+}
@@ -0,0 +1,896 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "RenderFrontend.hpp"
+#include "Batch.hpp"
+#include "Entity.hpp"
+#include "Profiler.hpp"
+#include "Texture.hpp"
+#include "View.hpp"
+#include <cstring>
+
+namespace
+{
+	float Dot( const Vec3& a, const Vec3& b )
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	Vec3 Cross( const Vec3& a, const Vec3& b )
+	{
+		return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+	}
+
+	// a + b * scale
+	Vec3 MultiplyAdd( const Vec3& a, const Vec3& b, float scale )
+	{
+		return { a.x + b.x * scale, a.y + b.y * scale, a.z + b.z * scale };
+	}
+
+	float Distance( const Vec3& a, const Vec3& b )
+	{
+		const Vec3 delta = MultiplyAdd( a, b, -1.0f );
+		return std::sqrt( Dot( delta, delta ) );
+	}
+
+	Vec3 Normalise( const Vec3& v )
+	{
+		const float length = std::sqrt( Dot( v, v ) );
+		if ( length < 1.0e-6f )
+		{
+			return { 0.0f, 0.0f, -1.0f };
+		}
+
+		return { v.x / length, v.y / length, v.z / length };
+	}
+
+	// Z is up, unless the direction is nearly vertical
+	void MakeBasis( const Vec3& forward, Vec3& outRight, Vec3& outUp )
+	{
+		const Vec3 upHint = std::abs( forward.z ) > 0.99f ? Vec3{ 0.0f, 1.0f, 0.0f } : Vec3{ 0.0f, 0.0f, 1.0f };
+		outRight = Normalise( Cross( forward, upHint ) );
+		outUp = Cross( outRight, forward );
+	}
+
+	// Projection * view with a depth range of [0, 1], square aspect ratio
+	Mat4 MakePerspective( const Vec3& origin, const Vec3& forward, float fovDegrees, float nearZ, float farZ )
+	{
+		Vec3 r, u;
+		const Vec3 f = Normalise( forward );
+		MakeBasis( f, r, u );
+
+		const float s = 1.0f / std::tan( fovDegrees * 0.5f * 3.14159265f / 180.0f );
+		const float a = farZ / (farZ - nearZ);
+
+		// Rows of the matrix, written out as columns
+		return Mat4(
+			Vec4( s * r.x, s * u.x, a * f.x, f.x ),
+			Vec4( s * r.y, s * u.y, a * f.y, f.y ),
+			Vec4( s * r.z, s * u.z, a * f.z, f.z ),
+			Vec4( -s * Dot( r, origin ), -s * Dot( u, origin ), -a * (Dot( f, origin ) + nearZ), -Dot( f, origin ) ) );
+	}
+
+	// Box of 2 * halfExtent around the centre, depth goes from nearZ to farZ along the forward axis
+	Mat4 MakeOrthographic( const Vec3& centre, const Vec3& forward, float halfExtent, float nearZ, float farZ )
+	{
+		Vec3 r, u;
+		const Vec3 f = Normalise( forward );
+		MakeBasis( f, r, u );
+
+		const float s = 1.0f / halfExtent;
+		const float d = 1.0f / (farZ - nearZ);
+
+		return Mat4(
+			Vec4( s * r.x, s * u.x, d * f.x, 0.0f ),
+			Vec4( s * r.y, s * u.y, d * f.y, 0.0f ),
+			Vec4( s * r.z, s * u.z, d * f.z, 0.0f ),
+			Vec4( -s * Dot( r, centre ), -s * Dot( u, centre ), -d * (Dot( f, centre ) + nearZ), 1.0f ) );
+	}
+
+	// Reads the matrix back through multiplications, so this doesn't depend on its memory layout
+	void GetMatrixRows( const Mat4& matrix, float outRows[4][4] )
+	{
+		for ( uint32_t column = 0U; column < 4U; column++ )
+		{
+			const Vec4 basis = Vec4( column == 0U ? 1.0f : 0.0f, column == 1U ? 1.0f : 0.0f,
+				column == 2U ? 1.0f : 0.0f, column == 3U ? 1.0f : 0.0f );
+			const Vec4 result = matrix * basis;
+			outRows[0][column] = result.m.x;
+			outRows[1][column] = result.m.y;
+			outRows[2][column] = result.m.z;
+			outRows[3][column] = result.m.w;
+		}
+	}
+
+	// Gauss-Jordan elimination with partial pivoting
+	bool InvertMatrix( const float rows[4][4], float outRows[4][4] )
+	{
+		float m[4][8];
+		for ( uint32_t i = 0U; i < 4U; i++ )
+		{
+			for ( uint32_t j = 0U; j < 4U; j++ )
+			{
+				m[i][j] = rows[i][j];
+				m[i][j + 4U] = i == j ? 1.0f : 0.0f;
+			}
+		}
+
+		for ( uint32_t column = 0U; column < 4U; column++ )
+		{
+			uint32_t pivot = column;
+			for ( uint32_t i = column + 1U; i < 4U; i++ )
+			{
+				if ( std::abs( m[i][column] ) > std::abs( m[pivot][column] ) )
+				{
+					pivot = i;
+				}
+			}
+
+			if ( std::abs( m[pivot][column] ) < 1.0e-12f )
+			{
+				return false;
+			}
+
+			for ( uint32_t j = 0U; j < 8U; j++ )
+			{
+				std::swap( m[column][j], m[pivot][j] );
+			}
+
+			const float scale = 1.0f / m[column][column];
+			for ( uint32_t j = 0U; j < 8U; j++ )
+			{
+				m[column][j] *= scale;
+			}
+
+			for ( uint32_t i = 0U; i < 4U; i++ )
+			{
+				if ( i == column )
+				{
+					continue;
+				}
+
+				const float factor = m[i][column];
+				for ( uint32_t j = 0U; j < 8U; j++ )
+				{
+					m[i][j] -= factor * m[column][j];
+				}
+			}
+		}
+
+		for ( uint32_t i = 0U; i < 4U; i++ )
+		{
+			for ( uint32_t j = 0U; j < 4U; j++ )
+			{
+				outRows[i][j] = m[i][j + 4U];
+			}
+		}
+
+		return true;
+	}
+
+	// Clip space to world space
+	Vec3 Unproject( const float inverseRows[4][4], float x, float y, float z )
+	{
+		float p[4];
+		for ( uint32_t i = 0U; i < 4U; i++ )
+		{
+			p[i] = inverseRows[i][0] * x + inverseRows[i][1] * y + inverseRows[i][2] * z + inverseRows[i][3];
+		}
+
+		const float w = std::abs( p[3] ) > 1.0e-6f ? p[3] : 1.0e-6f;
+		return { p[0] / w, p[1] / w, p[2] / w };
+	}
+
+	nvrhi::Viewport GetTileViewport( const ShadowAtlas::Tile& tile )
+	{
+		return nvrhi::Viewport( float( tile.x ), float( tile.x + tile.size ),
+			float( tile.y ), float( tile.y + tile.size ), 0.0f, 1.0f );
+	}
+
+	Bounds GetLightBounds( const LightShadowDesc& desc )
+	{
+		return {
+			{ desc.position.x - desc.range, desc.position.y - desc.range, desc.position.z - desc.range },
+			{ desc.position.x + desc.range, desc.position.y + desc.range, desc.position.z + desc.range } };
+	}
+}
+
+bool RenderFrontend::CreateShadowResources()
+{
+	shadowVertexShader = CreateShader( nvrhi::ShaderType::Vertex, "shadow" );
+	if ( nullptr == shadowVertexShader )
+	{
+		return false;
+	}
+
+	shadowAtlas.Init( shadowSettings.atlasSize, shadowSettings.minTileSize );
+	const uint32_t atlasSize = shadowAtlas.GetSize();
+
+	auto atlasDesc = nvrhi::TextureDesc()
+		.setWidth( atlasSize )
+		.setHeight( atlasSize )
+		.setFormat( nvrhi::Format::D32 )
+		.setDimension( nvrhi::TextureDimension::Texture2D )
+		.setKeepInitialState( true )
+		.setInitialState( nvrhi::ResourceStates::DepthWrite )
+		.setIsRenderTarget( true )
+		.setDebugName( "Static shadow atlas" );
+
+	shadowStaticAtlas = backend->createTexture( atlasDesc );
+	shadowDynamicAtlas = backend->createTexture( atlasDesc.setDebugName( "Dynamic shadow atlas" ) );
+	if ( nullptr == shadowStaticAtlas || nullptr == shadowDynamicAtlas )
+	{
+		Console->Error( "RenderFrontend: Failed to create shadow atlases" );
+		return false;
+	}
+	commandStats.Record( RenderCommand::CreateTexture );
+	commandStats.Record( RenderCommand::CreateTexture );
+
+	shadowAtlasMemory = memoryTracker.CreateOwner( MemoryCategory::ShadowMaps, "shadow atlases" );
+	memoryTracker.Allocate( shadowAtlasMemory, 2U * GetMipByteSize( atlasDesc.format, atlasSize, atlasSize, 0U ) );
+
+	shadowStaticFramebuffer = backend->createFramebuffer( nvrhi::FramebufferDesc().setDepthAttachment( shadowStaticAtlas ) );
+	shadowDynamicFramebuffer = backend->createFramebuffer( nvrhi::FramebufferDesc().setDepthAttachment( shadowDynamicAtlas ) );
+	if ( nullptr == shadowStaticFramebuffer || nullptr == shadowDynamicFramebuffer )
+	{
+		Console->Error( "RenderFrontend: Failed to create shadow framebuffers" );
+		return false;
+	}
+
+	// Same layout as the entity pipeline's first vertex buffer, so models and batches can be drawn as they are
+	const nvrhi::VertexAttributeDesc shadowVertexLayoutDesc = nvrhi::VertexAttributeDesc()
+		.setName( "POSITION" )
+		.setBufferIndex( 0U )
+		.setFormat( nvrhi::Format::RGB32_FLOAT )
+		.setElementStride( sizeof( Vec3 ) );
+	shadowVertexLayout = backend->createInputLayout( &shadowVertexLayoutDesc, 1U, shadowVertexShader );
+
+	// Slope-scaled bias against shadow acne, the constant part is in D32 units
+	auto shadowRasterState = nvrhi::RasterState()
+		.setCullNone()
+		.setFillSolid()
+		.setDepthBias( 64 )
+		.setSlopeScaleDepthBias( 2.0f );
+
+	auto shadowDepthStencilState = nvrhi::DepthStencilState()
+		.enableDepthTest()
+		.enableDepthWrite()
+		.disableStencil()
+		.setDepthFunc( nvrhi::ComparisonFunc::Less );
+
+	auto shadowPipelineDesc = nvrhi::GraphicsPipelineDesc()
+		.setVertexShader( shadowVertexShader )
+		.setInputLayout( shadowVertexLayout )
+		.setRenderState( nvrhi::RenderState()
+			.setRasterState( shadowRasterState )
+			.setDepthStencilState( shadowDepthStencilState ) )
+		.addBindingLayout( viewFrameBindingLayout )
+		.addBindingLayout( entityBindingLayout );
+
+	// Both atlases have the same format, so the pipelines work with either
+	shadowPipeline = backend->createGraphicsPipeline( shadowPipelineDesc, shadowStaticFramebuffer );
+	if ( nullptr == shadowPipeline )
+	{
+		Console->Error( "RenderFrontend: Failed to create shadow pipeline" );
+		return false;
+	}
+
+	shadowPipelineDesc.renderState.rasterState = nvrhi::RasterState()
+		.setCullNone()
+		.setFillSolid();
+	shadowPipelineDesc.renderState.depthStencilState.setDepthFunc( nvrhi::ComparisonFunc::Always );
+
+	shadowClearPipeline = backend->createGraphicsPipeline( shadowPipelineDesc, shadowStaticFramebuffer );
+	if ( nullptr == shadowClearPipeline )
+	{
+		Console->Error( "RenderFrontend: Failed to create shadow clear pipeline" );
+		return false;
+	}
+
+	// Format: XYZ, drawn with identity matrices, so Z is the depth it writes
+	const Vector<float> ClearQuadVertexData =
+	{
+		-1.0f, -1.0f, 1.0f,
+		1.0f, -1.0f, 1.0f,
+		1.0f, 1.0f, 1.0f,
+		-1.0f, 1.0f, 1.0f
+	};
+
+	const Vector<uint32_t> ClearQuadIndexData =
+	{
+		0, 1, 2,
+		2, 3, 0
+	};
+
+	shadowClearIndexBuffer = CreateIndexBuffer( ClearQuadIndexData, shadowAtlasMemory );
+	shadowClearVertexBuffer = CreateVertexBuffer( ClearQuadVertexData, shadowAtlasMemory );
+
+	return (nullptr != shadowClearIndexBuffer) && (nullptr != shadowClearVertexBuffer);
+}
+
+// Only called when the GPU is idle
+void RenderFrontend::DestroyShadowResources()
+{
+	for ( const auto& light : lights )
+	{
+		ReleaseShadowTiles( static_cast<Light*>( light.get() ) );
+	}
+
+	shadowStaticAtlas = nullptr;
+	shadowDynamicAtlas = nullptr;
+	shadowStaticFramebuffer = nullptr;
+	shadowDynamicFramebuffer = nullptr;
+	shadowVertexLayout = nullptr;
+	shadowVertexShader = nullptr;
+	shadowPipeline = nullptr;
+	shadowClearPipeline = nullptr;
+	shadowClearVertexBuffer = nullptr;
+	shadowClearIndexBuffer = nullptr;
+
+	memoryTracker.ReleaseOwner( shadowAtlasMemory );
+	shadowAtlasMemory = MemoryTracker::InvalidOwner;
+}
+
+void RenderFrontend::MarkStaticChange( const Bounds& bounds )
+{
+	batchChangeSerial = ++changeSerial;
+
+	staticChanges.push_back( { batchChangeSerial, bounds } );
+	if ( staticChanges.size() > MaxStaticChanges )
+	{
+		staticChanges.pop_front();
+	}
+}
+
+void RenderFrontend::ReleaseShadowTiles( Light* light )
+{
+	for ( LightShadowFace& face : light->shadowFaces )
+	{
+		shadowAtlas.Free( face.tile );
+	}
+
+	light->shadowFaces.clear();
+	light->shadowTileSize = 0U;
+	light->shadowRequestedSize = 0U;
+}
+
+bool RenderFrontend::IsStaticChangeInRange( const Light* light ) const
+{
+	if ( light->shadowStaticSerial >= batchChangeSerial )
+	{
+		return false;
+	}
+
+	// Cascades cover whatever the camera sees, and changes that were forgotten could've been anywhere
+	if ( light->shadowDesc.projection == ShadowProjection::Directional
+		|| (staticChanges.size() == MaxStaticChanges && staticChanges.front().serial > light->shadowStaticSerial) )
+	{
+		return true;
+	}
+
+	const Bounds lightBounds = GetLightBounds( light->shadowDesc );
+	for ( const StaticChange& change : staticChanges )
+	{
+		if ( change.serial > light->shadowStaticSerial && change.bounds.Overlaps( lightBounds ) )
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Roughly how many pixels tall the light's sphere of influence is on screen, 0 if it can't affect the view
+float RenderFrontend::GetShadowImportance( const Light* light, const View* view ) const
+{
+	const LightShadowDesc& desc = light->shadowDesc;
+	if ( !desc.castShadows )
+	{
+		return 0.0f;
+	}
+
+	if ( desc.projection == ShadowProjection::Directional )
+	{
+		return FLT_MAX;
+	}
+
+	if ( view->GetFrustum().Test( GetLightBounds( desc ) ) == FrustumTestResult::Outside )
+	{
+		return 0.0f;
+	}
+
+	const float renderHeight = view->GetRenderSize().y;
+	const float distance = Distance( view->GetOrigin(), desc.position );
+	if ( distance <= desc.range )
+	{
+		return renderHeight;
+	}
+
+	return renderHeight * desc.range / distance;
+}
+
+// Tiles are kept for as long as the light wants the same size. Returns false if the light has no tiles
+bool RenderFrontend::UpdateShadowTiles( Light* light, float importance )
+{
+	const LightShadowDesc& desc = light->shadowDesc;
+
+	uint32_t numFaces = 1U;
+	uint32_t tileSize = 0U;
+	if ( desc.projection == ShadowProjection::Directional )
+	{
+		numFaces = std::clamp( shadowSettings.numCascades, 1U, 4U );
+		tileSize = shadowAtlas.RoundTileSize( shadowSettings.cascadeTileSize );
+	}
+	else
+	{
+		// Point lights have six faces to fit, so each one gets less
+		const float faceScale = desc.projection == ShadowProjection::Point ? 0.5f : 1.0f;
+		const auto getTileSize = [&]( float pixels )
+		{
+			const float size = std::min( pixels * shadowSettings.resolutionScale * faceScale, float( shadowSettings.maxTileSize ) );
+			return shadowAtlas.RoundTileSize( uint32_t( std::max( size, 1.0f ) ) );
+		};
+
+		numFaces = desc.projection == ShadowProjection::Point ? 6U : 1U;
+		tileSize = getTileSize( importance );
+
+		// Lights only shrink with some margin, so the ones near a size boundary don't reallocate every frame
+		if ( tileSize < light->shadowRequestedSize && getTileSize( importance * 1.5f ) >= light->shadowRequestedSize )
+		{
+			tileSize = light->shadowRequestedSize;
+		}
+	}
+
+	// Lights that didn't fit at the size they asked for keep what they got,
+	// instead of trying again every frame and losing their cached tiles each time
+	if ( light->shadowFaces.size() == numFaces && light->shadowRequestedSize == tileSize )
+	{
+		return light->shadowTileSize != 0U;
+	}
+
+	for ( LightShadowFace& face : light->shadowFaces )
+	{
+		shadowAtlas.Free( face.tile );
+	}
+
+	light->shadowFaces.resize( numFaces );
+	light->shadowTileSize = 0U;
+	light->shadowRequestedSize = tileSize;
+
+	// Falls back to smaller tiles when the atlas is full
+	for ( uint32_t size = tileSize; size >= shadowAtlas.GetMinTileSize(); size /= 2U )
+	{
+		bool allocated = true;
+		for ( LightShadowFace& face : light->shadowFaces )
+		{
+			face.tile = shadowAtlas.Allocate( size );
+			face.staticValid = false;
+			allocated = allocated && face.tile.IsValid();
+		}
+
+		if ( allocated )
+		{
+			light->shadowTileSize = size;
+			return true;
+		}
+
+		for ( LightShadowFace& face : light->shadowFaces )
+		{
+			shadowAtlas.Free( face.tile );
+		}
+	}
+
+	return false;
+}
+
+void RenderFrontend::UpdateShadowMatrices( Light* light, const View* view )
+{
+	const LightShadowDesc& desc = light->shadowDesc;
+	Vector<LightShadowFace>& faces = light->shadowFaces;
+
+	// Cached static casters are only valid for the exact matrix they were drawn with
+	const auto setMatrix = []( LightShadowFace& face, const Mat4& matrix )
+	{
+		if ( 0 != std::memcmp( &face.viewProjection, &matrix, sizeof( Mat4 ) ) )
+		{
+			face.viewProjection = matrix;
+			face.staticValid = false;
+		}
+	};
+
+	const float nearZ = std::clamp( desc.range * 0.01f, 0.1f, 16.0f );
+
+	switch ( desc.projection )
+	{
+	case ShadowProjection::Spot:
+		setMatrix( faces[0], MakePerspective( desc.position, desc.direction, std::clamp( desc.spotAngle, 1.0f, 170.0f ), nearZ, desc.range ) );
+		break;
+
+	case ShadowProjection::Point:
+	{
+		static const Vec3 Axes[6] =
+		{
+			{ 1.0f, 0.0f, 0.0f }, { -1.0f, 0.0f, 0.0f },
+			{ 0.0f, 1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f },
+			{ 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, -1.0f }
+		};
+
+		for ( uint32_t i = 0U; i < 6U; i++ )
+		{
+			setMatrix( faces[i], MakePerspective( desc.position, Axes[i], 90.0f, nearZ, desc.range ) );
+		}
+		break;
+	}
+
+	case ShadowProjection::Directional:
+	{
+		// The view frustum's corners in world space
+		float viewRows[4][4];
+		float inverseRows[4][4];
+		GetMatrixRows( view->GetFrustum().viewProjection, viewRows );
+		if ( !InvertMatrix( viewRows, inverseRows ) )
+		{
+			break;
+		}
+
+		Vec3 nearCorners[4];
+		Vec3 farCorners[4];
+		for ( uint32_t i = 0U; i < 4U; i++ )
+		{
+			const float x = (i & 1U) ? 1.0f : -1.0f;
+			const float y = (i & 2U) ? 1.0f : -1.0f;
+			nearCorners[i] = Unproject( inverseRows, x, y, 0.0f );
+			farCorners[i] = Unproject( inverseRows, x, y, 1.0f );
+		}
+
+		const Vec3& origin = view->GetOrigin();
+		const float nearDistance = std::max( Distance( origin, Unproject( inverseRows, 0.0f, 0.0f, 0.0f ) ), 0.01f );
+		const float farDistance = std::max( Distance( origin, Unproject( inverseRows, 0.0f, 0.0f, 1.0f ) ), nearDistance + 1.0f );
+		const float shadowDistance = std::clamp( shadowSettings.cascadeDistance, nearDistance + 1.0f, farDistance );
+		const float lambda = std::clamp( shadowSettings.cascadeSplitLambda, 0.0f, 1.0f );
+
+		Vec3 right, up;
+		MakeBasis( Normalise( desc.direction ), right, up );
+
+		float splitStart = nearDistance;
+		for ( uint32_t cascade = 0U; cascade < faces.size(); cascade++ )
+		{
+			const float fraction = float( cascade + 1U ) / float( faces.size() );
+			const float logarithmicSplit = nearDistance * std::pow( shadowDistance / nearDistance, fraction );
+			const float uniformSplit = nearDistance + (shadowDistance - nearDistance) * fraction;
+			const float splitEnd = lambda * logarithmicSplit + (1.0f - lambda) * uniformSplit;
+
+			// Corners of this slice of the frustum
+			const float t0 = (splitStart - nearDistance) / (farDistance - nearDistance);
+			const float t1 = (splitEnd - nearDistance) / (farDistance - nearDistance);
+			Vec3 corners[8];
+			Vec3 centre = { 0.0f, 0.0f, 0.0f };
+			for ( uint32_t i = 0U; i < 4U; i++ )
+			{
+				const Vec3 edge = MultiplyAdd( farCorners[i], nearCorners[i], -1.0f );
+				corners[i] = MultiplyAdd( nearCorners[i], edge, t0 );
+				corners[i + 4U] = MultiplyAdd( nearCorners[i], edge, t1 );
+				centre = MultiplyAdd( centre, corners[i], 0.125f );
+				centre = MultiplyAdd( centre, corners[i + 4U], 0.125f );
+			}
+
+			// A bounding sphere doesn't change size as the camera turns, so the shadows don't shimmer
+			float radius = 0.0f;
+			for ( const Vec3& corner : corners )
+			{
+				radius = std::max( radius, Distance( centre, corner ) );
+			}
+			radius = std::ceil( radius * 16.0f ) / 16.0f;
+
+			// Moving in whole texels keeps the shadow edges still while the camera moves
+			const float texelSize = 2.0f * radius / float( faces[cascade].tile.size );
+			const float offsetRight = Dot( right, centre );
+			const float offsetUp = Dot( up, centre );
+			centre = MultiplyAdd( centre, right, std::floor( offsetRight / texelSize ) * texelSize - offsetRight );
+			centre = MultiplyAdd( centre, up, std::floor( offsetUp / texelSize ) * texelSize - offsetUp );
+
+			// Casters between the light and the slice are kept, up to the light's range
+			setMatrix( faces[cascade], MakeOrthographic( centre, desc.direction, radius, -radius - desc.range, radius ) );
+			faces[cascade].splitDistance = splitEnd;
+			splitStart = splitEnd;
+		}
+		break;
+	}
+	}
+}
+
+// Depth clears can only do whole textures, so tiles are cleared by drawing the far plane over them
+void RenderFrontend::ClearShadowTile( const LightShadowFace& face )
+{
+	currentViewData.viewMatrix = Mat4::Identity;
+	currentViewData.projectionMatrix = Mat4::Identity;
+	renderCommands->writeBuffer( viewDataBuffer, &currentViewData, sizeof( currentViewData ) );
+	commandStats.Record( RenderCommand::WriteBuffer, sizeof( currentViewData ) );
+
+	auto graphicsState = nvrhi::GraphicsState()
+		.addBindingSet( viewFrameBindingSet )
+		.addBindingSet( entityBindingSet )
+		.addVertexBuffer( { shadowClearVertexBuffer, 0U, 0U } )
+		.setIndexBuffer( { shadowClearIndexBuffer, nvrhi::Format::R32_UINT, 0U } )
+		.setFramebuffer( shadowStaticFramebuffer )
+		.setPipeline( shadowClearPipeline );
+	graphicsState.viewport.addViewportAndScissorRect( GetTileViewport( face.tile ) );
+
+	if ( stateTracker.Set( renderCommands, graphicsState ) )
+	{
+		commandStats.Record( RenderCommand::SetGraphicsState );
+	}
+
+	const auto drawArguments = nvrhi::DrawArguments().setVertexCount( 6U );
+	SetEntityConstants( IdentityEntitySlot, DefaultMaterialSlot );
+	renderCommands->drawIndexed( drawArguments );
+	commandStats.Record( RenderCommand::DrawIndexed, drawArguments.vertexCount );
+}
+
+// Static casters are batches and go into the static atlas, everything else is an entity
+// Only positions are bound, the rest of the vertex data doesn't matter for depth
+void RenderFrontend::RenderShadowFace( const LightShadowFace& face, bool staticCasters )
+{
+	Frustum frustum;
+	frustum.viewProjection = face.viewProjection;
+
+	currentViewData.viewMatrix = Mat4::Identity;
+	currentViewData.projectionMatrix = face.viewProjection;
+	renderCommands->writeBuffer( viewDataBuffer, &currentViewData, sizeof( currentViewData ) );
+	commandStats.Record( RenderCommand::WriteBuffer, sizeof( currentViewData ) );
+
+	auto graphicsState = nvrhi::GraphicsState()
+		.addBindingSet( viewFrameBindingSet )
+		.addBindingSet( entityBindingSet )
+		.setFramebuffer( staticCasters ? shadowStaticFramebuffer : shadowDynamicFramebuffer )
+		.setPipeline( shadowPipeline );
+	graphicsState.viewport.addViewportAndScissorRect( GetTileViewport( face.tile ) );
+
+	if ( !staticCasters )
+	{
+		shadowCasters.clear();
+		entityTree.QueryFrustum( frustum, shadowCasters );
+
+		for ( const IEntity* entity : shadowCasters )
+		{
+			const Entity* entityInternal = static_cast<const Entity*>( entity );
+			for ( const FaceDrawRecord& record : entityInternal->GetDrawRecords() )
+			{
+				if ( !record.complete )
+				{
+					continue;
+				}
+
+				graphicsState.vertexBuffers = { { record.vertexBuffers[0], 0U, record.vertexOffsets[0] } };
+				graphicsState.indexBuffer = { record.indexBuffer, record.indexFormat, record.indexOffset };
+				if ( stateTracker.Set( renderCommands, graphicsState ) )
+				{
+					commandStats.Record( RenderCommand::SetGraphicsState );
+				}
+
+				const auto drawArguments = nvrhi::DrawArguments().setVertexCount( record.numIndices );
+				SetEntityConstants( entityInternal->dataSlot, DefaultMaterialSlot );
+				renderCommands->drawIndexed( drawArguments );
+				commandStats.Record( RenderCommand::DrawIndexed, drawArguments.vertexCount );
+			}
+		}
+		return;
+	}
+
+	for ( const auto& batch : batches )
+	{
+		const Batch* batchInternal = static_cast<const Batch*>( batch.get() );
+		if ( frustum.Test( batchInternal->GetBounds() ) == FrustumTestResult::Outside )
+		{
+			continue;
+		}
+
+		for ( const BatchGroup& group : batchInternal->GetGroups() )
+		{
+			if ( frustum.Test( group.bounds ) == FrustumTestResult::Outside )
+			{
+				continue;
+			}
+
+			graphicsState.vertexBuffers = { { group.positionBuffer, 0U, 0U } };
+			graphicsState.indexBuffer = { group.indexBuffer, nvrhi::Format::R32_UINT, 0U };
+			if ( stateTracker.Set( renderCommands, graphicsState ) )
+			{
+				commandStats.Record( RenderCommand::SetGraphicsState );
+			}
+
+			// Same as RenderBatch, neighbouring visible chunks are merged into one draw
+			uint32_t runStart = 0U;
+			uint32_t runCount = 0U;
+			const auto flushRun = [&]()
+			{
+				if ( runCount > 0U )
+				{
+					SetEntityConstants( IdentityEntitySlot, DefaultMaterialSlot );
+					renderCommands->drawIndexed( nvrhi::DrawArguments()
+						.setVertexCount( runCount )
+						.setStartIndexLocation( runStart ) );
+					commandStats.Record( RenderCommand::DrawIndexed, runCount );
+				}
+				runCount = 0U;
+			};
+
+			for ( const BatchChunk& chunk : group.chunks )
+			{
+				if ( frustum.Test( chunk.bounds ) == FrustumTestResult::Outside )
+				{
+					flushRun();
+					continue;
+				}
+
+				if ( runCount == 0U )
+				{
+					runStart = chunk.firstIndex;
+				}
+				runCount += chunk.numIndices;
+			}
+			flushRun();
+		}
+	}
+}
+
+void RenderFrontend::RenderShadows( const IView* view )
+{
+	PROFILE_SCOPE( "RenderShadows" );
+
+	if ( nullptr == view || nullptr == shadowStaticAtlas )
+	{
+		return;
+	}
+
+	UpdateEntityTree();
+	const View* viewInternal = static_cast<const View*>( view );
+
+	shadowLights.clear();
+	for ( const auto& light : lights )
+	{
+		Light* lightInternal = static_cast<Light*>( light.get() );
+		lightInternal->shadowImportance = GetShadowImportance( lightInternal, viewInternal );
+		if ( lightInternal->shadowImportance > 0.0f )
+		{
+			lightInternal->shadowVisibleFrame = frameIndex;
+			shadowLights.push_back( lightInternal );
+		}
+		// Lights that are out of sight for a while give their space to others
+		else if ( frameIndex - lightInternal->shadowVisibleFrame > shadowSettings.tileKeepFrames )
+		{
+			ReleaseShadowTiles( lightInternal );
+		}
+	}
+
+	// The most important lights get their tiles first, in case the atlas runs out of space
+	std::sort( shadowLights.begin(), shadowLights.end(), []( const Light* a, const Light* b )
+	{
+		return a->shadowImportance > b->shadowImportance;
+	} );
+
+	size_t numShadowLights = 0U;
+	for ( Light* light : shadowLights )
+	{
+		if ( UpdateShadowTiles( light, light->shadowImportance ) )
+		{
+			UpdateShadowMatrices( light, viewInternal );
+			shadowLights[numShadowLights++] = light;
+		}
+	}
+	shadowLights.resize( numShadowLights );
+
+	if ( shadowLights.empty() )
+	{
+		return;
+	}
+
+	renderCommands->open();
+	stateTracker.Invalidate();
+	FlushEntityUploads();
+	SkinEntities();
+
+	gpuProfiler.BeginPass( renderCommands, "Shadows: static" );
+	for ( Light* light : shadowLights )
+	{
+		const bool staticChanged = IsStaticChangeInRange( light );
+		for ( LightShadowFace& face : light->shadowFaces )
+		{
+			if ( face.staticValid && !staticChanged )
+			{
+				shadowTilesCached++;
+				continue;
+			}
+
+			ClearShadowTile( face );
+			RenderShadowFace( face, true );
+			face.staticValid = true;
+			shadowTilesRedrawn++;
+		}
+		light->shadowStaticSerial = batchChangeSerial;
+	}
+	gpuProfiler.EndPass( renderCommands );
+
+	// D3D12 can only copy depth textures as a whole, so the whole atlas is copied
+	gpuProfiler.BeginPass( renderCommands, "Shadows: copy" );
+	renderCommands->copyTexture( shadowDynamicAtlas, nvrhi::TextureSlice(), shadowStaticAtlas, nvrhi::TextureSlice() );
+	commandStats.Record( RenderCommand::CopyTexture );
+	gpuProfiler.EndPass( renderCommands );
+	stateTracker.Invalidate();
+
+	gpuProfiler.BeginPass( renderCommands, "Shadows: dynamic" );
+	for ( const Light* light : shadowLights )
+	{
+		for ( const LightShadowFace& face : light->shadowFaces )
+		{
+			RenderShadowFace( face, false );
+		}
+	}
+	gpuProfiler.EndPass( renderCommands );
+
+	renderCommands->close();
+	backend->executeCommandList( renderCommands );
+	commandStats.Record( RenderCommand::ExecuteCommandList );
+}
+
+void RenderFrontend::SetLightShadow( ILight* light, const LightShadowDesc& desc )
+{
+	if ( nullptr == light )
+	{
+		Console->Warning( "RenderFrontend::SetLightShadow: light is nullptr" );
+		return;
+	}
+
+	Light* lightInternal = static_cast<Light*>( light );
+	if ( !desc.castShadows || desc.projection != lightInternal->shadowDesc.projection )
+	{
+		ReleaseShadowTiles( lightInternal );
+	}
+
+	lightInternal->shadowDesc = desc;
+	lightInternal->shadowDesc.direction = Normalise( desc.direction );
+	lightInternal->shadowDesc.range = std::max( desc.range, 1.0f );
+
+	// Whatever was cached is from the light's old position
+	for ( LightShadowFace& face : lightInternal->shadowFaces )
+	{
+		face.staticValid = false;
+	}
+}
+
+void RenderFrontend::SetShadowSettings( const ShadowSettings& settings )
+{
+	const bool atlasChanged = settings.atlasSize != shadowSettings.atlasSize
+		|| settings.minTileSize != shadowSettings.minTileSize;
+	shadowSettings = settings;
+
+	// Not initialised yet, PostInit will create the atlases
+	if ( !atlasChanged || nullptr == shadowStaticAtlas )
+	{
+		return;
+	}
+
+	backend->waitForIdle();
+	DestroyShadowResources();
+	if ( !CreateShadowResources() )
+	{
+		Console->Error( "RenderFrontend::SetShadowSettings: Failed to recreate the shadow atlases" );
+	}
+}
+
+nvrhi::ITexture* RenderFrontend::GetShadowAtlas() const
+{
+	return shadowDynamicAtlas;
+}
+
+const Vector<LightShadowFace>* RenderFrontend::GetLightShadowFaces( const ILight* light ) const
+{
+	const Light* lightInternal = static_cast<const Light*>( light );
+	if ( nullptr == lightInternal || 0U == lightInternal->shadowTileSize )
+	{
+		return nullptr;
+	}
+
+	return &lightInternal->shadowFaces;
+}
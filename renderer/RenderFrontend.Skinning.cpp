@@ -0,0 +1,403 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "RenderFrontend.hpp"
+#include "Entity.hpp"
+#include "Profiler.hpp"
+
+using Assets::RenderData::VertexAttributeType;
+using Assets::RenderData::VertexData;
+
+// Must match numthreads in skinning.hlsl
+constexpr uint32_t SkinningGroupSize = 64U;
+
+// Faces are numbered across meshes, in the same order PrepareModel goes through them
+static const VertexData* FindFaceData( const Assets::IModel* asset, uint32_t face )
+{
+	uint32_t index = 0U;
+	for ( const auto& mesh : asset->GetModelData().meshes )
+	{
+		for ( const auto& meshFace : mesh.faces )
+		{
+			if ( index++ == face )
+			{
+				return &meshFace.data;
+			}
+		}
+	}
+
+	return nullptr;
+}
+
+static const Assets::RenderData::VertexDataSegment* FindSegment( const VertexData& data, VertexAttributeType type )
+{
+	for ( const auto& segment : data.vertexData )
+	{
+		if ( segment.type == type )
+		{
+			return &segment;
+		}
+	}
+
+	return nullptr;
+}
+
+static bool HasBoneData( const Model* model, uint32_t face )
+{
+	return nullptr != model->FindVertexBuffer( face, VertexAttributeType::BoneIndices )
+		&& nullptr != model->FindVertexBuffer( face, VertexAttributeType::BoneWeights );
+}
+
+bool RenderFrontend::CreateSkinningResources()
+{
+	skinningShader = CreateComputeShader( "skinning" );
+	if ( nullptr == skinningShader )
+	{
+		return false;
+	}
+
+	auto paletteBindingLayoutDesc = nvrhi::BindingLayoutDesc()
+		.setVisibility( nvrhi::ShaderType::Compute )
+		.addItem( nvrhi::BindingLayoutItem::StructuredBuffer_SRV( 0 ) )
+		.addItem( nvrhi::BindingLayoutItem::PushConstants( 0, sizeof( SkinningConstants ) ) );
+
+	skinningPaletteBindingLayout = backend->createBindingLayout( paletteBindingLayoutDesc );
+	if ( nullptr == skinningPaletteBindingLayout )
+	{
+		Console->Error( "RenderFrontend: Failed to create bone palette binding layout" );
+		return false;
+	}
+
+	auto faceBindingLayoutDesc = nvrhi::BindingLayoutDesc()
+		.setVisibility( nvrhi::ShaderType::Compute )
+		.addItem( nvrhi::BindingLayoutItem::RawBuffer_SRV( 1 ) )
+		.addItem( nvrhi::BindingLayoutItem::RawBuffer_SRV( 2 ) )
+		.addItem( nvrhi::BindingLayoutItem::RawBuffer_SRV( 3 ) )
+		.addItem( nvrhi::BindingLayoutItem::RawBuffer_SRV( 4 ) )
+		.addItem( nvrhi::BindingLayoutItem::RawBuffer_UAV( 0 ) )
+		.addItem( nvrhi::BindingLayoutItem::RawBuffer_UAV( 1 ) );
+
+	skinningFaceBindingLayout = backend->createBindingLayout( faceBindingLayoutDesc );
+	if ( nullptr == skinningFaceBindingLayout )
+	{
+		Console->Error( "RenderFrontend: Failed to create skinning binding layout" );
+		return false;
+	}
+
+	auto pipelineDesc = nvrhi::ComputePipelineDesc()
+		.setComputeShader( skinningShader )
+		.addBindingLayout( skinningPaletteBindingLayout )
+		.addBindingLayout( skinningFaceBindingLayout );
+
+	skinningPipeline = backend->createComputePipeline( pipelineDesc );
+	if ( nullptr == skinningPipeline )
+	{
+		Console->Error( "RenderFrontend: Failed to create skinning pipeline" );
+		return false;
+	}
+
+	bonePaletteMemory = memoryTracker.CreateOwner( MemoryCategory::BonePalettes, "bone palette" );
+	return ResizeBonePaletteBuffer( 1024U );
+}
+
+bool RenderFrontend::ResizeBonePaletteBuffer( uint32_t capacity )
+{
+	auto bufferDesc = nvrhi::BufferDesc()
+		.setByteSize( uint64_t( capacity ) * sizeof( Mat4 ) )
+		.setStructStride( sizeof( Mat4 ) )
+		.setInitialState( nvrhi::ResourceStates::ShaderResource )
+		.setKeepInitialState( true )
+		.setDebugName( "Bone palette" );
+
+	nvrhi::BufferHandle newBuffer = backend->createBuffer( bufferDesc );
+	if ( nullptr == newBuffer )
+	{
+		Console->Error( format( "RenderFrontend: Failed to create a bone palette for %u bones", capacity ) );
+		return false;
+	}
+
+	commandStats.Record( RenderCommand::CreateBuffer, bufferDesc.byteSize );
+
+	// Nothing in the old one is needed, it's rewritten every time
+	if ( nullptr != bonePaletteBuffer )
+	{
+		memoryTracker.Free( bonePaletteMemory, size_t( bonePaletteCapacity ) * sizeof( Mat4 ) );
+	}
+	memoryTracker.Allocate( bonePaletteMemory, size_t( bufferDesc.byteSize ) );
+
+	bonePaletteBuffer = newBuffer;
+	bonePaletteCapacity = capacity;
+
+	auto paletteSetDesc = nvrhi::BindingSetDesc()
+		.addItem( nvrhi::BindingSetItem::StructuredBuffer_SRV( 0, bonePaletteBuffer ) )
+		.addItem( nvrhi::BindingSetItem::PushConstants( 0, sizeof( SkinningConstants ) ) );
+	skinningPaletteBindingSet = backend->createBindingSet( paletteSetDesc, skinningPaletteBindingLayout );
+	if ( nullptr == skinningPaletteBindingSet )
+	{
+		Console->Error( "RenderFrontend: Failed to create bone palette binding set" );
+		return false;
+	}
+
+	return true;
+}
+
+// Entities get a skin if they have bones and their model has bone data, and lose it
+// when either goes away. The model may also have been swapped through GetDesc
+void RenderFrontend::UpdateEntitySkin( Entity* entity )
+{
+	const EntityDesc& desc = static_cast<const Entity*>( entity )->GetDesc();
+	const Model* model = static_cast<const Model*>( desc.model );
+
+	bool needsSkin = desc.numBones > 0 && nullptr != desc.bones && nullptr != skinningPipeline;
+	if ( needsSkin )
+	{
+		needsSkin = false;
+		for ( uint32_t face = 0U; face < model->GetNumFaces() && !needsSkin; face++ )
+		{
+			needsSkin = HasBoneData( model, face );
+		}
+	}
+
+	if ( nullptr != entity->skin && (!needsSkin || entity->skin->model != desc.model) )
+	{
+		DestroyEntitySkin( entity );
+	}
+
+	if ( needsSkin && nullptr == entity->skin && !CreateEntitySkin( entity ) )
+	{
+		return;
+	}
+
+	if ( nullptr != entity->skin && !entity->skin->pending )
+	{
+		entity->skin->pending = true;
+		pendingSkins.push_back( entity );
+	}
+}
+
+bool RenderFrontend::CreateEntitySkin( Entity* entity )
+{
+	const Model* model = static_cast<const Model*>( static_cast<const Entity*>( entity )->GetDesc().model );
+
+	auto skin = std::make_unique<EntitySkin>();
+	skin->model = model;
+	skin->faces.resize( model->GetNumFaces() );
+	skin->drawRecords = model->GetDrawRecords();
+	skin->memoryOwner = memoryTracker.CreateOwner( MemoryCategory::Geometry,
+		format( "skinned entity (model '%s')", model->GetName().data() ) );
+
+	for ( uint32_t face = 0U; face < model->GetNumFaces(); face++ )
+	{
+		nvrhi::IBuffer* positions = model->FindVertexBuffer( face, VertexAttributeType::Position );
+		nvrhi::IBuffer* normals = model->FindVertexBuffer( face, VertexAttributeType::Normal );
+		if ( !HasBoneData( model, face ) || nullptr == positions || nullptr == normals )
+		{
+			continue;
+		}
+
+		SkinnedFace& skinnedFace = skin->faces[face];
+		skinnedFace.numVertices = uint32_t( model->GetNumVertices( face ) );
+
+		// Written by compute or by the CPU path, read as vertex buffers the rest of the time
+		auto bufferDesc = nvrhi::BufferDesc()
+			.setIsVertexBuffer( true )
+			.setCanHaveUAVs( true )
+			.setCanHaveRawViews( true )
+			.setInitialState( nvrhi::ResourceStates::VertexBuffer )
+			.setKeepInitialState( true );
+
+		bufferDesc.setByteSize( uint64_t( skinnedFace.numVertices ) * sizeof( Vec3 ) ).setDebugName( "Skinned positions" );
+		skinnedFace.positionBuffer = backend->createBuffer( bufferDesc );
+
+		bufferDesc.setByteSize( uint64_t( skinnedFace.numVertices ) * 4U ).setDebugName( "Skinned normals" );
+		skinnedFace.normalBuffer = backend->createBuffer( bufferDesc );
+
+		if ( nullptr == skinnedFace.positionBuffer || nullptr == skinnedFace.normalBuffer )
+		{
+			Console->Error( format( "RenderFrontend: Failed to create skinned vertex buffers (face %u)", face ) );
+			memoryTracker.ReleaseOwner( skin->memoryOwner );
+			return false;
+		}
+		commandStats.Record( RenderCommand::CreateBuffer, uint64_t( skinnedFace.numVertices ) * sizeof( Vec3 ) );
+		commandStats.Record( RenderCommand::CreateBuffer, bufferDesc.byteSize );
+		memoryTracker.Allocate( skin->memoryOwner, size_t( skinnedFace.numVertices ) * (sizeof( Vec3 ) + 4U) );
+
+		auto faceSetDesc = nvrhi::BindingSetDesc()
+			.addItem( nvrhi::BindingSetItem::RawBuffer_SRV( 1, positions ) )
+			.addItem( nvrhi::BindingSetItem::RawBuffer_SRV( 2, normals ) )
+			.addItem( nvrhi::BindingSetItem::RawBuffer_SRV( 3, model->FindVertexBuffer( face, VertexAttributeType::BoneIndices ) ) )
+			.addItem( nvrhi::BindingSetItem::RawBuffer_SRV( 4, model->FindVertexBuffer( face, VertexAttributeType::BoneWeights ) ) )
+			.addItem( nvrhi::BindingSetItem::RawBuffer_UAV( 0, skinnedFace.positionBuffer ) )
+			.addItem( nvrhi::BindingSetItem::RawBuffer_UAV( 1, skinnedFace.normalBuffer ) );
+		skinnedFace.bindingSet = backend->createBindingSet( faceSetDesc, skinningFaceBindingLayout );
+		if ( nullptr == skinnedFace.bindingSet )
+		{
+			Console->Error( format( "RenderFrontend: Failed to create skinning binding set (face %u)", face ) );
+			memoryTracker.ReleaseOwner( skin->memoryOwner );
+			return false;
+		}
+
+		// Streams 0 and 1 are positions and normals, see EntityVertexStreams
+		FaceDrawRecord& record = skin->drawRecords[face];
+		record.vertexBuffers[0] = skinnedFace.positionBuffer;
+		record.vertexBuffers[1] = skinnedFace.normalBuffer;
+		record.vertexOffsets[0] = 0U;
+		record.vertexOffsets[1] = 0U;
+	}
+
+	entity->skin = std::move( skin );
+	return true;
+}
+
+// The skinned buffers may still be in use by frames in flight
+void RenderFrontend::DestroyEntitySkin( Entity* entity )
+{
+	if ( entity->skin->pending )
+	{
+		pendingSkins.erase( std::find( pendingSkins.begin(), pendingSkins.end(), entity ) );
+	}
+
+	const MemoryTracker::OwnerId memoryOwner = entity->skin->memoryOwner;
+	releaseQueue.Enqueue( std::move( entity->skin ), frameIndex, memoryTracker, memoryOwner );
+}
+
+void RenderFrontend::SetSkinningOnCpu( bool enabled )
+{
+	skinningOnCpu = enabled;
+
+	// Redo everything, so nothing is left with the other path's results
+	for ( const auto& entity : entities )
+	{
+		Entity* entityInternal = static_cast<Entity*>( entity.get() );
+		if ( nullptr != entityInternal->skin && !entityInternal->skin->pending )
+		{
+			entityInternal->skin->pending = true;
+			pendingSkins.push_back( entityInternal );
+		}
+	}
+}
+
+// Only entities that changed since they were last skinned are processed, and only once,
+// no matter how many views and shadow maps draw them afterwards
+// All of their bones go into one palette upload, then there's one dispatch per skinned face
+void RenderFrontend::SkinEntities()
+{
+	if ( pendingSkins.empty() )
+	{
+		return;
+	}
+
+	PROFILE_SCOPE( "SkinEntities" );
+
+	if ( skinningOnCpu )
+	{
+		for ( Entity* entity : pendingSkins )
+		{
+			SkinEntityOnCpu( entity );
+			entity->skin->pending = false;
+		}
+		pendingSkins.clear();
+		stateTracker.Invalidate();
+		return;
+	}
+
+	bonePalette.clear();
+	for ( const Entity* entity : pendingSkins )
+	{
+		const EntityDesc& desc = entity->GetDesc();
+		bonePalette.insert( bonePalette.end(), desc.bones, desc.bones + desc.numBones );
+	}
+
+	const uint32_t numBones = uint32_t( bonePalette.size() );
+	if ( numBones > bonePaletteCapacity
+		&& !ResizeBonePaletteBuffer( std::max( numBones, bonePaletteCapacity * 2U ) ) )
+	{
+		return;
+	}
+
+	gpuProfiler.BeginPass( renderCommands, "Skinning" );
+
+	const size_t paletteBytes = bonePalette.size() * sizeof( Mat4 );
+	renderCommands->writeBuffer( bonePaletteBuffer, bonePalette.data(), paletteBytes );
+	commandStats.Record( RenderCommand::WriteBuffer, paletteBytes );
+
+	SkinningConstants constants{};
+	for ( Entity* entity : pendingSkins )
+	{
+		const EntityDesc& desc = static_cast<const Entity*>( entity )->GetDesc();
+		constants.numBones = uint32_t( desc.numBones );
+
+		for ( const SkinnedFace& face : entity->skin->faces )
+		{
+			if ( nullptr == face.bindingSet )
+			{
+				continue;
+			}
+
+			auto computeState = nvrhi::ComputeState()
+				.setPipeline( skinningPipeline )
+				.addBindingSet( skinningPaletteBindingSet )
+				.addBindingSet( face.bindingSet );
+			renderCommands->setComputeState( computeState );
+
+			constants.numVertices = face.numVertices;
+			renderCommands->setPushConstants( &constants, sizeof( constants ) );
+
+			const uint32_t numGroups = (face.numVertices + SkinningGroupSize - 1U) / SkinningGroupSize;
+			renderCommands->dispatch( numGroups );
+			commandStats.Record( RenderCommand::Dispatch, numGroups );
+			verticesSkinned += face.numVertices;
+		}
+
+		constants.firstBone += constants.numBones;
+		entity->skin->pending = false;
+	}
+	pendingSkins.clear();
+
+	gpuProfiler.EndPass( renderCommands );
+
+	// Compute drops the graphics state
+	stateTracker.Invalidate();
+}
+
+// Fallback path, the results are uploaded into the same buffers the compute pass writes
+void RenderFrontend::SkinEntityOnCpu( Entity* entity )
+{
+	const EntityDesc& desc = static_cast<const Entity*>( entity )->GetDesc();
+	const Model* model = static_cast<const Model*>( desc.model );
+
+	for ( uint32_t faceIndex = 0U; faceIndex < entity->skin->faces.size(); faceIndex++ )
+	{
+		const SkinnedFace& face = entity->skin->faces[faceIndex];
+		const VertexData* data = FindFaceData( model->GetAsset(), faceIndex );
+		if ( nullptr == face.positionBuffer || nullptr == data )
+		{
+			continue;
+		}
+
+		const auto* positions = FindSegment( *data, VertexAttributeType::Position );
+		const auto* normals = FindSegment( *data, VertexAttributeType::Normal );
+		const auto* boneIndices = FindSegment( *data, VertexAttributeType::BoneIndices );
+		const auto* boneWeights = FindSegment( *data, VertexAttributeType::BoneWeights );
+		if ( nullptr == positions || nullptr == normals || nullptr == boneIndices || nullptr == boneWeights )
+		{
+			continue;
+		}
+
+		skinnedPositions.resize( size_t( face.numVertices ) * 3U );
+		skinnedNormals.resize( size_t( face.numVertices ) * 4U );
+		Skinning::SkinVertices( reinterpret_cast<const float*>( positions->rawData.data() ),
+			reinterpret_cast<const int8_t*>( normals->rawData.data() ),
+			reinterpret_cast<const uint8_t*>( boneIndices->rawData.data() ),
+			reinterpret_cast<const uint8_t*>( boneWeights->rawData.data() ),
+			face.numVertices, desc.bones, desc.numBones, skinnedPositions.data(), skinnedNormals.data(), skinningBoneColumns );
+
+		const size_t positionBytes = skinnedPositions.size() * sizeof( float );
+		renderCommands->writeBuffer( face.positionBuffer, skinnedPositions.data(), positionBytes );
+		commandStats.Record( RenderCommand::WriteBuffer, positionBytes );
+		renderCommands->writeBuffer( face.normalBuffer, skinnedNormals.data(), skinnedNormals.size() );
+		commandStats.Record( RenderCommand::WriteBuffer, skinnedNormals.size() );
+		verticesSkinned += face.numVertices;
+	}
+}
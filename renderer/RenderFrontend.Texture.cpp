@@ -1,80 +1,323 @@
-// SPDX-FileCopyrightText: 2022 Admer Šuko
-// SPDX-License-Identifier: MIT
-
-#include "Precompiled.hpp"
-#include "RenderFrontend.hpp"
-
-static nvrhi::Format WindowFormatToNvrhi( WindowVideoFormat format )
-{
-	switch ( format )
-	{
-	case WindowVideoFormat::SRGBA8: return nvrhi::Format::SRGBA8_UNORM;
-	case WindowVideoFormat::SBGRA8: return nvrhi::Format::SBGRA8_UNORM;
-	case WindowVideoFormat::RGBA8: return nvrhi::Format::RGBA8_UNORM;
-	case WindowVideoFormat::BGRA8: return nvrhi::Format::BGRA8_UNORM;
-	}
-
-	return nvrhi::Format::UNKNOWN;
-}
-
-std::pair<nvrhi::TextureHandle, nvrhi::TextureHandle> RenderFrontend::CreateFramebufferImagesForView( const ViewDesc& desc )
-{
-	// This seems to be the optimal set of flags for attachments
-	// Works in both Vulkan and DX12
-	using RStates = nvrhi::ResourceStates;
-	const RStates ColourBufferStates = RStates::RenderTarget;
-	const RStates DepthBufferStates = RStates::DepthWrite;
-
-	auto colourAttachmentDesc = nvrhi::TextureDesc()
-		.setWidth( window->GetSize().x )
-		.setHeight( window->GetSize().y )
-		.setFormat( WindowFormatToNvrhi( window->GetVideoMode().format ) )
-		.setDimension( nvrhi::TextureDimension::Texture2D )
-		.setKeepInitialState( true )
-		.setInitialState( ColourBufferStates )
-		.setIsRenderTarget( true )
-		.setDebugName( "Colour attachment image" );
-
-	nvrhi::TextureHandle colourTexture = backend->createTexture( colourAttachmentDesc );
-	if ( nullptr == colourTexture )
-	{
-		Console->Error( "Failed to create colour component for renderview" );
-		return { nullptr, nullptr };
-	}
-
-	auto depthAttachmentDesc = colourAttachmentDesc
-		.setFormat( nvrhi::Format::D32 ) // we don't use a stencil buffer here
-		.setDimension( nvrhi::TextureDimension::Texture2D )
-		.setInitialState( DepthBufferStates )
-		.setDebugName( "Depth attachment image" );
-
-	nvrhi::TextureHandle depthTexture = backend->createTexture( depthAttachmentDesc );
-	if ( nullptr == depthTexture )
-	{
-		Console->Error( "Failed to create depth component for renderview" );
-		return { nullptr, nullptr };
-	}
-
-	return { colourTexture, depthTexture };
-}
-
-nvrhi::FramebufferHandle RenderFrontend::CreateFramebufferFromImages( nvrhi::ITexture* colourTexture, nvrhi::ITexture* depthTexture )
-{
-	auto framebufferDesc = nvrhi::FramebufferDesc()
-		.addColorAttachment( colourTexture )
-		.setDepthAttachment( depthTexture );
-
-	return backend->createFramebuffer( framebufferDesc );
-}
-
-nvrhi::BindingSetHandle RenderFrontend::CreateBindingSetForView( nvrhi::TextureHandle colourTexture, nvrhi::TextureHandle depthTexture )
-{
-	// Todo: the sampler for the framebuffer could potentially be nearest sometimes,
-	// might wanna have it controllable per-view
-	auto bindingSetDesc = nvrhi::BindingSetDesc()
-		.addItem( nvrhi::BindingSetItem::Texture_SRV( 0, colourTexture ) )
-		.addItem( nvrhi::BindingSetItem::Texture_SRV( 1, depthTexture ) )
-		.addItem( nvrhi::BindingSetItem::Sampler( 0, screenSampler ) );
-
-	return backend->createBindingSet( bindingSetDesc, screenBindingLayout );
-}
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "RenderFrontend.hpp"
+#include "Profiler.hpp"
+#include "Texture.hpp"
+
+std::pair<nvrhi::TextureHandle, nvrhi::TextureHandle> RenderFrontend::CreateFramebufferImagesForView( const ViewDesc& desc, MemoryTracker::OwnerId memoryOwner )
+{
+	// This seems to be the optimal set of flags for attachments
+	// Works in both Vulkan and DX12
+	using RStates = nvrhi::ResourceStates;
+	const RStates ColourBufferStates = RStates::RenderTarget;
+	const RStates DepthBufferStates = RStates::DepthWrite;
+
+	// Views with dynamic resolution render into a part of these
+	// Colour is HDR, it's brought into the window's range by tonemapping, see RenderPostProcess
+	auto colourAttachmentDesc = nvrhi::TextureDesc()
+		.setWidth( uint32_t( desc.viewportSize.x ) )
+		.setHeight( uint32_t( desc.viewportSize.y ) )
+		.setFormat( nvrhi::Format::RGBA16_FLOAT )
+		.setDimension( nvrhi::TextureDimension::Texture2D )
+		.setKeepInitialState( true )
+		.setInitialState( ColourBufferStates )
+		.setIsRenderTarget( true )
+		.setDebugName( "Colour attachment image" );
+
+	nvrhi::TextureHandle colourTexture = backend->createTexture( colourAttachmentDesc );
+	if ( nullptr == colourTexture )
+	{
+		Console->Error( "Failed to create colour component for renderview" );
+		return { nullptr, nullptr };
+	}
+
+	commandStats.Record( RenderCommand::CreateTexture );
+	memoryTracker.Allocate( memoryOwner, GetMipByteSize( colourAttachmentDesc.format, colourAttachmentDesc.width, colourAttachmentDesc.height, 0U ) );
+
+	auto depthAttachmentDesc = colourAttachmentDesc
+		.setFormat( nvrhi::Format::D32 ) // we don't use a stencil buffer here
+		.setDimension( nvrhi::TextureDimension::Texture2D )
+		.setInitialState( DepthBufferStates )
+		.setDebugName( "Depth attachment image" );
+
+	nvrhi::TextureHandle depthTexture = backend->createTexture( depthAttachmentDesc );
+	if ( nullptr == depthTexture )
+	{
+		Console->Error( "Failed to create depth component for renderview" );
+		return { nullptr, nullptr };
+	}
+
+	commandStats.Record( RenderCommand::CreateTexture );
+	memoryTracker.Allocate( memoryOwner, GetMipByteSize( depthAttachmentDesc.format, depthAttachmentDesc.width, depthAttachmentDesc.height, 0U ) );
+
+	return { colourTexture, depthTexture };
+}
+
+nvrhi::FramebufferHandle RenderFrontend::CreateFramebufferFromImages( nvrhi::ITexture* colourTexture, nvrhi::ITexture* depthTexture )
+{
+	auto framebufferDesc = nvrhi::FramebufferDesc()
+		.addColorAttachment( colourTexture )
+		.setDepthAttachment( depthTexture );
+
+	return backend->createFramebuffer( framebufferDesc );
+}
+
+nvrhi::BindingSetHandle RenderFrontend::CreateBindingSetForView( nvrhi::TextureHandle colourTexture, nvrhi::TextureHandle depthTexture )
+{
+	// Todo: the sampler for the framebuffer could potentially be nearest sometimes,
+	// might wanna have it controllable per-view
+	auto bindingSetDesc = nvrhi::BindingSetDesc()
+		.addItem( nvrhi::BindingSetItem::Texture_SRV( 0, colourTexture ) )
+		.addItem( nvrhi::BindingSetItem::Texture_SRV( 1, depthTexture ) )
+		.addItem( nvrhi::BindingSetItem::Sampler( 0, screenSampler ) )
+		.addItem( nvrhi::BindingSetItem::PushConstants( 0, sizeof( ScreenConstants ) ) );
+
+	return backend->createBindingSet( bindingSetDesc, screenBindingLayout );
+}
+
+// Limits how much streamed texture data gets uploaded in a single frame
+constexpr size_t MaxTextureUploadBytesPerFrame = 16U * 1024U * 1024U;
+
+nvrhi::TextureHandle RenderFrontend::CreateStreamedTextureImage( const Texture* texture, uint32_t firstMip )
+{
+	const TextureSource& source = texture->GetSource();
+
+	auto textureDesc = nvrhi::TextureDesc()
+		.setWidth( std::max( source.width >> firstMip, 1U ) )
+		.setHeight( std::max( source.height >> firstMip, 1U ) )
+		.setMipLevels( source.numMips - firstMip )
+		.setFormat( source.format )
+		.setDimension( nvrhi::TextureDimension::Texture2D )
+		.setKeepInitialState( true )
+		.setInitialState( nvrhi::ResourceStates::ShaderResource )
+		.setDebugName( "Streamed texture" );
+
+	nvrhi::TextureHandle image = backend->createTexture( textureDesc );
+	if ( nullptr != image )
+	{
+		commandStats.Record( RenderCommand::CreateTexture );
+	}
+
+	return image;
+}
+
+// Creates a new image for the new set of resident mips, copies over the mips that both images
+// have in common, and uploads newly loaded ones. Works in both directions, i.e. for eviction too
+bool RenderFrontend::ChangeTextureResidency( Texture* texture, uint32_t newFirstMip, const Vector<const MipLoadResult*>& newMips )
+{
+	const TextureSource& source = texture->GetSource();
+	const uint32_t oldFirstMip = texture->GetFirstResidentMip();
+
+	nvrhi::TextureHandle image = CreateStreamedTextureImage( texture, newFirstMip );
+	if ( nullptr == image )
+	{
+		Console->Error( "RenderFrontend: failed to create image for streamed texture" );
+		return false;
+	}
+
+	transferCommands->open();
+
+	if ( nullptr != texture->GetHandle() )
+	{
+		for ( uint32_t mip = std::max( oldFirstMip, newFirstMip ); mip < source.numMips; mip++ )
+		{
+			transferCommands->copyTexture(
+				image, nvrhi::TextureSlice().setMipLevel( mip - newFirstMip ),
+				texture->GetHandle(), nvrhi::TextureSlice().setMipLevel( mip - oldFirstMip ) );
+			commandStats.Record( RenderCommand::CopyTexture );
+		}
+	}
+
+	const nvrhi::FormatInfo& formatInfo = nvrhi::getFormatInfo( source.format );
+	for ( const MipLoadResult* newMip : newMips )
+	{
+		const uint32_t mipWidth = std::max( source.width >> newMip->mip, 1U );
+		const size_t rowPitch = size_t( (mipWidth + formatInfo.blockSize - 1U) / formatInfo.blockSize ) * formatInfo.bytesPerBlock;
+		transferCommands->writeTexture( image, 0U, newMip->mip - newFirstMip, newMip->data.data(), rowPitch );
+		commandStats.Record( RenderCommand::WriteTexture, newMip->data.size() );
+	}
+
+	transferCommands->close();
+	backend->executeCommandList( transferCommands, nvrhi::CommandQueue::Graphics );
+	commandStats.Record( RenderCommand::ExecuteCommandList );
+
+	// Frames in flight may still be sampling the old image
+	if ( nullptr != texture->GetHandle() )
+	{
+		releaseQueue.Enqueue( std::make_unique<nvrhi::TextureHandle>( texture->GetHandle() ), frameIndex,
+			memoryTracker, MemoryTracker::InvalidOwner );
+	}
+
+	textureMemoryUsage -= texture->GetResidentBytes();
+	memoryTracker.Free( texture->memoryOwner, texture->GetResidentBytes() );
+	texture->SetResidentMips( image, newFirstMip );
+	textureMemoryUsage += texture->GetResidentBytes();
+	memoryTracker.Allocate( texture->memoryOwner, texture->GetResidentBytes() );
+	UpdateTextureDescriptor( texture );
+
+	return true;
+}
+
+// Low mips are loaded right away, on the calling thread, so a texture always has something to show
+bool RenderFrontend::LoadPersistentMips( Texture* texture )
+{
+	const TextureSource& source = texture->GetSource();
+
+	Vector<MipLoadResult> loaded;
+	for ( uint32_t mip = texture->GetPersistentMip(); mip < source.numMips; mip++ )
+	{
+		MipLoadResult& result = loaded.emplace_back();
+		result.mip = mip;
+		result.success = source.loadMip( mip, result.data );
+
+		const size_t expectedSize = GetMipByteSize( source.format, source.width, source.height, mip );
+		if ( !result.success || result.data.size() < expectedSize )
+		{
+			Console->Error( format( "RenderFrontend: failed to load mip %u of a texture", mip ) );
+			return false;
+		}
+	}
+
+	Vector<const MipLoadResult*> newMips;
+	for ( const auto& result : loaded )
+	{
+		newMips.push_back( &result );
+	}
+
+	return ChangeTextureResidency( texture, texture->GetPersistentMip(), newMips );
+}
+
+// Drops streamed mips of the least recently used textures until at least bytesToFree are freed
+// Textures used last frame are left alone, the same test UpdateTextureStreaming uses to request more mips,
+// so nothing it's about to request gets evicted. Neither are textures with a load in flight
+size_t RenderFrontend::EvictTextureMips( size_t bytesToFree )
+{
+	Vector<Texture*> candidates;
+	for ( auto& [id, texture] : streamedTextures )
+	{
+		if ( texture->loadPending || texture->GetLastUsedFrame() + 1U >= frameIndex )
+		{
+			continue;
+		}
+
+		if ( texture->GetFirstResidentMip() < texture->GetPersistentMip() )
+		{
+			candidates.push_back( texture );
+		}
+	}
+
+	std::sort( candidates.begin(), candidates.end(), []( const Texture* a, const Texture* b )
+		{
+			return a->GetLastUsedFrame() < b->GetLastUsedFrame();
+		} );
+
+	size_t freed = 0U;
+	for ( Texture* texture : candidates )
+	{
+		if ( freed >= bytesToFree )
+		{
+			break;
+		}
+
+		const size_t before = texture->GetResidentBytes();
+		if ( ChangeTextureResidency( texture, texture->GetPersistentMip(), {} ) )
+		{
+			freed += before - texture->GetResidentBytes();
+		}
+	}
+
+	return freed;
+}
+
+void RenderFrontend::UpdateTextureStreaming()
+{
+	PROFILE_SCOPE( "UpdateTextureStreaming" );
+
+	textureStreamer.CollectResults( pendingMipUploads );
+
+	// Upload finished loads, spread across frames if there's a lot of them
+	size_t uploadedBytes = 0U;
+	size_t numProcessed = 0U;
+	for ( ; numProcessed < pendingMipUploads.size() && uploadedBytes < MaxTextureUploadBytesPerFrame; numProcessed++ )
+	{
+		const MipLoadResult& result = pendingMipUploads[numProcessed];
+
+		auto it = streamedTextures.find( result.textureId );
+		if ( it == streamedTextures.end() )
+		{
+			// Destroyed in the meantime
+			continue;
+		}
+
+		Texture* texture = it->second;
+		const TextureSource& source = texture->GetSource();
+		const size_t expectedSize = GetMipByteSize( source.format, source.width, source.height, result.mip );
+		texture->loadPending = false;
+		textureMemoryPending -= texture->loadPendingBytes;
+		texture->loadPendingBytes = 0U;
+
+		if ( !result.success || result.data.size() < expectedSize )
+		{
+			Console->Warning( format( "RenderFrontend: failed to stream in mip %u of a texture", result.mip ) );
+			continue;
+		}
+
+		// Could've been evicted while loading, in which case this mip no longer connects to the resident ones
+		if ( result.mip + 1U != texture->GetFirstResidentMip() )
+		{
+			continue;
+		}
+
+		ChangeTextureResidency( texture, result.mip, { &result } );
+		uploadedBytes += result.data.size();
+	}
+	pendingMipUploads.erase( pendingMipUploads.begin(), pendingMipUploads.begin() + numProcessed );
+
+	// Textures that were used last frame and want more detail get one more mip
+	Vector<Texture*> wantMore;
+	size_t requestedBytes = 0U;
+	for ( auto& [id, texture] : streamedTextures )
+	{
+		if ( texture->loadPending || texture->GetLastUsedFrame() + 1U < frameIndex )
+		{
+			continue;
+		}
+
+		if ( texture->GetWantedMip() < texture->GetFirstResidentMip() )
+		{
+			wantMore.push_back( texture );
+			const TextureSource& source = texture->GetSource();
+			requestedBytes += GetMipByteSize( source.format, source.width, source.height, texture->GetFirstResidentMip() - 1U );
+		}
+	}
+
+	const size_t projectedUsage = textureMemoryUsage + textureMemoryPending + requestedBytes;
+	if ( projectedUsage > textureMemoryBudget )
+	{
+		EvictTextureMips( projectedUsage - textureMemoryBudget );
+	}
+
+	// Textures that are furthest from what they want go first
+	std::sort( wantMore.begin(), wantMore.end(), []( const Texture* a, const Texture* b )
+		{
+			return (a->GetFirstResidentMip() - a->GetWantedMip()) > (b->GetFirstResidentMip() - b->GetWantedMip());
+		} );
+
+	for ( Texture* texture : wantMore )
+	{
+		const TextureSource& source = texture->GetSource();
+		const uint32_t mip = texture->GetFirstResidentMip() - 1U;
+		const size_t mipBytes = GetMipByteSize( source.format, source.width, source.height, mip );
+		if ( textureMemoryUsage + textureMemoryPending + mipBytes > textureMemoryBudget )
+		{
+			continue;
+		}
+
+		texture->loadPending = true;
+		texture->loadPendingBytes = mipBytes;
+		textureMemoryPending += mipBytes;
+		textureStreamer.Request( texture->GetStreamingId(), mip, source.loadMip );
+	}
+}
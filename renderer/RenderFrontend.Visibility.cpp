@@ -0,0 +1,283 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "RenderFrontend.hpp"
+#include "Entity.hpp"
+#include "Profiler.hpp"
+#include "View.hpp"
+#include "Volume.hpp"
+
+// Beyond this, portal chains are not followed any further
+constexpr uint32_t MaxPortalDepth = 32U;
+
+// Picks the smallest volume that contains the point, since cells may be nested
+Volume* RenderFrontend::FindVolumeAt( const Vec3& point ) const
+{
+	Volume* result = nullptr;
+	float resultArea = FLT_MAX;
+
+	for ( const auto& volumePtr : volumes )
+	{
+		Volume* volume = static_cast<Volume*>( volumePtr.get() );
+		const Bounds& bounds = volume->GetBounds();
+		if ( !bounds.IsValid() || !bounds.Contains( { point, point } ) )
+		{
+			continue;
+		}
+
+		const float area = bounds.GetSurfaceArea();
+		if ( area < resultArea )
+		{
+			result = volume;
+			resultArea = area;
+		}
+	}
+
+	return result;
+}
+
+void RenderFrontend::AssignEntityToVolumes( Entity* entity )
+{
+	UnassignEntityFromVolumes( entity );
+
+	for ( const auto& volumePtr : volumes )
+	{
+		Volume* volume = static_cast<Volume*>( volumePtr.get() );
+		if ( volume->GetBounds().Overlaps( entity->GetWorldBounds() ) )
+		{
+			volume->AddEntity( entity );
+			entity->cells.push_back( volume );
+		}
+	}
+}
+
+void RenderFrontend::UnassignEntityFromVolumes( Entity* entity )
+{
+	for ( Volume* volume : entity->cells )
+	{
+		volume->RemoveEntity( entity );
+	}
+
+	entity->cells.clear();
+}
+
+// Projects the portal polygon and narrows the frustum's NDC rectangle down to it
+// Returns false if nothing can be seen through the portal
+static bool ClipFrustumToPortal( const Frustum& frustum, const Portal& portal, Frustum& outFrustum )
+{
+	Vector<Vec4> clipPoints;
+	clipPoints.reserve( portal.points.size() );
+	for ( const Vec3& point : portal.points )
+	{
+		clipPoints.push_back( TransformPoint( frustum.viewProjection, point ) );
+	}
+
+	// Clip against the near plane first, so points behind the camera don't get flipped
+	Vector<Vec4> nearClipped;
+	nearClipped.reserve( clipPoints.size() + 1U );
+	for ( size_t i = 0U; i < clipPoints.size(); i++ )
+	{
+		const Vec4& a = clipPoints[i];
+		const Vec4& b = clipPoints[(i + 1U) % clipPoints.size()];
+		const bool aInside = a.m.z >= 0.0f;
+		const bool bInside = b.m.z >= 0.0f;
+
+		if ( aInside )
+		{
+			nearClipped.push_back( a );
+		}
+
+		if ( aInside != bInside )
+		{
+			const float t = a.m.z / (a.m.z - b.m.z);
+			nearClipped.push_back( Vec4(
+				a.m.x + (b.m.x - a.m.x) * t,
+				a.m.y + (b.m.y - a.m.y) * t,
+				0.0f,
+				a.m.w + (b.m.w - a.m.w) * t ) );
+		}
+	}
+
+	if ( nearClipped.empty() )
+	{
+		return false;
+	}
+
+	float minX = FLT_MAX, maxX = -FLT_MAX;
+	float minY = FLT_MAX, maxY = -FLT_MAX;
+	for ( const Vec4& point : nearClipped )
+	{
+		// The camera is practically standing in the portal, so it can see through all of it
+		if ( point.m.w <= 1.0e-5f )
+		{
+			outFrustum = frustum;
+			return true;
+		}
+
+		const float x = point.m.x / point.m.w;
+		const float y = point.m.y / point.m.w;
+		minX = std::min( minX, x );
+		maxX = std::max( maxX, x );
+		minY = std::min( minY, y );
+		maxY = std::max( maxY, y );
+	}
+
+	outFrustum = frustum;
+	outFrustum.left = std::max( frustum.left, minX );
+	outFrustum.right = std::min( frustum.right, maxX );
+	outFrustum.bottom = std::max( frustum.bottom, minY );
+	outFrustum.top = std::min( frustum.top, maxY );
+
+	return !outFrustum.IsEmpty();
+}
+
+void RenderFrontend::WalkPortals( const Volume* volume, const Frustum& frustum, const Volume* cameraVolume, uint32_t depth )
+{
+	VolumeVisibility& visibility = volumeVisibility[volume->index];
+	if ( !visibility.reached )
+	{
+		visibility.frustum = frustum;
+		visibility.reached = true;
+	}
+	else
+	{
+		Frustum& reached = visibility.frustum;
+
+		// Seen through an equal or larger opening before, nothing new to find here
+		if ( reached.left <= frustum.left && reached.right >= frustum.right
+			&& reached.bottom <= frustum.bottom && reached.top >= frustum.top )
+		{
+			return;
+		}
+
+		reached.left = std::min( reached.left, frustum.left );
+		reached.right = std::max( reached.right, frustum.right );
+		reached.bottom = std::min( reached.bottom, frustum.bottom );
+		reached.top = std::max( reached.top, frustum.top );
+	}
+
+	if ( depth >= MaxPortalDepth )
+	{
+		return;
+	}
+
+	visibility.onPath = true;
+	for ( const Portal& portal : volume->GetPortals() )
+	{
+		const Volume* target = portal.target;
+		if ( volumeVisibility[target->index].onPath || !cameraVolume->IsInPVS( target->index ) )
+		{
+			continue;
+		}
+
+		Frustum clipped;
+		if ( !ClipFrustumToPortal( frustum, portal, clipped ) )
+		{
+			continue;
+		}
+
+		WalkPortals( target, clipped, cameraVolume, depth + 1U );
+	}
+	visibility.onPath = false;
+}
+
+// If the camera is inside a visibility cell, only the cells reachable through portals
+// are considered, each with its own narrowed frustum. Entities outside of all cells
+// are not visible from inside. Otherwise, this is a plain frustum query
+void RenderFrontend::GatherVisibleEntities( const View* view, Vector<IEntity*>& outEntities )
+{
+	PROFILE_SCOPE( "GatherVisibleEntities" );
+
+	const Frustum frustum = view->GetFrustum();
+	const Volume* cameraVolume = FindVolumeAt( view->GetOrigin() );
+
+	if ( nullptr == cameraVolume )
+	{
+		entityTree.QueryFrustum( frustum, outEntities );
+		return;
+	}
+
+	volumeVisibility.assign( volumes.size(), VolumeVisibility() );
+	WalkPortals( cameraVolume, frustum, cameraVolume, 0U );
+
+	visibilityStamp++;
+	for ( const auto& volumePtr : volumes )
+	{
+		const Volume* volume = static_cast<const Volume*>( volumePtr.get() );
+		const VolumeVisibility& visibility = volumeVisibility[volume->index];
+		if ( !visibility.reached )
+		{
+			continue;
+		}
+
+		for ( Entity* entity : volume->GetEntities() )
+		{
+			if ( entity->visibilityStamp == visibilityStamp )
+			{
+				continue;
+			}
+
+			if ( visibility.frustum.Test( entity->GetWorldBounds() ) != FrustumTestResult::Outside )
+			{
+				entity->visibilityStamp = visibilityStamp;
+				outEntities.push_back( entity );
+			}
+		}
+	}
+}
+
+// Views without a camera volume share a single pass over the entity tree
+// The ones that are inside a volume go through portals, each on its own
+void RenderFrontend::GatherVisibleEntities( const View* const* viewList, uint32_t numViews, Vector<VisibleEntity>& outEntities )
+{
+	PROFILE_SCOPE( "GatherVisibleEntities" );
+
+	Frustum frusta[EntityTree::MaxFrusta];
+	numViews = std::min( numViews, EntityTree::MaxFrusta );
+
+	uint64_t portalViews = 0U;
+	for ( uint32_t i = 0U; i < numViews; i++ )
+	{
+		frusta[i] = viewList[i]->GetFrustum();
+		if ( !volumes.empty() && nullptr != FindVolumeAt( viewList[i]->GetOrigin() ) )
+		{
+			// Empty frusta are skipped by the tree query
+			frusta[i].left = frusta[i].right;
+			portalViews |= 1ULL << i;
+		}
+	}
+
+	entityTree.QueryFrusta( frusta, numViews, outEntities );
+	if ( 0U == portalViews )
+	{
+		return;
+	}
+
+	Map<IEntity*, size_t> entityIndices;
+	for ( size_t i = 0U; i < outEntities.size(); i++ )
+	{
+		entityIndices[outEntities[i].entity] = i;
+	}
+
+	Vector<IEntity*> portalEntities;
+	for ( uint32_t i = 0U; i < numViews; i++ )
+	{
+		if ( 0U == (portalViews & (1ULL << i)) )
+		{
+			continue;
+		}
+
+		portalEntities.clear();
+		GatherVisibleEntities( viewList[i], portalEntities );
+		for ( IEntity* entity : portalEntities )
+		{
+			auto [it, inserted] = entityIndices.try_emplace( entity, outEntities.size() );
+			if ( inserted )
+			{
+				outEntities.push_back( { entity, 0U } );
+			}
+			outEntities[it->second].frustumMask |= 1ULL << i;
+		}
+	}
+}
@@ -1,426 +1,1334 @@
-// SPDX-FileCopyrightText: 2022 Admer Šuko
-// SPDX-License-Identifier: MIT
-
-#include "Precompiled.hpp"
-#include "RenderFrontend.hpp"
-#include "Entity.hpp"
-#include "View.hpp"
-#include <nvrhi/utils.h>
-
-static PluginRegistry Registry( EngineVersion );
-
-ADM_API PluginRegistry* GetPluginRegistry()
-{
-	return &Registry.Register<RenderFrontend>();
-}
-
-bool RenderFrontend::Init( const EngineAPI& api )
-{
-	Core = api.core;
-	Console = api.console;
-	FileSystem = api.fileSystem;
-	ModelManager = api.modelManager;
-	MaterialManager = api.materialManager;
-
-	Console->Print( "RenderFrontend::Init" );
-
-	return true;
-}
-
-void RenderFrontend::Shutdown()
-{
-	Console->Print( "RenderFrontend::Shutdown" );
-
-	batches.clear();
-	entities.clear();
-	lights.clear();
-	textures.clear();
-	views.clear();
-	volumes.clear();
-	models.clear();
-
-	backend = nullptr;
-
-	Core = nullptr;
-	Console = nullptr;
-	FileSystem = nullptr;
-	ModelManager = nullptr;
-	MaterialManager = nullptr;
-}
-
-void RenderFrontend::Update()
-{
-
-}
-
-IBackend* RenderFrontend::GetBackend() const
-{
-	return backend;
-}
-
-void RenderFrontend::BeginFrame()
-{
-	backendManager->BeginFrame();
-}
-
-// Renders a fullscreen quad into the backbuffer
-// The main framebuffer is mapped onto this quad
-void RenderFrontend::EndFrameAndPresent( const IView* view )
-{
-	const nvrhi::Viewport windowViewport = { window->GetSize().x, window->GetSize().y };
-	auto graphicsState = nvrhi::GraphicsState()
-		.addBindingSet( view->GetBindingSet() )
-		.addVertexBuffer( { screenVertexBuffer, 0, 0 } )
-		.setIndexBuffer( { screenIndexBuffer, nvrhi::Format::R32_UINT, 0 } )
-		.setFramebuffer( backendManager->GetCurrentFramebuffer() )
-		.setPipeline( screenPipeline );
-	graphicsState.viewport.addViewportAndScissorRect( windowViewport );
-
-	// Vertex count is actually index count in this case
-	const auto drawArgs = nvrhi::DrawArguments().setVertexCount( 6 );
-
-	renderCommands->open();
-	renderCommands->setGraphicsState( graphicsState );
-
-	renderCommands->drawIndexed( drawArgs );
-
-	renderCommands->close();
-	backend->executeCommandList( renderCommands );
-
-	backendManager->Present();
-	backend->runGarbageCollection();
-}
-
-// Currently this just clears the render view, doesn't render any entities into it
-// Must do that soon and give render views their own framebuffers
-void RenderFrontend::RenderView( const IView* view )
-{
-	const Vec4 c = view->GetDesc().clearColour;
-	const nvrhi::Color clearColour = { c.m.x, c.m.y, c.m.z, c.m.w };
-
-	renderCommands->open();
-	renderCommands->clearTextureFloat( view->GetColourTexture(), nvrhi::AllSubresources, clearColour );
-	renderCommands->clearDepthStencilTexture( view->GetDepthTexture(), nvrhi::AllSubresources, true, 1.0f, false, 0 );
-
-	renderCommands->writeBuffer( viewDataBuffer, &currentViewData, sizeof( currentViewData ) );
-
-	for ( const auto& entity : entities )
-	{
-		RenderEntity( view, entity.get() );
-	}
-
-	renderCommands->close();
-
-	backend->executeCommandList( renderCommands );
-}
-
-void RenderFrontend::DebugLine( adm::Vec3 start, adm::Vec3 end, adm::Vec3 colour, float life, bool depthTest )
-{
-
-}
-
-void RenderFrontend::DebugRay( adm::Vec3 start, adm::Vec3 direction, float length, bool withArrowhead, adm::Vec3 colour, float life, bool depthTest )
-{
-
-}
-
-void RenderFrontend::DebugBox( adm::Vec3 min, adm::Vec3 max, adm::Vec3 colour, float life, bool depthTest )
-{
-
-}
-
-void RenderFrontend::DebugCube( adm::Vec3 position, float extents, adm::Vec3 colour, float life, bool depthTest )
-{
-}
-
-void RenderFrontend::DebugSphere( adm::Vec3 position, float extents, adm::Vec3 colour, float life, bool depthTest )
-{
-}
-
-IBatch* RenderFrontend::CreateBatch( const BatchDesc& desc )
-{
-	return nullptr;
-}
-
-bool RenderFrontend::DestroyBatch( IBatch* batch )
-{
-	return false;
-}
-
-size_t RenderFrontend::GetNumBatches() const
-{
-	return batches.size();
-}
-
-IBatch* RenderFrontend::GetBatch( uint32_t index )
-{
-	if ( index >= GetNumBatches() )
-	{
-		return nullptr;
-	}
-
-	return batches.at( index ).get();
-}
-
-IEntity* RenderFrontend::CreateEntity( const EntityDesc& desc )
-{
-	if ( nullptr == desc.model )
-	{
-		Console->Warning( "RenderFrontend::CreateEntity: tried creating an entity with no model" );
-		return false;
-	}
-
-	if ( desc.numBones > 0 && nullptr == desc.bones )
-	{
-		Console->Warning( "RenderFrontend::CreateEntity: you can't have numBones without an actual reference to a bone buffer" );
-		return false;
-	}
-
-	auto modelIt = FindIterator( models, desc.model );
-	if ( modelIt == models.end() )
-	{
-		Console->Warning( "RenderFrontend::CreateEntity: tried creating an entity with an unregistered model" );
-		return false;
-	}
-
-	return entities.emplace_back( new Entity( desc ) ).get();
-}
-
-bool RenderFrontend::DestroyEntity( IEntity* entity )
-{
-	if ( nullptr == entity )
-	{
-		Console->Warning( "RenderFrontend::DestroyEntity: tried destroying a non-existing entity" );
-		return false;
-	}
-
-	auto it = FindIterator( entities, entity );
-	if ( it == entities.end() )
-	{
-		Console->Warning( "RenderFrontend::DestroyEntity: tried destroying an unregistered entity" );
-		return false;
-	}
-
-	entities.erase( it );
-
-	return true;
-}
-
-size_t RenderFrontend::GetNumEntities() const
-{
-	return entities.size();
-}
-
-IEntity* RenderFrontend::GetEntity( uint32_t index )
-{
-	if ( index >= GetNumEntities() )
-	{
-		return nullptr;
-	}
-
-	return entities.at( index ).get();
-}
-
-ILight* RenderFrontend::CreateLight( const LightDesc& desc )
-{
-	return nullptr;
-}
-
-bool RenderFrontend::DestroyLight( ILight* light )
-{
-	return false;
-}
-
-size_t RenderFrontend::GetNumLights() const
-{
-	return lights.size();
-}
-
-ILight* RenderFrontend::GetLight( uint32_t index )
-{
-	if ( index >= GetNumLights() )
-	{
-		return nullptr;
-	}
-
-	return lights.at( index ).get();
-}
-
-ITexture* RenderFrontend::CreateTexture( const TextureDesc& desc )
-{
-	return nullptr;
-}
-
-bool RenderFrontend::DestroyTexture( ITexture* view )
-{
-	return false;
-}
-
-size_t RenderFrontend::GetNumTextures() const
-{
-	return textures.size();
-}
-
-ITexture* RenderFrontend::GetTexture( uint32_t index )
-{
-	if ( index >= GetNumTextures() )
-	{
-		return nullptr;
-	}
-
-	return textures.at( index ).get();
-}
-
-IView* RenderFrontend::CreateView( const ViewDesc& desc )
-{
-	ViewDesc descModified = desc;
-	if ( desc.viewportSize.x < 0.0f || desc.viewportSize.y < 0.0f )
-	{
-		descModified.viewportSize = window->GetSize();
-	}
-
-	auto [colourTexture, depthTexture] = CreateFramebufferImagesForView( descModified );
-	if ( nullptr == colourTexture || nullptr == depthTexture )
-	{
-		Console->Warning( "RenderFrontend::CreateView: failed to create attachments" );
-		return nullptr;
-	}
-
-	nvrhi::FramebufferHandle framebuffer = CreateFramebufferFromImages( colourTexture, depthTexture );
-	if ( nullptr == framebuffer )
-	{
-		Console->Warning( "RenderFrontend::CreateView: failed to create framebuffer for view" );
-		return nullptr;
-	}
-
-	nvrhi::BindingSetHandle bindingSet = CreateBindingSetForView( colourTexture, depthTexture );
-	if ( nullptr == bindingSet )
-	{
-		Console->Warning( "RenderFrontend::CreateView: failed to create binding set for view" );
-		return nullptr;
-	}
-
-	return views.emplace_back( new View( descModified, colourTexture, depthTexture, framebuffer, bindingSet ) ).get();
-}
-
-bool RenderFrontend::DestroyView( IView* view )
-{
-	if ( nullptr == view )
-	{
-		Console->Warning( "RenderFrontend::DestroyView: tried destroying a non-existing view" );
-		return false;
-	}
-
-	auto it = FindIterator( views, view );
-	if ( it == views.end() )
-	{
-		Console->Warning( "RenderFrontend::DestroyView: tried destroying an unregistered view" );
-		return false;
-	}
-
-	views.erase( it );
-
-	return true;
-}
-
-size_t RenderFrontend::GetNumViews() const
-{
-	return views.size();
-}
-
-IView* RenderFrontend::GetView( uint32_t index )
-{
-	if ( index >= GetNumViews() )
-	{
-		return nullptr;
-	}
-
-	return views.at( index ).get();
-}
-
-IVolume* RenderFrontend::CreateVolume( const VolumeDesc& desc )
-{
-	return nullptr;
-}
-
-bool RenderFrontend::DestroyVolume( IVolume* volume )
-{
-	return false;
-}
-
-size_t RenderFrontend::GetNumVolumes() const
-{
-	return volumes.size();
-}
-
-IVolume* RenderFrontend::GetVolume( uint32_t index )
-{
-	if ( index >= GetNumVolumes() )
-	{
-		return nullptr;
-	}
-
-	return volumes.at( index ).get();
-}
-
-IModel* RenderFrontend::CreateModel( const Assets::IModel* modelAsset )
-{
-	if ( nullptr == modelAsset )
-	{
-		Console->Warning( "RenderFrontend::CreateModel: tried creating a rendermodel from a non-existing model" );
-		return nullptr;
-	}
-
-	if ( !ValidateModelAsset( modelAsset ) )
-	{
-		Console->Warning( format( "RenderFrontend::CreateModel: model '%s' has invalid data", modelAsset->GetName().data() ) );
-		return nullptr;
-	}
-
-	IModel* model = BuildModelFromAsset( modelAsset );
-	if ( nullptr != model )
-	{
-		models.emplace_back( model );
-	}
-	else
-	{
-		Console->Warning( format( "RenderFrontend::CreateModel: model '%s' failed to upload to the GPU", modelAsset->GetName().data() ) );
-	}
-
-	return model;
-}
-
-bool RenderFrontend::DestroyModel( IModel* model )
-{
-	if ( nullptr == model )
-	{
-		Console->Warning( "RenderFrontend::DestroyModel: tried destroying a non-existing model" );
-		return false;
-	}
-
-	auto it = FindIterator( models, model );
-	if ( it == models.end() )
-	{
-		Console->Warning( "RenderFrontend::DestroyModel: tried destroying an unregistered model" );
-		return false;
-	}
-
-	models.erase( it );
-
-	return true;
-}
-
-size_t RenderFrontend::GetNumModels() const
-{
-	return models.size();
-}
-
-IModel* RenderFrontend::GetModel( uint32_t index )
-{
-	if ( index >= GetNumModels() )
-	{
-		return nullptr;
-	}
-
-	return models.at( index ).get();
-}
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "RenderFrontend.hpp"
+#include "Batch.hpp"
+#include "Entity.hpp"
+#include "Profiler.hpp"
+#include "Texture.hpp"
+#include "View.hpp"
+#include "Volume.hpp"
+#include <nvrhi/utils.h>
+
+static PluginRegistry Registry( EngineVersion );
+
+ADM_API PluginRegistry* GetPluginRegistry()
+{
+	return &Registry.Register<RenderFrontend>();
+}
+
+bool RenderFrontend::Init( const EngineAPI& api )
+{
+	Core = api.core;
+	Console = api.console;
+	FileSystem = api.fileSystem;
+	ModelManager = api.modelManager;
+	MaterialManager = api.materialManager;
+
+	Console->Print( "RenderFrontend::Init" );
+	PROFILE_THREAD( "Main" );
+	mainThread = std::this_thread::get_id();
+
+	return true;
+}
+
+void RenderFrontend::Shutdown()
+{
+	Console->Print( "RenderFrontend::Shutdown" );
+
+	if ( nullptr != backend )
+	{
+		backend->waitForIdle();
+	}
+	releaseQueue.RunRequests();
+	releaseQueue.ReleaseAll( memoryTracker );
+
+	DestroyShadowResources();
+	DestroyPostProcessResources();
+	DestroyMaterialResources();
+	batches.clear();
+	changedEntities.clear();
+	pendingSkins.clear();
+	entityTree.Clear();
+	volumes.clear();
+	entities.clear();
+	lights.clear();
+	textureStreamer.Stop();
+	workerPool.Stop();
+	pendingMipUploads.clear();
+	Profiler::Shutdown();
+	gpuProfiler.Shutdown();
+	DestroyFrameResources();
+	streamedTextures.clear();
+	textures.clear();
+	views.clear();
+	models.clear();
+	headlessFramebuffer = nullptr;
+	headlessColour = nullptr;
+
+	backend = nullptr;
+
+	Core = nullptr;
+	Console = nullptr;
+	FileSystem = nullptr;
+	ModelManager = nullptr;
+	MaterialManager = nullptr;
+}
+
+void RenderFrontend::Update()
+{
+
+}
+
+IBackend* RenderFrontend::GetBackend() const
+{
+	return backend;
+}
+
+void RenderFrontend::BeginFrame()
+{
+	// Collects the markers of the previous frame
+	PROFILE_END_FRAME();
+	PROFILE_SCOPE( "BeginFrame" );
+
+	frameIndex++;
+	AcquireFrameResources();
+
+	// Frame boundary, so this is where destruction happens
+	releaseQueue.RunRequests();
+	releaseQueue.Release( completedFrameIndex, memoryTracker );
+	textureSlots.Reclaim( completedFrameIndex );
+	materialSlotAllocator.Reclaim( completedFrameIndex );
+
+	UpdateDynamicResolution();
+	// Headless frontends have nothing to present to
+	if ( nullptr != backendManager )
+	{
+		backendManager->BeginFrame();
+	}
+	gpuProfiler.BeginFrame( frameIndex );
+
+	UpdateTextureStreaming();
+}
+
+// Renders a fullscreen quad into the backbuffer
+// The main framebuffer is mapped onto this quad
+void RenderFrontend::EndFrameAndPresent( const IView* view )
+{
+	PROFILE_SCOPE( "EndFrameAndPresent" );
+
+	renderCommands->open();
+	stateTracker.Invalidate();
+	RenderPostProcess( static_cast<const View*>( view ) );
+	renderCommands->close();
+	backend->executeCommandList( renderCommands );
+	commandStats.Record( RenderCommand::ExecuteCommandList );
+
+	// Everything of this frame has been submitted by now
+	backend->setEventQuery( currentFrame->fence, nvrhi::CommandQueue::Graphics );
+	currentFrame->submitted = true;
+
+	if ( nullptr != backendManager )
+	{
+		backendManager->Present();
+	}
+
+	{
+		PROFILE_SCOPE( "runGarbageCollection" );
+		backend->runGarbageCollection();
+	}
+
+	commandStats.EndFrame();
+}
+
+void RenderFrontend::RenderView( const IView* view )
+{
+	RenderViews( &view, 1U );
+}
+
+void RenderFrontend::RenderViews( const Vector<const IView*>& viewList )
+{
+	RenderViews( viewList.data(), uint32_t( viewList.size() ) );
+}
+
+// All views are recorded into one command list and submitted together
+// Entities are culled once for all of them, and then drawn into each view they're visible in
+// Views have their own framebuffers, so draws are replicated per view rather than per layer
+void RenderFrontend::RenderViews( const IView* const* viewList, uint32_t numViews )
+{
+	PROFILE_SCOPE( "RenderView" );
+
+	if ( numViews > EntityTree::MaxFrusta )
+	{
+		Console->Warning( format( "RenderFrontend::RenderViews: only %u views can be rendered at once, got %u",
+			EntityTree::MaxFrusta, numViews ) );
+		numViews = EntityTree::MaxFrusta;
+	}
+
+	UpdateEntityTree();
+
+	// Views that are up to date according to their policy are left out entirely,
+	// the ones that depend on what they can see are decided after culling
+	View* viewsInternal[EntityTree::MaxFrusta];
+	uint64_t renderMask = 0U;
+	uint64_t checkMask = 0U;
+	uint32_t numCandidates = 0U;
+	for ( uint32_t i = 0U; i < numViews; i++ )
+	{
+		View* view = static_cast<View*>( const_cast<IView*>( viewList[i] ) );
+		const ViewUpdate update = GetViewUpdate( view );
+		if ( update == ViewUpdate::Skip )
+		{
+			viewsReused++;
+			continue;
+		}
+
+		const uint64_t bit = 1ULL << numCandidates;
+		renderMask |= update == ViewUpdate::Render ? bit : 0U;
+		checkMask |= update == ViewUpdate::CheckChanges ? bit : 0U;
+		viewsInternal[numCandidates++] = view;
+	}
+
+	if ( 0U == numCandidates )
+	{
+		return;
+	}
+
+	visibleEntities.clear();
+	GatherVisibleEntities( viewsInternal, numCandidates, visibleEntities );
+
+	uint64_t visibleHashes[EntityTree::MaxFrusta]{};
+	uint64_t changedMask = 0U;
+	HashVisibleSets( viewsInternal, numCandidates, visibleHashes, changedMask );
+	for ( uint32_t i = 0U; i < numCandidates; i++ )
+	{
+		const uint64_t bit = 1ULL << i;
+		if ( (checkMask & bit) && ((changedMask & bit) || visibleHashes[i] != viewsInternal[i]->renderedVisibleHash) )
+		{
+			renderMask |= bit;
+		}
+	}
+
+	if ( 0U == renderMask )
+	{
+		viewsReused += numCandidates;
+		return;
+	}
+
+	renderCommands->open();
+	FlushEntityUploads();
+	FlushMaterialUploads();
+	SkinEntities();
+
+	// Passes are timed per view, so it's possible to tell which view is expensive
+	uint32_t viewIndices[EntityTree::MaxFrusta];
+	for ( uint32_t i = 0U; i < numCandidates; i++ )
+	{
+		if ( 0U == (renderMask & (1ULL << i)) )
+		{
+			viewsReused++;
+			continue;
+		}
+
+		const View* view = viewsInternal[i];
+		viewIndices[i] = uint32_t( FindIterator( views, view ) - views.begin() );
+
+		const Vec4 c = view->GetDesc().clearColour;
+		const nvrhi::Color clearColour = { c.m.x, c.m.y, c.m.z, c.m.w };
+
+		gpuProfiler.BeginPass( renderCommands, format( "View %u: clear", viewIndices[i] ) );
+		renderCommands->clearTextureFloat( view->GetColourTexture(), nvrhi::AllSubresources, clearColour );
+		commandStats.Record( RenderCommand::ClearTexture );
+		renderCommands->clearDepthStencilTexture( view->GetDepthTexture(), nvrhi::AllSubresources, true, 1.0f, false, 0 );
+		commandStats.Record( RenderCommand::ClearTexture );
+		gpuProfiler.EndPass( renderCommands );
+	}
+	// Opening the command list and clearing both drop the current state
+	stateTracker.Invalidate();
+
+	for ( uint32_t i = 0U; i < numCandidates; i++ )
+	{
+		const uint64_t viewBit = 1ULL << i;
+		if ( 0U == (renderMask & viewBit) )
+		{
+			continue;
+		}
+
+		View* viewInternal = viewsInternal[i];
+		currentViewData.viewMatrix = viewInternal->GetViewMatrix();
+		currentViewData.projectionMatrix = viewInternal->GetProjectionMatrix();
+		renderCommands->writeBuffer( viewDataBuffer, &currentViewData, sizeof( currentViewData ) );
+		commandStats.Record( RenderCommand::WriteBuffer, sizeof( currentViewData ) );
+
+		gpuProfiler.BeginPass( renderCommands, format( "View %u: entities", viewIndices[i] ) );
+
+		{
+			PROFILE_ACCUMULATOR( renderEntityTime, "RenderEntity" );
+			for ( const VisibleEntity& visible : visibleEntities )
+			{
+				if ( visible.frustumMask & viewBit )
+				{
+					PROFILE_ACCUMULATE( renderEntityTime );
+					RenderEntity( viewInternal, visible.entity );
+				}
+			}
+		}
+
+		{
+			PROFILE_ACCUMULATOR( renderBatchTime, "RenderBatch" );
+			for ( const auto& batch : batches )
+			{
+				PROFILE_ACCUMULATE( renderBatchTime );
+				RenderBatch( viewInternal, batch.get() );
+			}
+		}
+		gpuProfiler.EndPass( renderCommands );
+
+		viewInternal->hasImage = true;
+		viewInternal->updateRequested = false;
+		viewInternal->renderedFrame = frameIndex;
+		viewInternal->renderedChangeSerial = changeSerial;
+		viewInternal->renderedVisibleHash = visibleHashes[i];
+		viewInternal->renderedScale = viewInternal->resolutionScale;
+		viewInternal->ClearTransformChanged();
+		viewsRendered++;
+	}
+
+	renderCommands->close();
+
+	backend->executeCommandList( renderCommands );
+	commandStats.Record( RenderCommand::ExecuteCommandList );
+}
+
+void RenderFrontend::DebugLine( adm::Vec3 start, adm::Vec3 end, adm::Vec3 colour, float life, bool depthTest )
+{
+
+}
+
+void RenderFrontend::DebugRay( adm::Vec3 start, adm::Vec3 direction, float length, bool withArrowhead, adm::Vec3 colour, float life, bool depthTest )
+{
+
+}
+
+void RenderFrontend::DebugBox( adm::Vec3 min, adm::Vec3 max, adm::Vec3 colour, float life, bool depthTest )
+{
+
+}
+
+void RenderFrontend::DebugCube( adm::Vec3 position, float extents, adm::Vec3 colour, float life, bool depthTest )
+{
+}
+
+void RenderFrontend::DebugSphere( adm::Vec3 position, float extents, adm::Vec3 colour, float life, bool depthTest )
+{
+}
+
+// BatchDesc doesn't carry any geometry, see the overload with static entities
+IBatch* RenderFrontend::CreateBatch( const BatchDesc& desc )
+{
+	return CreateBatch( desc, {} );
+}
+
+bool RenderFrontend::DestroyBatch( IBatch* batch )
+{
+	if ( nullptr == batch )
+	{
+		Console->Warning( "RenderFrontend::DestroyBatch: tried destroying a non-existing batch" );
+		return false;
+	}
+
+	// The rest is checked when the request runs, so true only means it was queued
+	if ( std::this_thread::get_id() != mainThread )
+	{
+		releaseQueue.Request( [this, batch]() { DestroyBatch( batch ); } );
+		return true;
+	}
+
+	auto it = FindIterator( batches, batch );
+	if ( it == batches.end() )
+	{
+		Console->Warning( "RenderFrontend::DestroyBatch: tried destroying an unregistered batch" );
+		return false;
+	}
+
+	// Views that only update on changes and cached shadows need to know about it
+	MarkStaticChange( static_cast<Batch*>( batch )->GetBounds() );
+	releaseQueue.Enqueue( std::move( *it ), frameIndex, memoryTracker, static_cast<Batch*>( batch )->memoryOwner );
+	batches.erase( it );
+
+	return true;
+}
+
+size_t RenderFrontend::GetNumBatches() const
+{
+	return batches.size();
+}
+
+IBatch* RenderFrontend::GetBatch( uint32_t index )
+{
+	if ( index >= GetNumBatches() )
+	{
+		return nullptr;
+	}
+
+	return batches.at( index ).get();
+}
+
+IEntity* RenderFrontend::CreateEntity( const EntityDesc& desc )
+{
+	if ( nullptr == desc.model )
+	{
+		Console->Warning( "RenderFrontend::CreateEntity: tried creating an entity with no model" );
+		return false;
+	}
+
+	if ( desc.numBones > 0 && nullptr == desc.bones )
+	{
+		Console->Warning( "RenderFrontend::CreateEntity: you can't have numBones without an actual reference to a bone buffer" );
+		return false;
+	}
+
+	auto modelIt = FindIterator( models, desc.model );
+	if ( modelIt == models.end() )
+	{
+		Console->Warning( "RenderFrontend::CreateEntity: tried creating an entity with an unregistered model" );
+		return false;
+	}
+
+	Entity* entity = new Entity( desc, changedEntities );
+	// Views tell entities apart by address, and a new one may get the address of one destroyed just before
+	// A fresh serial makes OnChange views redraw anyway, see HashVisibleSets
+	entity->changeSerial = ++changeSerial;
+	entity->treeProxy = entityTree.Insert( entity->UpdateWorldBounds(), entity );
+	entity->dataSlot = AllocateEntitySlot();
+	QueueEntityUpload( entity->dataSlot, desc );
+	UpdateEntitySkin( entity );
+	AssignEntityToVolumes( entity );
+
+	return entities.emplace_back( entity ).get();
+}
+
+bool RenderFrontend::DestroyEntity( IEntity* entity )
+{
+	if ( nullptr == entity )
+	{
+		Console->Warning( "RenderFrontend::DestroyEntity: tried destroying a non-existing entity" );
+		return false;
+	}
+
+	auto it = FindIterator( entities, entity );
+	if ( it == entities.end() )
+	{
+		Console->Warning( "RenderFrontend::DestroyEntity: tried destroying an unregistered entity" );
+		return false;
+	}
+
+	Entity* entityInternal = static_cast<Entity*>( entity );
+	entityTree.Remove( entityInternal->treeProxy );
+	FreeEntitySlot( entityInternal->dataSlot );
+	if ( nullptr != entityInternal->skin )
+	{
+		DestroyEntitySkin( entityInternal );
+	}
+	UnassignEntityFromVolumes( entityInternal );
+	if ( entityInternal->IsChanged() )
+	{
+		changedEntities.erase( std::find( changedEntities.begin(), changedEntities.end(), entityInternal ) );
+	}
+
+	entities.erase( it );
+
+	return true;
+}
+
+size_t RenderFrontend::GetNumEntities() const
+{
+	return entities.size();
+}
+
+IEntity* RenderFrontend::GetEntity( uint32_t index )
+{
+	if ( index >= GetNumEntities() )
+	{
+		return nullptr;
+	}
+
+	return entities.at( index ).get();
+}
+
+void RenderFrontend::SetViewTransform( IView* view, const Vec3& origin, const Mat4& viewMatrix, const Mat4& projectionMatrix )
+{
+	if ( nullptr == view || FindIterator( views, view ) == views.end() )
+	{
+		Console->Warning( "RenderFrontend::SetViewTransform: tried updating an unregistered view" );
+		return;
+	}
+
+	static_cast<View*>( view )->SetTransform( origin, viewMatrix, projectionMatrix );
+}
+
+// The tree stores inflated bounds, so its results are narrowed down using the exact ones
+void RenderFrontend::QueryEntitiesInBox( const Vec3& mins, const Vec3& maxs, Vector<IEntity*>& outEntities )
+{
+	UpdateEntityTree();
+
+	const Bounds box = { mins, maxs };
+	const size_t first = outEntities.size();
+	entityTree.QueryBox( box, outEntities );
+
+	outEntities.erase( std::remove_if( outEntities.begin() + first, outEntities.end(), [&box]( const IEntity* entity )
+		{
+			return !box.Overlaps( static_cast<const Entity*>( entity )->GetWorldBounds() );
+		} ), outEntities.end() );
+}
+
+void RenderFrontend::QueryEntitiesInSphere( const Vec3& centre, float radius, Vector<IEntity*>& outEntities )
+{
+	UpdateEntityTree();
+
+	const size_t first = outEntities.size();
+	entityTree.QuerySphere( centre, radius, outEntities );
+
+	outEntities.erase( std::remove_if( outEntities.begin() + first, outEntities.end(), [&centre, radius]( const IEntity* entity )
+		{
+			return !static_cast<const Entity*>( entity )->GetWorldBounds().OverlapsSphere( centre, radius );
+		} ), outEntities.end() );
+}
+
+void RenderFrontend::QueryEntitiesAlongRay( const Vec3& start, const Vec3& rayDirection, float maxDistance, Vector<IEntity*>& outEntities )
+{
+	// Distances are in world units, so the direction is made unit length
+	const float length = std::sqrt( rayDirection.x * rayDirection.x + rayDirection.y * rayDirection.y + rayDirection.z * rayDirection.z );
+	if ( !(length > 0.0f) )
+	{
+		Console->Warning( "RenderFrontend::QueryEntitiesAlongRay: the ray has no direction" );
+		return;
+	}
+
+	const Vec3 direction = { rayDirection.x / length, rayDirection.y / length, rayDirection.z / length };
+
+	UpdateEntityTree();
+
+	Vector<IEntity*> candidates;
+	entityTree.QueryRay( start, direction, maxDistance, candidates );
+
+	const Vec3 inverseDirection = { 1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z };
+	Vector<std::pair<float, IEntity*>> hits;
+	for ( IEntity* entity : candidates )
+	{
+		float distance = 0.0f;
+		if ( static_cast<const Entity*>( entity )->GetWorldBounds().IntersectsRay( start, inverseDirection, maxDistance, distance ) )
+		{
+			hits.push_back( { distance, entity } );
+		}
+	}
+
+	std::stable_sort( hits.begin(), hits.end(), []( const auto& a, const auto& b )
+		{
+			return a.first < b.first;
+		} );
+
+	for ( const auto& hit : hits )
+	{
+		outEntities.push_back( hit.second );
+	}
+}
+
+void RenderFrontend::SetVolumeBounds( IVolume* volume, const Vec3& mins, const Vec3& maxs )
+{
+	if ( nullptr == volume || FindIterator( volumes, volume ) == volumes.end() )
+	{
+		Console->Warning( "RenderFrontend::SetVolumeBounds: tried updating an unregistered volume" );
+		return;
+	}
+
+	// Pending entity changes would otherwise get assigned twice below
+	UpdateEntityTree();
+
+	Volume* volumeInternal = static_cast<Volume*>( volume );
+	volumeInternal->SetBounds( { mins, maxs } );
+
+	// Redo the assignment of entities for this volume only
+	for ( Entity* entity : volumeInternal->GetEntities() )
+	{
+		entity->cells.erase( std::find( entity->cells.begin(), entity->cells.end(), volumeInternal ) );
+	}
+	volumeInternal->ClearEntities();
+
+	Vector<IEntity*> overlapping;
+	QueryEntitiesInBox( mins, maxs, overlapping );
+	for ( IEntity* entity : overlapping )
+	{
+		Entity* entityInternal = static_cast<Entity*>( entity );
+		volumeInternal->AddEntity( entityInternal );
+		entityInternal->cells.push_back( volumeInternal );
+	}
+}
+
+bool RenderFrontend::AddPortal( IVolume* from, IVolume* to, const Vector<Vec3>& points )
+{
+	if ( nullptr == from || nullptr == to || from == to )
+	{
+		Console->Warning( "RenderFrontend::AddPortal: a portal must connect two different, existing volumes" );
+		return false;
+	}
+
+	if ( FindIterator( volumes, from ) == volumes.end() || FindIterator( volumes, to ) == volumes.end() )
+	{
+		Console->Warning( "RenderFrontend::AddPortal: tried connecting an unregistered volume" );
+		return false;
+	}
+
+	if ( points.size() < 3U )
+	{
+		Console->Warning( "RenderFrontend::AddPortal: a portal needs at least 3 points" );
+		return false;
+	}
+
+	Volume* fromInternal = static_cast<Volume*>( from );
+	Volume* toInternal = static_cast<Volume*>( to );
+	// It would be walked through twice
+	if ( fromInternal->HasPortal( toInternal, points ) )
+	{
+		Console->Warning( "RenderFrontend::AddPortal: this portal already exists" );
+		return false;
+	}
+
+	fromInternal->AddPortal( toInternal, points );
+	toInternal->AddPortal( fromInternal, points );
+
+	return true;
+}
+
+void RenderFrontend::SetVolumePVS( IVolume* volume, const Vector<uint64_t>& bits )
+{
+	if ( nullptr == volume || FindIterator( volumes, volume ) == volumes.end() )
+	{
+		Console->Warning( "RenderFrontend::SetVolumePVS: tried updating an unregistered volume" );
+		return;
+	}
+
+	static_cast<Volume*>( volume )->SetPVS( bits );
+}
+
+ITexture* RenderFrontend::CreateTexture( const TextureDesc& desc, const TextureSource& source )
+{
+	if ( 0U == source.width || 0U == source.height || !source.loadMip )
+	{
+		Console->Warning( "RenderFrontend::CreateTexture: tried creating a texture without any data" );
+		return nullptr;
+	}
+
+	const uint32_t maxMips = 1U + uint32_t( std::log2( std::max( source.width, source.height ) ) );
+	if ( 0U == source.numMips || source.numMips > maxMips )
+	{
+		Console->Warning( format( "RenderFrontend::CreateTexture: invalid mip count %u (max. %u)", source.numMips, maxMips ) );
+		return nullptr;
+	}
+
+	Texture* texture = new Texture( desc, source, nextTextureId++ );
+	texture->memoryOwner = memoryTracker.CreateOwner( MemoryCategory::Textures,
+		format( "texture #%u (%ux%u)", texture->GetStreamingId(), source.width, source.height ) );
+	if ( !LoadPersistentMips( texture ) )
+	{
+		Console->Warning( "RenderFrontend::CreateTexture: failed to load the texture" );
+		memoryTracker.ReleaseOwner( texture->memoryOwner );
+		delete texture;
+		return nullptr;
+	}
+
+	// LoadPersistentMips has already given it a descriptor, through ChangeTextureResidency
+	streamedTextures[texture->GetStreamingId()] = texture;
+	return textures.emplace_back( texture ).get();
+}
+
+ITexture* RenderFrontend::CreateCompressedTexture( const TextureDesc& desc, const TextureSource& source, BlockCompression::Format blockFormat )
+{
+	TextureSource compressedSource;
+	if ( !textureCache.GetOrCreate( source, blockFormat, compressedSource ) )
+	{
+		Console->Warning( format( "RenderFrontend::CreateCompressedTexture: cannot compress to %s, using the uncompressed texture",
+			BlockCompression::ToString( blockFormat ) ) );
+		return CreateTexture( desc, source );
+	}
+
+	return CreateTexture( desc, compressedSource );
+}
+
+void RenderFrontend::SetTextureCacheDirectory( const Path& directory )
+{
+	textureCache.SetDirectory( directory );
+}
+
+void RenderFrontend::SetModelCacheDirectory( const Path& directory )
+{
+	modelCache.SetDirectory( directory );
+}
+
+void RenderFrontend::ReportTextureUsage( ITexture* texture, float screenSizeInPixels )
+{
+	if ( nullptr == texture )
+	{
+		Console->Warning( "RenderFrontend::ReportTextureUsage: tried reporting a non-existing texture" );
+		return;
+	}
+
+	if ( FindIterator( textures, texture ) == textures.end() )
+	{
+		Console->Warning( "RenderFrontend::ReportTextureUsage: tried reporting an unregistered texture" );
+		return;
+	}
+
+	Texture* textureInternal = static_cast<Texture*>( texture );
+	const TextureSource& source = textureInternal->GetSource();
+
+	// One texel per pixel is the goal
+	const float texelsPerPixel = float( std::max( source.width, source.height ) ) / std::max( screenSizeInPixels, 1.0f );
+	const uint32_t mip = uint32_t( std::max( std::floor( std::log2( texelsPerPixel ) ), 0.0f ) );
+
+	textureInternal->ReportUsage( mip, frameIndex );
+}
+
+void RenderFrontend::SetTextureMemoryBudget( size_t bytes )
+{
+	textureMemoryBudget = bytes;
+}
+
+size_t RenderFrontend::GetTextureMemoryUsage() const
+{
+	return textureMemoryUsage;
+}
+
+const MemoryTracker& RenderFrontend::GetMemoryTracker() const
+{
+	return memoryTracker;
+}
+
+void RenderFrontend::DumpMemoryStats() const
+{
+	memoryTracker.Dump();
+	Console->Print( format( "Pending release: %zu objects, %.2f MiB",
+		releaseQueue.GetNumPending(), float( releaseQueue.GetPendingBytes() ) / (1024.0f * 1024.0f) ) );
+}
+
+size_t RenderFrontend::GetPendingReleaseBytes() const
+{
+	return releaseQueue.GetPendingBytes();
+}
+
+void RenderFrontend::StartProfilerCapture( uint32_t numFrames, const Path& path )
+{
+	Profiler::StartCapture( numFrames, path );
+}
+
+void RenderFrontend::DumpProfilerStats() const
+{
+	Profiler::DumpStats();
+	gpuProfiler.Dump();
+	Console->Print( format( "Frames in flight: %u, the CPU waited for the GPU in %llu of %llu frames",
+		framesInFlight, (unsigned long long)frameStalls, (unsigned long long)frameIndex ) );
+	Console->Print( format( "Dynamic resolution scale: %.2f (budget %.2f ms)",
+		resolutionGovernor.GetScale(), resolutionGovernor.GetSettings().targetMilliseconds ) );
+	Console->Print( format( "Views: %llu rendered, %llu kept their last image",
+		(unsigned long long)viewsRendered, (unsigned long long)viewsReused ) );
+	Console->Print( format( "Static shadow tiles: %llu redrawn, %llu cached, atlas %.0f%% used",
+		(unsigned long long)shadowTilesRedrawn, (unsigned long long)shadowTilesCached, shadowAtlas.GetUsage() * 100.0f ) );
+	Console->Print( format( "Entity data: %u slots, %llu uploads since startup (%.2f per frame)",
+		numEntitySlots - uint32_t( freeEntitySlots.size() ), (unsigned long long)entityUploads,
+		double( entityUploads ) / double( std::max<uint64_t>( frameIndex, 1U ) ) ) );
+	Console->Print( format( "Model cache: %llu hits, %llu misses",
+		(unsigned long long)modelCacheHits, (unsigned long long)modelCacheMisses ) );
+	Console->Print( format( "Skinning: %llu vertices skinned since startup, on the %s",
+		(unsigned long long)verticesSkinned, skinningOnCpu ? "CPU" : "GPU" ) );
+	if ( bindless )
+	{
+		Console->Print( format( "Materials: %u, bindless, %u of %u texture slots used",
+			materialSlotAllocator.GetNumUsed(), textureSlots.GetNumUsed(), textureSlots.GetMaxSlots() ) );
+	}
+	else
+	{
+		Console->Print( format( "Materials: %u, a binding set per material", materialSlotAllocator.GetNumUsed() ) );
+	}
+}
+
+const GpuProfiler& RenderFrontend::GetGpuProfiler() const
+{
+	return gpuProfiler;
+}
+
+CommandStats& RenderFrontend::GetCommandStats()
+{
+	return commandStats;
+}
+
+void RenderFrontend::DumpCommandStats() const
+{
+	commandStats.Dump();
+
+	const GraphicsStateTracker::Stats& stateStats = stateTracker.GetStats();
+	Console->Print( format( "Graphics states: %llu set, %llu redundant ones skipped",
+		(unsigned long long)stateStats.emitted, (unsigned long long)stateStats.skipped ) );
+	for ( size_t i = 0U; i < size_t( GraphicsStateTracker::Part::Count ); i++ )
+	{
+		Console->Print( format( "  * %-14s changed %llu times", GraphicsStateTracker::PartToString( GraphicsStateTracker::Part( i ) ),
+			(unsigned long long)stateStats.partChanges[i] ) );
+	}
+}
+
+void RenderFrontend::SetViewUpdatePolicy( IView* view, ViewUpdatePolicy policy, uint32_t interval )
+{
+	if ( nullptr == view || FindIterator( views, view ) == views.end() )
+	{
+		Console->Warning( "RenderFrontend::SetViewUpdatePolicy: tried updating an unregistered view" );
+		return;
+	}
+
+	View* viewInternal = static_cast<View*>( view );
+	viewInternal->updatePolicy = policy;
+	viewInternal->updateInterval = std::max( interval, 1U );
+}
+
+void RenderFrontend::RequestViewUpdate( IView* view )
+{
+	if ( nullptr == view || FindIterator( views, view ) == views.end() )
+	{
+		Console->Warning( "RenderFrontend::RequestViewUpdate: tried updating an unregistered view" );
+		return;
+	}
+
+	static_cast<View*>( view )->updateRequested = true;
+}
+
+void RenderFrontend::SetViewResolutionScale( IView* view, float scale )
+{
+	if ( nullptr == view || FindIterator( views, view ) == views.end() )
+	{
+		Console->Warning( "RenderFrontend::SetViewResolutionScale: tried updating an unregistered view" );
+		return;
+	}
+
+	View* viewInternal = static_cast<View*>( view );
+	viewInternal->resolutionScale = std::clamp( scale, ResolutionGovernor::MinScale, 1.0f );
+	viewInternal->dynamicResolution = false;
+}
+
+void RenderFrontend::SetViewDynamicResolution( IView* view, bool enabled )
+{
+	if ( nullptr == view || FindIterator( views, view ) == views.end() )
+	{
+		Console->Warning( "RenderFrontend::SetViewDynamicResolution: tried updating an unregistered view" );
+		return;
+	}
+
+	View* viewInternal = static_cast<View*>( view );
+	viewInternal->dynamicResolution = enabled;
+	viewInternal->resolutionScale = enabled ? resolutionGovernor.GetScale() : 1.0f;
+}
+
+float RenderFrontend::GetViewResolutionScale( const IView* view ) const
+{
+	if ( nullptr == view || FindIterator( views, view ) == views.end() )
+	{
+		Console->Warning( "RenderFrontend::GetViewResolutionScale: tried querying an unregistered view" );
+		return 1.0f;
+	}
+
+	return static_cast<const View*>( view )->resolutionScale;
+}
+
+void RenderFrontend::SetDynamicResolutionSettings( const ResolutionGovernor::Settings& settings )
+{
+	resolutionGovernor.SetSettings( settings );
+}
+
+bool RenderFrontend::SetFramesInFlight( uint32_t count )
+{
+	if ( count < 1U || count > MaxFramesInFlight )
+	{
+		Console->Warning( format( "RenderFrontend::SetFramesInFlight: %u is out of range, must be between 1 and %u",
+			count, MaxFramesInFlight ) );
+		return false;
+	}
+
+	if ( count == framesInFlight )
+	{
+		return true;
+	}
+
+	framesInFlight = count;
+	// Not initialised yet, PostInit will create them
+	if ( frames.empty() )
+	{
+		return true;
+	}
+
+	backend->waitForIdle();
+	DestroyFrameResources();
+	releaseQueue.ReleaseAll( memoryTracker );
+	return CreateFrameResources();
+}
+
+uint32_t RenderFrontend::GetFramesInFlight() const
+{
+	return framesInFlight;
+}
+
+// Lights are CPU-side only, their shadows are set up with SetLightShadow
+ILight* RenderFrontend::CreateLight( const LightDesc& desc )
+{
+	return lights.emplace_back( new Light( desc ) ).get();
+}
+
+bool RenderFrontend::DestroyLight( ILight* light )
+{
+	if ( nullptr == light )
+	{
+		Console->Warning( "RenderFrontend::DestroyLight: tried destroying a non-existing light" );
+		return false;
+	}
+
+	auto it = FindIterator( lights, light );
+	if ( it == lights.end() )
+	{
+		Console->Warning( "RenderFrontend::DestroyLight: tried destroying an unregistered light" );
+		return false;
+	}
+
+	ReleaseShadowTiles( static_cast<Light*>( light ) );
+	lights.erase( it );
+
+	return true;
+}
+
+size_t RenderFrontend::GetNumLights() const
+{
+	return lights.size();
+}
+
+ILight* RenderFrontend::GetLight( uint32_t index )
+{
+	if ( index >= GetNumLights() )
+	{
+		return nullptr;
+	}
+
+	return lights.at( index ).get();
+}
+
+// TextureDesc doesn't say where the data comes from, see the overload with a TextureSource
+ITexture* RenderFrontend::CreateTexture( const TextureDesc& desc )
+{
+	return CreateTexture( desc, TextureSource() );
+}
+
+bool RenderFrontend::DestroyTexture( ITexture* view )
+{
+	if ( nullptr == view )
+	{
+		Console->Warning( "RenderFrontend::DestroyTexture: tried destroying a non-existing texture" );
+		return false;
+	}
+
+	// The rest is checked when the request runs, so true only means it was queued
+	if ( std::this_thread::get_id() != mainThread )
+	{
+		releaseQueue.Request( [this, view]() { DestroyTexture( view ); } );
+		return true;
+	}
+
+	auto it = FindIterator( textures, view );
+	if ( it == textures.end() )
+	{
+		Console->Warning( "RenderFrontend::DestroyTexture: tried destroying an unregistered texture" );
+		return false;
+	}
+
+	// Loads that are still in flight will find nothing when they finish, and get discarded
+	Texture* texture = static_cast<Texture*>( view );
+	textureMemoryUsage -= texture->GetResidentBytes();
+	textureMemoryPending -= texture->loadPendingBytes;
+	streamedTextures.erase( texture->GetStreamingId() );
+	ReleaseTextureSlot( texture );
+
+	releaseQueue.Enqueue( std::move( *it ), frameIndex, memoryTracker, texture->memoryOwner );
+	textures.erase( it );
+
+	return true;
+}
+
+size_t RenderFrontend::GetNumTextures() const
+{
+	return textures.size();
+}
+
+ITexture* RenderFrontend::GetTexture( uint32_t index )
+{
+	if ( index >= GetNumTextures() )
+	{
+		return nullptr;
+	}
+
+	return textures.at( index ).get();
+}
+
+IView* RenderFrontend::CreateView( const ViewDesc& desc )
+{
+	ViewDesc descModified = desc;
+	if ( desc.viewportSize.x <= 0.0f || desc.viewportSize.y <= 0.0f )
+	{
+		descModified.viewportSize = GetScreenSize();
+	}
+
+	const MemoryTracker::OwnerId memoryOwner = memoryTracker.CreateOwner( MemoryCategory::ViewAttachments,
+		format( "view #%u", nextViewId++ ) );
+
+	auto [colourTexture, depthTexture] = CreateFramebufferImagesForView( descModified, memoryOwner );
+	if ( nullptr == colourTexture || nullptr == depthTexture )
+	{
+		Console->Warning( "RenderFrontend::CreateView: failed to create attachments" );
+		memoryTracker.ReleaseOwner( memoryOwner );
+		return nullptr;
+	}
+
+	nvrhi::FramebufferHandle framebuffer = CreateFramebufferFromImages( colourTexture, depthTexture );
+	if ( nullptr == framebuffer )
+	{
+		Console->Warning( "RenderFrontend::CreateView: failed to create framebuffer for view" );
+		memoryTracker.ReleaseOwner( memoryOwner );
+		return nullptr;
+	}
+
+	nvrhi::BindingSetHandle bindingSet = CreateBindingSetForView( colourTexture, depthTexture );
+	if ( nullptr == bindingSet )
+	{
+		Console->Warning( "RenderFrontend::CreateView: failed to create binding set for view" );
+		memoryTracker.ReleaseOwner( memoryOwner );
+		return nullptr;
+	}
+
+	View* view = new View( descModified, colourTexture, depthTexture, framebuffer, bindingSet );
+	view->memoryOwner = memoryOwner;
+
+	return views.emplace_back( view ).get();
+}
+
+bool RenderFrontend::DestroyView( IView* view )
+{
+	if ( nullptr == view )
+	{
+		Console->Warning( "RenderFrontend::DestroyView: tried destroying a non-existing view" );
+		return false;
+	}
+
+	// The rest is checked when the request runs, so true only means it was queued
+	if ( std::this_thread::get_id() != mainThread )
+	{
+		releaseQueue.Request( [this, view]() { DestroyView( view ); } );
+		return true;
+	}
+
+	auto it = FindIterator( views, view );
+	if ( it == views.end() )
+	{
+		Console->Warning( "RenderFrontend::DestroyView: tried destroying an unregistered view" );
+		return false;
+	}
+
+	releaseQueue.Enqueue( std::move( *it ), frameIndex, memoryTracker, static_cast<View*>( view )->memoryOwner );
+	views.erase( it );
+
+	return true;
+}
+
+size_t RenderFrontend::GetNumViews() const
+{
+	return views.size();
+}
+
+IView* RenderFrontend::GetView( uint32_t index )
+{
+	if ( index >= GetNumViews() )
+	{
+		return nullptr;
+	}
+
+	return views.at( index ).get();
+}
+
+IVolume* RenderFrontend::CreateVolume( const VolumeDesc& desc )
+{
+	Volume* volume = new Volume( desc );
+	volume->index = uint32_t( volumes.size() );
+
+	return volumes.emplace_back( volume ).get();
+}
+
+bool RenderFrontend::DestroyVolume( IVolume* volume )
+{
+	if ( nullptr == volume )
+	{
+		Console->Warning( "RenderFrontend::DestroyVolume: tried destroying a non-existing volume" );
+		return false;
+	}
+
+	auto it = FindIterator( volumes, volume );
+	if ( it == volumes.end() )
+	{
+		Console->Warning( "RenderFrontend::DestroyVolume: tried destroying an unregistered volume" );
+		return false;
+	}
+
+	Volume* volumeInternal = static_cast<Volume*>( volume );
+	for ( Entity* entity : volumeInternal->GetEntities() )
+	{
+		entity->cells.erase( std::find( entity->cells.begin(), entity->cells.end(), volumeInternal ) );
+	}
+
+	const uint32_t removedIndex = volumeInternal->index;
+	volumes.erase( it );
+
+	// Volume indices shift, and so do the PVS bits that refer to them
+	for ( size_t i = 0U; i < volumes.size(); i++ )
+	{
+		Volume* other = static_cast<Volume*>( volumes[i].get() );
+		other->RemovePortalsTo( volumeInternal );
+		other->RemoveFromPVS( removedIndex );
+		other->index = uint32_t( i );
+	}
+
+	return true;
+}
+
+size_t RenderFrontend::GetNumVolumes() const
+{
+	return volumes.size();
+}
+
+IVolume* RenderFrontend::GetVolume( uint32_t index )
+{
+	if ( index >= GetNumVolumes() )
+	{
+		return nullptr;
+	}
+
+	return volumes.at( index ).get();
+}
+
+IModel* RenderFrontend::CreateModel( const Assets::IModel* modelAsset )
+{
+	if ( nullptr == modelAsset )
+	{
+		Console->Warning( "RenderFrontend::CreateModel: tried creating a rendermodel from a non-existing model" );
+		return nullptr;
+	}
+
+	Vector<IModel*> result;
+	CreateModels( { modelAsset }, result );
+	return result[0];
+}
+
+size_t RenderFrontend::CreateModels( const Vector<const Assets::IModel*>& modelAssets, Vector<IModel*>& outModels )
+{
+	// Keeps the staging memory of one submission in check
+	constexpr size_t MaxBytesPerSubmission = 256U * 1024U * 1024U;
+
+	outModels.assign( modelAssets.size(), nullptr );
+	if ( modelAssets.empty() )
+	{
+		return 0U;
+	}
+
+	Vector<ModelLoadJob> jobs( modelAssets.size() );
+	for ( size_t i = 0U; i < jobs.size(); i++ )
+	{
+		jobs[i].asset = modelAssets[i];
+	}
+
+	// Hashing reads all of the geometry, so it's spread out too
+	{
+		PROFILE_SCOPE( "HashModels" );
+		const auto failures = workerPool.Run( jobs.size(), [&jobs]( size_t i )
+		{
+			if ( nullptr != jobs[i].asset )
+			{
+				jobs[i].hash = ModelCache::HashAsset( jobs[i].asset );
+			}
+		} );
+
+		for ( const auto& failure : failures )
+		{
+			jobs[failure.index].errors.push_back( format( "RenderFrontend: hashing model '%s' failed: %s",
+				jobs[failure.index].asset->GetName().data(), failure.message.c_str() ) );
+		}
+	}
+
+	// Models with the same geometry are loaded once, that also keeps two threads from writing the same cache file
+	Map<uint64_t, size_t> firstJobWithHash;
+	Vector<size_t> sourceJobs( jobs.size() );
+	Vector<size_t> uniqueJobs;
+	for ( size_t i = 0U; i < jobs.size(); i++ )
+	{
+		sourceJobs[i] = i;
+		if ( nullptr == jobs[i].asset || !jobs[i].errors.empty() )
+		{
+			continue;
+		}
+
+		const auto [it, inserted] = firstJobWithHash.emplace( jobs[i].hash, i );
+		sourceJobs[i] = it->second;
+		if ( inserted )
+		{
+			uniqueJobs.push_back( i );
+		}
+	}
+
+	{
+		PROFILE_SCOPE( "LoadModels" );
+		const auto failures = workerPool.Run( uniqueJobs.size(), [this, &jobs, &uniqueJobs]( size_t i )
+		{
+			LoadModel( jobs[uniqueJobs[i]] );
+		} );
+
+		for ( const auto& failure : failures )
+		{
+			ModelLoadJob& job = jobs[uniqueJobs[failure.index]];
+			job.valid = false;
+			job.cacheHit = false;
+			job.prepared = PreparedModel();
+			job.errors.push_back( format( "RenderFrontend: loading model '%s' failed: %s",
+				job.asset->GetName().data(), failure.message.c_str() ) );
+		}
+	}
+
+	// Prepared data is released as soon as its last model is recorded, instead of holding the whole batch until the end
+	Vector<size_t> lastUsers( jobs.size() );
+	for ( size_t i = 0U; i < jobs.size(); i++ )
+	{
+		lastUsers[sourceJobs[i]] = i;
+	}
+
+	// Uploads are batched into as few submissions as possible, failed models are skipped
+	PROFILE_SCOPE( "UploadModels" );
+	size_t numCreated = 0U;
+	size_t bytesRecorded = 0U;
+	transferCommands->open();
+	for ( size_t i = 0U; i < jobs.size(); i++ )
+	{
+		const Assets::IModel* modelAsset = jobs[i].asset;
+		if ( nullptr == modelAsset )
+		{
+			Console->Warning( format( "RenderFrontend::CreateModels: model %zu doesn't exist", i ) );
+			continue;
+		}
+
+		ModelLoadJob& source = jobs[sourceJobs[i]];
+		if ( sourceJobs[i] == i )
+		{
+			for ( const String& error : source.errors )
+			{
+				Console->Error( error );
+			}
+
+			if ( source.cacheHit )
+			{
+				modelCacheHits++;
+			}
+			else if ( source.valid )
+			{
+				modelCacheMisses++;
+				if ( !source.cacheWritten )
+				{
+					Console->Warning( format( "RenderFrontend: failed to write model '%s' to the cache", modelAsset->GetName().data() ) );
+				}
+			}
+		}
+
+		if ( !source.valid )
+		{
+			Console->Warning( format( "RenderFrontend: model '%s' has invalid data", modelAsset->GetName().data() ) );
+			continue;
+		}
+
+		// writeBuffer copies the data into staging memory, so it's not needed after recording
+		Model* model = RecordModelUpload( modelAsset, source.prepared );
+		bytesRecorded += source.prepared.GetDataSize();
+		if ( lastUsers[sourceJobs[i]] == i )
+		{
+			source.prepared = PreparedModel();
+		}
+
+		if ( nullptr == model )
+		{
+			Console->Warning( format( "RenderFrontend: model '%s' failed to upload to the GPU", modelAsset->GetName().data() ) );
+			continue;
+		}
+
+		models.emplace_back( model );
+		outModels[i] = model;
+		numCreated++;
+
+		if ( bytesRecorded >= MaxBytesPerSubmission )
+		{
+			transferCommands->close();
+			backend->executeCommandList( transferCommands, nvrhi::CommandQueue::Graphics );
+			commandStats.Record( RenderCommand::ExecuteCommandList );
+			transferCommands->open();
+			bytesRecorded = 0U;
+		}
+	}
+	transferCommands->close();
+
+	backend->executeCommandList( transferCommands, nvrhi::CommandQueue::Graphics );
+	commandStats.Record( RenderCommand::ExecuteCommandList );
+
+	if ( numCreated < jobs.size() && jobs.size() > 1U )
+	{
+		Console->Warning( format( "RenderFrontend::CreateModels: %zu of %zu models failed", jobs.size() - numCreated, jobs.size() ) );
+	}
+
+	return numCreated;
+}
+
+bool RenderFrontend::DestroyModel( IModel* model )
+{
+	if ( nullptr == model )
+	{
+		Console->Warning( "RenderFrontend::DestroyModel: tried destroying a non-existing model" );
+		return false;
+	}
+
+	// The rest is checked when the request runs, so true only means it was queued
+	if ( std::this_thread::get_id() != mainThread )
+	{
+		releaseQueue.Request( [this, model]() { DestroyModel( model ); } );
+		return true;
+	}
+
+	auto it = FindIterator( models, model );
+	if ( it == models.end() )
+	{
+		Console->Warning( "RenderFrontend::DestroyModel: tried destroying an unregistered model" );
+		return false;
+	}
+
+	releaseQueue.Enqueue( std::move( *it ), frameIndex, memoryTracker, static_cast<Model*>( model )->memoryOwner );
+	models.erase( it );
+
+	return true;
+}
+
+size_t RenderFrontend::GetNumModels() const
+{
+	return models.size();
+}
+
+IModel* RenderFrontend::GetModel( uint32_t index )
+{
+	if ( index >= GetNumModels() )
+	{
+		return nullptr;
+	}
+
+	return models.at( index ).get();
+}
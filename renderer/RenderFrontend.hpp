@@ -1,170 +1,689 @@
-// SPDX-FileCopyrightText: 2022 Admer Šuko
-// SPDX-License-Identifier: MIT
-
-#pragma once
-
-#include "Model.hpp"
-
-class RenderFrontend : public IRenderFrontend
-{
-public: // Data structures for binding sets
-	struct ViewFrameData
-	{
-		Mat4 viewMatrix;
-		Mat4 projectionMatrix;
-		float time;
-	};
-
-	struct EntityData
-	{
-		Mat4 modelMatrix;
-		Vec4 shaderParametersA;
-		Vec4 shaderParametersB;
-	};
-
-public: // Plugin API
-	bool					Init( const EngineAPI& api ) override;
-	void					Shutdown() override;
-
-	const char*				GetPluginName() const override
-	{
-		return "BTX Test Renderer";
-	}
-
-public: // Render frontend API
-	bool 					PostInit( RenderBackend* renderBackend, IWindow* mainWindow ) override;
-	void					Update() override;
-	IBackend*				GetBackend() const override;
-
-	void					BeginFrame() override;
-	void					EndFrameAndPresent( const IView* view ) override;
-
-	void					RenderView( const IView* view ) override;
-	
-	void					DebugLine( Vec3 start, Vec3 end, Vec3 colour, float life, bool depthTest ) override;
-	void					DebugRay( Vec3 start, Vec3 direction, float length, bool withArrowhead, Vec3 colour, float life, bool depthTest ) override;
-	void					DebugBox( Vec3 min, Vec3 max, Vec3 colour, float life, bool depthTest ) override;
-	void					DebugCube( Vec3 position, float extents, Vec3 colour, float life, bool depthTest ) override;
-	void					DebugSphere( Vec3 position, float extents, Vec3 colour, float life, bool depthTest ) override;
-
-	IBatch*					CreateBatch( const BatchDesc& desc ) override;
-	bool					DestroyBatch( IBatch* batch ) override;
-	size_t					GetNumBatches() const override;
-	IBatch*					GetBatch( uint32_t index ) override;
-
-	IEntity*				CreateEntity( const EntityDesc& desc ) override;
-	bool					DestroyEntity( IEntity* entity ) override;
-	size_t					GetNumEntities() const override;
-	IEntity*				GetEntity( uint32_t index ) override;
-
-	ILight*					CreateLight( const LightDesc& desc ) override;
-	bool					DestroyLight( ILight* light ) override;
-	size_t					GetNumLights() const override;
-	ILight*					GetLight( uint32_t index ) override;
-
-	ITexture*				CreateTexture( const TextureDesc& desc ) override;
-	bool 					DestroyTexture( ITexture* view ) override;
-	size_t					GetNumTextures() const override;
-	ITexture*				GetTexture( uint32_t index ) override;
-
-	IView*					CreateView( const ViewDesc& desc ) override;
-	bool					DestroyView( IView* view ) override;
-	size_t					GetNumViews() const override;
-	IView*					GetView( uint32_t index ) override;
-
-	IVolume*				CreateVolume( const VolumeDesc& desc ) override;
-	bool					DestroyVolume( IVolume* volume ) override;
-	size_t					GetNumVolumes() const override;
-	IVolume*				GetVolume( uint32_t index ) override;
-
-	IModel*					CreateModel( const Assets::IModel* modelAsset ) override;
-	bool					DestroyModel( IModel* model ) override;
-	size_t					GetNumModels() const override;
-	IModel*					GetModel( uint32_t index ) override;
-
-private: // Internals
-
-	// RenderFrontend.Init.cpp
-	bool					CreateCommandLists();
-	bool					CreateMainFramebuffer();
-	bool					CreateScreenVertexBuffer(); // screen quad
-
-	// RenderFrontend.Model.cpp
-	bool					ValidateModelAsset( const Assets::IModel* modelAsset );
-	nvrhi::BufferHandle		CreateIndexBuffer( Vector<uint32_t> indices );
-	nvrhi::BufferHandle		CreateVertexBuffer( const Vector<float>& rawVertexData );
-	bool					CreateVertexBuffer( uint32_t face, const Assets::RenderData::VertexDataSegment& segment, VertexBufferMap& outVertexBuffers );
-	bool					CreateBuffersFromVertexData( uint32_t face, const Assets::RenderData::VertexData& data, Vector<nvrhi::BufferHandle>& outIndexBuffers, VertexBufferMap& outVertexBuffers );
-	IModel*					BuildModelFromAsset( const Assets::IModel* modelAsset );
-
-	// RenderFrontend.Pipeline.cpp
-	Path					BuildShaderPath( nvrhi::ShaderType type, StringView shaderPath );
-	nvrhi::ShaderHandle		CreateShader( nvrhi::ShaderType type, StringView shaderPath );
-	bool					CreateShaderPair( StringView shaderPath, nvrhi::ShaderHandle& outVertexShader, nvrhi::ShaderHandle& outPixelShader );
-	nvrhi::ShaderHandle		CreateComputeShader( StringView shaderPath );
-	bool					CreateMainShaders();
-	bool					CreateMainGraphicsPipelines();
-	
-	// RenderFrontend.Render.cpp
-	bool					IsEntityVisible( const IView* view, const IEntity* entity );
-	void					RenderEntity( const IView* view, const IEntity* entity );
-
-	// RenderFrontend.Texture.cpp
-	std::pair<nvrhi::TextureHandle, nvrhi::TextureHandle> CreateFramebufferImagesForView( const ViewDesc& desc );
-	nvrhi::FramebufferHandle CreateFramebufferFromImages( nvrhi::ITexture* colourTexture, nvrhi::ITexture* depthTexture );
-	nvrhi::BindingSetHandle CreateBindingSetForView( nvrhi::TextureHandle colourTexture, nvrhi::TextureHandle depthTexture );
-
-private:
-	Vector<UniquePtr<IBatch>>	batches{};
-	Vector<UniquePtr<IEntity>>	entities{};
-	Vector<UniquePtr<ILight>>	lights{};
-	Vector<UniquePtr<ITexture>>	textures{};
-	Vector<UniquePtr<IView>>	views{};
-	Vector<UniquePtr<IVolume>>	volumes{};
-	Vector<UniquePtr<IModel>>	models{};
-
-	IWindow*				window{ nullptr };
-	RenderBackend*			backendManager{ nullptr };
-	IBackend*				backend{ nullptr };
-
-	nvrhi::SamplerHandle	screenSampler{ nullptr };
-
-	nvrhi::CommandListHandle transferCommands{};
-	// Later we will have multiple render commandlists,
-	// so we can do multithreaded rendering
-	nvrhi::CommandListHandle renderCommands{};
-
-	// Todo: replace with a map of vertex layouts
-	// E.g. something that could be used like GetVertexLayoutForCombo( { VA::Position, VA::Normal } );
-	// In latter iterations, when we have a material system, base materials will demand vertex layout
-	// specifications, and this is crucial for that
-	nvrhi::InputLayoutHandle entityVertexLayout{};
-	// This will also be changed once we have a material system.
-	// Each material base will have its own pipeline which uses its own shader
-	nvrhi::BindingLayoutHandle viewFrameBindingLayout{};
-	nvrhi::BindingLayoutHandle entityBindingLayout{};
-	// Look at ViewFrameData and EntityData
-	nvrhi::BufferHandle		viewDataBuffer{};
-	ViewFrameData			currentViewData;
-	nvrhi::BufferHandle		entityDataBuffer{};
-	EntityData				currentEntityData;
-	// This binding set contains the projection & view matrix. It changes per frame and per view
-	// Later on there will be a per-surface binding set too, once we have texturing and all
-	nvrhi::BindingSetHandle viewFrameBindingSet{};
-	// This binding set contains transformation data for the entity and its parameters
-	nvrhi::BindingSetHandle entityBindingSet{};
-	nvrhi::ShaderHandle entityVertexShader{};
-	nvrhi::ShaderHandle entityPixelShader{};
-	nvrhi::GraphicsPipelineHandle entityPipeline{};
-	
-	// The minimum needed to render a basic fullscreen quad
-	// 2D vector for positions, and another 2D vector for texture coords
-	nvrhi::InputLayoutHandle screenVertexLayout{};
-	nvrhi::BufferHandle		screenVertexBuffer{};
-	nvrhi::BufferHandle		screenIndexBuffer{};
-	// 1 texture sampler, 1 colour attachment, 1 depth attachment
-	nvrhi::BindingLayoutHandle screenBindingLayout{};
-	nvrhi::ShaderHandle		screenVertexShader{};
-	nvrhi::ShaderHandle		screenPixelShader{};
-	nvrhi::GraphicsPipelineHandle screenPipeline{};
-};
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <chrono>
+#include <deque>
+
+#include "Model.hpp"
+#include "PostProcess.hpp"
+#include "CommandStats.hpp"
+#include "DeferredRelease.hpp"
+#include "EntityTree.hpp"
+#include "GpuProfiler.hpp"
+#include "GraphicsStateTracker.hpp"
+#include "Light.hpp"
+#include "Material.hpp"
+#include "MemoryTracker.hpp"
+#include "ModelCache.hpp"
+#include "ResolutionGovernor.hpp"
+#include "SlotAllocator.hpp"
+#include "TextureCache.hpp"
+#include "TextureStreamer.hpp"
+#include "View.hpp"
+#include "WorkerPool.hpp"
+
+class Entity;
+class Texture;
+class Volume;
+struct BatchGroup;
+struct BatchSourceFace;
+
+class RenderFrontend : public IRenderFrontend
+{
+public: // Data structures for binding sets
+	struct ViewFrameData
+	{
+		Mat4 viewMatrix;
+		Mat4 projectionMatrix;
+		float time;
+	};
+
+	// Every entity has a slot in one persistent structured buffer of these
+	struct EntityData
+	{
+		Mat4 modelMatrix;
+		Vec4 shaderParametersA;
+		Vec4 shaderParametersB;
+	};
+
+	// Push constants of entity draws, the slots of the entity's data and of the face's material
+	struct EntityConstants
+	{
+		uint32_t entityIndex;
+		uint32_t materialIndex;
+	};
+
+	// One per material in one structured buffer, see Material.hpp
+	// Textures are slots in the texture table, see RenderFrontend.Material.cpp
+	struct MaterialData
+	{
+		Vec4 colour;
+		uint32_t diffuseTexture;
+		uint32_t padding[3];
+	};
+
+	// A changed entity, these are scattered into the entity buffer by a compute pass
+	struct EntityUpload
+	{
+		uint32_t slot;
+		uint32_t padding[3];
+		EntityData data;
+	};
+
+	// Push constants of skinning dispatches, one per skinned face
+	struct SkinningConstants
+	{
+		uint32_t numVertices;
+		// Where the entity's bones start in the bone palette
+		uint32_t firstBone;
+		uint32_t numBones;
+		uint32_t padding;
+	};
+
+	// Push constants of the screen pass and the other post-process passes, see PostProcessSettings
+	struct ScreenConstants
+	{
+		// The part of the view's attachments that was rendered into, in UV space
+		Vec2 uvScale;
+		// Size of one attachment texel in UV space
+		Vec2 texelSize;
+		// RGB is the grading filter, alpha is exposure
+		Vec4 colourFilter;
+		float contrast;
+		float saturation;
+		float sharpness;
+		float bloomIntensity;
+		float bloomThreshold;
+		uint32_t padding;
+		// Bloom blur passes only
+		Vec2 blurDirection;
+	};
+
+public: // Plugin API
+	bool					Init( const EngineAPI& api ) override;
+	void					Shutdown() override;
+
+	const char*				GetPluginName() const override
+	{
+		return "BTX Test Renderer";
+	}
+
+public: // Render frontend API
+	bool 					PostInit( RenderBackend* renderBackend, IWindow* mainWindow ) override;
+	void					Update() override;
+	IBackend*				GetBackend() const override;
+
+	void					BeginFrame() override;
+	void					EndFrameAndPresent( const IView* view ) override;
+
+	void					RenderView( const IView* view ) override;
+	
+	void					DebugLine( Vec3 start, Vec3 end, Vec3 colour, float life, bool depthTest ) override;
+	void					DebugRay( Vec3 start, Vec3 direction, float length, bool withArrowhead, Vec3 colour, float life, bool depthTest ) override;
+	void					DebugBox( Vec3 min, Vec3 max, Vec3 colour, float life, bool depthTest ) override;
+	void					DebugCube( Vec3 position, float extents, Vec3 colour, float life, bool depthTest ) override;
+	void					DebugSphere( Vec3 position, float extents, Vec3 colour, float life, bool depthTest ) override;
+
+	IBatch*					CreateBatch( const BatchDesc& desc ) override;
+	bool					DestroyBatch( IBatch* batch ) override;
+	size_t					GetNumBatches() const override;
+	IBatch*					GetBatch( uint32_t index ) override;
+
+	IEntity*				CreateEntity( const EntityDesc& desc ) override;
+	bool					DestroyEntity( IEntity* entity ) override;
+	size_t					GetNumEntities() const override;
+	IEntity*				GetEntity( uint32_t index ) override;
+
+	ILight*					CreateLight( const LightDesc& desc ) override;
+	bool					DestroyLight( ILight* light ) override;
+	size_t					GetNumLights() const override;
+	ILight*					GetLight( uint32_t index ) override;
+
+	ITexture*				CreateTexture( const TextureDesc& desc ) override;
+	bool 					DestroyTexture( ITexture* view ) override;
+	size_t					GetNumTextures() const override;
+	ITexture*				GetTexture( uint32_t index ) override;
+
+	IView*					CreateView( const ViewDesc& desc ) override;
+	bool					DestroyView( IView* view ) override;
+	size_t					GetNumViews() const override;
+	IView*					GetView( uint32_t index ) override;
+
+	IVolume*				CreateVolume( const VolumeDesc& desc ) override;
+	bool					DestroyVolume( IVolume* volume ) override;
+	size_t					GetNumVolumes() const override;
+	IVolume*				GetVolume( uint32_t index ) override;
+
+	IModel*					CreateModel( const Assets::IModel* modelAsset ) override;
+	bool					DestroyModel( IModel* model ) override;
+	size_t					GetNumModels() const override;
+	IModel*					GetModel( uint32_t index ) override;
+
+public: // Extensions that are not in IRenderFrontend yet
+	// Merges the geometry of static entities into a few world-space buffers
+	// The entities are left as they are, callers will typically destroy them afterwards
+	IBatch*					CreateBatch( const BatchDesc& desc, const Vector<IEntity*>& staticEntities );
+
+	// Streamed textures. Low mips are loaded immediately, the rest are streamed in on demand
+	ITexture*				CreateTexture( const TextureDesc& desc, const TextureSource& source );
+	// Rendering feedback: roughly how many pixels the texture covers on screen, along its larger axis
+	void					ReportTextureUsage( ITexture* texture, float screenSizeInPixels );
+	void					SetTextureMemoryBudget( size_t bytes );
+	size_t					GetTextureMemoryUsage() const;
+	// Same as above, but stored block-compressed on the GPU. The source must be RGBA8
+	// Compression happens on first use, later loads come from the texture cache
+	ITexture*				CreateCompressedTexture( const TextureDesc& desc, const TextureSource& source, BlockCompression::Format blockFormat );
+	void					SetTextureCacheDirectory( const Path& directory );
+	// Models are prepared once and then loaded from the model cache, see ModelCache.hpp
+	void					SetModelCacheDirectory( const Path& directory );
+	// Same as CreateModel for many models at once. Loading and preparing them is spread across
+	// all cores, and the uploads go in as few submissions as possible. A model that fails is skipped
+	// outModels lines up with modelAssets, with null for failed models. Returns how many were created
+	size_t					CreateModels( const Vector<const Assets::IModel*>& modelAssets, Vector<IModel*>& outModels );
+
+	// GPU memory statistics, per category and per owner
+	const MemoryTracker&	GetMemoryTracker() const;
+	void					DumpMemoryStats() const;
+	// Memory of destroyed objects that the GPU may still be using
+	size_t					GetPendingReleaseBytes() const;
+
+	// CPU profiling, see Profiler.hpp. Captures are written in the Chrome trace format
+	// The stats dump includes GPU timings per pass too, if the backend supports timer queries
+	void					StartProfilerCapture( uint32_t numFrames, const Path& path );
+	void					DumpProfilerStats() const;
+	const GpuProfiler&		GetGpuProfiler() const;
+
+	// Counts of draws, state changes, uploads, submissions and resource creations
+	// These are recorded by the frontend itself, so they're the same on every backend
+	// The dump also says how many redundant graphics states were filtered out
+	CommandStats&			GetCommandStats();
+	void					DumpCommandStats() const;
+
+	// Brings the frontend up on any device, without the engine's backend and window, e.g. for the benchmark
+	// An offscreen target of this size stands in for the backbuffer, and nothing is presented
+	// Init must have been called first, for the console and the file system
+	bool					PostInitHeadless( IBackend* device, uint32_t width, uint32_t height );
+
+	// How many frames the CPU may record ahead of the GPU, 1 to MaxFramesInFlight
+	// Changing it after PostInit waits for the GPU to go idle, so don't call it mid-frame
+	bool					SetFramesInFlight( uint32_t count );
+	uint32_t				GetFramesInFlight() const;
+
+	// Views render into a part of their attachments, which is then upscaled onto the screen
+	// Setting a fixed scale turns dynamic resolution off for that view
+	void					SetViewResolutionScale( IView* view, float scale );
+	void					SetViewDynamicResolution( IView* view, bool enabled );
+	float					GetViewResolutionScale( const IView* view ) const;
+	// Frame time budget and scale limits for views with dynamic resolution
+	void					SetDynamicResolutionSettings( const ResolutionGovernor::Settings& settings );
+
+	// Renders several views with one pass over the entity tree and one submission
+	// Much cheaper than calling RenderView for each, e.g. for split-screen or cubemap faces
+	// Up to EntityTree::MaxFrusta views at once
+	void					RenderViews( const Vector<const IView*>& viewList );
+
+	// Lets views keep their last image instead of rendering again, see ViewUpdatePolicy
+	// The interval is only used with ViewUpdatePolicy::Interval
+	void					SetViewUpdatePolicy( IView* view, ViewUpdatePolicy policy, uint32_t interval = 1U );
+	// The view is rendered next time, whatever its policy says
+	void					RequestViewUpdate( IView* view );
+
+	// Sets the camera for a view, used for culling and the per-view constant buffer
+	void					SetViewTransform( IView* view, const Vec3& origin, const Mat4& viewMatrix, const Mat4& projectionMatrix );
+
+	// Spatial queries over entity bounds, backed by the entity tree
+	void					QueryEntitiesInBox( const Vec3& mins, const Vec3& maxs, Vector<IEntity*>& outEntities );
+	void					QueryEntitiesInSphere( const Vec3& centre, float radius, Vector<IEntity*>& outEntities );
+	// Results are sorted from nearest to farthest, any direction length is fine, maxDistance is in world units
+	void					QueryEntitiesAlongRay( const Vec3& start, const Vec3& direction, float maxDistance, Vector<IEntity*>& outEntities );
+
+	// Volumes as visibility cells. Portals are two-way, with the points forming a convex polygon
+	void					SetVolumeBounds( IVolume* volume, const Vec3& mins, const Vec3& maxs );
+	bool					AddPortal( IVolume* from, IVolume* to, const Vector<Vec3>& points );
+	// One bit per volume index (see GetVolume), an empty set disables PVS checks for this volume
+	void					SetVolumePVS( IVolume* volume, const Vector<uint64_t>& bits );
+
+	// Shadow maps, see Light.hpp. Lights get atlas tiles sized by how big they are on screen
+	// Batches are cached in a static atlas and only redrawn when batches in the light's range change,
+	// entities are drawn on top of a copy of it every frame. Call before rendering the view
+	void					SetLightShadow( ILight* light, const LightShadowDesc& desc );
+	// Changing the atlas size waits for the GPU to go idle and redraws all shadows
+	void					SetShadowSettings( const ShadowSettings& settings );
+	void					RenderShadows( const IView* view );
+	// The atlas with both static and dynamic casters, and where each light's faces are in it
+	nvrhi::ITexture*		GetShadowAtlas() const;
+	const Vector<LightShadowFace>* GetLightShadowFaces( const ILight* light ) const;
+
+	// Entities with bones are skinned by a compute pass into their own vertex buffers, see Skinning.hpp
+	// They're skinned again only when changed, modify the bones through GetDesc so that's noticed
+	// The CPU path is a lot slower, and nothing checks it against the compute one
+	void					SetSkinningOnCpu( bool enabled );
+
+	// Applied when a view is presented, see PostProcess.hpp. Each pass is timed by the GPU profiler
+	void					SetPostProcessSettings( const PostProcessSettings& settings );
+	const PostProcessSettings& GetPostProcessSettings() const;
+
+	// Materials, see Material.hpp. Faces use the default material, plain white, until given another
+	// Where the backend supports it, textures are in one global table and a draw only carries the
+	// material's index, so switching materials doesn't change any bindings
+	Material*				CreateMaterial( const MaterialDesc& desc );
+	bool					UpdateMaterial( Material* material, const MaterialDesc& desc );
+	// Faces that used the material go back to the default one
+	bool					DestroyMaterial( Material* material );
+	// Null for the default material. Batches take their materials from the faces when they're created
+	bool					SetFaceMaterial( IModel* model, uint32_t face, Material* material );
+	// False if there's a binding set per material, e.g. on D3D11
+	bool					IsBindless() const;
+
+private: // Internals
+
+	// RenderFrontend.Init.cpp
+	// Everything that needs the device, shared by PostInit and PostInitHeadless
+	bool					CreateResources();
+	bool					CreateCommandLists();
+	bool					CreateMainFramebuffer();
+	// The backbuffer, or the offscreen target when headless
+	nvrhi::IFramebuffer*	GetScreenFramebuffer() const;
+	Vec2					GetScreenSize() const;
+	bool					CreateFrameResources();
+	void					DestroyFrameResources();
+	// Waits until the GPU is done with the frame that last used these resources
+	void					AcquireFrameResources();
+
+	// RenderFrontend.Model.cpp
+	// Errors are collected instead of printed, so this can run on worker threads
+	bool					ValidateModelAsset( const Assets::IModel* modelAsset, Vector<String>& outErrors ) const;
+	nvrhi::BufferHandle		CreateIndexBuffer( Vector<uint32_t> indices, MemoryTracker::OwnerId memoryOwner );
+	nvrhi::BufferHandle		CreateVertexBuffer( const Vector<float>& rawVertexData, MemoryTracker::OwnerId memoryOwner );
+	nvrhi::BufferHandle		CreateVertexBuffer( const Vector<uint8_t>& rawVertexData, MemoryTracker::OwnerId memoryOwner );
+	// Records the upload into transferCommands, which must be open
+	nvrhi::BufferHandle		CreateModelBuffer( nvrhi::BufferDesc desc, const uint8_t* data, size_t dataSize,
+								nvrhi::ResourceStates finalState, MemoryTracker::OwnerId memoryOwner );
+	Bounds					CalculateFaceBounds( const Assets::RenderData::VertexData& data ) const;
+	// CPU-side work only: bounds, index narrowing. The asset must be valid
+	void					PrepareModel( const Assets::IModel* modelAsset, PreparedModel& outModel ) const;
+	// Reads the model from the cache, or validates, prepares and caches it. Safe to run on worker threads
+	void					LoadModel( ModelLoadJob& job ) const;
+	// Records into transferCommands, which must be open. Null if no face could be uploaded
+	Model*					RecordModelUpload( const Assets::IModel* modelAsset, const PreparedModel& prepared );
+
+	// RenderFrontend.Batch.cpp
+	bool					BuildBatchGroup( Vector<BatchSourceFace>& faces, BatchGroup& outGroup, MemoryTracker::OwnerId memoryOwner );
+
+	// RenderFrontend.Pipeline.cpp
+	Path					BuildShaderPath( nvrhi::ShaderType type, StringView shaderPath );
+	bool					LoadShaderBlob( nvrhi::ShaderType type, StringView shaderPath, Vector<uint8_t>& outData );
+	nvrhi::ShaderHandle		CreateShader( nvrhi::ShaderType type, StringView shaderPath );
+	// For shaders that were compiled with feature permutations, see shaders.cfg
+	bool					CreateShaderPermutations( nvrhi::ShaderType type, StringView shaderPath,
+								const char* const* featureDefines, uint32_t numFeatures, ShaderPermutations& outPermutations,
+								const uint32_t* featureValues = nullptr );
+	bool					CreateShaderPair( StringView shaderPath, nvrhi::ShaderHandle& outVertexShader, nvrhi::ShaderHandle& outPixelShader );
+	nvrhi::ShaderHandle		CreateComputeShader( StringView shaderPath );
+	bool					CreateMainShaders();
+	bool					CreateMainGraphicsPipelines();
+	// Screen pipelines are made the first time a combination of effects is used
+	nvrhi::IGraphicsPipeline* GetScreenPipeline( ShaderFeatureMask features );
+
+	// RenderFrontend.EntityData.cpp
+	bool					CreateEntityDataResources();
+	uint32_t				AllocateEntitySlot();
+	void					FreeEntitySlot( uint32_t slot );
+	// Replaces any upload of the same slot that hasn't been flushed yet
+	void					QueueEntityUpload( uint32_t slot, const EntityDesc& desc );
+	bool					ResizeEntityDataBuffer( uint32_t capacity );
+	bool					ResizeEntityUploadBuffer( uint32_t capacity );
+	// Records the scatter pass into renderCommands, must come before any entity draws
+	void					FlushEntityUploads();
+	void					SetEntityConstants( uint32_t slot, uint32_t material );
+
+	// RenderFrontend.Skinning.cpp
+	bool					CreateSkinningResources();
+	bool					ResizeBonePaletteBuffer( uint32_t capacity );
+	// Creates or destroys the entity's skin as needed, and queues it for skinning
+	void					UpdateEntitySkin( Entity* entity );
+	bool					CreateEntitySkin( Entity* entity );
+	void					DestroyEntitySkin( Entity* entity );
+	// Records skinning into renderCommands, must come before any entity draws
+	void					SkinEntities();
+	void					SkinEntityOnCpu( Entity* entity );
+
+	// RenderFrontend.Material.cpp
+	bool					CreateMaterialBindingLayouts();
+	bool					CreateMaterialResources();
+	void					DestroyMaterialResources();
+	bool					ResizeMaterialBuffer( uint32_t capacity );
+	uint32_t				GetTextureSlot( const ITexture* texture ) const;
+	// Points the texture's descriptors at its current image, which changes along with its resident mips
+	// With bindless, this moves the texture to a new slot in the table
+	void					UpdateTextureDescriptor( Texture* texture );
+	void					ReleaseTextureSlot( Texture* texture );
+	bool					CreateMaterialTextureSet( Material* material );
+	void					QueueMaterialUpload( Material* material );
+	// Records material writes into renderCommands, must come before any entity draws
+	void					FlushMaterialUploads();
+	// The texture table if bindless, otherwise the material's own binding set
+	nvrhi::IBindingSet*		GetMaterialTextureSet( uint32_t slot ) const;
+	// In models, skins and batches
+	void					ReplaceFaceMaterial( uint32_t oldMaterial, uint32_t newMaterial );
+
+	// RenderFrontend.Shadow.cpp
+	bool					CreateShadowResources();
+	void					DestroyShadowResources();
+	// Batches were created or destroyed in this area
+	void					MarkStaticChange( const Bounds& bounds );
+	void					ReleaseShadowTiles( Light* light );
+	bool					IsStaticChangeInRange( const Light* light ) const;
+	float					GetShadowImportance( const Light* light, const View* view ) const;
+	bool					UpdateShadowTiles( Light* light, float importance );
+	void					UpdateShadowMatrices( Light* light, const View* view );
+	void					ClearShadowTile( const LightShadowFace& face );
+	void					RenderShadowFace( const LightShadowFace& face, bool staticCasters );
+	
+	// RenderFrontend.PostProcess.cpp
+	bool					CreatePostProcessResources();
+	void					DestroyPostProcessResources();
+	bool					CreateBloomTargets( uint32_t width, uint32_t height );
+	void					DestroyBloomTargets();
+	ScreenConstants			GetScreenConstants( const View* view ) const;
+	ShaderFeatureMask		GetScreenFeatures() const;
+	void					DrawScreenPass( const nvrhi::GraphicsState& state, const ScreenConstants& constants );
+	bool					RenderBloom( const View* view, const ScreenConstants& viewConstants );
+	// Records all post-processing into renderCommands, ending with the view on the backbuffer
+	void					RenderPostProcess( const View* view );
+
+	// RenderFrontend.Render.cpp
+	enum class ViewUpdate : uint8_t
+	{
+		Skip,
+		Render,
+		// Render only if the visible set changed
+		CheckChanges
+	};
+
+	void					UpdateEntityTree();
+	ViewUpdate				GetViewUpdate( const View* view ) const;
+	void					HashVisibleSets( const View* const* viewList, uint32_t numViews, uint64_t* outHashes, uint64_t& outChangedMask ) const;
+	bool					IsEntityVisible( const IView* view, const IEntity* entity );
+	void					RenderEntity( const IView* view, const IEntity* entity );
+	void					RenderBatch( const IView* view, const IBatch* batch );
+	void					UpdateDynamicResolution();
+	void					RenderViews( const IView* const* viewList, uint32_t numViews );
+
+	// RenderFrontend.Visibility.cpp
+	Volume*					FindVolumeAt( const Vec3& point ) const;
+	void					AssignEntityToVolumes( Entity* entity );
+	void					UnassignEntityFromVolumes( Entity* entity );
+	void					WalkPortals( const Volume* volume, const Frustum& frustum, const Volume* cameraVolume, uint32_t depth );
+	void					GatherVisibleEntities( const View* view, Vector<IEntity*>& outEntities );
+	void					GatherVisibleEntities( const View* const* viewList, uint32_t numViews, Vector<VisibleEntity>& outEntities );
+
+	// RenderFrontend.Texture.cpp
+	std::pair<nvrhi::TextureHandle, nvrhi::TextureHandle> CreateFramebufferImagesForView( const ViewDesc& desc, MemoryTracker::OwnerId memoryOwner );
+	nvrhi::FramebufferHandle CreateFramebufferFromImages( nvrhi::ITexture* colourTexture, nvrhi::ITexture* depthTexture );
+	nvrhi::BindingSetHandle CreateBindingSetForView( nvrhi::TextureHandle colourTexture, nvrhi::TextureHandle depthTexture );
+	nvrhi::TextureHandle	CreateStreamedTextureImage( const Texture* texture, uint32_t firstMip );
+	bool					ChangeTextureResidency( Texture* texture, uint32_t newFirstMip, const Vector<const MipLoadResult*>& newMips );
+	bool					LoadPersistentMips( Texture* texture );
+	size_t					EvictTextureMips( size_t bytesToFree );
+	void					UpdateTextureStreaming();
+
+private:
+	Vector<UniquePtr<IBatch>>	batches{};
+	Vector<UniquePtr<IEntity>>	entities{};
+	Vector<UniquePtr<ILight>>	lights{};
+	Vector<UniquePtr<ITexture>>	textures{};
+	Vector<UniquePtr<IView>>	views{};
+	Vector<UniquePtr<IVolume>>	volumes{};
+	Vector<UniquePtr<IModel>>	models{};
+	ModelCache				modelCache{};
+	uint64_t				modelCacheHits{ 0U };
+	uint64_t				modelCacheMisses{ 0U };
+	// Hashes and loads models in parallel, see CreateModels
+	WorkerPool				workerPool{};
+
+	// Hierarchy over entity bounds, used for culling and spatial queries
+	EntityTree				entityTree{};
+	// Entities that were modified since the last tree update
+	Vector<Entity*>			changedEntities{};
+	// Results of the last frustum query, reused to avoid reallocating
+	Vector<VisibleEntity>	visibleEntities{};
+	// Bumped whenever entities are created or updated, so views can tell what changed since they were rendered
+	uint64_t				changeSerial{ 0U };
+	// Change serial of the last time a batch was created or destroyed
+	uint64_t				batchChangeSerial{ 0U };
+	// Bumped when materials or texture images change, which changes how entities look without touching them
+	uint64_t				shadingChangeSerial{ 0U };
+	uint64_t				viewsRendered{ 0U };
+	// Views that kept their last image, due to their update policy
+	uint64_t				viewsReused{ 0U };
+
+	// Where batches were created or destroyed, so that cached shadows only redraw what's affected
+	struct StaticChange
+	{
+		uint64_t serial{ 0U };
+		Bounds bounds{};
+	};
+	static constexpr size_t	MaxStaticChanges = 64U;
+	std::deque<StaticChange> staticChanges{};
+
+	ShadowSettings			shadowSettings{};
+	ShadowAtlas				shadowAtlas{};
+	// Lights that have shadows this frame, sorted by importance
+	Vector<Light*>			shadowLights{};
+	// Results of the shadow caster queries
+	Vector<IEntity*>		shadowCasters{};
+	uint64_t				shadowTilesRedrawn{ 0U };
+	uint64_t				shadowTilesCached{ 0U };
+
+	// Portal traversal state, indexed by volume index
+	struct VolumeVisibility
+	{
+		Frustum frustum{};
+		bool reached{ false };
+		bool onPath{ false };
+	};
+	Vector<VolumeVisibility> volumeVisibility{};
+	uint32_t				visibilityStamp{ 0U };
+
+	// Texture streaming, textures are looked up by streaming ID when loads finish
+	TextureStreamer			textureStreamer{};
+	Map<uint32_t, Texture*>	streamedTextures{};
+	TextureCache			textureCache{};
+	Vector<MipLoadResult>	pendingMipUploads{};
+	uint32_t				nextTextureId{ 1U };
+	uint32_t				nextViewId{ 0U };
+	size_t					textureMemoryBudget{ 512U * 1024U * 1024U };
+	size_t					textureMemoryUsage{ 0U };
+	// Mips that are being loaded and will soon be resident
+	size_t					textureMemoryPending{ 0U };
+
+	uint64_t				frameIndex{ 0U };
+
+	MemoryTracker			memoryTracker{};
+	GpuProfiler				gpuProfiler{};
+	ResolutionGovernor		resolutionGovernor{};
+	// Last GPU frame the governor has seen, GPU timings come in a few frames late
+	uint64_t				governedGpuFrame{ 0U };
+	// Time between the last two BeginFrames, used when there are no GPU timings
+	std::chrono::steady_clock::time_point lastFrameStart{};
+	float					cpuFrameMilliseconds{ 0.0f };
+	CommandStats			commandStats{};
+	// Filters out redundant setGraphicsState calls on renderCommands
+	GraphicsStateTracker	stateTracker{};
+	MemoryTracker::OwnerId	constantBufferMemory{ MemoryTracker::InvalidOwner };
+
+	IWindow*				window{ nullptr };
+	RenderBackend*			backendManager{ nullptr };
+	IBackend*				backend{ nullptr };
+	// Only set when headless, see PostInitHeadless
+	nvrhi::TextureHandle	headlessColour{ nullptr };
+	nvrhi::FramebufferHandle headlessFramebuffer{ nullptr };
+
+	nvrhi::SamplerHandle	screenSampler{ nullptr };
+
+	// Everything the CPU writes into while recording a frame. There's one of these per frame
+	// in flight, so the CPU can record the next frame while the GPU is still executing this one
+	// Command lists own their upload chunks, so each frame effectively has its own upload ring
+	struct FrameResources
+	{
+		nvrhi::CommandListHandle renderCommands{};
+		nvrhi::BufferHandle viewDataBuffer{};
+		nvrhi::BindingSetHandle viewFrameBindingSet{};
+		// Signalled once the GPU finishes the frame's last submission
+		nvrhi::EventQueryHandle fence{};
+		bool submitted{ false };
+		uint64_t frameIndex{ 0U };
+	};
+
+	static constexpr uint32_t MaxFramesInFlight = 4U;
+	uint32_t				framesInFlight{ 2U };
+	Vector<FrameResources>	frames{};
+	FrameResources*			currentFrame{ nullptr };
+	// Frames where the CPU had to wait for the GPU to free up the frame's resources
+	uint64_t				frameStalls{ 0U };
+	// The newest frame that the GPU is known to have finished
+	uint64_t				completedFrameIndex{ 0U };
+
+	// Destroyed objects wait here until the GPU is done with them
+	DeferredReleaseQueue	releaseQueue{};
+	// Destroy* calls from other threads are deferred to the main thread. Only the null check
+	// happens right away, an unregistered object is reported when the request runs
+	std::thread::id			mainThread{};
+
+	// Used for loading, outside of frames
+	nvrhi::CommandListHandle transferCommands{};
+	// The current frame's command list, see AcquireFrameResources
+	nvrhi::CommandListHandle renderCommands{};
+
+	// Todo: replace with a map of vertex layouts
+	// E.g. something that could be used like GetVertexLayoutForCombo( { VA::Position, VA::Normal } );
+	// In latter iterations, when we have a material system, base materials will demand vertex layout
+	// specifications, and this is crucial for that
+	// One per entity shader permutation, the layout only has the streams the permutation reads
+	nvrhi::InputLayoutHandle entityVertexLayouts[EntityFeatures::NumPermutations]{};
+	// This will also be changed once we have a material system.
+	// Each material base will have its own pipeline which uses its own shader
+	nvrhi::BindingLayoutHandle viewFrameBindingLayout{};
+	nvrhi::BindingLayoutHandle entityBindingLayout{};
+	// Look at ViewFrameData, it's the current frame's, same as renderCommands
+	nvrhi::BufferHandle		viewDataBuffer{};
+	ViewFrameData			currentViewData;
+	// This binding set contains the projection & view matrix. It changes per frame and per view
+	// Later on there will be a per-surface binding set too, once we have texturing and all
+	nvrhi::BindingSetHandle viewFrameBindingSet{};
+	// This binding set contains the entity buffer, it only changes when the buffer grows
+	nvrhi::BindingSetHandle entityBindingSet{};
+
+	// Transforms and parameters of all entities, see EntityData
+	// Entries stay on the GPU, only the changed ones are uploaded each frame
+	static constexpr uint32_t IdentityEntitySlot = 0U;
+	nvrhi::BufferHandle		entityDataBuffer{};
+	uint32_t				entityDataCapacity{ 0U };
+	// Slot 0 is an identity transform, used by batches
+	uint32_t				numEntitySlots{ 1U };
+	Vector<uint32_t>		freeEntitySlots{};
+	Vector<EntityUpload>	pendingEntityUploads{};
+	// Index + 1 into pendingEntityUploads per slot, 0 if the slot has no pending upload
+	Vector<uint32_t>		pendingEntitySlots{};
+	nvrhi::BufferHandle		entityUploadBuffer{};
+	uint32_t				entityUploadCapacity{ 0U };
+	nvrhi::ShaderHandle		entityScatterShader{};
+	nvrhi::BindingLayoutHandle entityScatterBindingLayout{};
+	nvrhi::BindingSetHandle entityScatterBindingSet{};
+	nvrhi::ComputePipelineHandle entityScatterPipeline{};
+	MemoryTracker::OwnerId	entityDataMemory{ MemoryTracker::InvalidOwner };
+	uint64_t				entityUploads{ 0U };
+	// Skinned entities that changed since they were last skinned
+	Vector<Entity*>			pendingSkins{};
+	// Bones of all pending entities, uploaded in one go
+	Vector<Mat4>			bonePalette{};
+	nvrhi::BufferHandle		bonePaletteBuffer{};
+	uint32_t				bonePaletteCapacity{ 0U };
+	nvrhi::ShaderHandle		skinningShader{};
+	nvrhi::BindingLayoutHandle skinningPaletteBindingLayout{};
+	nvrhi::BindingLayoutHandle skinningFaceBindingLayout{};
+	nvrhi::BindingSetHandle skinningPaletteBindingSet{};
+	nvrhi::ComputePipelineHandle skinningPipeline{};
+	MemoryTracker::OwnerId	bonePaletteMemory{ MemoryTracker::InvalidOwner };
+	bool					skinningOnCpu{ false };
+	// Scratch space of the CPU path
+	Vector<float>			skinnedPositions{};
+	Vector<int8_t>			skinnedNormals{};
+	Vector<float>			skinningBoneColumns{};
+	uint64_t				verticesSkinned{ 0U };
+	ShaderPermutations		entityVertexShaders{};
+	ShaderPermutations		entityPixelShaders{};
+	// Indexed by the faces' EntityFeatures, all of these are made up front
+	nvrhi::GraphicsPipelineHandle entityPipelines[EntityFeatures::NumPermutations]{};
+
+	// Materials, see RenderFrontend.Material.cpp
+	static constexpr uint32_t DefaultMaterialSlot = 0U;
+	static constexpr uint32_t WhiteTextureSlot = 0U;
+	Vector<UniquePtr<Material>>	materials{};
+	// Indexed by material slot, null for free slots
+	Vector<Material*>		materialSlots{};
+	Vector<Material*>		pendingMaterialUploads{};
+	SlotAllocator			materialSlotAllocator{};
+	nvrhi::BufferHandle		materialBuffer{};
+	uint32_t				materialCapacity{ 0U };
+	nvrhi::SamplerHandle	materialSampler{};
+	// The material buffer and the sampler, only changes when the buffer grows
+	nvrhi::BindingLayoutHandle materialBindingLayout{};
+	nvrhi::BindingSetHandle materialBindingSet{};
+	nvrhi::TextureHandle	whiteTexture{};
+	MemoryTracker::OwnerId	materialMemory{ MemoryTracker::InvalidOwner };
+	// With bindless, all textures are in one descriptor table, bound along with the material buffer
+	// Without it, each material has a binding set with its textures, switched per draw
+	bool					bindless{ false };
+	nvrhi::BindingLayoutHandle textureTableLayout{};
+	nvrhi::DescriptorTableHandle textureTable{};
+	SlotAllocator			textureSlots{};
+	nvrhi::BindingLayoutHandle materialTextureBindingLayout{};
+	
+	// The screen pass draws a single fullscreen triangle, without any vertex buffers
+	// 1 texture sampler, 1 colour attachment, 1 depth attachment
+	nvrhi::BindingLayoutHandle screenBindingLayout{};
+	// The bloom texture, read by the screen pass
+	nvrhi::BindingLayoutHandle postBindingLayout{};
+	nvrhi::ShaderHandle		screenVertexShader{};
+	ShaderPermutations		screenPixelShaders{};
+	// Per ScreenFeatures combination
+	Map<ShaderFeatureMask, nvrhi::GraphicsPipelineHandle> screenPipelines{};
+
+	PostProcessSettings		postSettings{};
+	MemoryTracker::OwnerId	postProcessMemory{ MemoryTracker::InvalidOwner };
+	nvrhi::TextureHandle	postBlackTexture{};
+	nvrhi::BindingSetHandle postBlackBindingSet{};
+	// Two targets to ping-pong between, the result is always in the first one
+	nvrhi::TextureHandle	bloomTextures[2]{};
+	nvrhi::FramebufferHandle bloomFramebuffers[2]{};
+	nvrhi::BindingSetHandle bloomSourceBindingSets[2]{};
+	nvrhi::BindingSetHandle bloomBindingSet{};
+	uint32_t				bloomWidth{ 0U };
+	uint32_t				bloomHeight{ 0U };
+	// Size the bloom targets last failed to be created at, so it isn't retried every frame
+	uint32_t				bloomFailedWidth{ 0U };
+	uint32_t				bloomFailedHeight{ 0U };
+	nvrhi::ShaderHandle		bloomDownsampleShader{};
+	nvrhi::ShaderHandle		bloomBlurShader{};
+	nvrhi::GraphicsPipelineHandle bloomDownsamplePipeline{};
+	nvrhi::GraphicsPipelineHandle bloomBlurPipeline{};
+
+	// Batches only ever go into the static atlas, which is copied into the dynamic one every frame
+	nvrhi::TextureHandle	shadowStaticAtlas{};
+	nvrhi::TextureHandle	shadowDynamicAtlas{};
+	nvrhi::FramebufferHandle shadowStaticFramebuffer{};
+	nvrhi::FramebufferHandle shadowDynamicFramebuffer{};
+	MemoryTracker::OwnerId	shadowAtlasMemory{ MemoryTracker::InvalidOwner };
+	// Depth only, positions only, with depth bias
+	nvrhi::InputLayoutHandle shadowVertexLayout{};
+	nvrhi::ShaderHandle		shadowVertexShader{};
+	nvrhi::GraphicsPipelineHandle shadowPipeline{};
+	// Writes the far plane into a tile, since depth clears can't be limited to a part of the atlas
+	nvrhi::GraphicsPipelineHandle shadowClearPipeline{};
+	nvrhi::BufferHandle		shadowClearVertexBuffer{};
+	nvrhi::BufferHandle		shadowClearIndexBuffer{};
+};
@@ -0,0 +1,60 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "ResolutionGovernor.hpp"
+
+void ResolutionGovernor::SetSettings( const Settings& newSettings )
+{
+	settings = newSettings;
+	settings.minScale = std::clamp( settings.minScale, MinScale, 1.0f );
+	settings.maxScale = std::clamp( settings.maxScale, settings.minScale, 1.0f );
+	scale = std::clamp( scale, settings.minScale, settings.maxScale );
+}
+
+const ResolutionGovernor::Settings& ResolutionGovernor::GetSettings() const
+{
+	return settings;
+}
+
+float ResolutionGovernor::Update( float gpuMilliseconds, float cpuMilliseconds )
+{
+	const float measured = gpuMilliseconds > 0.0f ? gpuMilliseconds : cpuMilliseconds;
+	if ( measured <= 0.0f || settings.targetMilliseconds <= 0.0f )
+	{
+		return scale;
+	}
+
+	const float target = settings.targetMilliseconds * settings.headroom;
+	const float ideal = std::clamp( scale * std::sqrt( target / measured ), settings.minScale, settings.maxScale );
+
+	// Limits are always reached though, so a light scene ends up at full resolution
+	const float difference = ideal - scale;
+	const bool atLimit = ideal == settings.minScale || ideal == settings.maxScale;
+	if ( std::abs( difference ) < settings.deadZone && !atLimit )
+	{
+		return scale;
+	}
+
+	// A dropped frame is worse than a blurry one, so drop straight to the ideal scale
+	if ( measured > settings.targetMilliseconds )
+	{
+		scale = ideal;
+		return scale;
+	}
+
+	// Steps are at least as big as the dead zone, otherwise the damping would stall right before it
+	const float step = std::max( std::abs( difference ) * settings.damping, settings.deadZone );
+	scale += std::copysign( std::min( step, std::abs( difference ) ), difference );
+	return scale;
+}
+
+float ResolutionGovernor::GetScale() const
+{
+	return scale;
+}
+
+void ResolutionGovernor::Reset()
+{
+	scale = settings.maxScale;
+}
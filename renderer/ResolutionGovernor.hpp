@@ -0,0 +1,42 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+// Picks the resolution scale for views with dynamic resolution, so that frames fit a time budget
+// Rendering cost is assumed to grow with the area, i.e. with the square of the scale
+// Going over the budget is reacted to immediately, while coming back up is damped,
+// and tiny changes are ignored, so the resolution doesn't flicker between two values
+class ResolutionGovernor
+{
+public:
+	struct Settings
+	{
+		float targetMilliseconds{ 16.6f };
+		float minScale{ 0.5f };
+		float maxScale{ 1.0f };
+		// Fraction of the budget to aim for, leaves some room for spikes
+		float headroom{ 0.9f };
+		// How far the scale moves towards the ideal one per update, when under budget
+		float damping{ 0.25f };
+		// Changes smaller than this are ignored
+		float deadZone{ 0.02f };
+	};
+
+	// No view renders at less than this, whatever the settings say
+	static constexpr float MinScale = 0.25f;
+
+	void					SetSettings( const Settings& newSettings );
+	const Settings&			GetSettings() const;
+
+	// Feeds one frame's measurements and returns the new scale
+	// Resolution mostly affects GPU work, so GPU time is used when there is one,
+	// otherwise pass 0 and the CPU frame time is used instead
+	float					Update( float gpuMilliseconds, float cpuMilliseconds );
+	float					GetScale() const;
+	void					Reset();
+
+private:
+	Settings				settings{};
+	float					scale{ 1.0f };
+};
@@ -0,0 +1,106 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "ShaderPermutations.hpp"
+#include <nvrhi/common/shader-blob.h>
+
+void ShaderPermutations::Init( IBackend* device, nvrhi::ShaderType type, const char* entryName, StringView name,
+	Vector<uint8_t>&& blob, const char* const* featureDefines, uint32_t numFeatures, const uint32_t* featureValues )
+{
+	Clear();
+	this->device = device;
+	this->type = type;
+	this->entryName = entryName;
+	this->name = String( name );
+	this->blob = std::move( blob );
+	defines.assign( featureDefines, featureDefines + numFeatures );
+
+	for ( uint32_t i = 0U; i < numFeatures; i++ )
+	{
+		const uint32_t numValues = nullptr != featureValues ? std::max( featureValues[i], 2U ) : 2U;
+		uint32_t bits = 1U;
+		while ( (1U << bits) < numValues )
+		{
+			bits++;
+		}
+
+		values.push_back( numValues );
+		shifts.push_back( numBits );
+		numBits += bits;
+	}
+}
+
+nvrhi::IShader* ShaderPermutations::Get( ShaderFeatureMask features )
+{
+	auto it = shaders.find( features );
+	if ( it != shaders.end() )
+	{
+		return it->second;
+	}
+
+	// The constants point into these
+	Vector<String> valueStrings( defines.size() );
+	Vector<nvrhi::ShaderConstant> constants;
+	for ( size_t i = 0U; i < defines.size(); i++ )
+	{
+		valueStrings[i] = format( "%u", GetValue( features, i ) );
+		constants.push_back( { defines[i], valueStrings[i].c_str() } );
+	}
+
+	const void* binary = nullptr;
+	size_t binarySize = 0U;
+	if ( !nvrhi::findPermutationInBlob( blob.data(), blob.size(), constants.data(), uint32_t( constants.size() ), &binary, &binarySize ) )
+	{
+		Console->Error( format( "ShaderPermutations: shader '%s' has no permutation 0x%x: %s", name.c_str(), features,
+			nvrhi::formatShaderNotFoundMessage( blob.data(), blob.size(), constants.data(), uint32_t( constants.size() ) ).c_str() ) );
+		// Remembered, so the error isn't repeated every frame
+		shaders[features] = nullptr;
+		return nullptr;
+	}
+
+	auto desc = nvrhi::ShaderDesc( type );
+	desc.entryName = entryName;
+
+	nvrhi::ShaderHandle shader = device->createShader( desc, binary, binarySize );
+	if ( nullptr == shader )
+	{
+		Console->Error( format( "ShaderPermutations: shader '%s', permutation 0x%x appears to be corrupted", name.c_str(), features ) );
+	}
+
+	shaders[features] = shader;
+	return shader;
+}
+
+uint32_t ShaderPermutations::GetValue( ShaderFeatureMask features, size_t define ) const
+{
+	const uint32_t end = define + 1U < shifts.size() ? shifts[define + 1U] : numBits;
+	return (features >> shifts[define]) & ((1U << (end - shifts[define])) - 1U);
+}
+
+bool ShaderPermutations::CreateAll()
+{
+	bool failed = false;
+	for ( ShaderFeatureMask features = 0U; features < GetNumPermutations(); features++ )
+	{
+		bool inRange = true;
+		for ( size_t i = 0U; i < defines.size(); i++ )
+		{
+			inRange &= GetValue( features, i ) < values[i];
+		}
+
+		failed |= inRange && nullptr == Get( features );
+	}
+
+	return !failed;
+}
+
+void ShaderPermutations::Clear()
+{
+	shaders.clear();
+	blob.clear();
+	defines.clear();
+	values.clear();
+	shifts.clear();
+	numBits = 0U;
+}
@@ -0,0 +1,48 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+// One bit per shader feature. A feature is a define that's either 0 or 1, or a small
+// number for features with more values, which then take as many bits as they need
+// Every combination is compiled offline into the shader's blob, see shaders.cfg,
+// so a draw only pays for the features it actually uses
+using ShaderFeatureMask = uint32_t;
+
+// All permutations of one shader stage. Shaders are created the first time they're asked for,
+// the blob is kept around until then
+class ShaderPermutations
+{
+public:
+	// Feature defines are in the order of their bits
+	// featureValues is how many values each define has, null if they're all 0 or 1
+	void					Init( IBackend* device, nvrhi::ShaderType type, const char* entryName, StringView name,
+								Vector<uint8_t>&& blob, const char* const* featureDefines, uint32_t numFeatures,
+								const uint32_t* featureValues = nullptr );
+	// Null if the blob doesn't have this permutation
+	nvrhi::IShader*			Get( ShaderFeatureMask features );
+	// Creates every permutation up front, so there are no hitches later
+	bool					CreateAll();
+	void					Clear();
+
+	// Including masks with out-of-range values, which don't have a permutation
+	uint32_t				GetNumPermutations() const
+	{
+		return 1U << numBits;
+	}
+
+private:
+	uint32_t				GetValue( ShaderFeatureMask features, size_t define ) const;
+
+	IBackend*				device{ nullptr };
+	nvrhi::ShaderType		type{ nvrhi::ShaderType::None };
+	const char*				entryName{ nullptr };
+	String					name{};
+	Vector<uint8_t>			blob{};
+	Vector<const char*>		defines{};
+	Vector<uint32_t>		values{};
+	// Where each define's value starts in the mask
+	Vector<uint32_t>		shifts{};
+	uint32_t				numBits{ 0U };
+	Map<ShaderFeatureMask, nvrhi::ShaderHandle> shaders{};
+};
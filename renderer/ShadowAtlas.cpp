@@ -0,0 +1,189 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "ShadowAtlas.hpp"
+
+static uint32_t NextPowerOfTwo( uint32_t value )
+{
+	uint32_t result = 1U;
+	while ( result < value )
+	{
+		result <<= 1U;
+	}
+	return result;
+}
+
+static uint32_t Log2( uint32_t value )
+{
+	uint32_t result = 0U;
+	while ( value > 1U )
+	{
+		value >>= 1U;
+		result++;
+	}
+	return result;
+}
+
+void ShadowAtlas::Init( uint32_t newAtlasSize, uint32_t newMinTileSize )
+{
+	atlasSize = NextPowerOfTwo( newAtlasSize );
+	minTileSize = std::min( NextPowerOfTwo( newMinTileSize ), atlasSize );
+	numLevels = Log2( atlasSize / minTileSize ) + 1U;
+
+	// 1 + 4 + 16 + ... nodes
+	size_t numNodes = 0U;
+	for ( uint32_t level = 0U; level < numLevels; level++ )
+	{
+		numNodes += size_t( 1U ) << (level * 2U);
+	}
+
+	nodes.assign( numNodes, NodeState::Free );
+	usedArea = 0U;
+}
+
+ShadowAtlas::Tile ShadowAtlas::Allocate( uint32_t size )
+{
+	if ( nodes.empty() )
+	{
+		return {};
+	}
+
+	size = RoundTileSize( size );
+	const uint32_t targetLevel = Log2( atlasSize / size );
+
+	const int32_t node = FindNode( 0, 0U, targetLevel );
+	if ( node < 0 )
+	{
+		return {};
+	}
+
+	nodes[node] = NodeState::Used;
+	usedArea += uint64_t( size ) * size;
+	return GetTile( node, targetLevel );
+}
+
+uint32_t ShadowAtlas::RoundTileSize( uint32_t size ) const
+{
+	return std::clamp( NextPowerOfTwo( size ), minTileSize, atlasSize );
+}
+
+void ShadowAtlas::Free( Tile& tile )
+{
+	if ( !tile.IsValid() || size_t( tile.node ) >= nodes.size() || nodes[tile.node] != NodeState::Used )
+	{
+		tile = {};
+		return;
+	}
+
+	nodes[tile.node] = NodeState::Free;
+	usedArea -= uint64_t( tile.size ) * tile.size;
+
+	// Merge free siblings back into their parent
+	int32_t node = tile.node;
+	while ( node > 0 )
+	{
+		const int32_t parent = (node - 1) / 4;
+		const int32_t firstChild = parent * 4 + 1;
+		for ( int32_t child = firstChild; child < firstChild + 4; child++ )
+		{
+			if ( nodes[child] != NodeState::Free )
+			{
+				tile = {};
+				return;
+			}
+		}
+
+		nodes[parent] = NodeState::Free;
+		node = parent;
+	}
+
+	tile = {};
+}
+
+void ShadowAtlas::Clear()
+{
+	std::fill( nodes.begin(), nodes.end(), NodeState::Free );
+	usedArea = 0U;
+}
+
+uint32_t ShadowAtlas::GetSize() const
+{
+	return atlasSize;
+}
+
+uint32_t ShadowAtlas::GetMinTileSize() const
+{
+	return minTileSize;
+}
+
+float ShadowAtlas::GetUsage() const
+{
+	if ( 0U == atlasSize )
+	{
+		return 0.0f;
+	}
+
+	return float( double( usedArea ) / (double( atlasSize ) * atlasSize) );
+}
+
+int32_t ShadowAtlas::FindNode( int32_t node, uint32_t level, uint32_t targetLevel )
+{
+	const NodeState state = nodes[node];
+	if ( level == targetLevel )
+	{
+		return state == NodeState::Free ? node : -1;
+	}
+
+	if ( state == NodeState::Used )
+	{
+		return -1;
+	}
+
+	// Children of a free node are all free, so this always succeeds
+	if ( state == NodeState::Free )
+	{
+		nodes[node] = NodeState::Split;
+		return FindNode( node * 4 + 1, level + 1U, targetLevel );
+	}
+
+	// Split children first, free ones only if that didn't work out
+	for ( const bool wantSplit : { true, false } )
+	{
+		for ( int32_t child = node * 4 + 1; child <= node * 4 + 4; child++ )
+		{
+			if ( (nodes[child] == NodeState::Split) != wantSplit )
+			{
+				continue;
+			}
+
+			const int32_t result = FindNode( child, level + 1U, targetLevel );
+			if ( result >= 0 )
+			{
+				return result;
+			}
+		}
+	}
+
+	return -1;
+}
+
+ShadowAtlas::Tile ShadowAtlas::GetTile( int32_t node, uint32_t level ) const
+{
+	Tile tile;
+	tile.node = node;
+	tile.size = atlasSize >> level;
+
+	// Each step up the tree tells which quadrant of the parent this is
+	uint32_t size = tile.size;
+	while ( node > 0 )
+	{
+		const int32_t quadrant = (node - 1) % 4;
+		tile.x += (quadrant & 1) ? size : 0U;
+		tile.y += (quadrant & 2) ? size : 0U;
+		node = (node - 1) / 4;
+		size <<= 1U;
+	}
+
+	return tile;
+}
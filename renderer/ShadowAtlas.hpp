@@ -0,0 +1,62 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+// Hands out square, power-of-two tiles of a shadow atlas
+// It's a quadtree buddy allocator: a tile is split into 4 to make room for smaller ones,
+// and 4 free siblings are merged back. Allocations prefer tiles that are already split,
+// so big tiles stay free for as long as possible
+class ShadowAtlas
+{
+public:
+	struct Tile
+	{
+		uint32_t x{ 0U };
+		uint32_t y{ 0U };
+		uint32_t size{ 0U };
+		int32_t node{ -1 };
+
+		bool IsValid() const
+		{
+			return node >= 0;
+		}
+
+		bool operator==( const Tile& other ) const
+		{
+			return node == other.node;
+		}
+	};
+
+	void					Init( uint32_t atlasSize, uint32_t minTileSize );
+	// Sizes are rounded up to a power of two, within the min tile size and the atlas size
+	// Returns an invalid tile if there's no room
+	Tile					Allocate( uint32_t size );
+	uint32_t				RoundTileSize( uint32_t size ) const;
+	void					Free( Tile& tile );
+	void					Clear();
+
+	uint32_t				GetSize() const;
+	uint32_t				GetMinTileSize() const;
+	// Fraction of the atlas area that's allocated
+	float					GetUsage() const;
+
+private:
+	enum class NodeState : uint8_t
+	{
+		Free,
+		Split,
+		Used
+	};
+
+	int32_t					FindNode( int32_t node, uint32_t level, uint32_t targetLevel );
+	Tile					GetTile( int32_t node, uint32_t level ) const;
+
+private:
+	// Complete quadtree, the children of node N are 4N+1 to 4N+4
+	Vector<NodeState>		nodes{};
+	uint32_t				atlasSize{ 0U };
+	uint32_t				minTileSize{ 0U };
+	uint32_t				numLevels{ 0U };
+	uint64_t				usedArea{ 0U };
+};
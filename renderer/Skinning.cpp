@@ -0,0 +1,156 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "Skinning.hpp"
+
+#if defined( __SSE__ ) || defined( _M_X64 ) || (defined( _M_IX86_FP ) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define SKINNING_SSE 1
+#endif
+
+namespace Skinning
+{
+	// 16 floats per bone, column by column, so a column can be loaded as a whole
+	static void GetBoneColumns( const Mat4* bones, size_t numBones, Vector<float>& outColumns )
+	{
+		outColumns.resize( numBones * 16U );
+		for ( size_t bone = 0U; bone < numBones; bone++ )
+		{
+			for ( size_t column = 0U; column < 4U; column++ )
+			{
+				const Vec4 basis( column == 0U ? 1.0f : 0.0f, column == 1U ? 1.0f : 0.0f,
+					column == 2U ? 1.0f : 0.0f, column == 3U ? 1.0f : 0.0f );
+				const Vec4 value = bones[bone] * basis;
+
+				float* out = &outColumns[bone * 16U + column * 4U];
+				out[0] = value.m.x;
+				out[1] = value.m.y;
+				out[2] = value.m.z;
+				out[3] = value.m.w;
+			}
+		}
+	}
+
+	// Same as in skinning.hlsl, vertices without any weight follow their first bone
+	static void GetWeights( const uint8_t* packed, float outWeights[MaxInfluences] )
+	{
+		const uint32_t sum = uint32_t( packed[0] ) + packed[1] + packed[2] + packed[3];
+		if ( 0U == sum )
+		{
+			outWeights[0] = 1.0f;
+			outWeights[1] = outWeights[2] = outWeights[3] = 0.0f;
+			return;
+		}
+
+		const float inverseSum = 1.0f / float( sum );
+		for ( uint32_t i = 0U; i < MaxInfluences; i++ )
+		{
+			outWeights[i] = packed[i] * inverseSum;
+		}
+	}
+
+	static int8_t PackSnorm8( float value )
+	{
+		return int8_t( std::round( std::clamp( value, -1.0f, 1.0f ) * 127.0f ) );
+	}
+
+	static void WriteNormal( float x, float y, float z, int8_t w, int8_t* out )
+	{
+		const float length = std::sqrt( x * x + y * y + z * z );
+		const float inverseLength = length > 0.0f ? 1.0f / length : 0.0f;
+		out[0] = PackSnorm8( x * inverseLength );
+		out[1] = PackSnorm8( y * inverseLength );
+		out[2] = PackSnorm8( z * inverseLength );
+		out[3] = w;
+	}
+
+	void SkinVertices( const float* positions, const int8_t* normals,
+		const uint8_t* boneIndices, const uint8_t* boneWeights, size_t numVertices,
+		const Mat4* bones, size_t numBones, float* outPositions, int8_t* outNormals,
+		Vector<float>& boneColumns )
+	{
+		if ( 0U == numBones )
+		{
+			return;
+		}
+
+		GetBoneColumns( bones, numBones, boneColumns );
+		const size_t lastBone = numBones - 1U;
+
+		for ( size_t v = 0U; v < numVertices; v++ )
+		{
+			float weights[MaxInfluences];
+			GetWeights( &boneWeights[v * 4U], weights );
+
+			const float* position = &positions[v * 3U];
+			const int8_t* normal = &normals[v * 4U];
+			const float nx = std::max( normal[0] / 127.0f, -1.0f );
+			const float ny = std::max( normal[1] / 127.0f, -1.0f );
+			const float nz = std::max( normal[2] / 127.0f, -1.0f );
+
+#if SKINNING_SSE
+			// Blend the bones' columns, then transform with the blended matrix
+			__m128 columns[4] = { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+			for ( uint32_t i = 0U; i < MaxInfluences; i++ )
+			{
+				if ( weights[i] <= 0.0f )
+				{
+					continue;
+				}
+
+				const float* bone = &boneColumns[std::min<size_t>( boneIndices[v * 4U + i], lastBone ) * 16U];
+				const __m128 weight = _mm_set1_ps( weights[i] );
+				for ( uint32_t c = 0U; c < 4U; c++ )
+				{
+					columns[c] = _mm_add_ps( columns[c], _mm_mul_ps( weight, _mm_loadu_ps( &bone[c * 4U] ) ) );
+				}
+			}
+
+			const __m128 direction = _mm_add_ps( _mm_add_ps(
+				_mm_mul_ps( columns[0], _mm_set1_ps( nx ) ),
+				_mm_mul_ps( columns[1], _mm_set1_ps( ny ) ) ),
+				_mm_mul_ps( columns[2], _mm_set1_ps( nz ) ) );
+			const __m128 point = _mm_add_ps( _mm_add_ps( _mm_add_ps(
+				_mm_mul_ps( columns[0], _mm_set1_ps( position[0] ) ),
+				_mm_mul_ps( columns[1], _mm_set1_ps( position[1] ) ) ),
+				_mm_mul_ps( columns[2], _mm_set1_ps( position[2] ) ) ),
+				columns[3] );
+
+			float skinnedPosition[4];
+			float skinnedNormal[4];
+			_mm_storeu_ps( skinnedPosition, point );
+			_mm_storeu_ps( skinnedNormal, direction );
+#else
+			float columns[16]{};
+			for ( uint32_t i = 0U; i < MaxInfluences; i++ )
+			{
+				if ( weights[i] <= 0.0f )
+				{
+					continue;
+				}
+
+				const float* bone = &boneColumns[std::min<size_t>( boneIndices[v * 4U + i], lastBone ) * 16U];
+				for ( uint32_t j = 0U; j < 16U; j++ )
+				{
+					columns[j] += weights[i] * bone[j];
+				}
+			}
+
+			float skinnedPosition[4];
+			float skinnedNormal[4];
+			for ( uint32_t j = 0U; j < 4U; j++ )
+			{
+				skinnedNormal[j] = columns[j] * nx + columns[4U + j] * ny + columns[8U + j] * nz;
+				skinnedPosition[j] = columns[j] * position[0] + columns[4U + j] * position[1]
+					+ columns[8U + j] * position[2] + columns[12U + j];
+			}
+#endif
+
+			outPositions[v * 3U] = skinnedPosition[0];
+			outPositions[v * 3U + 1U] = skinnedPosition[1];
+			outPositions[v * 3U + 2U] = skinnedPosition[2];
+			WriteNormal( skinnedNormal[0], skinnedNormal[1], skinnedNormal[2], normal[3], &outNormals[v * 4U] );
+		}
+	}
+}
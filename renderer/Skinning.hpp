@@ -0,0 +1,50 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "Model.hpp"
+#include "MemoryTracker.hpp"
+
+// Skinned faces have BoneIndices and BoneWeights segments, 4 influences per vertex
+// Indices are 4 uint8s and weights are 4 unorm8s, packed like colours
+// Weights are normalised, so they don't have to add up to exactly 255
+// Bones are model-space matrices, i.e. the bind pose is already taken out of them
+namespace Skinning
+{
+	constexpr uint32_t MaxInfluences = 4U;
+
+	// CPU version of skinning.hlsl, uses SSE where available. Keep the two in sync by hand
+	// Positions are float triplets, normals are 4 snorm8s whose 4th component is kept
+	// Bone indices past numBones are clamped to the last bone
+	// boneColumns is scratch space, kept by the caller so it isn't reallocated every call
+	void					SkinVertices( const float* positions, const int8_t* normals,
+								const uint8_t* boneIndices, const uint8_t* boneWeights, size_t numVertices,
+								const Mat4* bones, size_t numBones, float* outPositions, int8_t* outNormals,
+								Vector<float>& boneColumns );
+}
+
+// An entity's own copy of the skinned streams of one face
+struct SkinnedFace
+{
+	// Null if the face has no bone data, it's drawn straight from the model then
+	nvrhi::BufferHandle		positionBuffer{};
+	nvrhi::BufferHandle		normalBuffer{};
+	// The model's streams in, the buffers above out
+	nvrhi::BindingSetHandle bindingSet{};
+	uint32_t				numVertices{ 0U };
+};
+
+// GPU state of an entity with bones, see RenderFrontend.Skinning.cpp
+// Skinning runs once per change, the results are shared by all views and shadow passes
+struct EntitySkin
+{
+	const IModel*			model{ nullptr };
+	// One per model face
+	Vector<SkinnedFace>		faces{};
+	// The model's draw records, with the skinned buffers swapped in
+	Vector<FaceDrawRecord>	drawRecords{};
+	MemoryTracker::OwnerId	memoryOwner{ MemoryTracker::InvalidOwner };
+	// Already queued for the next SkinEntities
+	bool					pending{ false };
+};
@@ -0,0 +1,77 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "SlotAllocator.hpp"
+
+void SlotAllocator::Init( uint32_t newMaxSlots, uint32_t numReserved )
+{
+	Clear();
+	maxSlots = newMaxSlots;
+	numSlots = std::min( numReserved, maxSlots );
+	numUsed = numSlots;
+}
+
+uint32_t SlotAllocator::Allocate()
+{
+	uint32_t slot = InvalidSlot;
+	if ( !freeSlots.empty() )
+	{
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else if ( numSlots < maxSlots )
+	{
+		slot = numSlots++;
+	}
+	else
+	{
+		return InvalidSlot;
+	}
+
+	numUsed++;
+	return slot;
+}
+
+void SlotAllocator::Free( uint32_t slot, uint64_t frameIndex )
+{
+	if ( slot >= numSlots )
+	{
+		return;
+	}
+
+	pendingFrees.push_back( { frameIndex, slot } );
+	numUsed--;
+}
+
+void SlotAllocator::Reclaim( uint64_t completedFrame )
+{
+	while ( !pendingFrees.empty() && pendingFrees.front().frameIndex <= completedFrame )
+	{
+		freeSlots.push_back( pendingFrees.front().slot );
+		pendingFrees.pop_front();
+	}
+}
+
+void SlotAllocator::Clear()
+{
+	numSlots = 0U;
+	numUsed = 0U;
+	freeSlots.clear();
+	pendingFrees.clear();
+}
+
+uint32_t SlotAllocator::GetNumSlots() const
+{
+	return numSlots;
+}
+
+uint32_t SlotAllocator::GetNumUsed() const
+{
+	return numUsed;
+}
+
+uint32_t SlotAllocator::GetMaxSlots() const
+{
+	return maxSlots;
+}
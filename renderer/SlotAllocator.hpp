@@ -0,0 +1,43 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <deque>
+
+// Hands out indices into a table that lives on the GPU, like a descriptor table
+// Descriptors are written right away rather than through a command list, so a freed slot
+// is only handed out again once the GPU is done with the frame it was freed in
+class SlotAllocator
+{
+public:
+	static constexpr uint32_t InvalidSlot = ~0U;
+
+	// The first few slots are never handed out, they're for defaults
+	void					Init( uint32_t maxSlots, uint32_t numReserved );
+	// Returns InvalidSlot if the table is full
+	uint32_t				Allocate();
+	void					Free( uint32_t slot, uint64_t frameIndex );
+	// Makes slots freed in or before completedFrame available again
+	void					Reclaim( uint64_t completedFrame );
+	void					Clear();
+
+	// One past the highest slot ever handed out, the part of the table that's actually used
+	uint32_t				GetNumSlots() const;
+	uint32_t				GetNumUsed() const;
+	uint32_t				GetMaxSlots() const;
+
+private:
+	struct PendingFree
+	{
+		uint64_t frameIndex{ 0U };
+		uint32_t slot{ InvalidSlot };
+	};
+
+	uint32_t				maxSlots{ 0U };
+	uint32_t				numSlots{ 0U };
+	uint32_t				numUsed{ 0U };
+	Vector<uint32_t>		freeSlots{};
+	// In the order of frames
+	std::deque<PendingFree>	pendingFrees{};
+};
@@ -1,15 +1,94 @@
-// SPDX-FileCopyrightText: 2022 Admer Šuko
-// SPDX-License-Identifier: MIT
-
-#include "Precompiled.hpp"
-#include "Texture.hpp"
-
-TextureDesc& Texture::GetDesc()
-{
-	return desc;
-}
-
-const TextureDesc& Texture::GetDesc() const
-{
-	return desc;
-}
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "Texture.hpp"
+
+Texture::Texture( const TextureDesc& desc, const TextureSource& source, uint32_t streamingId )
+	: desc( desc ), source( source ), streamingId( streamingId )
+{
+	persistentMip = source.numMips - 1U;
+	while ( persistentMip > 0U
+		&& std::max( source.width >> (persistentMip - 1U), source.height >> (persistentMip - 1U) ) <= PersistentMipSize )
+	{
+		persistentMip--;
+	}
+
+	firstResidentMip = source.numMips;
+	wantedMip = persistentMip;
+}
+
+TextureDesc& Texture::GetDesc()
+{
+	return desc;
+}
+
+const TextureDesc& Texture::GetDesc() const
+{
+	return desc;
+}
+
+const TextureSource& Texture::GetSource() const
+{
+	return source;
+}
+
+uint32_t Texture::GetStreamingId() const
+{
+	return streamingId;
+}
+
+nvrhi::ITexture* Texture::GetHandle() const
+{
+	return handle;
+}
+
+void Texture::SetResidentMips( nvrhi::TextureHandle newHandle, uint32_t newFirstMip )
+{
+	handle = newHandle;
+	firstResidentMip = newFirstMip;
+
+	residentBytes = 0U;
+	for ( uint32_t mip = firstResidentMip; mip < source.numMips; mip++ )
+	{
+		residentBytes += GetMipByteSize( source.format, source.width, source.height, mip );
+	}
+}
+
+uint32_t Texture::GetFirstResidentMip() const
+{
+	return firstResidentMip;
+}
+
+uint32_t Texture::GetPersistentMip() const
+{
+	return persistentMip;
+}
+
+size_t Texture::GetResidentBytes() const
+{
+	return residentBytes;
+}
+
+void Texture::ReportUsage( uint32_t mip, uint64_t frame )
+{
+	mip = std::min( mip, persistentMip );
+	if ( frame != lastUsedFrame )
+	{
+		wantedMip = mip;
+		lastUsedFrame = frame;
+		return;
+	}
+
+	wantedMip = std::min( wantedMip, mip );
+}
+
+uint32_t Texture::GetWantedMip() const
+{
+	return wantedMip;
+}
+
+uint64_t Texture::GetLastUsedFrame() const
+{
+	return lastUsedFrame;
+}
@@ -1,13 +1,82 @@
-// SPDX-FileCopyrightText: 2022 Admer Šuko
-// SPDX-License-Identifier: MIT
-
-#pragma once
-
-class Texture final : public ITexture
-{
-public:
-	TextureDesc& GetDesc() override;
-	const TextureDesc& GetDesc() const override;
-private:
-	TextureDesc desc;
-};
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "MemoryTracker.hpp"
+
+// Loads the data of one mip level, tightly packed. Called from the streaming thread
+using TextureMipLoader = std::function<bool( uint32_t mip, Vector<uint8_t>& outData )>;
+
+// Where a texture's mips come from
+struct TextureSource
+{
+	uint32_t width{ 0U };
+	uint32_t height{ 0U };
+	uint32_t numMips{ 1U };
+	nvrhi::Format format{ nvrhi::Format::RGBA8_UNORM };
+	TextureMipLoader loadMip{};
+	// Identifies the content for the texture cache, e.g. a hash of the file's path and modification time
+	// With 0, the texture cache has to load and hash every mip to find the cache file
+	uint64_t cacheKey{ 0U };
+};
+
+// Size of a single mip level in bytes, taking block compression into account
+inline size_t GetMipByteSize( nvrhi::Format format, uint32_t width, uint32_t height, uint32_t mip )
+{
+	const nvrhi::FormatInfo& info = nvrhi::getFormatInfo( format );
+	const uint32_t mipWidth = std::max( width >> mip, 1U );
+	const uint32_t mipHeight = std::max( height >> mip, 1U );
+	const uint32_t blocksX = (mipWidth + info.blockSize - 1U) / info.blockSize;
+	const uint32_t blocksY = (mipHeight + info.blockSize - 1U) / info.blockSize;
+	return size_t( blocksX ) * blocksY * info.bytesPerBlock;
+}
+
+// Streamed texture. Only mips from firstResidentMip onwards are on the GPU,
+// the GPU texture gets recreated whenever that changes
+class Texture final : public ITexture
+{
+public:
+	// Mips at or below this size are always resident
+	static constexpr uint32_t PersistentMipSize = 64U;
+
+	Texture( const TextureDesc& desc, const TextureSource& source, uint32_t streamingId );
+
+	TextureDesc& GetDesc() override;
+	const TextureDesc& GetDesc() const override;
+
+	const TextureSource& GetSource() const;
+	uint32_t GetStreamingId() const;
+
+	nvrhi::ITexture* GetHandle() const;
+	void SetResidentMips( nvrhi::TextureHandle newHandle, uint32_t newFirstMip );
+	uint32_t GetFirstResidentMip() const;
+	// Streaming never evicts past this mip
+	uint32_t GetPersistentMip() const;
+	size_t GetResidentBytes() const;
+
+	// Feedback from rendering, takes the most detailed mip requested within a frame
+	void ReportUsage( uint32_t mip, uint64_t frame );
+	uint32_t GetWantedMip() const;
+	uint64_t GetLastUsedFrame() const;
+
+	bool loadPending{ false };
+	// Counted in the frontend's pending texture memory until the load finishes
+	size_t loadPendingBytes{ 0U };
+	MemoryTracker::OwnerId memoryOwner{ MemoryTracker::InvalidOwner };
+	// Index in the bindless texture table, the white texture's slot if it has none
+	uint32_t tableSlot{ 0U };
+
+private:
+	TextureDesc desc;
+	TextureSource source{};
+	uint32_t streamingId{ 0U };
+
+	nvrhi::TextureHandle handle{};
+	uint32_t firstResidentMip{ 0U };
+	uint32_t persistentMip{ 0U };
+	size_t residentBytes{ 0U };
+
+	uint32_t wantedMip{ 0U };
+	uint64_t lastUsedFrame{ 0U };
+};
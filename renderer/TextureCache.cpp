@@ -0,0 +1,221 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "TextureCache.hpp"
+
+// 8 bytes at a time
+uint64_t HashData( const uint8_t* data, size_t size, uint64_t hash )
+{
+	constexpr uint64_t Prime = 0x100000001b3ULL;
+
+	size_t i = 0U;
+	for ( ; i + 8U <= size; i += 8U )
+	{
+		uint64_t word;
+		std::memcpy( &word, data + i, 8U );
+		hash = (hash ^ word) * Prime;
+		hash ^= hash >> 29U;
+	}
+
+	for ( ; i < size; i++ )
+	{
+		hash = (hash ^ data[i]) * Prime;
+	}
+
+	return hash;
+}
+
+void TextureCache::SetDirectory( const Path& newDirectory )
+{
+	directory = newDirectory;
+}
+
+const Path& TextureCache::GetDirectory() const
+{
+	return directory;
+}
+
+bool TextureCache::GetOrCreate( const TextureSource& source, BlockCompression::Format blockFormat, TextureSource& outSource )
+{
+	using namespace BlockCompression;
+
+	if ( source.format != nvrhi::Format::RGBA8_UNORM )
+	{
+		Console->Warning( "TextureCache: only RGBA8 textures can be compressed" );
+		return false;
+	}
+
+	// GPUs need the top mip to be made of whole blocks. Smaller mips can end in partial blocks,
+	// which the encoder fills with clamped pixels
+	if ( (source.width % BlockSize) || (source.height % BlockSize) )
+	{
+		Console->Warning( format( "TextureCache: %ux%u texture is not a multiple of the block size", source.width, source.height ) );
+		return false;
+	}
+
+	// Without a key from the caller, the source has to be loaded to be hashed,
+	// so keep it around in case it needs compressing
+	Vector<Vector<uint8_t>> sourceMips;
+	uint64_t hash = HashSeed;
+	if ( 0U != source.cacheKey )
+	{
+		hash = HashData( reinterpret_cast<const uint8_t*>( &source.cacheKey ), sizeof( source.cacheKey ) );
+	}
+	else
+	{
+		if ( !LoadSourceMips( source, sourceMips ) )
+		{
+			return false;
+		}
+
+		for ( uint32_t mip = 0U; mip < source.numMips; mip++ )
+		{
+			hash = HashData( sourceMips[mip].data(), GetMipByteSize( source.format, source.width, source.height, mip ), hash );
+		}
+	}
+
+	Header header;
+	header.contentHash = hash;
+	header.format = uint32_t( blockFormat );
+	header.width = source.width;
+	header.height = source.height;
+	header.numMips = source.numMips;
+
+	// e.g. cache/textures/0123456789abcdef_BC7.btxt
+	char fileName[64];
+	std::snprintf( fileName, sizeof( fileName ), "%016llx_%s.btxt", static_cast<unsigned long long>( hash ), ToString( blockFormat ) );
+	const Path path = directory / fileName;
+
+	Vector<uint64_t> mipOffsets;
+	if ( ReadHeader( path, header, mipOffsets ) )
+	{
+		outSource = MakeCachedSource( path, header, mipOffsets );
+		return true;
+	}
+
+	if ( sourceMips.empty() && !LoadSourceMips( source, sourceMips ) )
+	{
+		return false;
+	}
+
+	Vector<Vector<uint8_t>> compressedMips( source.numMips );
+	for ( uint32_t mip = 0U; mip < source.numMips; mip++ )
+	{
+		const uint32_t mipWidth = std::max( source.width >> mip, 1U );
+		const uint32_t mipHeight = std::max( source.height >> mip, 1U );
+		EncodeImage( blockFormat, sourceMips[mip].data(), mipWidth, mipHeight, compressedMips[mip] );
+	}
+
+	if ( !Write( path, header, compressedMips ) || !ReadHeader( path, header, mipOffsets ) )
+	{
+		Console->Warning( format( "TextureCache: failed to write '%s'", path.string().c_str() ) );
+		return false;
+	}
+
+	Console->DPrint( format( "TextureCache: compressed %ux%u texture to %s", source.width, source.height, ToString( blockFormat ) ), 1 );
+	outSource = MakeCachedSource( path, header, mipOffsets );
+	return true;
+}
+
+bool TextureCache::LoadSourceMips( const TextureSource& source, Vector<Vector<uint8_t>>& outMips ) const
+{
+	outMips.resize( source.numMips );
+	for ( uint32_t mip = 0U; mip < source.numMips; mip++ )
+	{
+		const size_t expectedSize = GetMipByteSize( source.format, source.width, source.height, mip );
+		if ( !source.loadMip( mip, outMips[mip] ) || outMips[mip].size() < expectedSize )
+		{
+			Console->Warning( format( "TextureCache: failed to load mip %u", mip ) );
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool TextureCache::ReadHeader( const Path& path, const Header& expected, Vector<uint64_t>& outMipOffsets ) const
+{
+	std::ifstream file( path, std::ios::binary );
+	if ( !file )
+	{
+		return false;
+	}
+
+	Header header;
+	file.read( reinterpret_cast<char*>( &header ), sizeof( header ) );
+	if ( !file || std::memcmp( &header, &expected, sizeof( Header ) ) )
+	{
+		return false;
+	}
+
+	outMipOffsets.resize( header.numMips );
+	file.read( reinterpret_cast<char*>( outMipOffsets.data() ), header.numMips * sizeof( uint64_t ) );
+	return bool( file );
+}
+
+bool TextureCache::Write( const Path& path, const Header& header, const Vector<Vector<uint8_t>>& mips ) const
+{
+	std::error_code error;
+	std::filesystem::create_directories( path.parent_path(), error );
+
+	// Write to a temporary file first, so a crash never leaves a half-written cache entry behind
+	Path temporaryPath = path;
+	temporaryPath += ".tmp";
+	{
+		std::ofstream file( temporaryPath, std::ios::binary | std::ios::trunc );
+		if ( !file )
+		{
+			return false;
+		}
+
+		file.write( reinterpret_cast<const char*>( &header ), sizeof( header ) );
+
+		uint64_t offset = sizeof( header ) + mips.size() * sizeof( uint64_t );
+		for ( const auto& mip : mips )
+		{
+			file.write( reinterpret_cast<const char*>( &offset ), sizeof( offset ) );
+			offset += mip.size();
+		}
+
+		for ( const auto& mip : mips )
+		{
+			file.write( reinterpret_cast<const char*>( mip.data() ), mip.size() );
+		}
+
+		if ( !file )
+		{
+			return false;
+		}
+	}
+
+	std::filesystem::rename( temporaryPath, path, error );
+	return !error;
+}
+
+TextureSource TextureCache::MakeCachedSource( const Path& path, const Header& header, const Vector<uint64_t>& mipOffsets ) const
+{
+	const auto blockFormat = BlockCompression::Format( header.format );
+
+	TextureSource result;
+	result.width = header.width;
+	result.height = header.height;
+	result.numMips = header.numMips;
+	result.format = BlockCompression::ToNvrhiFormat( blockFormat );
+	// Each call opens its own stream, so this is safe to call from the streaming thread
+	result.loadMip = [path, mipOffsets, blockFormat, width = header.width, height = header.height]( uint32_t mip, Vector<uint8_t>& outData )
+	{
+		std::ifstream file( path, std::ios::binary );
+		if ( !file || mip >= mipOffsets.size() )
+		{
+			return false;
+		}
+
+		outData.resize( BlockCompression::GetEncodedSize( blockFormat, std::max( width >> mip, 1U ), std::max( height >> mip, 1U ) ) );
+		file.seekg( std::streamoff( mipOffsets[mip] ) );
+		file.read( reinterpret_cast<char*>( outData.data() ), outData.size() );
+		return bool( file );
+	};
+
+	return result;
+}
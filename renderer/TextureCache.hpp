@@ -0,0 +1,47 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "BlockCompression.hpp"
+#include "Texture.hpp"
+
+// 64-bit content hash that cache files are keyed by, see ModelCache too
+constexpr uint64_t HashSeed = 0xcbf29ce484222325ULL;
+uint64_t HashData( const uint8_t* data, size_t size, uint64_t hash = HashSeed );
+
+// On-disk cache of block-compressed textures, keyed by TextureSource::cacheKey or a hash of the source pixels
+// The first time a texture is seen, all of its mips are compressed and written out,
+// and from then on its mips are read straight from the cache file
+class TextureCache
+{
+public:
+	// Bump this whenever the encoder output changes, so stale cache files get ignored
+	static constexpr uint32_t EncoderVersion = 1U;
+
+	void					SetDirectory( const Path& newDirectory );
+	const Path&				GetDirectory() const;
+
+	// Turns an RGBA8 source into a compressed one. Returns false if the source can't be compressed
+	bool					GetOrCreate( const TextureSource& source, BlockCompression::Format blockFormat, TextureSource& outSource );
+
+private:
+	struct Header
+	{
+		char magic[4]{ 'B', 'T', 'X', 'T' };
+		uint32_t version{ EncoderVersion };
+		uint64_t contentHash{ 0U };
+		uint32_t format{ 0U };
+		uint32_t width{ 0U };
+		uint32_t height{ 0U };
+		uint32_t numMips{ 0U };
+	};
+
+	bool					LoadSourceMips( const TextureSource& source, Vector<Vector<uint8_t>>& outMips ) const;
+	bool					ReadHeader( const Path& path, const Header& expected, Vector<uint64_t>& outMipOffsets ) const;
+	bool					Write( const Path& path, const Header& header, const Vector<Vector<uint8_t>>& mips ) const;
+	TextureSource			MakeCachedSource( const Path& path, const Header& header, const Vector<uint64_t>& mipOffsets ) const;
+
+private:
+	Path					directory{ "cache/textures" };
+};
@@ -0,0 +1,98 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "TextureStreamer.hpp"
+#include "Profiler.hpp"
+
+TextureStreamer::~TextureStreamer()
+{
+	Stop();
+}
+
+void TextureStreamer::Start()
+{
+	if ( worker.joinable() )
+	{
+		return;
+	}
+
+	quit = false;
+	worker = std::thread( &TextureStreamer::WorkerLoop, this );
+}
+
+void TextureStreamer::Stop()
+{
+	if ( !worker.joinable() )
+	{
+		return;
+	}
+
+	{
+		std::lock_guard lock( mutex );
+		quit = true;
+		requests.clear();
+	}
+
+	wakeUp.notify_all();
+	worker.join();
+	results.clear();
+}
+
+void TextureStreamer::Request( uint32_t textureId, uint32_t mip, const TextureMipLoader& loadMip )
+{
+	{
+		std::lock_guard lock( mutex );
+		requests.push_back( { textureId, mip, loadMip } );
+	}
+
+	wakeUp.notify_one();
+}
+
+void TextureStreamer::CollectResults( Vector<MipLoadResult>& outResults )
+{
+	std::lock_guard lock( mutex );
+	for ( auto& result : results )
+	{
+		outResults.push_back( std::move( result ) );
+	}
+
+	results.clear();
+}
+
+void TextureStreamer::WorkerLoop()
+{
+	PROFILE_THREAD( "Texture streamer" );
+
+	while ( true )
+	{
+		MipLoadRequest request;
+		{
+			std::unique_lock lock( mutex );
+			wakeUp.wait( lock, [this]()
+				{
+					return quit || !requests.empty();
+				} );
+
+			if ( quit )
+			{
+				return;
+			}
+
+			request = std::move( requests.front() );
+			requests.pop_front();
+		}
+
+		// The actual loading happens outside of the lock
+		MipLoadResult result;
+		result.textureId = request.textureId;
+		result.mip = request.mip;
+		{
+			PROFILE_SCOPE( "LoadMip" );
+			result.success = request.loadMip( request.mip, result.data );
+		}
+
+		std::lock_guard lock( mutex );
+		results.push_back( std::move( result ) );
+	}
+}
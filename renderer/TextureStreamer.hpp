@@ -0,0 +1,52 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "Texture.hpp"
+
+struct MipLoadRequest
+{
+	uint32_t textureId{ 0U };
+	uint32_t mip{ 0U };
+	TextureMipLoader loadMip{};
+};
+
+struct MipLoadResult
+{
+	uint32_t textureId{ 0U };
+	uint32_t mip{ 0U };
+	bool success{ false };
+	Vector<uint8_t> data{};
+};
+
+// Loads texture mips on a background thread
+// GPU uploads are not done here, the frontend collects the results at the start of a frame
+class TextureStreamer
+{
+public:
+	~TextureStreamer();
+
+	void					Start();
+	void					Stop();
+
+	void					Request( uint32_t textureId, uint32_t mip, const TextureMipLoader& loadMip );
+	// Moves all finished loads into outResults
+	void					CollectResults( Vector<MipLoadResult>& outResults );
+
+private:
+	void					WorkerLoop();
+
+private:
+	std::thread				worker{};
+	std::mutex				mutex{};
+	std::condition_variable	wakeUp{};
+	std::deque<MipLoadRequest> requests{};
+	Vector<MipLoadResult>	results{};
+	bool					quit{ false };
+};
@@ -1,44 +1,117 @@
-// SPDX-FileCopyrightText: 2022 Admer Šuko
-// SPDX-License-Identifier: MIT
-
-#include "Precompiled.hpp"
-#include "View.hpp"
-
-View::View( const ViewDesc& desc,
-	nvrhi::TextureHandle colour, nvrhi::TextureHandle depth,
-	nvrhi::FramebufferHandle framebuffer, nvrhi::BindingSetHandle bindingSet )
-	: desc( desc ),
-	colourTexture( colour ), depthTexture( depth ),
-	framebuffer( framebuffer ), bindingSet( bindingSet )
-{
-}
-
-nvrhi::IFramebuffer* View::GetFramebuffer() const
-{
-	return framebuffer;
-}
-
-nvrhi::ITexture* View::GetColourTexture() const
-{
-	return colourTexture;
-}
-
-nvrhi::ITexture* View::GetDepthTexture() const
-{
-	return depthTexture;
-}
-
-nvrhi::IBindingSet* View::GetBindingSet() const
-{
-	return bindingSet;
-}
-
-ViewDesc& View::GetDesc()
-{
-	return desc;
-}
-
-const ViewDesc& View::GetDesc() const
-{
-	return desc;
-}
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "View.hpp"
+
+const char* ViewUpdatePolicyToString( ViewUpdatePolicy policy )
+{
+	switch ( policy )
+	{
+	case ViewUpdatePolicy::EveryFrame: return "EveryFrame";
+	case ViewUpdatePolicy::Interval: return "Interval";
+	case ViewUpdatePolicy::OnDemand: return "OnDemand";
+	case ViewUpdatePolicy::OnChange: return "OnChange";
+	}
+
+	return "UNKNOWN";
+}
+
+View::View( const ViewDesc& desc,
+	nvrhi::TextureHandle colour, nvrhi::TextureHandle depth,
+	nvrhi::FramebufferHandle framebuffer, nvrhi::BindingSetHandle bindingSet )
+	: desc( desc ),
+	colourTexture( colour ), depthTexture( depth ),
+	framebuffer( framebuffer ), bindingSet( bindingSet )
+{
+}
+
+nvrhi::IFramebuffer* View::GetFramebuffer() const
+{
+	return framebuffer;
+}
+
+nvrhi::ITexture* View::GetColourTexture() const
+{
+	return colourTexture;
+}
+
+nvrhi::ITexture* View::GetDepthTexture() const
+{
+	return depthTexture;
+}
+
+nvrhi::IBindingSet* View::GetBindingSet() const
+{
+	return bindingSet;
+}
+
+void View::SetTransform( const Vec3& origin, const Mat4& viewMatrix, const Mat4& projectionMatrix )
+{
+	this->origin = origin;
+	this->viewMatrix = viewMatrix;
+	this->projectionMatrix = projectionMatrix;
+	transformChanged = true;
+}
+
+bool View::IsTransformChanged() const
+{
+	return transformChanged;
+}
+
+void View::ClearTransformChanged()
+{
+	transformChanged = false;
+}
+
+const Vec3& View::GetOrigin() const
+{
+	return origin;
+}
+
+const Mat4& View::GetViewMatrix() const
+{
+	return viewMatrix;
+}
+
+const Mat4& View::GetProjectionMatrix() const
+{
+	return projectionMatrix;
+}
+
+Frustum View::GetFrustum() const
+{
+	Frustum frustum;
+	frustum.viewProjection = projectionMatrix * viewMatrix;
+	return frustum;
+}
+
+Vec2 View::GetAttachmentSize() const
+{
+	const nvrhi::TextureDesc& textureDesc = colourTexture->getDesc();
+	return Vec2( float( textureDesc.width ), float( textureDesc.height ) );
+}
+
+Vec2 View::GetRenderSize() const
+{
+	const Vec2 attachmentSize = GetAttachmentSize();
+	return Vec2(
+		std::max( std::floor( attachmentSize.x * resolutionScale ), 1.0f ),
+		std::max( std::floor( attachmentSize.y * resolutionScale ), 1.0f ) );
+}
+
+ViewDesc& View::GetDesc()
+{
+	descSerial++;
+	return desc;
+}
+
+const ViewDesc& View::GetDesc() const
+{
+	return desc;
+}
+
+uint64_t View::GetDescSerial() const
+{
+	return descSerial;
+}
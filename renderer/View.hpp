@@ -1,29 +1,88 @@
-// SPDX-FileCopyrightText: 2022 Admer Šuko
-// SPDX-License-Identifier: MIT
-
-#pragma once
-
-class View final : public IView
-{
-public:
-	View( const ViewDesc& desc,
-		nvrhi::TextureHandle colour,
-		nvrhi::TextureHandle depth,
-		nvrhi::FramebufferHandle framebuffer,
-		nvrhi::BindingSetHandle bindingSet );
-
-	nvrhi::IFramebuffer* GetFramebuffer() const override;
-	nvrhi::ITexture* GetColourTexture() const override;
-	nvrhi::ITexture* GetDepthTexture() const override;
-	nvrhi::IBindingSet* GetBindingSet() const override;
-
-	ViewDesc& GetDesc() override;
-	const ViewDesc& GetDesc() const override;
-private:
-	ViewDesc desc{};
-
-	nvrhi::TextureHandle colourTexture{};
-	nvrhi::TextureHandle depthTexture{};
-	nvrhi::FramebufferHandle framebuffer{};
-	nvrhi::BindingSetHandle bindingSet{};
-};
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "Bounds.hpp"
+#include "MemoryTracker.hpp"
+
+// When RenderView(s) actually redraws a view. Otherwise, the view keeps the image it has,
+// which is handy for mirrors, monitors and other render-to-texture views that rarely change
+enum class ViewUpdatePolicy : uint8_t
+{
+	EveryFrame,
+	// Every N frames, see View::updateInterval
+	Interval,
+	// Only after the view was explicitly asked to update
+	OnDemand,
+	// Only when the camera, or anything the camera can see, has changed
+	OnChange
+};
+
+const char* ViewUpdatePolicyToString( ViewUpdatePolicy policy );
+
+class View final : public IView
+{
+public:
+	View( const ViewDesc& desc,
+		nvrhi::TextureHandle colour,
+		nvrhi::TextureHandle depth,
+		nvrhi::FramebufferHandle framebuffer,
+		nvrhi::BindingSetHandle bindingSet );
+
+	nvrhi::IFramebuffer* GetFramebuffer() const override;
+	nvrhi::ITexture* GetColourTexture() const override;
+	nvrhi::ITexture* GetDepthTexture() const override;
+	nvrhi::IBindingSet* GetBindingSet() const override;
+
+	void SetTransform( const Vec3& origin, const Mat4& viewMatrix, const Mat4& projectionMatrix );
+	const Vec3& GetOrigin() const;
+	const Mat4& GetViewMatrix() const;
+	const Mat4& GetProjectionMatrix() const;
+	// Full-screen frustum built from the view & projection matrices
+	Frustum GetFrustum() const;
+
+	// Attachments are as big as the viewport in the desc, but only a part
+	// of them is rendered into, depending on the resolution scale
+	Vec2 GetAttachmentSize() const;
+	Vec2 GetRenderSize() const;
+
+	MemoryTracker::OwnerId memoryOwner{ MemoryTracker::InvalidOwner };
+	// Fraction of the attachment size that is rendered at, along both axes
+	float resolutionScale{ 1.0f };
+	// If set, the resolution governor picks the scale every frame
+	bool dynamicResolution{ false };
+
+	ViewUpdatePolicy updatePolicy{ ViewUpdatePolicy::EveryFrame };
+	uint32_t updateInterval{ 1U };
+	bool updateRequested{ false };
+	// Whether the attachments hold an image at all
+	bool hasImage{ false };
+	// What the view looked like when it was last rendered, to tell if it's out of date
+	uint64_t renderedFrame{ 0U };
+	uint64_t renderedChangeSerial{ 0U };
+	uint64_t renderedVisibleHash{ 0U };
+	float renderedScale{ 1.0f };
+
+	// Set by SetTransform, cleared once the view is rendered
+	bool IsTransformChanged() const;
+	void ClearTransformChanged();
+
+	// The desc can be edited through the non-const overload, so every call counts as an edit
+	ViewDesc& GetDesc() override;
+	const ViewDesc& GetDesc() const override;
+	uint64_t GetDescSerial() const;
+private:
+	ViewDesc desc{};
+	uint64_t descSerial{ 0U };
+
+	nvrhi::TextureHandle colourTexture{};
+	nvrhi::TextureHandle depthTexture{};
+	nvrhi::FramebufferHandle framebuffer{};
+	nvrhi::BindingSetHandle bindingSet{};
+
+	Vec3 origin{ 0.0f, 0.0f, 0.0f };
+	Mat4 viewMatrix{};
+	Mat4 projectionMatrix{};
+	bool transformChanged{ true };
+};
@@ -1,15 +1,144 @@
-// SPDX-FileCopyrightText: 2022 Admer Šuko
-// SPDX-License-Identifier: MIT
-
-#include "Precompiled.hpp"
-#include "Volume.hpp"
-
-VolumeDesc& Volume::GetDesc()
-{
-	return desc;
-}
-
-const VolumeDesc& Volume::GetDesc() const
-{
-	return desc;
-}
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "Volume.hpp"
+
+Volume::Volume( const VolumeDesc& desc )
+	: desc( desc )
+{
+}
+
+VolumeDesc& Volume::GetDesc()
+{
+	return desc;
+}
+
+const VolumeDesc& Volume::GetDesc() const
+{
+	return desc;
+}
+
+void Volume::SetBounds( const Bounds& newBounds )
+{
+	bounds = newBounds;
+}
+
+const Bounds& Volume::GetBounds() const
+{
+	return bounds;
+}
+
+void Volume::AddPortal( Volume* target, const Vector<Vec3>& points )
+{
+	portals.push_back( { target, points } );
+}
+
+bool Volume::HasPortal( const Volume* target, const Vector<Vec3>& points ) const
+{
+	for ( const Portal& portal : portals )
+	{
+		if ( portal.target != target || portal.points.size() != points.size() )
+		{
+			continue;
+		}
+
+		const bool samePoints = std::equal( points.begin(), points.end(), portal.points.begin(), []( const Vec3& a, const Vec3& b )
+			{
+				return a.x == b.x && a.y == b.y && a.z == b.z;
+			} );
+
+		if ( samePoints )
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void Volume::RemovePortalsTo( const Volume* target )
+{
+	portals.erase( std::remove_if( portals.begin(), portals.end(), [target]( const Portal& portal )
+		{
+			return portal.target == target;
+		} ), portals.end() );
+}
+
+const Vector<Portal>& Volume::GetPortals() const
+{
+	return portals;
+}
+
+void Volume::SetPVS( const Vector<uint64_t>& bits )
+{
+	pvs = bits;
+}
+
+bool Volume::HasPVS() const
+{
+	return !pvs.empty();
+}
+
+bool Volume::IsInPVS( uint32_t volumeIndex ) const
+{
+	if ( pvs.empty() )
+	{
+		return true;
+	}
+
+	const size_t word = volumeIndex / 64U;
+	if ( word >= pvs.size() )
+	{
+		return false;
+	}
+
+	return (pvs[word] >> (volumeIndex % 64U)) & 1U;
+}
+
+void Volume::RemoveFromPVS( uint32_t volumeIndex )
+{
+	const size_t firstWord = volumeIndex / 64U;
+	if ( firstWord >= pvs.size() )
+	{
+		return;
+	}
+
+	// Bits below the removed one stay where they are, the rest move down by one
+	const uint64_t bit = volumeIndex % 64U;
+	const uint64_t keepMask = (uint64_t( 1U ) << bit) - 1U;
+	const uint64_t word = pvs[firstWord];
+	pvs[firstWord] = (word & keepMask) | ((word >> 1U) & ~keepMask);
+
+	for ( size_t i = firstWord + 1U; i < pvs.size(); i++ )
+	{
+		pvs[i - 1U] |= (pvs[i] & 1U) << 63U;
+		pvs[i] >>= 1U;
+	}
+}
+
+void Volume::AddEntity( Entity* entity )
+{
+	entities.push_back( entity );
+}
+
+void Volume::RemoveEntity( Entity* entity )
+{
+	auto it = std::find( entities.begin(), entities.end(), entity );
+	if ( it != entities.end() )
+	{
+		// Order doesn't matter, so swap with the last one
+		*it = entities.back();
+		entities.pop_back();
+	}
+}
+
+void Volume::ClearEntities()
+{
+	entities.clear();
+}
+
+const Vector<Entity*>& Volume::GetEntities() const
+{
+	return entities;
+}
@@ -1,13 +1,60 @@
-// SPDX-FileCopyrightText: 2022 Admer Šuko
-// SPDX-License-Identifier: MIT
-
-#pragma once
-
-class Volume final : public IVolume
-{
-public:
-	VolumeDesc& GetDesc() override;
-	const VolumeDesc& GetDesc() const override;
-private:
-	VolumeDesc desc;
-};
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include "Bounds.hpp"
+
+class Entity;
+class Volume;
+
+// One-way opening from one volume into another
+// Portals are always created in pairs, one on each side
+struct Portal
+{
+	Volume* target{ nullptr };
+	// Convex polygon, in world space
+	Vector<Vec3> points{};
+};
+
+// Volumes act as visibility cells: entities get assigned to the cells they
+// overlap, and cells are connected by portals. Optionally, a cell can have a
+// precomputed potentially visible set, one bit per volume index
+class Volume final : public IVolume
+{
+public:
+	Volume( const VolumeDesc& desc );
+
+	VolumeDesc& GetDesc() override;
+	const VolumeDesc& GetDesc() const override;
+
+	void SetBounds( const Bounds& newBounds );
+	const Bounds& GetBounds() const;
+
+	void AddPortal( Volume* target, const Vector<Vec3>& points );
+	bool HasPortal( const Volume* target, const Vector<Vec3>& points ) const;
+	void RemovePortalsTo( const Volume* target );
+	const Vector<Portal>& GetPortals() const;
+
+	void SetPVS( const Vector<uint64_t>& bits );
+	bool HasPVS() const;
+	// If there's no PVS, everything is potentially visible
+	bool IsInPVS( uint32_t volumeIndex ) const;
+	// Drops the bit of a destroyed volume, the bits above it shift down like the volume indices do
+	void RemoveFromPVS( uint32_t volumeIndex );
+
+	void AddEntity( Entity* entity );
+	void RemoveEntity( Entity* entity );
+	void ClearEntities();
+	const Vector<Entity*>& GetEntities() const;
+
+	// Position in RenderFrontend::volumes, which the PVS bits refer to
+	uint32_t index{ 0U };
+
+private:
+	VolumeDesc desc;
+	Bounds bounds{};
+	Vector<Portal> portals{};
+	Vector<uint64_t> pvs{};
+	Vector<Entity*> entities{};
+};
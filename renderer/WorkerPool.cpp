@@ -0,0 +1,127 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "WorkerPool.hpp"
+#include "Profiler.hpp"
+
+WorkerPool::~WorkerPool()
+{
+	Stop();
+}
+
+void WorkerPool::Start()
+{
+	if ( !workers.empty() )
+	{
+		return;
+	}
+
+	quit = false;
+	const uint32_t numThreads = std::max( std::thread::hardware_concurrency(), 1U ) - 1U;
+	for ( uint32_t i = 0U; i < numThreads; i++ )
+	{
+		workers.emplace_back( &WorkerPool::WorkerLoop, this );
+	}
+}
+
+void WorkerPool::Stop()
+{
+	if ( workers.empty() )
+	{
+		return;
+	}
+
+	{
+		std::lock_guard lock( mutex );
+		quit = true;
+	}
+
+	wakeUp.notify_all();
+	for ( auto& worker : workers )
+	{
+		worker.join();
+	}
+
+	workers.clear();
+}
+
+Vector<WorkerPool::Failure> WorkerPool::Run( size_t count, const std::function<void( size_t )>& job )
+{
+	{
+		std::lock_guard lock( mutex );
+		this->job = &job;
+		this->count = count;
+		nextIndex = 0U;
+		failures.clear();
+		numBusy = workers.size();
+		loop++;
+	}
+
+	wakeUp.notify_all();
+	Work();
+
+	std::unique_lock lock( mutex );
+	finished.wait( lock, [this]()
+		{
+			return 0U == numBusy;
+		} );
+
+	this->job = nullptr;
+	return std::move( failures );
+}
+
+void WorkerPool::WorkerLoop()
+{
+	PROFILE_THREAD( "Worker" );
+
+	uint64_t lastLoop = 0U;
+	while ( true )
+	{
+		{
+			std::unique_lock lock( mutex );
+			wakeUp.wait( lock, [this, lastLoop]()
+				{
+					return quit || loop != lastLoop;
+				} );
+
+			if ( quit )
+			{
+				return;
+			}
+
+			lastLoop = loop;
+		}
+
+		Work();
+
+		{
+			std::lock_guard lock( mutex );
+			numBusy--;
+		}
+
+		finished.notify_one();
+	}
+}
+
+void WorkerPool::Work()
+{
+	for ( size_t i = nextIndex++; i < count; i = nextIndex++ )
+	{
+		// An exception escaping a thread would terminate the process
+		try
+		{
+			(*job)( i );
+		}
+		catch ( const std::exception& exception )
+		{
+			std::lock_guard lock( mutex );
+			failures.push_back( { i, exception.what() } );
+		}
+		catch ( ... )
+		{
+			std::lock_guard lock( mutex );
+			failures.push_back( { i, "unknown exception" } );
+		}
+	}
+}
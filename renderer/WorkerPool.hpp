@@ -0,0 +1,55 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Threads that are started once and then shared by parallel loops, e.g. model loading
+// Run is only meant to be called from one thread at a time
+class WorkerPool
+{
+public:
+	// A job that threw, its exception doesn't leave the pool
+	struct Failure
+	{
+		size_t index{ 0U };
+		String message{};
+	};
+
+	~WorkerPool();
+
+	// The calling thread of Run works too, so this starts one thread less than there are cores
+	void					Start();
+	void					Stop();
+
+	// Calls job( i ) for every i below count and returns once all of them are done
+	// Threads take the next index whenever they're done, since some jobs are much bigger than others
+	// Without worker threads, everything runs on the calling thread
+	Vector<Failure>			Run( size_t count, const std::function<void( size_t )>& job );
+
+private:
+	void					WorkerLoop();
+	// Takes indices of the current loop until there are none left
+	void					Work();
+
+private:
+	Vector<std::thread>		workers{};
+	std::mutex				mutex{};
+	std::condition_variable	wakeUp{};
+	std::condition_variable	finished{};
+	// The current loop, set by Run
+	const std::function<void( size_t )>* job{ nullptr };
+	size_t					count{ 0U };
+	std::atomic<size_t>		nextIndex{ 0U };
+	// Bumped by Run, so every worker joins each loop exactly once
+	uint64_t				loop{ 0U };
+	// Workers that haven't finished the current loop yet
+	size_t					numBusy{ 0U };
+	Vector<Failure>			failures{};
+	bool					quit{ false };
+};
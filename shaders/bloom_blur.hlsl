@@ -0,0 +1,61 @@
+// Separable gaussian blur of the bloom targets, see RenderFrontend::RenderBloom
+// Ping-pongs between the two targets, one direction per pass
+// Drawn with the vertex shader from screen.hlsl, with a uvScale of 1
+
+#ifdef SPIRV
+#define VK_PUSH_CONSTANT [[vk::push_constant]]
+#else
+#define VK_PUSH_CONSTANT
+#endif
+
+// See RenderFrontend::ScreenConstants
+struct ScreenConstants
+{
+	float2 uvScale;
+	float2 texelSize;
+	float4 colourFilter;
+	float contrast;
+	float saturation;
+	float sharpness;
+	float bloomIntensity;
+	float bloomThreshold;
+	uint padding;
+	float2 blurDirection;
+};
+
+#ifdef DXBC
+cbuffer ScreenConstantBuffer : register(b0)
+{
+	ScreenConstants gScreen;
+}
+#else
+VK_PUSH_CONSTANT ConstantBuffer<ScreenConstants> gScreen : register(b0);
+#endif
+
+Texture2D bloomTexture : register(t0);
+SamplerState screenSampler : register(s0);
+
+float3 SampleClamped( float2 uv )
+{
+	const float2 uvMin = gScreen.texelSize * 0.5;
+	return bloomTexture.SampleLevel( screenSampler, clamp( uv, uvMin, 1.0 - uvMin ), 0 ).rgb;
+}
+
+void main_ps(
+	in float4 inPosition : SV_POSITION,
+	in float2 inTexcoords : TEXCOORD,
+
+	out float4 outColour : SV_TARGET0
+)
+{
+	// 9 gaussian taps in 5 bilinear ones
+	const float2 step = gScreen.blurDirection * gScreen.texelSize;
+	const float2 offset1 = step * 1.3846153846;
+	const float2 offset2 = step * 3.2307692308;
+
+	float3 colour = SampleClamped( inTexcoords ) * 0.2270270270;
+	colour += (SampleClamped( inTexcoords + offset1 ) + SampleClamped( inTexcoords - offset1 )) * 0.3162162162;
+	colour += (SampleClamped( inTexcoords + offset2 ) + SampleClamped( inTexcoords - offset2 )) * 0.0702702703;
+
+	outColour = float4( colour, 1.0 );
+}
@@ -0,0 +1,74 @@
+// First bloom pass, see RenderFrontend::RenderBloom
+// Takes the bright parts of the view into a bloom target, a fraction of the screen's size
+// Drawn with the vertex shader from screen.hlsl
+
+#ifdef SPIRV
+#define VK_PUSH_CONSTANT [[vk::push_constant]]
+#else
+#define VK_PUSH_CONSTANT
+#endif
+
+// See RenderFrontend::ScreenConstants
+struct ScreenConstants
+{
+	float2 uvScale;
+	float2 texelSize;
+	float4 colourFilter;
+	float contrast;
+	float saturation;
+	float sharpness;
+	float bloomIntensity;
+	float bloomThreshold;
+	uint padding;
+	float2 blurDirection;
+};
+
+#ifdef DXBC
+cbuffer ScreenConstantBuffer : register(b0)
+{
+	ScreenConstants gScreen;
+}
+#else
+VK_PUSH_CONSTANT ConstantBuffer<ScreenConstants> gScreen : register(b0);
+#endif
+
+Texture2D screenTexture : register(t0);
+SamplerState screenSampler : register(s0);
+
+float3 Prefilter( float2 uv )
+{
+	const float2 uvMin = gScreen.texelSize * 0.5;
+	const float2 uvMax = gScreen.uvScale - gScreen.texelSize * 0.5;
+	const float3 colour = screenTexture.SampleLevel( screenSampler, clamp( uv, uvMin, uvMax ), 0 ).rgb;
+
+	// Soft knee, so things don't pop in and out of bloom
+	const float threshold = gScreen.bloomThreshold;
+	const float knee = threshold * 0.5;
+	const float brightness = max( colour.r, max( colour.g, colour.b ) );
+	float soft = clamp( brightness - threshold + knee, 0.0, 2.0 * knee );
+	soft = soft * soft / (4.0 * knee + 1e-4);
+	const float contribution = max( soft, brightness - threshold ) / max( brightness, 1e-4 );
+
+	// Weighed by inverse brightness, so single very bright pixels don't flicker
+	return colour * contribution / (1.0 + brightness);
+}
+
+void main_ps(
+	in float4 inPosition : SV_POSITION,
+	in float2 inTexcoords : TEXCOORD,
+
+	out float4 outColour : SV_TARGET0
+)
+{
+	// Four bilinear taps around the bloom texel's centre, one per quarter of the view texels it covers
+	// The screen pass's UVs step by one bloom texel per pixel, so the derivatives give its footprint
+	// whatever the downscale and resolution scale are. Past a downscale of 4 the taps skip texels
+	const float2 footprint = float2( abs( ddx( inTexcoords.x ) ), abs( ddy( inTexcoords.y ) ) );
+	const float2 offset = footprint * 0.25;
+	float3 colour = Prefilter( inTexcoords + float2( -offset.x, -offset.y ) );
+	colour += Prefilter( inTexcoords + float2( offset.x, -offset.y ) );
+	colour += Prefilter( inTexcoords + float2( -offset.x, offset.y ) );
+	colour += Prefilter( inTexcoords + float2( offset.x, offset.y ) );
+
+	outColour = float4( colour * 0.25, 1.0 );
+}
@@ -1,82 +1,145 @@
-
-// If you use row-major matrices with HLSL, you'll need this: 
-//#pragma pack_matrix(row_major)
-// ...because HLSL is column-major
-
-// These macros here are for Vulkan compatibility
-// Registers (b0, t0, c0 etc.) don't quite exist in Vulkan and OpenGL, so the folks who
-// were solving this figured "Oh, let's just define offsets, buffers start at 0, samplers start at 128" etc.
-// And this is basically the adapter for that
-#ifdef SPIRV
-#define VK_PUSH_CONSTANT [[vk::push_constant]]
-#define VK_BINDING(reg,dset) [[vk::binding(reg,dset)]]
-#define VK_DESCRIPTOR_SET(dset) ,space##dset
-#else
-#define VK_PUSH_CONSTANT
-#define VK_BINDING(reg,dset) 
-#define VK_DESCRIPTOR_SET(dset)
-#endif
-// ^ these should actually be moved to an include file
-
-cbuffer PerViewFrameBuffer : register(b0)
-{
-	float4x4 gViewMatrix;
-	float4x4 gProjectionMatrix;
-	float gTime;
-}
-
-cbuffer EntityBuffer : register(b1 VK_DESCRIPTOR_SET(1))
-{
-	float4x4 gEntityMatrix;
-	float4 gEntityParamsA;
-	float4 gEntityParamsB;
-}
-
-void main_vs(
-	float3 inPosition : POSITION,
-	float4 inNormal : NORMAL,
-	float2 inTexcoords : TEXCOORD,
-	float4 inColour : COLOR,
-
-	out float4 outPosition : SV_POSITION,
-	out float4 outNormal : NORMAL,
-	out float2 outTexcoords : TEXCOORD,
-	out float3 outColour : COLOR
-)
-{
-	//float4x4 finalMatrix = mul( gEntityMatrix, mul( gViewMatrix, gProjectionMatrix ) );
-	//float4 transformedPos = mul( float4( inPosition, 1.0 ), finalMatrix );
-	//float4 transformedNormal = mul( float4( inNormal, 0.0 ), gEntityMatrix );
-
-	//outPosition = transformedPos;
-	outPosition = float4( inPosition, 1.0 );
-	outTexcoords = inTexcoords;
-	outColour = inColour;
-	//outNormal = transformedNormal.xyz;
-	outNormal = inNormal;
-}
-
-//SamplerState diffuseSampler : register(s0);
-//Texture2D diffuseTexture : register(t0 VK_DESCRIPTOR_SET(1));
-
-float HalfLambert( float3 normal, float3 lightDir )
-{
-	return dot( normal, normalize( lightDir ) ) * 0.5 + 0.5;
-}
-// ^ TODO: move to a common include file
-
-void main_ps(
-	in float4 inPosition : SV_POSITION,
-	in float4 inNormal : NORMAL,
-	in float2 inTexcoords : TEXCOORD,
-	in float3 inColour : COLOR,
-
-	out float4 outColour : SV_TARGET0
-)
-{
-	//outColour.rgb = float3( 1.0, 1.0, 1.0 );
-	outColour.rgb = inColour;
-	//outColour.rgb = diffuseTexture.Sample( diffuseSampler, inTexcoords ).rgb;
-	//outColour.rgb *= HalfLambert( inNormal, float3( 20.0, 40.0, 60.0 ) ); // Fake light source
-	outColour.a = 1.0;
-}
+
+// If you use row-major matrices with HLSL, you'll need this: 
+//#pragma pack_matrix(row_major)
+// ...because HLSL is column-major
+
+// These macros here are for Vulkan compatibility
+// Registers (b0, t0, c0 etc.) don't quite exist in Vulkan and OpenGL, so the folks who
+// were solving this figured "Oh, let's just define offsets, buffers start at 0, samplers start at 128" etc.
+// And this is basically the adapter for that
+#ifdef SPIRV
+#define VK_PUSH_CONSTANT [[vk::push_constant]]
+#define VK_BINDING(reg,dset) [[vk::binding(reg,dset)]]
+#define VK_DESCRIPTOR_SET(dset) ,space##dset
+#else
+#define VK_PUSH_CONSTANT
+#define VK_BINDING(reg,dset) 
+#define VK_DESCRIPTOR_SET(dset)
+#endif
+// ^ these should actually be moved to an include file
+
+cbuffer PerViewFrameBuffer : register(b0)
+{
+	float4x4 gViewMatrix;
+	float4x4 gProjectionMatrix;
+	float gTime;
+}
+
+// See RenderFrontend::EntityData, all entities are in one buffer
+struct EntityData
+{
+	float4x4 transform;
+	float4 paramsA;
+	float4 paramsB;
+};
+
+// See RenderFrontend::EntityConstants
+struct EntityConstants
+{
+	uint entityIndex;
+	uint materialIndex;
+};
+
+StructuredBuffer<EntityData> gEntities : register(t0 VK_DESCRIPTOR_SET(1));
+
+#ifdef DXBC
+cbuffer EntityConstantBuffer : register(b1)
+{
+	EntityConstants gEntity;
+}
+#else
+VK_PUSH_CONSTANT ConstantBuffer<EntityConstants> gEntity : register(b1);
+#endif
+
+// Features of the vertex shader, see EntityFeatures in Model.hpp
+// Every combination is compiled separately, see shaders.cfg
+#ifndef VERTEX_COLOURS
+#define VERTEX_COLOURS 0
+#endif
+
+void main_vs(
+	float3 inPosition : POSITION,
+	float4 inNormal : NORMAL,
+	float2 inTexcoords : TEXCOORD,
+#if VERTEX_COLOURS
+	float4 inColour : COLOR,
+#endif
+
+	out float4 outPosition : SV_POSITION,
+	out float4 outNormal : NORMAL,
+	out float2 outTexcoords : TEXCOORD,
+	out float3 outColour : COLOR
+)
+{
+	// Same order as shadow.hlsl, the matrices are column-major
+	const float4x4 entityMatrix = gEntities[gEntity.entityIndex].transform;
+	const float4 worldPosition = mul( entityMatrix, float4( inPosition, 1.0 ) );
+
+	outPosition = mul( gProjectionMatrix, mul( gViewMatrix, worldPosition ) );
+	outTexcoords = inTexcoords;
+#if VERTEX_COLOURS
+	outColour = inColour.rgb;
+#else
+	outColour = 1.0;
+#endif
+	outNormal = mul( entityMatrix, float4( inNormal.xyz, 0.0 ) );
+}
+
+// Features of the pixel shader, see MaterialFeatures in Material.hpp
+#ifndef BINDLESS
+#define BINDLESS 0
+#endif
+
+// Shader model 5.0 can't index into unbounded arrays, the frontend never asks for this there
+#if defined(DXBC) && BINDLESS
+#undef BINDLESS
+#define BINDLESS 0
+#endif
+
+// See RenderFrontend::MaterialData
+struct MaterialData
+{
+	float4 colour;
+	uint diffuseTexture;
+	uint3 padding;
+};
+
+StructuredBuffer<MaterialData> gMaterials : register(t1 VK_DESCRIPTOR_SET(2));
+SamplerState gMaterialSampler : register(s1 VK_DESCRIPTOR_SET(2));
+
+#if BINDLESS
+// Every texture, indexed by the material. The index is the same for the whole draw,
+// so it doesn't need NonUniformResourceIndex
+// The space is explicit on DXIL too, the table's layout is register space 3 and t0 in space 0 is gEntities
+Texture2D gTextures[] : register(t0, space3);
+#else
+// The material's own binding set
+Texture2D gDiffuseTexture : register(t2 VK_DESCRIPTOR_SET(3));
+#endif
+
+float HalfLambert( float3 normal, float3 lightDir )
+{
+	return dot( normal, normalize( lightDir ) ) * 0.5 + 0.5;
+}
+// ^ TODO: move to a common include file
+
+void main_ps(
+	in float4 inPosition : SV_POSITION,
+	in float4 inNormal : NORMAL,
+	in float2 inTexcoords : TEXCOORD,
+	in float3 inColour : COLOR,
+
+	out float4 outColour : SV_TARGET0
+)
+{
+	const MaterialData material = gMaterials[gEntity.materialIndex];
+#if BINDLESS
+	const float3 diffuse = gTextures[material.diffuseTexture].Sample( gMaterialSampler, inTexcoords ).rgb;
+#else
+	const float3 diffuse = gDiffuseTexture.Sample( gMaterialSampler, inTexcoords ).rgb;
+#endif
+
+	outColour.rgb = inColour * material.colour.rgb * diffuse;
+	//outColour.rgb *= HalfLambert( inNormal, float3( 20.0, 40.0, 60.0 ) ); // Fake light source
+	outColour.a = 1.0;
+}
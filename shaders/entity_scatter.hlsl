@@ -0,0 +1,53 @@
+// Puts changed entity data into the persistent entity buffer, see RenderFrontend::FlushEntityUploads
+// One thread per changed entity
+
+#ifdef SPIRV
+#define VK_PUSH_CONSTANT [[vk::push_constant]]
+#else
+#define VK_PUSH_CONSTANT
+#endif
+
+// See RenderFrontend::EntityData
+struct EntityData
+{
+	float4x4 transform;
+	float4 paramsA;
+	float4 paramsB;
+};
+
+// See RenderFrontend::EntityUpload
+struct EntityUpload
+{
+	uint slot;
+	uint3 padding;
+	EntityData data;
+};
+
+struct ScatterConstants
+{
+	uint numUploads;
+};
+
+#ifdef DXBC
+cbuffer ScatterConstantBuffer : register(b0)
+{
+	ScatterConstants gScatter;
+}
+#else
+VK_PUSH_CONSTANT ConstantBuffer<ScatterConstants> gScatter : register(b0);
+#endif
+
+StructuredBuffer<EntityUpload> gUploads : register(t0);
+RWStructuredBuffer<EntityData> gEntities : register(u0);
+
+[numthreads(64, 1, 1)]
+void main_cs( uint3 threadId : SV_DispatchThreadID )
+{
+	if ( threadId.x >= gScatter.numUploads )
+	{
+		return;
+	}
+
+	const EntityUpload upload = gUploads[threadId.x];
+	gEntities[upload.slot] = upload.data;
+}
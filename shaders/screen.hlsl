@@ -1,27 +1,185 @@
-
-void main_vs(
-	float2 inPosition : POSITION,
-	float2 inTexcoords : TEXCOORD,
-
-	out float4 outPosition : SV_POSITION,
-	out float2 outTexcoords : TEXCOORD
-)
-{
-	outPosition = float4( inPosition, 0.0, 1.0 );
-	outTexcoords = inTexcoords;
-}
-
-Texture2D screenTexture : register(t0);
-Texture2D depthTexture : register(t1);
-SamplerState screenSampler : register(s0);
-
-void main_ps(
-	in float4 inPosition : SV_POSITION,
-	in float2 inTexcoords : TEXCOORD,
-
-	out float4 outColour : SV_TARGET0
-)
-{
-	outColour.rgb = screenTexture.Sample( screenSampler, inTexcoords ).rgb;
-	outColour.a = 1.0;
-}
+
+#ifdef SPIRV
+#define VK_PUSH_CONSTANT [[vk::push_constant]]
+#define VK_DESCRIPTOR_SET(dset) ,space##dset
+#else
+#define VK_PUSH_CONSTANT
+#define VK_DESCRIPTOR_SET(dset)
+#endif
+
+// See RenderFrontend::ScreenConstants, shared by all post-process passes
+struct ScreenConstants
+{
+	float2 uvScale;
+	float2 texelSize;
+	float4 colourFilter;
+	float contrast;
+	float saturation;
+	float sharpness;
+	float bloomIntensity;
+	float bloomThreshold;
+	uint padding;
+	float2 blurDirection;
+};
+
+// Features of the pixel shader, see ScreenFeatures in PostProcess.hpp
+// Every combination is compiled separately, see shaders.cfg
+// 0 is none, 1 is Reinhard, 2 is ACES, like the Tonemapper enum
+#ifndef TONEMAPPER
+#define TONEMAPPER 0
+#endif
+#ifndef GRADING
+#define GRADING 0
+#endif
+#ifndef SHARPEN
+#define SHARPEN 0
+#endif
+#ifndef BLOOM
+#define BLOOM 0
+#endif
+
+#ifdef DXBC
+cbuffer ScreenConstantBuffer : register(b0)
+{
+	ScreenConstants gScreen;
+}
+#else
+VK_PUSH_CONSTANT ConstantBuffer<ScreenConstants> gScreen : register(b0);
+#endif
+
+// One triangle that covers the whole screen, no vertex buffers needed
+// Unlike a quad, there's no diagonal seam where pixels get shaded twice
+void main_vs(
+	uint vertexId : SV_VertexID,
+
+	out float4 outPosition : SV_POSITION,
+	out float2 outTexcoords : TEXCOORD
+)
+{
+	const float2 uv = float2( (vertexId << 1) & 2, vertexId & 2 );
+	outPosition = float4( uv.x * 2.0 - 1.0, 1.0 - uv.y * 2.0, 0.0, 1.0 );
+	// Views with dynamic resolution only render into a part of their attachments
+	outTexcoords = uv * gScreen.uvScale;
+}
+
+Texture2D screenTexture : register(t0);
+Texture2D depthTexture : register(t1);
+SamplerState screenSampler : register(s0);
+// A black texel if bloom is off
+Texture2D bloomTexture : register(t2 VK_DESCRIPTOR_SET(1));
+
+// Catmull-Rom upscaling in 9 bilinear taps instead of 16 point ones
+// Sharper than plain bilinear, which matters when upscaling from a lower resolution
+// Taps are clamped to the rendered part, so nothing bleeds in from outside of it
+float3 SampleCatmullRom( float2 uv )
+{
+	const float2 texelSize = gScreen.texelSize;
+	const float2 uvMin = texelSize * 0.5;
+	const float2 uvMax = gScreen.uvScale - texelSize * 0.5;
+
+	const float2 samplePosition = uv / texelSize;
+	const float2 texelPosition1 = floor( samplePosition - 0.5 ) + 0.5;
+	const float2 f = samplePosition - texelPosition1;
+
+	const float2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));
+	const float2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);
+	const float2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));
+	const float2 w3 = f * f * (-0.5 + 0.5 * f);
+
+	// The middle two taps are merged into one bilinear tap
+	const float2 w12 = w1 + w2;
+	const float2 offset12 = w2 / w12;
+
+	const float2 uv0 = clamp( (texelPosition1 - 1.0) * texelSize, uvMin, uvMax );
+	const float2 uv3 = clamp( (texelPosition1 + 2.0) * texelSize, uvMin, uvMax );
+	const float2 uv12 = clamp( (texelPosition1 + offset12) * texelSize, uvMin, uvMax );
+
+	float3 result = 0.0;
+	result += screenTexture.SampleLevel( screenSampler, float2( uv0.x, uv0.y ), 0 ).rgb * w0.x * w0.y;
+	result += screenTexture.SampleLevel( screenSampler, float2( uv12.x, uv0.y ), 0 ).rgb * w12.x * w0.y;
+	result += screenTexture.SampleLevel( screenSampler, float2( uv3.x, uv0.y ), 0 ).rgb * w3.x * w0.y;
+
+	result += screenTexture.SampleLevel( screenSampler, float2( uv0.x, uv12.y ), 0 ).rgb * w0.x * w12.y;
+	result += screenTexture.SampleLevel( screenSampler, float2( uv12.x, uv12.y ), 0 ).rgb * w12.x * w12.y;
+	result += screenTexture.SampleLevel( screenSampler, float2( uv3.x, uv12.y ), 0 ).rgb * w3.x * w12.y;
+
+	result += screenTexture.SampleLevel( screenSampler, float2( uv0.x, uv3.y ), 0 ).rgb * w0.x * w3.y;
+	result += screenTexture.SampleLevel( screenSampler, float2( uv12.x, uv3.y ), 0 ).rgb * w12.x * w3.y;
+	result += screenTexture.SampleLevel( screenSampler, float2( uv3.x, uv3.y ), 0 ).rgb * w3.x * w3.y;
+
+	// The negative lobes can overshoot around hard edges
+	return max( result, 0.0 );
+}
+
+float3 SampleClamped( float2 uv )
+{
+	const float2 uvMin = gScreen.texelSize * 0.5;
+	const float2 uvMax = gScreen.uvScale - gScreen.texelSize * 0.5;
+	return screenTexture.SampleLevel( screenSampler, clamp( uv, uvMin, uvMax ), 0 ).rgb;
+}
+
+// Unsharp mask, the neighbours are in the cache already from the upscaling taps
+float3 Sharpen( float3 colour, float2 uv )
+{
+	const float2 texelSize = gScreen.texelSize;
+	const float3 neighbours = 0.25 * (
+		SampleClamped( uv + float2( texelSize.x, 0.0 ) ) +
+		SampleClamped( uv - float2( texelSize.x, 0.0 ) ) +
+		SampleClamped( uv + float2( 0.0, texelSize.y ) ) +
+		SampleClamped( uv - float2( 0.0, texelSize.y ) ) );
+
+	return max( colour + (colour - neighbours) * gScreen.sharpness, 0.0 );
+}
+
+float3 TonemapAces( float3 x )
+{
+	return saturate( (x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14) );
+}
+
+float Luminance( float3 colour )
+{
+	return dot( colour, float3( 0.2126, 0.7152, 0.0722 ) );
+}
+
+float3 GradeColour( float3 colour )
+{
+	colour *= gScreen.colourFilter.rgb;
+	colour = (colour - 0.18) * gScreen.contrast + 0.18;
+	colour = lerp( Luminance( colour ), colour, gScreen.saturation );
+	return saturate( colour );
+}
+
+// All per-pixel effects in one pass: upscale, sharpen, bloom, exposure, tonemap, grade
+void main_ps(
+	in float4 inPosition : SV_POSITION,
+	in float2 inTexcoords : TEXCOORD,
+
+	out float4 outColour : SV_TARGET0
+)
+{
+	float3 colour = SampleCatmullRom( inTexcoords );
+
+#if SHARPEN
+	colour = Sharpen( colour, inTexcoords );
+#endif
+
+	// Bloom targets cover just the rendered part
+#if BLOOM
+	colour += bloomTexture.SampleLevel( screenSampler, inTexcoords / gScreen.uvScale, 0 ).rgb * gScreen.bloomIntensity;
+#endif
+
+	colour *= gScreen.colourFilter.a;
+
+#if TONEMAPPER == 1
+	colour = colour / (1.0 + Luminance( colour ));
+#elif TONEMAPPER == 2
+	colour = TonemapAces( colour );
+#endif
+
+#if GRADING
+	colour = GradeColour( colour );
+#endif
+
+	outColour.rgb = saturate( colour );
+	outColour.a = 1.0;
+}
@@ -0,0 +1,53 @@
+// Depth-only pass for shadow maps, see RenderFrontend.Shadow.cpp
+// The view matrix is identity and the projection is the light's projection * view,
+// so this uses the same constant buffers as the default shader
+
+#ifdef SPIRV
+#define VK_PUSH_CONSTANT [[vk::push_constant]]
+#define VK_DESCRIPTOR_SET(dset) ,space##dset
+#else
+#define VK_PUSH_CONSTANT
+#define VK_DESCRIPTOR_SET(dset)
+#endif
+
+cbuffer PerViewFrameBuffer : register(b0)
+{
+	float4x4 gViewMatrix;
+	float4x4 gProjectionMatrix;
+	float gTime;
+}
+
+// See RenderFrontend::EntityData
+struct EntityData
+{
+	float4x4 transform;
+	float4 paramsA;
+	float4 paramsB;
+};
+
+// See RenderFrontend::EntityConstants
+struct EntityConstants
+{
+	uint entityIndex;
+	uint materialIndex;
+};
+
+StructuredBuffer<EntityData> gEntities : register(t0 VK_DESCRIPTOR_SET(1));
+
+#ifdef DXBC
+cbuffer EntityConstantBuffer : register(b1)
+{
+	EntityConstants gEntity;
+}
+#else
+VK_PUSH_CONSTANT ConstantBuffer<EntityConstants> gEntity : register(b1);
+#endif
+
+void main_vs(
+	float3 inPosition : POSITION,
+	out float4 outPosition : SV_POSITION
+)
+{
+	const float4 worldPosition = mul( gEntities[gEntity.entityIndex].transform, float4( inPosition, 1.0 ) );
+	outPosition = mul( gProjectionMatrix, mul( gViewMatrix, worldPosition ) );
+}
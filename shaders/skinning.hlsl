@@ -0,0 +1,91 @@
+// Skins the positions and normals of one face into an entity's own buffers, see RenderFrontend::SkinEntities
+// One thread per vertex. Skinning::SkinVertices is the CPU version of this, keep the two in sync
+
+#ifdef SPIRV
+#define VK_PUSH_CONSTANT [[vk::push_constant]]
+#define VK_DESCRIPTOR_SET(dset) ,space##dset
+#else
+#define VK_PUSH_CONSTANT
+#define VK_DESCRIPTOR_SET(dset)
+#endif
+
+// See RenderFrontend::SkinningConstants
+struct SkinningConstants
+{
+	uint numVertices;
+	// Where the entity's bones start in the palette
+	uint firstBone;
+	uint numBones;
+	uint padding;
+};
+
+#ifdef DXBC
+cbuffer SkinningConstantBuffer : register(b0)
+{
+	SkinningConstants gSkinning;
+}
+#else
+VK_PUSH_CONSTANT ConstantBuffer<SkinningConstants> gSkinning : register(b0);
+#endif
+
+// Bones of every entity skinned this frame
+StructuredBuffer<float4x4> gBonePalette : register(t0);
+
+// The model's vertex streams, see Skinning.hpp for the formats
+ByteAddressBuffer gPositions : register(t1 VK_DESCRIPTOR_SET(1));
+ByteAddressBuffer gNormals : register(t2 VK_DESCRIPTOR_SET(1));
+ByteAddressBuffer gBoneIndices : register(t3 VK_DESCRIPTOR_SET(1));
+ByteAddressBuffer gBoneWeights : register(t4 VK_DESCRIPTOR_SET(1));
+
+RWByteAddressBuffer gSkinnedPositions : register(u0 VK_DESCRIPTOR_SET(1));
+RWByteAddressBuffer gSkinnedNormals : register(u1 VK_DESCRIPTOR_SET(1));
+
+float3 UnpackSnorm8( uint packed )
+{
+	const int3 values = int3( packed << 24, packed << 16, packed << 8 ) >> 24;
+	return max( float3( values ) / 127.0, -1.0 );
+}
+
+uint PackSnorm8( float3 value )
+{
+	const int3 values = int3( round( clamp( value, -1.0, 1.0 ) * 127.0 ) );
+	return (values.x & 0xff) | ((values.y & 0xff) << 8) | ((values.z & 0xff) << 16);
+}
+
+float4x4 GetBone( uint index )
+{
+	return gBonePalette[gSkinning.firstBone + min( index, gSkinning.numBones - 1 )];
+}
+
+[numthreads(64, 1, 1)]
+void main_cs( uint3 threadId : SV_DispatchThreadID )
+{
+	const uint vertex = threadId.x;
+	if ( vertex >= gSkinning.numVertices )
+	{
+		return;
+	}
+
+	const float3 position = asfloat( gPositions.Load3( vertex * 12 ) );
+	const uint packedNormal = gNormals.Load( vertex * 4 );
+	const uint indices = gBoneIndices.Load( vertex * 4 );
+	const uint packedWeights = gBoneWeights.Load( vertex * 4 );
+
+	float4 weights = float4( packedWeights & 0xff, (packedWeights >> 8) & 0xff, (packedWeights >> 16) & 0xff, packedWeights >> 24 );
+	const float weightSum = dot( weights, 1.0 );
+	weights = weightSum > 0.0 ? weights / weightSum : float4( 1.0, 0.0, 0.0, 0.0 );
+
+	const float4x4 skin =
+		GetBone( indices & 0xff ) * weights.x
+		+ GetBone( (indices >> 8) & 0xff ) * weights.y
+		+ GetBone( (indices >> 16) & 0xff ) * weights.z
+		+ GetBone( indices >> 24 ) * weights.w;
+
+	const float3 skinnedPosition = mul( skin, float4( position, 1.0 ) ).xyz;
+	const float3 skinnedNormal = mul( skin, float4( UnpackSnorm8( packedNormal ), 0.0 ) ).xyz;
+	const float normalLength = length( skinnedNormal );
+
+	gSkinnedPositions.Store3( vertex * 12, asuint( skinnedPosition ) );
+	gSkinnedNormals.Store( vertex * 4, PackSnorm8( normalLength > 0.0 ? skinnedNormal / normalLength : 0.0 )
+		| (packedNormal & 0xff000000) );
+}
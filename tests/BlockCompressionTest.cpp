@@ -0,0 +1,103 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+// Headless round-trip test of the block compressors
+// Synthetic images are encoded and decoded again, and each format has to stay above a PSNR floor
+// Sizes that aren't a multiple of the block size check the partial blocks at the edges
+//
+// Usage: BtxRendererTests
+
+#include "Precompiled.hpp"
+#include "BlockCompression.hpp"
+#include <cstdio>
+#include <random>
+
+using namespace BlockCompression;
+
+namespace
+{
+	struct FormatCase
+	{
+		Format format;
+		// Only the channels the format stores are compared
+		uint32_t channelMask;
+		double minPSNR;
+	};
+
+	// Floors are a few dB under what the encoders reach, so they catch regressions, not noise
+	constexpr FormatCase FormatCases[] =
+	{
+		{ Format::BC1, 0b0111U, 28.0 },
+		{ Format::BC3, 0b1111U, 29.0 },
+		{ Format::BC4, 0b0001U, 42.0 },
+		{ Format::BC5, 0b0011U, 41.0 },
+		{ Format::BC7, 0b1111U, 29.0 }
+	};
+
+	struct ImageSize
+	{
+		uint32_t width;
+		uint32_t height;
+	};
+
+	constexpr ImageSize ImageSizes[] =
+	{
+		{ 64U, 64U },
+		{ 30U, 18U },
+		{ 1U, 1U }
+	};
+
+	// Smooth gradients with a little noise, roughly what textures look like within a block
+	Vector<uint8_t> MakeImage( uint32_t width, uint32_t height, uint32_t seed )
+	{
+		std::mt19937 random( seed );
+		std::uniform_int_distribution<int> noise( -4, 4 );
+
+		Vector<uint8_t> rgba( size_t( width ) * height * 4U );
+		for ( uint32_t y = 0U; y < height; y++ )
+		{
+			for ( uint32_t x = 0U; x < width; x++ )
+			{
+				const float u = float( x ) / float( std::max( width, 2U ) - 1U );
+				const float v = float( y ) / float( std::max( height, 2U ) - 1U );
+				const float base[4] = { u, v, 1.0f - u * v, 0.5f + 0.5f * (u - v) };
+
+				uint8_t* pixel = &rgba[(size_t( y ) * width + x) * 4U];
+				for ( uint32_t channel = 0U; channel < 4U; channel++ )
+				{
+					pixel[channel] = uint8_t( std::clamp( int( base[channel] * 255.0f ) + noise( random ), 0, 255 ) );
+				}
+			}
+		}
+
+		return rgba;
+	}
+}
+
+int main()
+{
+	int numFailed = 0;
+	for ( const FormatCase& formatCase : FormatCases )
+	{
+		for ( const ImageSize& size : ImageSizes )
+		{
+			const Vector<uint8_t> source = MakeImage( size.width, size.height, size.width * 31U + size.height );
+
+			Vector<uint8_t> encoded;
+			EncodeImage( formatCase.format, source.data(), size.width, size.height, encoded );
+
+			Vector<uint8_t> decoded;
+			DecodeImage( formatCase.format, encoded.data(), size.width, size.height, decoded );
+
+			const double psnr = ComputePSNR( source.data(), decoded.data(), size.width, size.height, formatCase.channelMask );
+			const bool passed = encoded.size() == GetEncodedSize( formatCase.format, size.width, size.height )
+				&& psnr >= formatCase.minPSNR;
+
+			std::printf( "%s %4ux%-4u %6.2f dB (min %.1f) %s\n", ToString( formatCase.format ),
+				size.width, size.height, psnr, formatCase.minPSNR, passed ? "ok" : "FAILED" );
+			numFailed += passed ? 0 : 1;
+		}
+	}
+
+	return numFailed ? 1 : 0;
+}